@@ -46,3 +46,4 @@ __version__ = '2.0'
 
 from numpy.testing import Tester
 test = Tester().test
+bench = Tester().bench
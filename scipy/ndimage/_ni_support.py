@@ -87,3 +87,9 @@ def _check_axis(axis, rank):
     if axis < 0 or axis >= rank:
         raise ValueError('invalid axis')
     return axis
+
+def _check_threads(threads):
+    threads = int(threads)
+    if threads < 1:
+        raise ValueError('number of threads must be at least 1')
+    return threads
@@ -0,0 +1,379 @@
+""" Benchmark functions for the ndimage module
+
+Each case is timed on 2-D and 3-D images of several data types, and its
+throughput is printed in Mpixel/s, together with the peak memory that it
+allocates (on Linux). To compare two builds, run the benchmarks of the
+first one with the NDIMAGE_BENCH_SAVE environment variable set to a file
+name, and those of the second one with NDIMAGE_BENCH_COMPARE set to the
+same file: the ratio of the throughputs is then printed as well.
+"""
+import os
+import sys
+import time
+
+import numpy
+from numpy.testing import *
+
+from scipy import ndimage
+
+# images of 2**18 and 2**21 pixels in two and three dimensions:
+shapes = [(512, 512), (2048, 1024), (64, 64, 64), (128, 128, 128)]
+small_shapes = [(512, 512), (64, 64, 64)]
+dtypes = [numpy.uint8, numpy.int32, numpy.float32, numpy.float64]
+modes = ['reflect', 'constant', 'nearest', 'mirror', 'wrap']
+
+_saved = None
+_results = {}
+
+def _load_saved():
+    global _saved
+    if _saved is None:
+        _saved = {}
+        name = os.environ.get('NDIMAGE_BENCH_COMPARE')
+        if name:
+            f = open(name)
+            for line in f:
+                key, value = line.rstrip('\n').split('\t')
+                _saved[key] = float(value)
+            f.close()
+    return _saved
+
+def _save(key, value):
+    name = os.environ.get('NDIMAGE_BENCH_SAVE')
+    if name:
+        _results[key] = value
+        f = open(name, 'w')
+        keys = _results.keys()
+        keys.sort()
+        for k in keys:
+            f.write('%s\t%r\n' % (k, _results[k]))
+        f.close()
+
+def _memory():
+    """Current and peak resident memory in bytes, None if not known"""
+    try:
+        f = open('/proc/self/status')
+    except IOError:
+        return None, None
+    current = peak = None
+    for line in f:
+        if line.startswith('VmRSS:'):
+            current = int(line.split()[1]) * 1024
+        elif line.startswith('VmHWM:'):
+            peak = int(line.split()[1]) * 1024
+    f.close()
+    return current, peak
+
+def _reset_peak_memory():
+    try:
+        f = open('/proc/self/clear_refs', 'w')
+        f.write('5')
+        f.close()
+    except (IOError, OSError):
+        return False
+    return True
+
+def _image(shape, dtype, kind = 'random'):
+    numpy.random.seed(0)
+    if kind == 'binary':
+        return numpy.random.random(shape) > 0.3
+    if kind == 'blobs':
+        image = ndimage.gaussian_filter(numpy.random.random(shape), 2)
+        return image > image.mean()
+    image = numpy.random.random(shape) * 100
+    return image.astype(dtype)
+
+def _cross(rank, radius):
+    """Footprint of the elements within a city block distance"""
+    indices = numpy.indices((2 * radius + 1,) * rank) - radius
+    return numpy.abs(indices).sum(axis = 0) <= radius
+
+def _header(title):
+    print
+    print title
+    print '=' * 79
+    print '%-30s|%-16s|%-8s|%9s |%8s |%6s' % (' case', ' shape', ' dtype',
+                                             'Mpix/s', 'peak MB', 'ratio')
+    print '-' * 79
+
+def _measure(title, case, function, image, repeat = 3):
+    """Print the throughput of function() on an image in Mpixel/s"""
+    shape = 'x'.join([str(ii) for ii in image.shape])
+    dtype = image.dtype.name
+    print '%-30s|%-16s|%-8s|' % (' ' + case, ' ' + shape, ' ' + dtype),
+    sys.stdout.flush()
+    function()
+    current, peak = _memory()
+    if _reset_peak_memory() and current is not None:
+        function()
+        peak = max(_memory()[1] - current, 0) / 2.0 ** 20
+    else:
+        peak = None
+    best = None
+    for ii in range(repeat):
+        t = time.time()
+        function()
+        t = time.time() - t
+        if best is None or t < best:
+            best = t
+    mpixels = image.size / max(best, 1e-9) / 1e6
+    key = '%s|%s|%s|%s' % (title, case, shape, dtype)
+    _save(key, mpixels)
+    saved = _load_saved().get(key)
+    line = '%9.1f |' % mpixels
+    if peak is None:
+        line += '%8s |' % '-'
+    else:
+        line += '%8.1f |' % peak
+    if saved:
+        line += '%6.2f' % (mpixels / saved)
+    print line
+    sys.stdout.flush()
+
+
+class BenchFilters(TestCase):
+
+    def bench_correlate1d(self):
+        _header('One-dimensional correlation along the last axis')
+        for shape in shapes:
+            for dtype in dtypes:
+                image = _image(shape, dtype)
+                for size in [3, 11, 31]:
+                    weights = numpy.ones(size) / size
+                    _measure('correlate1d', 'size %d' % size,
+                             lambda: ndimage.correlate1d(image, weights),
+                             image)
+
+    def bench_correlate1d_modes(self):
+        _header('One-dimensional correlation with the extend modes')
+        for shape in small_shapes:
+            image = _image(shape, numpy.float64)
+            weights = numpy.ones(11) / 11.0
+            for mode in modes:
+                _measure('correlate1d modes', 'size 11 ' + mode,
+                         lambda: ndimage.correlate1d(image, weights, 0,
+                                                     mode = mode), image)
+
+    def bench_correlate(self):
+        _header('Multi-dimensional correlation')
+        for shape in small_shapes:
+            for dtype in dtypes:
+                image = _image(shape, dtype)
+                for size in [3, 5]:
+                    box = numpy.ones((size,) * len(shape))
+                    cross = _cross(len(shape), size // 2)
+                    for name, weights in [('box', box), ('cross', cross)]:
+                        _measure('correlate', '%s %d' % (name, size),
+                                 lambda: ndimage.correlate(image, weights),
+                                 image)
+
+    def bench_separable_filters(self):
+        _header('Separable filters')
+        for shape in shapes:
+            for dtype in [numpy.uint8, numpy.float32, numpy.float64]:
+                image = _image(shape, dtype)
+                for name, function in [
+                        ('uniform_filter 5',
+                         lambda: ndimage.uniform_filter(image, 5)),
+                        ('gaussian_filter 2',
+                         lambda: ndimage.gaussian_filter(image, 2.0)),
+                        ('gaussian_filter 8',
+                         lambda: ndimage.gaussian_filter(image, 8.0)),
+                        ('gaussian_filter 8 recursive',
+                         lambda: ndimage.gaussian_filter(image, 8.0,
+                                                 recursive = True)),
+                        ('sobel', lambda: ndimage.sobel(image)),
+                        ('laplace', lambda: ndimage.laplace(image))]:
+                    _measure('separable filters', name, function, image)
+
+    def bench_pyramids(self):
+        _header('Gaussian and Laplacian pyramids')
+        for shape in shapes:
+            for dtype in [numpy.uint8, numpy.float64]:
+                image = _image(shape, dtype)
+                arena = numpy.empty(image.size, numpy.float64)
+                for name, function in [
+                        ('gaussian_pyramid',
+                         lambda: ndimage.gaussian_pyramid(image)),
+                        ('gaussian_pyramid arena',
+                         lambda: ndimage.gaussian_pyramid(image,
+                                                output = arena)),
+                        ('laplacian_pyramid',
+                         lambda: ndimage.laplacian_pyramid(image))]:
+                    _measure('pyramids', name, function, image)
+
+    def bench_rank_filters(self):
+        _header('Minimum, maximum and rank filters')
+        for shape in small_shapes:
+            for dtype in [numpy.uint8, numpy.float64]:
+                image = _image(shape, dtype)
+                cross = _cross(len(shape), 1)
+                for name, function in [
+                        ('minimum_filter 3',
+                         lambda: ndimage.minimum_filter(image, 3)),
+                        ('minimum_filter 9',
+                         lambda: ndimage.minimum_filter(image, 9)),
+                        ('maximum_filter cross',
+                         lambda: ndimage.maximum_filter(image,
+                                                footprint = cross)),
+                        ('median_filter 3',
+                         lambda: ndimage.median_filter(image, 3)),
+                        ('median_filter 5',
+                         lambda: ndimage.median_filter(image, 5)),
+                        ('rank_filter cross',
+                         lambda: ndimage.rank_filter(image, 1,
+                                                footprint = cross))]:
+                    _measure('rank filters', name, function, image)
+
+
+class BenchMorphology(TestCase):
+
+    def bench_binary(self):
+        _header('Binary morphology')
+        for shape in shapes:
+            image = _image(shape, None, 'binary')
+            full = ndimage.generate_binary_structure(len(shape), len(shape))
+            for name, function in [
+                    ('binary_erosion',
+                     lambda: ndimage.binary_erosion(image)),
+                    ('binary_erosion full',
+                     lambda: ndimage.binary_erosion(image, full)),
+                    ('binary_erosion 5 times',
+                     lambda: ndimage.binary_erosion(image, iterations = 5)),
+                    ('binary_dilation brute_force',
+                     lambda: ndimage.binary_dilation(image,
+                                                     brute_force = True)),
+                    ('binary_opening',
+                     lambda: ndimage.binary_opening(image)),
+                    ('binary_fill_holes',
+                     lambda: ndimage.binary_fill_holes(image))]:
+                _measure('binary morphology', name, function, image)
+
+    def bench_grey(self):
+        _header('Grey morphology')
+        for shape in small_shapes:
+            for dtype in [numpy.uint8, numpy.float64]:
+                image = _image(shape, dtype)
+                # grey_dilation indexes size, so it must be a sequence:
+                size3, size7 = (3,) * image.ndim, (7,) * image.ndim
+                for name, function in [
+                        ('grey_erosion 3',
+                         lambda: ndimage.grey_erosion(image, size3)),
+                        ('grey_dilation 7',
+                         lambda: ndimage.grey_dilation(image, size7)),
+                        ('grey_opening 3',
+                         lambda: ndimage.grey_opening(image, size3)),
+                        ('morphological_gradient 3',
+                         lambda: ndimage.morphological_gradient(image,
+                                                                size3))]:
+                    _measure('grey morphology', name, function, image)
+
+
+class BenchInterpolation(TestCase):
+
+    def bench_transforms(self):
+        _header('Interpolation')
+        for shape in small_shapes:
+            for dtype in [numpy.uint8, numpy.float32, numpy.float64]:
+                image = _image(shape, dtype)
+                for order in [0, 1, 3]:
+                    _measure('interpolation', 'zoom 1.5 order %d' % order,
+                             lambda: ndimage.zoom(image, 1.5, order = order),
+                             image)
+                    _measure('interpolation', 'shift order %d' % order,
+                             lambda: ndimage.shift(image, 0.5, order = order),
+                             image)
+                    _measure('interpolation', 'rotate order %d' % order,
+                             lambda: ndimage.rotate(image, 30,
+                                                    order = order),
+                             image)
+                _measure('interpolation', 'spline_filter',
+                         lambda: ndimage.spline_filter(image), image)
+
+    def bench_transform_modes(self):
+        _header('Interpolation with the extend modes')
+        for shape in small_shapes:
+            image = _image(shape, numpy.float64)
+            matrix = numpy.identity(len(shape)) * 0.9
+            for mode in modes:
+                _measure('interpolation modes', 'affine order 3 ' + mode,
+                         lambda: ndimage.affine_transform(image, matrix,
+                                        offset = 5.0, mode = mode), image)
+
+    def bench_map_coordinates(self):
+        _header('Interpolation at coordinates')
+        for shape in small_shapes:
+            image = _image(shape, numpy.float64)
+            numpy.random.seed(1)
+            coordinates = numpy.random.random((len(shape), image.size))
+            coordinates *= numpy.array(shape)[:, numpy.newaxis] - 1
+            for order in [1, 3]:
+                _measure('map_coordinates', 'order %d' % order,
+                         lambda: ndimage.map_coordinates(image, coordinates,
+                                                         order = order),
+                         image)
+
+
+class BenchMeasurements(TestCase):
+
+    def bench_label(self):
+        _header('Labeling')
+        for shape in shapes:
+            image = _image(shape, None, 'blobs')
+            full = ndimage.generate_binary_structure(len(shape), len(shape))
+            labels, n = ndimage.label(image)
+            for name, function in [
+                    ('label', lambda: ndimage.label(image)),
+                    ('label full', lambda: ndimage.label(image, full)),
+                    ('find_objects', lambda: ndimage.find_objects(labels))]:
+                _measure('labeling', name, function, image)
+
+    def bench_statistics(self):
+        _header('Measurements at labels')
+        for shape in shapes:
+            for dtype in [numpy.uint8, numpy.float64]:
+                image = _image(shape, dtype)
+                labels, n = ndimage.label(_image(shape, None, 'blobs'))
+                index = numpy.arange(1, n + 1)
+                for name, function in [
+                        ('sum', lambda: ndimage.sum(image, labels, index)),
+                        ('mean', lambda: ndimage.mean(image, labels, index)),
+                        ('variance',
+                         lambda: ndimage.variance(image, labels, index)),
+                        ('minimum',
+                         lambda: ndimage.minimum(image, labels, index)),
+                        ('center_of_mass',
+                         lambda: ndimage.center_of_mass(image, labels,
+                                                        index)),
+                        ('histogram',
+                         lambda: ndimage.histogram(image, 0, 100, 10,
+                                                   labels, index))]:
+                    _measure('measurements', name, function, image)
+
+
+class BenchDistance(TestCase):
+
+    def bench_distance_transforms(self):
+        _header('Distance transforms')
+        for shape in shapes:
+            image = _image(shape, None, 'blobs')
+            for name, function in [
+                    ('edt',
+                     lambda: ndimage.distance_transform_edt(image)),
+                    ('edt indices',
+                     lambda: ndimage.distance_transform_edt(image,
+                                        return_indices = True)),
+                    ('cdt chessboard',
+                     lambda: ndimage.distance_transform_cdt(image)),
+                    ('cdt taxicab',
+                     lambda: ndimage.distance_transform_cdt(image,
+                                                    'taxicab'))]:
+                _measure('distance transforms', name, function, image)
+        for shape in [(64, 64), (16, 16, 16)]:
+            image = _image(shape, None, 'blobs')
+            _measure('distance transforms', 'bf',
+                     lambda: ndimage.distance_transform_bf(image), image)
+
+
+if __name__ == "__main__":
+    run_module_suite()
@@ -29,6 +29,7 @@
 # SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 import math
+import threading
 import numpy
 import _ni_support
 import _nd_image
@@ -71,6 +72,16 @@ _cval_doc = \
 _origin_doc = \
 """origin : scalar, optional
 The ``origin`` parameter controls the placement of the filter. Default 0"""
+_recursive_doc = \
+"""recursive : bool, optional
+    If True, the Gaussian filters are approximated by recursive filters,
+    whose cost does not depend on sigma, instead of being correlated
+    with a kernel of radius 4 * sigma. Only orders up to 2 are
+    supported. Default is False"""
+_threads_doc = \
+"""threads : int, optional
+    The number of threads over which the lines of the array are divided.
+    The threads run without the global interpreter lock. Default is 1"""
 _extra_arguments_doc = \
 """extra_arguments : sequence, optional
     Sequence of extra positional arguments to pass to passed function"""
@@ -86,6 +97,8 @@ docdict = {
     'mode':_mode_doc,
     'cval':_cval_doc,
     'origin':_origin_doc,
+    'recursive':_recursive_doc,
+    'threads':_threads_doc,
     'extra_arguments':_extra_arguments_doc,
     'extra_keywords':_extra_keywords_doc,
     }
@@ -94,7 +107,7 @@ docfiller = doccer.filldoc(docdict)
 
 @docfiller
 def correlate1d(input, weights, axis = -1, output = None, mode = "reflect",
-                cval = 0.0, origin = 0):
+                cval = 0.0, origin = 0, threads = 1):
     """Calculate a one-dimensional correlation along the given axis.
 
     The lines of the array along the given axis are correlated with the
@@ -110,6 +123,7 @@ def correlate1d(input, weights, axis = -1, output = None, mode = "reflect",
     %(mode)s
     %(cval)s
     %(origin)s
+    %(threads)s
     """
     input = numpy.asarray(input)
     if numpy.iscomplexobj(input):
@@ -125,14 +139,15 @@ def correlate1d(input, weights, axis = -1, output = None, mode = "reflect",
         (len(weights) // 2 + origin > len(weights))):
         raise ValueError('invalid origin')
     mode = _ni_support._extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
     _nd_image.correlate1d(input, weights, axis, output, mode, cval,
-                          origin)
+                          origin, threads)
     return return_value
 
 
 @docfiller
 def convolve1d(input, weights, axis = -1, output = None, mode = "reflect",
-               cval = 0.0, origin = 0):
+               cval = 0.0, origin = 0, threads = 1):
     """Calculate a one-dimensional convolution along the given axis.
 
     The lines of the array along the given axis are convolved with the
@@ -148,36 +163,148 @@ def convolve1d(input, weights, axis = -1, output = None, mode = "reflect",
     %(mode)s
     %(cval)s
     %(origin)s
+    %(threads)s
     """
     weights = weights[::-1]
     origin = -origin
     if not len(weights) & 1:
         origin -= 1
-    return correlate1d(input, weights, axis, output, mode, cval, origin)
+    return correlate1d(input, weights, axis, output, mode, cval, origin,
+                       threads)
 
 
-@docfiller
-def gaussian_filter1d(input, sigma, axis = -1, order = 0, output = None,
-                      mode = "reflect", cval = 0.0):
-    """One-dimensional Gaussian filter.
+_separable_kinds = {None: 0, 'correlate': 1, 'uniform': 2, 'minimum': 3,
+                    'maximum': 4}
 
-    Parameters
-    ----------
-    %(input)s
-    sigma : scalar
-        standard deviation for Gaussian kernel
-    %(axis)s
-    order : {0, 1, 2, 3}, optional
-        An order of 0 corresponds to convolution with a Gaussian
-        kernel. An order of 1, 2, or 3 corresponds to convolution with
-        the first, second or third derivatives of a Gaussian. Higher
-        order derivatives are not implemented
-    %(output)s
-    %(mode)s
-    %(cval)s
+def _separable_filter(input, filters, output, mode, cval, threads = 1):
+    """Apply one-dimensional filters along several axes in one pass.
+
+    filters is a list with an item (kind, weights or size, origin) for
+    each axis, or None for axes that are not filtered. The array is
+    processed in tiles that fit in the cache, with intermediate results
+    in double precision. If the halos of the tiles would cost more than
+    they save, the axes are filtered in turn, with intermediate results
+    in the output. Returns False, without filtering, if the
+    filters cannot be combined, so that the caller can filter each axis
+    in turn. The tiles are divided over the given number of threads.
     """
-    if order not in range(4):
-        raise ValueError('Order outside 0..3 not implemented')
+    kinds, sizes, origins, weights = [], [], [], []
+    for item in filters:
+        if item is None:
+            kinds.append(0)
+            sizes.append(1)
+            origins.append(0)
+            continue
+        kind, size, origin = item
+        if kind == 'correlate':
+            weights.extend(size)
+            size = len(size)
+        size = int(size)
+        if size // 2 + origin < 0 or size // 2 + origin > size - 1:
+            return False
+        kinds.append(_separable_kinds[kind])
+        sizes.append(size)
+        origins.append(origin)
+    if numpy.may_share_memory(input, output):
+        input = input.copy()
+    weights = numpy.asarray(weights, dtype=numpy.float64)
+    mode = _ni_support._extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
+    _nd_image.separable_filter(input, kinds, sizes, origins, weights, output,
+                               mode, cval, threads)
+    return True
+
+
+# Recursive approximations of the Gaussian and its derivatives, for unit
+# standard deviation and x >= 0, as the parameters (a, b, lambda, omega)
+# of a sum of terms (a * cos(omega * x) + b * sin(omega * x)) *
+# exp(-lambda * x). Orders 0 and 1 are those of Deriche; the second
+# order uses the coefficients of Farneback and Westin, which share their
+# poles with a Gaussian so that the two can be combined:
+_deriche_terms = {
+    0: [(1.680, 3.735, 1.783, 0.6318), (-0.6803, -0.2598, 1.723, 1.997)],
+    1: [(-0.6472, -4.531, 1.527, 0.6719), (0.6494, 0.9557, 1.516, 2.072)]}
+_farneback_terms = {
+    0: [(1.3530, 1.8151, 1.3932, 0.6681), (-0.3531, 0.0902, 1.3732, 2.0787)],
+    2: [(-1.3563, 5.2318, 1.3932, 0.6681), (0.3446, -2.2355, 1.3732, 2.0787)]}
+
+
+def _recursive_parts(terms, sigma, antisymmetric):
+    """Causal and anti-causal numerators and the common denominator of a
+    recursive filter that is symmetric or anti-symmetric around 0."""
+    # each term is the real part of a geometric series in the sample
+    # index, so the causal part is a sum of rational functions of the
+    # delay, here with coefficients in increasing powers of the delay:
+    num = numpy.zeros(1, dtype=complex)
+    den = numpy.ones(1, dtype=complex)
+    for a, b, lam, omega in terms:
+        p = numpy.exp((-lam + 1j * omega) / sigma)
+        for c, q in [(a - 1j * b, p), (a + 1j * b, p.conjugate())]:
+            num = numpy.convolve(num, [1.0, -q])
+            num[:len(den)] += 0.5 * c * den
+            den = numpy.convolve(den, [1.0, -q])
+    num = num.real[:4]
+    den = den.real
+    # the anti-causal part mirrors the causal part, without the center:
+    tail = numpy.concatenate((num[1:] - num[0] * den[1:4],
+                              [-num[0] * den[4]]))
+    if antisymmetric:
+        # the center is left out of both parts:
+        return numpy.concatenate(([0.0], tail)), -tail, den
+    return num, tail, den
+
+
+def _recursive_moments(causal, anticausal, den):
+    """Moments sum(k**p * h[k]), p = 0, 1, 2, of the impulse response h
+    of a recursive filter."""
+    def moments(num):
+        # derivatives at 1 of num / den as a function of the delay:
+        n = [numpy.polyval(numpy.polyder(num[::-1], i), 1.0)
+             for i in range(3)]
+        d = [numpy.polyval(numpy.polyder(den[::-1], i), 1.0)
+             for i in range(3)]
+        m0 = n[0] / d[0]
+        m1 = (n[1] * d[0] - n[0] * d[1]) / d[0] ** 2
+        m2 = ((n[2] * d[0] - n[0] * d[2]) * d[0] -
+              2.0 * d[1] * (n[1] * d[0] - n[0] * d[1])) / d[0] ** 3
+        return m0, m1, m2 + m1
+    c = moments(causal)
+    a = moments(numpy.concatenate(([0.0], anticausal)))
+    return c[0] + a[0], c[1] - a[1], c[2] + a[2]
+
+
+def _gaussian_recursive_coefficients(sigma, order):
+    """Coefficients of a recursive Gaussian filter of the given order.
+
+    Returns the numerators of the causal and anti-causal parts and their
+    common denominator, as used by _nd_image.recursive_filter1d. The
+    filters are normalized to be exact for polynomials up to the order.
+    """
+    if order == 2:
+        causal, anticausal, den = _recursive_parts(_farneback_terms[2],
+                                                   sigma, False)
+        causal0, anticausal0, den = _recursive_parts(_farneback_terms[0],
+                                                     sigma, False)
+        # add a Gaussian to make the response to a constant zero:
+        beta = -(_recursive_moments(causal, anticausal, den)[0] /
+                 _recursive_moments(causal0, anticausal0, den)[0])
+        causal = causal + beta * causal0
+        anticausal = anticausal + beta * anticausal0
+        scale = 2.0 / _recursive_moments(causal, anticausal, den)[2]
+    else:
+        causal, anticausal, den = _recursive_parts(_deriche_terms[order],
+                                                   sigma, order == 1)
+        moments = _recursive_moments(causal, anticausal, den)
+        if order == 0:
+            scale = 1.0 / moments[0]
+        else:
+            scale = -1.0 / moments[1]
+    return (causal * scale, anticausal * scale,
+            numpy.ascontiguousarray(den[1:]))
+
+
+def _gaussian_kernel1d(sigma, order):
+    """Weights of a Gaussian kernel, or of a derivative of it"""
     sd = float(sigma)
     # make the length of the filter equal to 4 times the standard
     # deviations:
@@ -217,12 +344,76 @@ def gaussian_filter1d(input, sigma, axis = -1, order = 0, output = None,
             tmp = (3.0 - x * x / sd) * x * weights[lw + ii] / sd2
             weights[lw + ii] = -tmp
             weights[lw - ii] = tmp
-    return correlate1d(input, weights, axis, output, mode, cval, 0)
+    return weights
+
+
+@docfiller
+def gaussian_filter1d(input, sigma, axis = -1, order = 0, output = None,
+                      mode = "reflect", cval = 0.0, recursive = False,
+                      threads = 1):
+    """One-dimensional Gaussian filter.
+
+    Parameters
+    ----------
+    %(input)s
+    sigma : scalar
+        standard deviation for Gaussian kernel
+    %(axis)s
+    order : {0, 1, 2, 3}, optional
+        An order of 0 corresponds to convolution with a Gaussian
+        kernel. An order of 1, 2, or 3 corresponds to convolution with
+        the first, second or third derivatives of a Gaussian. Higher
+        order derivatives are not implemented
+    %(output)s
+    %(mode)s
+    %(cval)s
+    %(recursive)s
+    %(threads)s
+
+    Notes
+    -----
+    The recursive filters are fourth order approximations (Deriche;
+    Farneback and Westin), applied forward and backward along each
+    line. They are exact for polynomials up to their order, and match
+    the Gaussian kernels to about 5e-4 (order 0), 5e-3 (order 1) and
+    2e-2 (order 2) relative to the peak of the kernel, for sigma of 1
+    and larger.
+    For the 'nearest' and 'constant' modes the borders are exact; for
+    the other modes the lines are extended by 6 * sigma before filtering.
+    """
+    if recursive:
+        if order not in range(3):
+            raise ValueError('Order outside 0..2 not implemented for '
+                             'recursive filters')
+        input = numpy.asarray(input)
+        if numpy.iscomplexobj(input):
+            raise TypeError('Complex type not supported')
+        output, return_value = _ni_support._get_output(output, input)
+        axis = _ni_support._check_axis(axis, input.ndim)
+        if mode == 'nearest':
+            extension = 0
+        elif mode == 'constant':
+            extension = 1
+        else:
+            extension = int(6.0 * sigma + 0.5)
+        causal, anticausal, denominator = \
+                _gaussian_recursive_coefficients(float(sigma), order)
+        mode = _ni_support._extend_mode_to_code(mode)
+        threads = _ni_support._check_threads(threads)
+        _nd_image.recursive_filter1d(input, causal, anticausal, denominator,
+                                     extension, axis, output, mode, cval,
+                                     threads)
+        return return_value
+    if order not in range(4):
+        raise ValueError('Order outside 0..3 not implemented')
+    weights = _gaussian_kernel1d(sigma, order)
+    return correlate1d(input, weights, axis, output, mode, cval, 0, threads)
 
 
 @docfiller
 def gaussian_filter(input, sigma, order = 0, output = None,
-                  mode = "reflect", cval = 0.0):
+                  mode = "reflect", cval = 0.0, recursive = False,
+                  threads = 1):
     """Multi-dimensional Gaussian filter.
 
     Parameters
@@ -243,15 +434,20 @@ def gaussian_filter(input, sigma, order = 0, output = None,
     %(output)s
     %(mode)s
     %(cval)s
+    %(recursive)s
+    %(threads)s
 
     Notes
     -----
     The multi-dimensional filter is implemented as a sequence of
-    one-dimensional convolution filters. The intermediate arrays are
-    stored in the same data type as the output. Therefore, for output
-    types with a limited precision, the results may be imprecise
-    because intermediate results may be stored with insufficient
-    precision.
+    one-dimensional convolution filters. For floating point outputs
+    the non-recursive filters are applied in a single pass over tiles
+    of the array that fit in the cache, with intermediate results in
+    double precision, unless the kernels are so large that filtering
+    each axis in turn is cheaper. Otherwise the intermediate arrays are
+    stored in the same data type as the output. Therefore, for output types with
+    a limited precision, the results may be imprecise because
+    intermediate results may be stored with insufficient precision.
     """
     input = numpy.asarray(input)
     output, return_value = _ni_support._get_output(output, input)
@@ -262,10 +458,17 @@ def gaussian_filter(input, sigma, order = 0, output = None,
     axes = range(input.ndim)
     axes = [(axes[ii], sigmas[ii], orders[ii])
                         for ii in range(len(axes)) if sigmas[ii] > 1e-15]
+    if (len(axes) > 1 and not recursive and
+        output.dtype.kind == 'f' and input.dtype.kind in 'biuf'):
+        filters = [None] * input.ndim
+        for axis, sigma, order in axes:
+            filters[axis] = ('correlate', _gaussian_kernel1d(sigma, order), 0)
+        if _separable_filter(input, filters, output, mode, cval, threads):
+            return return_value
     if len(axes) > 0:
         for axis, sigma, order in axes:
             gaussian_filter1d(input, sigma, axis, order, output,
-                              mode, cval)
+                              mode, cval, recursive, threads)
             input = output
     else:
         output[...] = input[...]
@@ -374,7 +577,7 @@ def laplace(input, output = None, mode = "reflect", cval = 0.0):
 
 @docfiller
 def gaussian_laplace(input, sigma, output = None, mode = "reflect",
-                     cval = 0.0):
+                     cval = 0.0, recursive = False):
     """Calculate a multidimensional laplace filter using gaussian
     second derivatives.
 
@@ -388,12 +591,14 @@ def gaussian_laplace(input, sigma, output = None, mode = "reflect",
     %(output)s
     %(mode)s
     %(cval)s
+    %(recursive)s
     """
     input = numpy.asarray(input)
     def derivative2(input, axis, output, mode, cval, sigma):
         order = [0] * input.ndim
         order[axis] = 2
-        return gaussian_filter(input, sigma, order, output, mode, cval)
+        return gaussian_filter(input, sigma, order, output, mode, cval,
+                               recursive)
     return generic_laplace(input, derivative2, output, mode, cval,
                            extra_arguments = (sigma,))
 
@@ -445,7 +650,7 @@ def generic_gradient_magnitude(input, derivative, output = None,
 
 @docfiller
 def gaussian_gradient_magnitude(input, sigma, output = None,
-                mode = "reflect", cval = 0.0):
+                mode = "reflect", cval = 0.0, recursive = False):
     """Calculate a multidimensional gradient magnitude using gaussian
     derivatives.
 
@@ -459,16 +664,226 @@ def gaussian_gradient_magnitude(input, sigma, output = None,
     %(output)s
     %(mode)s
     %(cval)s
+    %(recursive)s
     """
     input = numpy.asarray(input)
     def derivative(input, axis, output, mode, cval, sigma):
         order = [0] * input.ndim
         order[axis] = 1
-        return gaussian_filter(input, sigma, order, output, mode, cval)
+        return gaussian_filter(input, sigma, order, output, mode, cval,
+                               recursive)
     return generic_gradient_magnitude(input, derivative, output, mode,
                             cval, extra_arguments = (sigma,))
 
 
+def _pyramid_size(shape):
+    size = 1
+    for dim in shape:
+        size *= dim
+    return size
+
+
+def _pyramid_shapes(shape, levels):
+    """Shapes of the levels of a pyramid, starting with the given shape"""
+    if levels is None:
+        levels = 1
+        length = 1
+        if len(shape) > 0:
+            length = max(shape)
+        while length > 1:
+            length = (length + 1) // 2
+            levels += 1
+    if levels < 1:
+        raise ValueError('levels must be at least 1')
+    shapes = [tuple(shape)]
+    for ii in range(levels - 1):
+        shapes.append(tuple([(dim + 1) // 2 for dim in shapes[-1]]))
+    return shapes
+
+
+def _pyramid_arena(output, dtype, shapes):
+    """Views of the levels of a pyramid in a single array"""
+    size = 0
+    for shape in shapes:
+        size += _pyramid_size(shape)
+    if isinstance(output, numpy.ndarray):
+        if (output.ndim != 1 or not output.flags.contiguous or
+            output.shape[0] < size):
+            raise RuntimeError('output array too small for the pyramid')
+        arena = output
+    elif output is None:
+        arena = numpy.empty(size, dtype)
+    else:
+        arena = numpy.empty(size, output)
+    levels = []
+    offset = 0
+    for shape in shapes:
+        size = _pyramid_size(shape)
+        levels.append(arena[offset:offset + size].reshape(shape))
+        offset += size
+    return arena, levels
+
+
+def _pyramid_scratch(scratch, index, shape, dtype):
+    """A view of a scratch array that is reused between the levels"""
+    size = _pyramid_size(shape)
+    if scratch[index] is None or scratch[index].shape[0] < size:
+        scratch[index] = numpy.empty(size, dtype)
+    return scratch[index][:size].reshape(shape)
+
+
+def _pyramid_filter(input, output, weights, expand, mode, cval, threads,
+                    scratch):
+    """Reduce or expand an array to the shape of the output, one axis at a
+    time, with intermediate results in two alternating scratch arrays"""
+    if input.ndim == 0:
+        output[...] = input
+        return
+    # the last axis is filtered while the array is largest, since its
+    # lines are contiguous:
+    axes = range(input.ndim)
+    if not expand:
+        axes = axes[::-1]
+    for ii in range(input.ndim):
+        axis = axes[ii]
+        if ii == input.ndim - 1:
+            target = output
+        else:
+            shape = list(input.shape)
+            shape[axis] = output.shape[axis]
+            target = _pyramid_scratch(scratch, ii % 2, shape, output.dtype)
+        _nd_image.correlate1d_pyramid(input, weights, axis, target, mode,
+                                      cval, expand, threads)
+        input = target
+
+
+@docfiller
+def gaussian_pyramid(input, levels = None, sigma = 1.0, output = None,
+                     mode = "reflect", cval = 0.0, threads = 1):
+    """Calculate a Gaussian pyramid.
+
+    Each level is the previous level filtered with a Gaussian filter and
+    reduced to every second point along each axis, starting with the
+    first. The filter is only calculated at the points that are kept, one
+    axis at a time, which takes about a third of the work of filtering
+    the previous level at full size.
+
+    Parameters
+    ----------
+    %(input)s
+    levels : int, optional
+        The number of levels, including the input. By default levels are
+        added until all axes have length one.
+    sigma : scalar, optional
+        The standard deviation of the Gaussian filter. Default is 1.0
+    output : dtype or ndarray, optional
+        The type of the reduced levels, or a contiguous one-dimensional
+        array that holds them one after the other, which can be reused
+        between calls. The reduced levels have length ``(n + 1) // 2``
+        along each axis of length ``n`` of the previous level. By default
+        they have the type of the input.
+    %(mode)s
+    %(cval)s
+    %(threads)s
+
+    Returns
+    -------
+    pyramid : list of ndarrays
+        The input, followed by the reduced levels, which are views of a
+        single array.
+    """
+    input = numpy.asarray(input)
+    if numpy.iscomplexobj(input):
+        raise TypeError('Complex type not supported')
+    shapes = _pyramid_shapes(input.shape, levels)
+    arena, pyramid = _pyramid_arena(output, input.dtype, shapes[1:])
+    weights = numpy.array(_gaussian_kernel1d(sigma, 0), numpy.float64)
+    mode = _ni_support._extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
+    scratch = [None, None]
+    pyramid.insert(0, input)
+    for ii in range(1, len(pyramid)):
+        _pyramid_filter(pyramid[ii - 1], pyramid[ii], weights, 0, mode,
+                        cval, threads, scratch)
+    return pyramid
+
+
+@docfiller
+def laplacian_pyramid(input, levels = None, sigma = 1.0, output = None,
+                      mode = "reflect", cval = 0.0, threads = 1):
+    """Calculate a Laplacian pyramid.
+
+    Each level is the difference of a level of the Gaussian pyramid of
+    the input and the expansion of the next level of that pyramid. The
+    last level is the last level of the Gaussian pyramid. A level is
+    expanded by inserting zeros after each point along each axis, and
+    filtering with twice the Gaussian filter along each axis. The filter
+    is only calculated from the points of the level, and the modes extend
+    the level itself.
+
+    Parameters
+    ----------
+    %(input)s
+    levels : int, optional
+        The number of levels. By default levels are added until all axes
+        of the last level have length one.
+    sigma : scalar, optional
+        The standard deviation of the Gaussian filter. Default is 1.0
+    output : dtype or ndarray, optional
+        The type of the levels, or a contiguous one-dimensional array that
+        holds them one after the other, which can be reused between calls.
+        The first level has the shape of the input, the next levels have
+        length ``(n + 1) // 2`` along each axis of length ``n`` of the
+        previous level. By default the levels have the type of the input
+        if it is a floating point type, and numpy.float64 otherwise.
+    %(mode)s
+    %(cval)s
+    %(threads)s
+
+    Returns
+    -------
+    pyramid : list of ndarrays
+        The levels, which are views of a single array.
+
+    Notes
+    -----
+    The Gaussian levels are calculated as by `gaussian_pyramid`, in the
+    memory of the levels of the Laplacian pyramid.
+    """
+    input = numpy.asarray(input)
+    if numpy.iscomplexobj(input):
+        raise TypeError('Complex type not supported')
+    dtype = input.dtype
+    if not issubclass(dtype.type, numpy.floating):
+        dtype = numpy.float64
+    shapes = _pyramid_shapes(input.shape, levels)
+    arena, pyramid = _pyramid_arena(output, dtype, shapes)
+    weights = numpy.array(_gaussian_kernel1d(sigma, 0), numpy.float64)
+    mode = _ni_support._extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
+    scratch = [None, None, None]
+    if len(pyramid) == 1:
+        pyramid[0][...] = input
+    # the Gaussian levels after the first:
+    previous = input
+    for ii in range(1, len(pyramid)):
+        _pyramid_filter(previous, pyramid[ii], weights, 0, mode, cval,
+                        threads, scratch)
+        previous = pyramid[ii]
+    # subtract the expansion of the next Gaussian level from each level:
+    for ii in range(len(pyramid) - 1):
+        if ii == 0:
+            _pyramid_filter(pyramid[1], pyramid[0], weights, 1, mode, cval,
+                            threads, scratch)
+            numpy.subtract(input, pyramid[0], pyramid[0])
+        else:
+            expanded = _pyramid_scratch(scratch, 2, shapes[ii], arena.dtype)
+            _pyramid_filter(pyramid[ii + 1], expanded, weights, 1, mode,
+                            cval, threads, scratch)
+            numpy.subtract(pyramid[ii], expanded, pyramid[ii])
+    return pyramid
+
+
 def _correlate_or_convolve(input, weights, output, mode, cval, origin,
                            convolution):
     input = numpy.asarray(input)
@@ -648,7 +1063,7 @@ def convolve(input, weights, output = None, mode = 'reflect', cval = 0.0,
 
 @docfiller
 def uniform_filter1d(input, size, axis = -1, output = None,
-                     mode = "reflect", cval = 0.0, origin = 0):
+                     mode = "reflect", cval = 0.0, origin = 0, threads = 1):
     """Calculate a one-dimensional uniform filter along the given axis.
 
     The lines of the array along the given axis are filtered with a
@@ -664,6 +1079,7 @@ def uniform_filter1d(input, size, axis = -1, output = None,
     %(mode)s
     %(cval)s
     %(origin)s
+    %(threads)s
     """
     input = numpy.asarray(input)
     if numpy.iscomplexobj(input):
@@ -675,14 +1091,15 @@ def uniform_filter1d(input, size, axis = -1, output = None,
     if (size // 2 + origin < 0) or (size // 2 + origin > size):
         raise ValueError('invalid origin')
     mode = _ni_support._extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
     _nd_image.uniform_filter1d(input, size, axis, output, mode, cval,
-                               origin)
+                               origin, threads)
     return return_value
 
 
 @docfiller
 def uniform_filter(input, size = 3, output = None, mode = "reflect",
-                   cval = 0.0, origin = 0):
+                   cval = 0.0, origin = 0, threads = 1):
     """Multi-dimensional uniform filter.
 
     Parameters
@@ -696,14 +1113,19 @@ def uniform_filter(input, size = 3, output = None, mode = "reflect",
     %(mode)s
     %(cval)s
     %(origin)s
+    %(threads)s
 
     Notes
     -----
     The multi-dimensional filter is implemented as a sequence of
-    one-dimensional uniform filters. The intermediate arrays are stored
-    in the same data type as the output. Therefore, for output types
-    with a limited precision, the results may be imprecise because
-    intermediate results may be stored with insufficient precision.
+    one-dimensional uniform filters. For floating point outputs the
+    filters are applied in a single pass over tiles of the array that
+    fit in the cache, with intermediate results in double precision,
+    unless the filters are so large that filtering each axis in turn is
+    cheaper. Otherwise the intermediate arrays are stored in the same
+    data type as the output. Therefore, for output types with a limited
+    precision, the results may be imprecise because intermediate
+    results may be stored with insufficient precision.
     """
     input = numpy.asarray(input)
     output, return_value = _ni_support._get_output(output, input)
@@ -712,10 +1134,17 @@ def uniform_filter(input, size = 3, output = None, mode = "reflect",
     axes = range(input.ndim)
     axes = [(axes[ii], sizes[ii], origins[ii])
                            for ii in range(len(axes)) if sizes[ii] > 1]
+    if (len(axes) > 1 and output.dtype.kind == 'f' and
+        input.dtype.kind in 'biuf'):
+        filters = [None] * input.ndim
+        for axis, size, origin in axes:
+            filters[axis] = ('uniform', size, origin)
+        if _separable_filter(input, filters, output, mode, cval, threads):
+            return return_value
     if len(axes) > 0:
         for axis, size, origin in axes:
             uniform_filter1d(input, int(size), axis, output, mode,
-                             cval, origin)
+                             cval, origin, threads)
             input = output
     else:
         output[...] = input[...]
@@ -724,7 +1153,7 @@ def uniform_filter(input, size = 3, output = None, mode = "reflect",
 
 @docfiller
 def minimum_filter1d(input, size, axis = -1, output = None,
-                     mode = "reflect", cval = 0.0, origin = 0):
+                     mode = "reflect", cval = 0.0, origin = 0, threads = 1):
     """Calculate a one-dimensional minimum filter along the given axis.
 
     The lines of the array along the given axis are filtered with a
@@ -740,6 +1169,7 @@ def minimum_filter1d(input, size, axis = -1, output = None,
     %(mode)s
     %(cval)s
     %(origin)s
+    %(threads)s
     """
     input = numpy.asarray(input)
     if numpy.iscomplexobj(input):
@@ -751,14 +1181,15 @@ def minimum_filter1d(input, size, axis = -1, output = None,
     if (size // 2 + origin < 0) or (size // 2 + origin > size):
         raise ValueError('invalid origin')
     mode = _ni_support._extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
     _nd_image.min_or_max_filter1d(input, size, axis, output, mode, cval,
-                                  origin, 1)
+                                  origin, 1, threads)
     return return_value
 
 
 @docfiller
 def maximum_filter1d(input, size, axis = -1, output = None,
-                     mode = "reflect", cval = 0.0, origin = 0):
+                     mode = "reflect", cval = 0.0, origin = 0, threads = 1):
     """Calculate a one-dimensional maximum filter along the given axis.
 
     The lines of the array along the given axis are filtered with a
@@ -774,6 +1205,7 @@ def maximum_filter1d(input, size, axis = -1, output = None,
     %(mode)s
     %(cval)s
     %(origin)s
+    %(threads)s
     """
     input = numpy.asarray(input)
     if numpy.iscomplexobj(input):
@@ -785,13 +1217,14 @@ def maximum_filter1d(input, size, axis = -1, output = None,
     if (size // 2 + origin < 0) or (size // 2 + origin > size):
         raise ValueError('invalid origin')
     mode = _ni_support._extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
     _nd_image.min_or_max_filter1d(input, size, axis, output, mode, cval,
-                                  origin, 0)
+                                  origin, 0, threads)
     return return_value
 
 
 def _min_or_max_filter(input, size, footprint, structure, output, mode,
-                       cval, origin, minimum):
+                       cval, origin, minimum, threads = 1):
     if structure is None:
         if footprint is None:
             if size is None:
@@ -828,9 +1261,19 @@ def _min_or_max_filter(input, size, footprint, structure, output, mode,
             filter_ = minimum_filter1d
         else:
             filter_ = maximum_filter1d
+        if (len(axes) > 1 and input.dtype == output.dtype and
+            (input.dtype.kind == 'f' or input.dtype.itemsize <= 4)):
+            filters = [None] * input.ndim
+            for axis, size, origin in axes:
+                filters[axis] = (minimum and 'minimum' or 'maximum', size,
+                                 origin)
+            if _separable_filter(input, filters, output, mode, cval,
+                                 threads):
+                return return_value
         if len(axes) > 0:
             for axis, size, origin in axes:
-                filter_(input, int(size), axis, output, mode, cval, origin)
+                filter_(input, int(size), axis, output, mode, cval, origin,
+                        threads)
                 input = output
         else:
             output[...] = input[...]
@@ -856,7 +1299,7 @@ def _min_or_max_filter(input, size, footprint, structure, output, mode,
 
 @docfiller
 def minimum_filter(input, size = None, footprint = None, output = None,
-      mode = "reflect", cval = 0.0, origin = 0):
+      mode = "reflect", cval = 0.0, origin = 0, threads = 1):
     """Calculates a multi-dimensional minimum filter.
 
     Parameters
@@ -867,14 +1310,17 @@ def minimum_filter(input, size = None, footprint = None, output = None,
     %(mode)s
     %(cval)s
     %(origin)s
+    threads : int, optional
+        The number of threads used for footprints that are separated
+        into one-dimensional filters. Default is 1
     """
     return _min_or_max_filter(input, size, footprint, None, output, mode,
-                              cval, origin, 1)
+                              cval, origin, 1, threads)
 
 
 @docfiller
 def maximum_filter(input, size = None, footprint = None, output = None,
-      mode = "reflect", cval = 0.0, origin = 0):
+      mode = "reflect", cval = 0.0, origin = 0, threads = 1):
     """Calculates a multi-dimensional maximum filter.
 
     Parameters
@@ -885,9 +1331,12 @@ def maximum_filter(input, size = None, footprint = None, output = None,
     %(mode)s
     %(cval)s
     %(origin)s
+    threads : int, optional
+        The number of threads used for footprints that are separated
+        into one-dimensional filters. Default is 1
     """
     return _min_or_max_filter(input, size, footprint, None, output, mode,
-                              cval, origin, 0)
+                              cval, origin, 0, threads)
 
 
 @docfiller
@@ -1030,7 +1479,7 @@ def percentile_filter(input, percentile, size = None, footprint = None,
 @docfiller
 def generic_filter1d(input, function, filter_size, axis = -1,
                  output = None, mode = "reflect", cval = 0.0, origin = 0,
-                 extra_arguments = (), extra_keywords = None):
+                 extra_arguments = (), extra_keywords = None, threads = 1):
     """Calculate a one-dimensional filter along the given axis.
 
     generic_filter1d iterates over the lines of the array, calling the
@@ -1043,8 +1492,8 @@ def generic_filter1d(input, function, filter_size, axis = -1,
     Parameters
     ----------
     %(input)s
-    function : callable
-        function to apply along given axis
+    function : callable or capsule
+        function to apply along given axis, or a C function (see Notes)
     filter_size : scalar
         length of the filter
     %(axis)s
@@ -1054,6 +1503,27 @@ def generic_filter1d(input, function, filter_size, axis = -1,
     %(origin)s
     %(extra_arguments)s
     %(extra_keywords)s
+    threads : int, optional
+        The number of threads over which the lines are divided, if
+        ``function`` is a C function, which must then be safe to call
+        concurrently. Python functions are always called from a single
+        thread. Default is 1
+
+    Notes
+    -----
+    A C function is passed as a capsule that holds a pointer to a
+    function with the signature::
+
+        int function(double *input_line, npy_intp input_length,
+                     double *output_line, npy_intp output_length,
+                     void *user_data)
+
+    The capsule is named by the signature,
+    ``"int (double *, npy_intp, double *, npy_intp, void *)"``, which is
+    checked, and its context is passed as ``user_data``. The function
+    returns 1 on success and 0 on failure. It is called without the
+    global interpreter lock and must not use the Python API. A function
+    in an unnamed capsule is called with the lock, from a single thread.
     """
     if extra_keywords is None:
         extra_keywords = {}
@@ -1068,26 +1538,30 @@ def generic_filter1d(input, function, filter_size, axis = -1,
         (filter_size // 2 + origin > filter_size)):
         raise ValueError('invalid origin')
     mode = _ni_support._extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
     _nd_image.generic_filter1d(input, function, filter_size, axis, output,
-                      mode, cval, origin, extra_arguments, extra_keywords)
+                      mode, cval, origin, extra_arguments, extra_keywords,
+                      threads)
     return return_value
 
 
 @docfiller
 def generic_filter(input, function, size = None, footprint = None,
                    output = None, mode = "reflect", cval = 0.0, origin = 0,
-                   extra_arguments = (), extra_keywords = None):
+                   extra_arguments = (), extra_keywords = None, threads = 1,
+                   block = None):
     """Calculates a multi-dimensional filter using the given function.
 
     At each element the provided function is called. The input values
     within the filter footprint at that element are passed to the function
-    as a 1D array of double values.
+    as a 1D array of double values. If a block size is given, the function
+    is instead called once for each block of elements, see Notes.
 
     Parameters
     ----------
     %(input)s
-    function : callable
-        function to apply at each element
+    function : callable or capsule
+        function to apply at each element, or a C function (see Notes)
     %(size_foot)s
     %(output)s
     %(mode)s
@@ -1095,6 +1569,44 @@ def generic_filter(input, function, size = None, footprint = None,
     %(origin)s
     %(extra_arguments)s
     %(extra_keywords)s
+    threads : int, optional
+        The number of threads over which the elements are divided, if
+        ``function`` is a C function, which must then be safe to call
+        concurrently. Python functions are always called from a single
+        thread. Default is 1
+    block : int, optional
+        If given, the values of up to ``block`` consecutive elements, in C
+        order, are gathered into a 2D array with one row of length equal
+        to the footprint size per element, and the function is called once
+        with that array. It must return a sequence with one value per row,
+        for instance ``lambda x: x.std(axis=1)``. Since the calls are fewer,
+        this is much faster for functions written with numpy reductions. A
+        block of ``input.shape[-1]`` elements filters a line at a time.
+
+    Notes
+    -----
+    A C function is passed as a capsule that holds a pointer to a
+    function with the signature::
+
+        int function(double *buffer, npy_intp filter_size,
+                     double *return_value, void *user_data)
+
+    The capsule is named by the signature,
+    ``"int (double *, npy_intp, double *, void *)"``, which is checked,
+    and its context is passed as ``user_data``. The function stores the
+    filtered value in ``return_value`` and returns 1 on success and 0 on
+    failure. It is called without the global interpreter lock and must
+    not use the Python API. A function in an unnamed capsule is called
+    with the lock, from a single thread. With a block size, the signature
+    is::
+
+        int function(double *buffer, npy_intp block, npy_intp filter_size,
+                     double *return_values, void *user_data)
+
+    which must be the name of the capsule,
+    ``"int (double *, npy_intp, npy_intp, double *, void *)"``, where
+    ``buffer`` holds ``block`` rows of ``filter_size`` values and a value
+    is stored in ``return_values`` for each row.
     """
     if extra_keywords is None:
         extra_keywords = {}
@@ -1120,6 +1632,169 @@ def generic_filter(input, function, size = None, footprint = None,
         footprint = footprint.copy()
     output, return_value = _ni_support._get_output(output, input)
     mode = _ni_support._extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
+    if block is None:
+        block = 0
+    elif block < 1:
+        raise ValueError('block size must be positive')
     _nd_image.generic_filter(input, function, footprint, output, mode,
-                         cval, origins, extra_arguments, extra_keywords)
+                         cval, origins, extra_arguments, extra_keywords,
+                         threads, int(block))
+    return return_value
+
+
+def _filter_halo(keywords, rank, axis):
+    """Reach of a filter along an axis, from its keyword arguments"""
+    origin = keywords.get('origin', 0)
+    origin = _ni_support._normalize_sequence(origin, rank)[axis]
+    if keywords.get('footprint') is not None:
+        size = numpy.asarray(keywords['footprint']).shape[axis]
+    elif keywords.get('size') is not None:
+        size = _ni_support._normalize_sequence(keywords['size'], rank)[axis]
+    elif keywords.get('weights') is not None:
+        weights = numpy.asarray(keywords['weights'])
+        if weights.ndim != rank:
+            raise RuntimeError('the halo of the filter must be given')
+        size = weights.shape[axis]
+    elif keywords.get('sigma') is not None:
+        sigma = _ni_support._normalize_sequence(keywords['sigma'], rank)[axis]
+        if keywords.get('recursive'):
+            size = 2 * int(6.0 * sigma + 0.5) + 1
+        else:
+            size = 2 * int(4.0 * sigma + 0.5) + 1
+    else:
+        raise RuntimeError('the halo of the filter must be given')
+    return int(size) // 2 + abs(int(origin))
+
+@docfiller
+def chunked_filter(function, input, output = None, axis = 0, chunk_size = 64,
+                   halo = None, extra_arguments = (), extra_keywords = None,
+                   threads = 1):
+    """Apply a filter to an array in slabs along one axis.
+
+    The input is divided into slabs of ``chunk_size`` elements along
+    ``axis``. Each slab is read together with ``halo`` elements on either
+    side, filtered by ``function``, and the result without the halo is
+    written to the output. Only a few slabs are in memory at a time, so
+    input and output may be memory-mapped arrays that do not fit in
+    memory. Since the halo covers the reach of the filter, the result is
+    the same as filtering the whole array at once. At the ends of
+    ``axis`` the slab ends with the array, and ``function`` extends it
+    by its mode, except for ``mode='wrap'`` in ``extra_keywords``: then
+    the halo is read from the other end of ``axis``.
+
+    Parameters
+    ----------
+    function : callable
+        A filter such as ``uniform_filter``, called as
+        ``function(slab, *extra_arguments, **extra_keywords)``. It must
+        return the filtered slab, and its result may only depend on the
+        input within ``halo`` elements along ``axis``. Recursive filters
+        are therefore only approximated.
+    %(input)s
+    %(output)s
+    axis : integer, optional
+        axis of ``input`` along which the slabs are taken. The default of
+        0 reads contiguous slabs from C ordered files.
+    chunk_size : int, optional
+        The number of elements along ``axis`` in a slab, which is raised
+        to the halo if it is smaller. Default is 64
+    halo : int, optional
+        The number of elements along ``axis`` that the filter reaches
+        from an element. If not given, it is derived from the ``size``,
+        ``footprint``, ``weights`` (of the same rank as the input) or
+        ``sigma`` keyword, together with ``origin``, in
+        ``extra_keywords``.
+    %(extra_arguments)s
+    %(extra_keywords)s
+    threads : int, optional
+        The number of slabs that are filtered concurrently. The filters of
+        this module release the global interpreter lock while they filter,
+        except the generic filters with a Python function, which gain
+        nothing from more threads. Default is 1
+
+    Notes
+    -----
+    The output may be the input array itself: the slabs are read before
+    the results that overlap them are written, and with the wrap mode
+    the first ``halo`` elements along ``axis`` are kept for the halo of
+    the last slab.
+    """
+    if extra_keywords is None:
+        extra_keywords = {}
+    input = numpy.asarray(input)
+    axis = _ni_support._check_axis(axis, input.ndim)
+    if halo is None:
+        halo = _filter_halo(extra_keywords, input.ndim, axis)
+    halo = int(halo)
+    if halo < 0:
+        raise ValueError('halo must not be negative')
+    chunk_size = max(int(chunk_size), halo, 1)
+    threads = _ni_support._check_threads(threads)
+    output, return_value = _ni_support._get_output(output, input)
+    length = input.shape[axis]
+    starts = range(0, length, chunk_size)
+    batches = [starts[ii:ii + threads]
+               for ii in range(0, len(starts), threads)]
+
+    def index(start, stop):
+        return ((slice(None),) * axis + (slice(start, stop),) +
+                (slice(None),) * (input.ndim - axis - 1))
+
+    # with the wrap mode the halos of the end slabs wrap around the axis;
+    # the first elements, which the output may overwrite before the last
+    # slab is read, are kept:
+    wrap = extra_keywords.get('mode') == 'wrap'
+    if wrap:
+        head = numpy.array(input[index(0, min(halo, length))])
+
+    def read(batch):
+        slabs = []
+        for start in batch:
+            if wrap:
+                lo = start - halo
+                hi = min(start + chunk_size, length) + halo
+                rows = numpy.arange(lo, hi) % length
+                slab = numpy.take(input, rows, axis)
+                kept = rows < head.shape[axis]
+                slab[(slice(None),) * axis + (kept,)] = numpy.take(head,
+                                                        rows[kept], axis)
+            else:
+                lo = max(start - halo, 0)
+                hi = min(start + chunk_size + halo, length)
+                slab = numpy.array(input[index(lo, hi)])
+            slabs.append((start, lo, slab))
+        return slabs
+
+    def run(slab, results, ii):
+        try:
+            results[ii] = function(slab, *extra_arguments, **extra_keywords)
+        except Exception, e:
+            results[ii] = e
+
+    if batches:
+        slabs = read(batches[0])
+    for jj in range(len(batches)):
+        results = [None] * len(slabs)
+        if len(slabs) == 1:
+            run(slabs[0][2], results, 0)
+        else:
+            workers = [threading.Thread(target = run,
+                                        args = (slab, results, ii))
+                       for ii, (start, lo, slab) in enumerate(slabs)]
+            for worker in workers:
+                worker.start()
+            for worker in workers:
+                worker.join()
+        for result in results:
+            if isinstance(result, Exception):
+                raise result
+        # read the next slabs before writing results that overlap them:
+        written = slabs
+        if jj + 1 < len(batches):
+            slabs = read(batches[jj + 1])
+        for (start, lo, slab), result in zip(written, results):
+            stop = min(start + chunk_size, length)
+            output[index(start, stop)] = numpy.asarray(result)[
+                                index(start - lo, stop - lo)]
     return return_value
@@ -71,7 +71,16 @@ def _get_output_fourier_complex(output, input):
         return_value = None
     return output, return_value
 
-def fourier_gaussian(input, sigma, n = -1, axis = -1, output = None):
+def _check_fourier_axes(input, n, axis, batch):
+    axis = _ni_support._check_axis(axis, input.ndim)
+    if batch < 0 or batch > input.ndim:
+        raise RuntimeError('invalid number of batch axes')
+    if n >= 0 and axis < batch:
+        raise RuntimeError('the axis of the real transform is a batch axis')
+    return axis
+
+def fourier_gaussian(input, sigma, n = -1, axis = -1, output = None,
+                     batch = 0):
     """
     Multi-dimensional Gaussian fourier filter.
 
@@ -96,7 +105,12 @@ def fourier_gaussian(input, sigma, n = -1, axis = -1, output = None):
         The axis of the real transform.
     output : ndarray, optional
         If given, the result of filtering the input is placed in this array.
-        None is returned in this case.
+        None is returned in this case. This may be the input array, which
+        is then filtered in place.
+    batch : int, optional
+        The number of leading axes of `input` that index a stack of
+        independent spectra. These axes are not filtered and are not
+        counted by `sigma`. By default there are none.
 
     Returns
     -------
@@ -107,16 +121,16 @@ def fourier_gaussian(input, sigma, n = -1, axis = -1, output = None):
     """
     input = numpy.asarray(input)
     output, return_value = _get_output_fourier(output, input)
-    axis = _ni_support._check_axis(axis, input.ndim)
-    sigmas = _ni_support._normalize_sequence(sigma, input.ndim)
+    axis = _check_fourier_axes(input, n, axis, batch)
+    sigmas = _ni_support._normalize_sequence(sigma, input.ndim - batch)
     sigmas = numpy.asarray(sigmas, dtype = numpy.float64)
     if not sigmas.flags.contiguous:
         sigmas = sigmas.copy()
-
-    _nd_image.fourier_filter(input, sigmas, n, axis, output, 0)
+    _nd_image.fourier_filter(input, sigmas, n, axis, output, 0, batch)
     return return_value
 
-def fourier_uniform(input, size, n = -1, axis = -1, output = None):
+def fourier_uniform(input, size, n = -1, axis = -1, output = None,
+                    batch = 0):
     """
     Multi-dimensional uniform fourier filter.
 
@@ -141,7 +155,12 @@ def fourier_uniform(input, size, n = -1, axis = -1, output = None):
         The axis of the real transform.
     output : ndarray, optional
         If given, the result of filtering the input is placed in this array.
-        None is returned in this case.
+        None is returned in this case. This may be the input array, which
+        is then filtered in place.
+    batch : int, optional
+        The number of leading axes of `input` that index a stack of
+        independent spectra. These axes are not filtered and are not
+        counted by `size`. By default there are none.
 
     Returns
     -------
@@ -152,15 +171,16 @@ def fourier_uniform(input, size, n = -1, axis = -1, output = None):
     """
     input = numpy.asarray(input)
     output, return_value = _get_output_fourier(output, input)
-    axis = _ni_support._check_axis(axis, input.ndim)
-    sizes = _ni_support._normalize_sequence(size, input.ndim)
+    axis = _check_fourier_axes(input, n, axis, batch)
+    sizes = _ni_support._normalize_sequence(size, input.ndim - batch)
     sizes = numpy.asarray(sizes, dtype = numpy.float64)
     if not sizes.flags.contiguous:
         sizes = sizes.copy()
-    _nd_image.fourier_filter(input, sizes, n, axis, output, 1)
+    _nd_image.fourier_filter(input, sizes, n, axis, output, 1, batch)
     return return_value
 
-def fourier_ellipsoid(input, size, n = -1, axis = -1, output = None):
+def fourier_ellipsoid(input, size, n = -1, axis = -1, output = None,
+                      batch = 0):
     """
     Multi-dimensional ellipsoid fourier filter.
 
@@ -185,7 +205,12 @@ def fourier_ellipsoid(input, size, n = -1, axis = -1, output = None):
         The axis of the real transform.
     output : ndarray, optional
         If given, the result of filtering the input is placed in this array.
-        None is returned in this case.
+        None is returned in this case. This may be the input array, which
+        is then filtered in place.
+    batch : int, optional
+        The number of leading axes of `input` that index a stack of
+        independent spectra. These axes are not filtered and are not
+        counted by `size`. By default there are none.
 
     Returns
     -------
@@ -195,20 +220,22 @@ def fourier_ellipsoid(input, size, n = -1, axis = -1, output = None):
 
     Notes
     -----
-    This function is implemented for arrays of rank 1, 2, or 3.
+    This function is implemented for arrays of rank 1, 2, or 3, not
+    counting the batch axes.
 
     """
     input = numpy.asarray(input)
     output, return_value = _get_output_fourier(output, input)
-    axis = _ni_support._check_axis(axis, input.ndim)
-    sizes = _ni_support._normalize_sequence(size, input.ndim)
+    axis = _check_fourier_axes(input, n, axis, batch)
+    sizes = _ni_support._normalize_sequence(size, input.ndim - batch)
     sizes = numpy.asarray(sizes, dtype = numpy.float64)
     if not sizes.flags.contiguous:
         sizes = sizes.copy()
-    _nd_image.fourier_filter(input, sizes, n, axis, output, 2)
+    _nd_image.fourier_filter(input, sizes, n, axis, output, 2, batch)
     return return_value
 
-def fourier_shift(input, shift, n = -1, axis = -1, output = None):
+def fourier_shift(input, shift, n = -1, axis = -1, output = None,
+                  batch = 0):
     """
     Multi-dimensional fourier shift filter.
 
@@ -232,7 +259,12 @@ def fourier_shift(input, shift, n = -1, axis = -1, output = None):
         The axis of the real transform.
     output : ndarray, optional
         If given, the result of shifting the input is placed in this array.
-        None is returned in this case.
+        None is returned in this case. This may be the input array, which
+        is then shifted in place.
+    batch : int, optional
+        The number of leading axes of `input` that index a stack of
+        independent spectra. These axes are not filtered and are not
+        counted by `shift`. By default there are none.
 
     Returns
     -------
@@ -243,10 +275,10 @@ def fourier_shift(input, shift, n = -1, axis = -1, output = None):
     """
     input = numpy.asarray(input)
     output, return_value = _get_output_fourier_complex(output, input)
-    axis = _ni_support._check_axis(axis, input.ndim)
-    shifts = _ni_support._normalize_sequence(shift, input.ndim)
+    axis = _check_fourier_axes(input, n, axis, batch)
+    shifts = _ni_support._normalize_sequence(shift, input.ndim - batch)
     shifts = numpy.asarray(shifts, dtype = numpy.float64)
     if not shifts.flags.contiguous:
         shifts = shifts.copy()
-    _nd_image.fourier_shift(input, shifts, n, axis, output)
+    _nd_image.fourier_shift(input, shifts, n, axis, output, batch)
     return return_value
@@ -26,19 +26,23 @@ Functions (partial list)
 
    affine_transform - Apply an affine transformation
    center_of_mass - The center of mass of the values of an array at labels
+   chunked_filter - Apply a filter to an array in slabs along an axis
    convolve - Multi-dimensional convolution
    convolve1d - 1-D convolution along the given axis
    correlate - Multi-dimensional correlation
    correlate1d - 1-D correlation along the given axis
    extrema - Min's and max's of an array at labels, with their positions
    find_objects - Find objects in a labeled array
+   gaussian_pyramid - Gaussian pyramid with levels in a single array
    generic_filter - Multi-dimensional filter using a given function
    generic_filter1d - 1-D generic filter along the given axis
    geometric_transform - Apply an arbritrary geometric transform
    histogram - Histogram of the values of an array, optionally at labels
    imread - Load an image from a file
    label - Label features in an array
+   labeled_statistics - Several statistics of an array at labels in one pass
    laplace - n-D Laplace filter based on approximate second derivatives
+   laplacian_pyramid - Laplacian pyramid with levels in a single array
    map_coordinates - Map input array to new coordinates by interpolation
    mean - Mean of the values of an array at labels
    median_filter - Calculates a multi-dimensional median filter
@@ -51,6 +55,7 @@ Functions (partial list)
    uniform_filter - Multi-dimensional uniform filter
    uniform_filter1d - 1-D uniform filter along the given axis
    variance - Variance of the values of an n-D image array
+   watershed - Flood an array from markers in the order of its values
    zoom - Zoom an array
 
 Note: the above is only roughly half the functions available in this
@@ -62,6 +67,7 @@ Objects
 .. autosummary::
    :toctree: generated/
 
+   SplineInterpolator - Spline interpolation with precomputed coefficients
    docdict -
 
 """
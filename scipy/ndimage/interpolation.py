@@ -37,7 +37,8 @@ def _extend_mode_to_code(mode):
     mode = _ni_support._extend_mode_to_code(mode)
     return mode
 
-def spline_filter1d(input, order=3, axis=-1, output=numpy.float64):
+def spline_filter1d(input, order=3, axis=-1, output=numpy.float64,
+                    threads=1):
     """
     Calculates a one-dimensional spline filter along the given axis.
 
@@ -56,6 +57,10 @@ def spline_filter1d(input, order=3, axis=-1, output=numpy.float64):
     output : ndarray or dtype, optional
         The array in which to place the output, or the dtype of the returned
         array. Default is `numpy.float64`.
+    threads : int, optional
+        The number of threads over which the lines of the array are
+        divided. The threads run without the global interpreter lock.
+        Default is 1.
 
     Returns
     -------
@@ -74,11 +79,12 @@ def spline_filter1d(input, order=3, axis=-1, output=numpy.float64):
         output[...] = numpy.array(input)
     else:
         axis = _ni_support._check_axis(axis, input.ndim)
-        _nd_image.spline_filter1d(input, order, axis, output)
+        threads = _ni_support._check_threads(threads)
+        _nd_image.spline_filter1d(input, order, axis, output, threads)
     return return_value
 
 
-def spline_filter(input, order=3, output = numpy.float64):
+def spline_filter(input, order=3, output = numpy.float64, threads = 1):
     """
     Multi-dimensional spline filter.
 
@@ -105,7 +111,8 @@ def spline_filter(input, order=3, output = numpy.float64):
     output, return_value = _ni_support._get_output(output, input)
     if order not in [0, 1] and input.ndim > 0:
         for axis in range(input.ndim):
-            spline_filter1d(input, order, axis, output = output)
+            spline_filter1d(input, order, axis, output = output,
+                            threads = threads)
             input = output
     else:
         output[...] = input[...]
@@ -114,7 +121,7 @@ def spline_filter(input, order=3, output = numpy.float64):
 def geometric_transform(input, mapping, output_shape=None,
                         output=None, order=3,
                         mode='constant', cval=0.0, prefilter=True,
-                        extra_arguments=(), extra_keywords={}):
+                        extra_arguments=(), extra_keywords={}, threads=1):
     """
     Apply an arbritrary geometric transform.
 
@@ -127,10 +134,17 @@ def geometric_transform(input, mapping, output_shape=None,
     ----------
     input : array_like
         The input array.
-    mapping : callable
+    mapping : callable or capsule
         A callable object that accepts a tuple of length equal to the output
         array rank, and returns the corresponding input coordinates as a tuple
-        of length equal to the input array rank.
+        of length equal to the input array rank. A C function can be given
+        as a capsule named ``"int (npy_intp *, double *, int, int, void *)"``
+        that holds a pointer to ``int mapping(npy_intp *output_coordinates,
+        double *input_coordinates, int output_rank, int input_rank, void
+        *user_data)``, with the context of the capsule as ``user_data``.
+        The C function is called without the global interpreter lock and
+        must not use the Python API. A function in an unnamed capsule is
+        called with the lock, from a single thread.
     output_shape : tuple of ints
         Shape tuple.
     output : ndarray or dtype, optional
@@ -155,6 +169,11 @@ def geometric_transform(input, mapping, output_shape=None,
         Extra arguments passed to `mapping`.
     extra_keywords : dict, optional
         Extra keywords passed to `mapping`.
+    threads : int, optional
+        The number of threads over which the output and the spline filter
+        are divided, if `mapping` is a C function, which must then be safe
+        to call concurrently. A Python `mapping` is always called from a
+        single thread. Default is 1.
 
     Returns
     -------
@@ -189,19 +208,22 @@ def geometric_transform(input, mapping, output_shape=None,
     if input.ndim < 1 or len(output_shape) < 1:
         raise RuntimeError('input and output rank must be > 0')
     mode = _extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
     if prefilter and order > 1:
-        filtered = spline_filter(input, order, output = numpy.float64)
+        filtered = spline_filter(input, order, output = numpy.float64,
+                                 threads = threads)
     else:
         filtered = input
     output, return_value = _ni_support._get_output(output, input,
                                                    shape=output_shape)
     _nd_image.geometric_transform(filtered, mapping, None, None, None,
-               output, order, mode, cval, extra_arguments, extra_keywords)
+               output, order, mode, cval, extra_arguments, extra_keywords,
+               threads)
     return return_value
 
 
 def map_coordinates(input, coordinates, output=None, order=3,
-                    mode='constant', cval=0.0, prefilter=True):
+                    mode='constant', cval=0.0, prefilter=True, threads=1):
     """
     Map the input array to new coordinates by interpolation.
 
@@ -239,6 +261,10 @@ def map_coordinates(input, coordinates, output=None, order=3,
         `spline_filter` before interpolation (necessary for spline
         interpolation of order > 1).  If False, it is assumed that the input is
         already filtered. Default is True.
+    threads : int, optional
+        The number of threads over which the output and the spline filter
+        are divided. The threads run without the global interpreter lock.
+        Default is 1.
 
     Returns
     -------
@@ -288,20 +314,22 @@ def map_coordinates(input, coordinates, output=None, order=3,
     if coordinates.shape[0] != input.ndim:
         raise RuntimeError('invalid shape for coordinate array')
     mode = _extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
     if prefilter and order > 1:
-        filtered = spline_filter(input, order, output = numpy.float64)
+        filtered = spline_filter(input, order, output = numpy.float64,
+                                 threads = threads)
     else:
         filtered = input
     output, return_value = _ni_support._get_output(output, input,
                                                    shape=output_shape)
     _nd_image.geometric_transform(filtered, None, coordinates, None, None,
-               output, order, mode, cval, None, None)
+               output, order, mode, cval, None, None, threads)
     return return_value
 
 
 def affine_transform(input, matrix, offset=0.0, output_shape=None,
                      output=None, order=3,
-                     mode='constant', cval=0.0, prefilter=True):
+                     mode='constant', cval=0.0, prefilter=True, threads=1):
     """
     Apply an affine transformation.
 
@@ -345,6 +373,10 @@ def affine_transform(input, matrix, offset=0.0, output_shape=None,
         `spline_filter` before interpolation (necessary for spline
         interpolation of order > 1).  If False, it is assumed that the input is
         already filtered. Default is True.
+    threads : int, optional
+        The number of threads over which the output and the spline filter
+        are divided. The threads run without the global interpreter lock.
+        Default is 1.
 
     Returns
     -------
@@ -363,8 +395,10 @@ def affine_transform(input, matrix, offset=0.0, output_shape=None,
     if input.ndim < 1 or len(output_shape) < 1:
         raise RuntimeError('input and output rank must be > 0')
     mode = _extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
     if prefilter and order > 1:
-        filtered = spline_filter(input, order, output = numpy.float64)
+        filtered = spline_filter(input, order, output = numpy.float64,
+                                 threads = threads)
     else:
         filtered = input
     output, return_value = _ni_support._get_output(output, input,
@@ -386,15 +420,15 @@ def affine_transform(input, matrix, offset=0.0, output_shape=None,
         offset = offset.copy()
     if matrix.ndim == 1:
         _nd_image.zoom_shift(filtered, matrix, offset, output, order,
-                             mode, cval)
+                             mode, cval, threads)
     else:
         _nd_image.geometric_transform(filtered, None, None, matrix, offset,
-                            output, order, mode, cval, None, None)
+                            output, order, mode, cval, None, None, threads)
     return return_value
 
 
 def shift(input, shift, output=None, order=3, mode='constant', cval=0.0,
-          prefilter=True):
+          prefilter=True, threads=1):
     """
     Shift an array.
 
@@ -427,6 +461,10 @@ def shift(input, shift, output=None, order=3, mode='constant', cval=0.0,
         `spline_filter` before interpolation (necessary for spline
         interpolation of order > 1).  If False, it is assumed that the input is
         already filtered. Default is True.
+    threads : int, optional
+        The number of threads over which the output and the spline filter
+        are divided. The threads run without the global interpreter lock.
+        Default is 1.
 
     Returns
     -------
@@ -443,8 +481,10 @@ def shift(input, shift, output=None, order=3, mode='constant', cval=0.0,
     if input.ndim < 1:
         raise RuntimeError('input and output rank must be > 0')
     mode = _extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
     if prefilter and order > 1:
-        filtered = spline_filter(input, order, output = numpy.float64)
+        filtered = spline_filter(input, order, output = numpy.float64,
+                                 threads = threads)
     else:
         filtered = input
     output, return_value = _ni_support._get_output(output, input)
@@ -453,12 +493,13 @@ def shift(input, shift, output=None, order=3, mode='constant', cval=0.0,
     shift = numpy.asarray(shift, dtype = numpy.float64)
     if not shift.flags.contiguous:
         shift = shift.copy()
-    _nd_image.zoom_shift(filtered, None, shift, output, order, mode, cval)
+    _nd_image.zoom_shift(filtered, None, shift, output, order, mode, cval,
+                         threads)
     return return_value
 
 
 def zoom(input, zoom, output=None, order=3, mode='constant', cval=0.0,
-         prefilter=True):
+         prefilter=True, threads=1):
     """
     Zoom an array.
 
@@ -489,6 +530,10 @@ def zoom(input, zoom, output=None, order=3, mode='constant', cval=0.0,
         `spline_filter` before interpolation (necessary for spline
         interpolation of order > 1).  If False, it is assumed that the input is
         already filtered. Default is True.
+    threads : int, optional
+        The number of threads over which the output and the spline filter
+        are divided. The threads run without the global interpreter lock.
+        Default is 1.
 
     Returns
     -------
@@ -505,8 +550,10 @@ def zoom(input, zoom, output=None, order=3, mode='constant', cval=0.0,
     if input.ndim < 1:
         raise RuntimeError('input and output rank must be > 0')
     mode = _extend_mode_to_code(mode)
+    threads = _ni_support._check_threads(threads)
     if prefilter and order > 1:
-        filtered = spline_filter(input, order, output = numpy.float64)
+        filtered = spline_filter(input, order, output = numpy.float64,
+                                 threads = threads)
     else:
         filtered = input
     zoom = _ni_support._normalize_sequence(zoom, input.ndim)
@@ -516,7 +563,8 @@ def zoom(input, zoom, output=None, order=3, mode='constant', cval=0.0,
                                                    shape=output_shape)
     zoom = numpy.asarray(zoom, dtype = numpy.float64)
     zoom = numpy.ascontiguousarray(zoom)
-    _nd_image.zoom_shift(filtered, zoom, None, output, order, mode, cval)
+    _nd_image.zoom_shift(filtered, zoom, None, output, order, mode, cval,
+                         threads)
     return return_value
 
 def _minmax(coor, minc, maxc):
@@ -530,9 +578,62 @@ def _minmax(coor, minc, maxc):
         maxc[1] = coor[1]
     return minc, maxc
 
+def _rotation(shape, angle, axes, reshape):
+    """Return the sorted axes, the matrix and offset of the rotation in
+    their plane, and the output shape of a rotation"""
+    axes = list(axes)
+    rank = len(shape)
+    if axes[0] < 0:
+        axes[0] += rank
+    if axes[1] < 0:
+        axes[1] += rank
+    if axes[0] < 0 or axes[1] < 0 or axes[0] > rank or axes[1] > rank:
+        raise RuntimeError('invalid rotation plane specified')
+    if axes[0] > axes[1]:
+        axes = axes[1], axes[0]
+    angle = numpy.pi / 180 * angle
+    m11 = math.cos(angle)
+    m12 = math.sin(angle)
+    m21 = -math.sin(angle)
+    m22 = math.cos(angle)
+    matrix = numpy.array([[m11, m12],
+                             [m21, m22]], dtype = numpy.float64)
+    iy = shape[axes[0]]
+    ix = shape[axes[1]]
+    if reshape:
+        mtrx = numpy.array([[ m11, -m21],
+                               [-m12,  m22]], dtype = numpy.float64)
+        minc = [0, 0]
+        maxc = [0, 0]
+        coor = numpy.dot(mtrx, [0, ix])
+        minc, maxc = _minmax(coor, minc, maxc)
+        coor = numpy.dot(mtrx, [iy, 0])
+        minc, maxc = _minmax(coor, minc, maxc)
+        coor = numpy.dot(mtrx, [iy, ix])
+        minc, maxc = _minmax(coor, minc, maxc)
+        oy = int(maxc[0] - minc[0] + 0.5)
+        ox = int(maxc[1] - minc[1] + 0.5)
+    else:
+        oy = shape[axes[0]]
+        ox = shape[axes[1]]
+    offset = numpy.zeros((2,), dtype = numpy.float64)
+    offset[0] = float(oy) / 2.0 - 0.5
+    offset[1] = float(ox) / 2.0 - 0.5
+    offset = numpy.dot(matrix, offset)
+    tmp = numpy.zeros((2,), dtype = numpy.float64)
+    tmp[0] = float(iy) / 2.0 - 0.5
+    tmp[1] = float(ix) / 2.0 - 0.5
+    offset = tmp - offset
+    output_shape = list(shape)
+    output_shape[axes[0]] = oy
+    output_shape[axes[1]] = ox
+    output_shape = tuple(output_shape)
+    return axes, matrix, offset, output_shape
+
+
 def rotate(input, angle, axes=(1, 0), reshape=True,
            output=None, order=3,
-           mode='constant', cval=0.0, prefilter=True):
+           mode='constant', cval=0.0, prefilter=True, threads=1):
     """
     Rotate an array.
 
@@ -569,6 +670,10 @@ def rotate(input, angle, axes=(1, 0), reshape=True,
         `spline_filter` before interpolation (necessary for spline
         interpolation of order > 1).  If False, it is assumed that the input is
         already filtered. Default is True.
+    threads : int, optional
+        The number of threads over which the output and the spline filter
+        are divided. The threads run without the global interpreter lock.
+        Default is 1.
 
     Returns
     -------
@@ -578,58 +683,13 @@ def rotate(input, angle, axes=(1, 0), reshape=True,
 
     """
     input = numpy.asarray(input)
-    axes = list(axes)
-    rank = input.ndim
-    if axes[0] < 0:
-        axes[0] += rank
-    if axes[1] < 0:
-        axes[1] += rank
-    if axes[0] < 0 or axes[1] < 0 or axes[0] > rank or axes[1] > rank:
-        raise RuntimeError('invalid rotation plane specified')
-    if axes[0] > axes[1]:
-        axes = axes[1], axes[0]
-    angle = numpy.pi / 180 * angle
-    m11 = math.cos(angle)
-    m12 = math.sin(angle)
-    m21 = -math.sin(angle)
-    m22 = math.cos(angle)
-    matrix = numpy.array([[m11, m12],
-                             [m21, m22]], dtype = numpy.float64)
-    iy = input.shape[axes[0]]
-    ix = input.shape[axes[1]]
-    if reshape:
-        mtrx = numpy.array([[ m11, -m21],
-                               [-m12,  m22]], dtype = numpy.float64)
-        minc = [0, 0]
-        maxc = [0, 0]
-        coor = numpy.dot(mtrx, [0, ix])
-        minc, maxc = _minmax(coor, minc, maxc)
-        coor = numpy.dot(mtrx, [iy, 0])
-        minc, maxc = _minmax(coor, minc, maxc)
-        coor = numpy.dot(mtrx, [iy, ix])
-        minc, maxc = _minmax(coor, minc, maxc)
-        oy = int(maxc[0] - minc[0] + 0.5)
-        ox = int(maxc[1] - minc[1] + 0.5)
-    else:
-        oy = input.shape[axes[0]]
-        ox = input.shape[axes[1]]
-    offset = numpy.zeros((2,), dtype = numpy.float64)
-    offset[0] = float(oy) / 2.0 - 0.5
-    offset[1] = float(ox) / 2.0 - 0.5
-    offset = numpy.dot(matrix, offset)
-    tmp = numpy.zeros((2,), dtype = numpy.float64)
-    tmp[0] = float(iy) / 2.0 - 0.5
-    tmp[1] = float(ix) / 2.0 - 0.5
-    offset = tmp - offset
-    output_shape = list(input.shape)
-    output_shape[axes[0]] = oy
-    output_shape[axes[1]] = ox
-    output_shape = tuple(output_shape)
+    axes, matrix, offset, output_shape = _rotation(input.shape, angle, axes,
+                                                   reshape)
     output, return_value = _ni_support._get_output(output, input,
                                                    shape=output_shape)
     if input.ndim <= 2:
         affine_transform(input, matrix, offset, output_shape, output,
-                         order, mode, cval, prefilter)
+                         order, mode, cval, prefilter, threads)
     else:
         coordinates = []
         size = numpy.product(input.shape,axis=0)
@@ -649,7 +709,7 @@ def rotate(input, angle, axes=(1, 0), reshape=True,
             ia = input[tuple(coordinates)]
             oa = output[tuple(coordinates)]
             affine_transform(ia, matrix, offset, os, oa, order, mode,
-                             cval, prefilter)
+                             cval, prefilter, threads)
             for jj in iter_axes:
                 if coordinates[jj] < input.shape[jj] - 1:
                     coordinates[jj] += 1
@@ -657,3 +717,156 @@ def rotate(input, angle, axes=(1, 0), reshape=True,
                 else:
                     coordinates[jj] = 0
     return return_value
+
+
+# shadowed by the arguments of the methods of SplineInterpolator:
+_shift = shift
+_zoom = zoom
+
+
+class SplineInterpolator(object):
+    """
+    Spline interpolation of an array with precomputed coefficients.
+
+    The functions of this module that interpolate with splines of order
+    larger than one compute the spline coefficients of the whole input on
+    every call. A SplineInterpolator computes them once, so that the same
+    array can be resampled many times, for instance by an optimizer that
+    tries many transforms.
+
+    Parameters
+    ----------
+    input : ndarray
+        The input array.
+    order : int, optional
+        The order of the spline interpolation, default is 3.
+        The order has to be in the range 0-5.
+    mode : str, optional
+        Points outside the boundaries of the input are filled according
+        to the given mode ('constant', 'nearest', 'reflect' or 'wrap').
+        Default is 'constant'.
+    cval : scalar, optional
+        Value used for points outside the boundaries of the input if
+        ``mode='constant'``. Default is 0.0
+    dtype : dtype, optional
+        The type of the stored coefficients, `numpy.float64` or
+        `numpy.float32`. Single precision halves the memory used, at the
+        cost of precision. Default is `numpy.float64`.
+    prefilter : bool, optional
+        If False, it is assumed that the input already holds the spline
+        coefficients, which are then used as is. Default is True.
+    threads : int, optional
+        The number of threads used to compute the coefficients and to
+        interpolate. Default is 1.
+
+    Attributes
+    ----------
+    coefficients : ndarray
+        The spline coefficients of the input.
+
+    Notes
+    -----
+    The methods take the arguments of the functions of the same name,
+    without those of the interpolation given to the constructor. Unless
+    given, the type of their output is that of the original input.
+
+    Examples
+    --------
+    >>> a = np.arange(12.).reshape((4, 3))
+    >>> ip = sp.ndimage.SplineInterpolator(a, order=3)
+    >>> ip([[0.5, 2], [0.5, 1]])
+    array([ 1.3625,  7.    ])
+    >>> ip.shift([1, 0]).shape
+    (4, 3)
+
+    """
+    def __init__(self, input, order=3, mode='constant', cval=0.0,
+                 dtype=numpy.float64, prefilter=True, threads=1):
+        if order < 0 or order > 5:
+            raise RuntimeError('spline order not supported')
+        input = numpy.asarray(input)
+        if numpy.iscomplexobj(input):
+            raise TypeError('Complex type not supported')
+        if input.ndim < 1:
+            raise RuntimeError('input and output rank must be > 0')
+        dtype = numpy.dtype(dtype)
+        if dtype not in [numpy.dtype(numpy.float32),
+                         numpy.dtype(numpy.float64)]:
+            raise RuntimeError('coefficients must be float32 or float64')
+        if prefilter and order > 1:
+            self.coefficients = spline_filter(input, order,
+                                              output = dtype.type,
+                                              threads = threads)
+        else:
+            self.coefficients = input
+        self.order = order
+        self.mode = mode
+        self.cval = cval
+        self.shape = input.shape
+        self.dtype = input.dtype.type
+        self.threads = threads
+
+    def _output(self, output):
+        if output is None:
+            return self.dtype
+        return output
+
+    def __call__(self, coordinates, output=None):
+        """Interpolate at coordinates, see `map_coordinates`"""
+        return self.map_coordinates(coordinates, output)
+
+    def map_coordinates(self, coordinates, output=None):
+        """Map the array to new coordinates, see `map_coordinates`"""
+        return map_coordinates(self.coefficients, coordinates,
+                               self._output(output), self.order, self.mode,
+                               self.cval, prefilter=False,
+                               threads=self.threads)
+
+    def geometric_transform(self, mapping, output_shape=None, output=None,
+                            extra_arguments=(), extra_keywords={}):
+        """Apply a geometric transform, see `geometric_transform`"""
+        return geometric_transform(self.coefficients, mapping, output_shape,
+                                   self._output(output), self.order,
+                                   self.mode, self.cval, prefilter=False,
+                                   extra_arguments=extra_arguments,
+                                   extra_keywords=extra_keywords,
+                                   threads=self.threads)
+
+    def affine_transform(self, matrix, offset=0.0, output_shape=None,
+                         output=None):
+        """Apply an affine transformation, see `affine_transform`"""
+        return affine_transform(self.coefficients, matrix, offset,
+                                output_shape, self._output(output),
+                                self.order, self.mode, self.cval,
+                                prefilter=False, threads=self.threads)
+
+    def shift(self, shift, output=None):
+        """Shift the array, see `shift`"""
+        return _shift(self.coefficients, shift, self._output(output),
+                      self.order, self.mode, self.cval, prefilter=False,
+                      threads=self.threads)
+
+    def zoom(self, zoom, output=None):
+        """Zoom the array, see `zoom`"""
+        return _zoom(self.coefficients, zoom, self._output(output),
+                     self.order, self.mode, self.cval, prefilter=False,
+                     threads=self.threads)
+
+    def rotate(self, angle, axes=(1, 0), reshape=True, output=None):
+        """Rotate the array, see `rotate`"""
+        # rotate resamples the planes one at a time, which the coefficients
+        # of more than two dimensions do not allow: the rotation is applied
+        # to the whole array as one affine transform instead.
+        axes, mtrx, offs, output_shape = _rotation(self.shape, angle, axes,
+                                                   reshape)
+        rank = len(self.shape)
+        matrix = numpy.identity(rank, dtype = numpy.float64)
+        offset = numpy.zeros((rank,), dtype = numpy.float64)
+        for ii in range(2):
+            offset[axes[ii]] = offs[ii]
+            for jj in range(2):
+                matrix[axes[ii], axes[jj]] = mtrx[ii, jj]
+        return affine_transform(self.coefficients, matrix, offset,
+                                output_shape, self._output(output),
+                                self.order, self.mode, self.cval,
+                                prefilter=False, threads=self.threads)
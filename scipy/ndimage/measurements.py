@@ -34,7 +34,8 @@ import _ni_support
 import _nd_image
 import morphology
 
-def label(input, structure = None, output = None):
+def label(input, structure = None, output = None, threads = 1,
+          objects = False):
     """
     Label features in an array.
 
@@ -62,11 +63,23 @@ def label(input, structure = None, output = None):
 
     output : (None, data-type, array_like), optional
         If `output` is a data type, it specifies the type of the resulting
-        labeled feature array
+        labeled feature array, which must be int32 or int64. By default
+        the labels are int32, or int64 if the input has too many elements
+        to number its features with int32.
 
         If `output` is an array-like object, then `output` will be updated
         with the labeled features from this function
 
+    threads : int, optional
+        The number of threads that label slabs of the array along its
+        first axis. The threads run without the global interpreter lock.
+        Default is 1.
+
+    objects : bool, optional
+        If True, also return a list of slices for the extent of each
+        feature, as returned by `find_objects`, found in the same pass.
+        Default is False.
+
     Returns
     -------
     labeled_array : array_like
@@ -75,12 +88,23 @@ def label(input, structure = None, output = None):
     num_features : int
         How many objects were found
 
+    object_slices : list of tuples of slices
+        The slices of the features, only if `objects` is True.
+
     If `output` is None or a data type, this function returns a tuple,
     (`labeled_array`, `num_features`).
 
     If `output` is an array, then it will be updated with values in
     `labeled_array` and only `num_features` will be returned by this function.
 
+    If `objects` is True, `object_slices` is added to the result as a last
+    element.
+
+    Notes
+    -----
+    The features are labeled in two passes with a union-find structure.
+    The features are numbered in the order of their first element.
+
 
     See Also
     --------
@@ -150,17 +174,34 @@ def label(input, structure = None, output = None):
             raise  RuntimeError('structure dimensions must be equal to 3')
     if not structure.flags.contiguous:
         structure = structure.copy()
+    threads = _ni_support._check_threads(threads)
+    # compare dtypes, not their types: longlong is also a 64-bit integer
+    int64 = numpy.dtype(numpy.int64)
     if isinstance(output, numpy.ndarray):
-        if output.dtype.type != numpy.int32:
-            raise RuntimeError('output type must be int32')
-    else:
+        if output.dtype not in [numpy.dtype(numpy.int32), int64]:
+            raise RuntimeError('output type must be int32 or int64')
+    elif output is not None and numpy.dtype(output) == int64:
+        output = numpy.int64
+    elif input.size < 2**31 - 1:
         output = numpy.int32
+    else:
+        output = numpy.int64
     output, return_value = _ni_support._get_output(output, input)
-    max_label = _nd_image.label(input, structure, output)
+    result = _nd_image.label(input, structure, output, threads,
+                             bool(objects))
+    if objects:
+        max_label, object_slices = result
+    else:
+        max_label = result
     if return_value is None:
-        return max_label
+        result = (max_label,)
     else:
-        return return_value, max_label
+        result = (return_value, max_label)
+    if objects:
+        result = result + (object_slices,)
+    if len(result) == 1:
+        return result[0]
+    return result
 
 def find_objects(input, max_label = 0):
     """
@@ -374,6 +415,195 @@ def labeled_comprehension(input, labels, index, func, out_dtype, default, pass_p
 
     return output
 
+_statistics = ['count', 'sum', 'mean', 'variance', 'standard_deviation',
+               'minimum', 'maximum', 'minimum_position', 'maximum_position',
+               'center_of_mass', 'bounding_box', 'histogram']
+
+def labeled_statistics(input, labels = None, index = None, statistics = None,
+                       histogram = None, threads = 1):
+    """
+    Calculate several statistics of an array at labels in a single pass.
+
+    Parameters
+    ----------
+    input : array_like
+        Data of which to calculate the statistics.
+    labels : array_like or None, optional
+        Labels of the objects in `input`. If not None, must be broadcastable
+        to the shape of `input`.
+    index : int, sequence of int, or None, optional
+        Label or labels for which to calculate the statistics. If None, all
+        values where `labels` is greater than zero are used.
+    statistics : sequence of str, optional
+        The statistics to calculate, any of 'count', 'sum', 'mean',
+        'variance', 'standard_deviation', 'minimum', 'maximum',
+        'minimum_position', 'maximum_position', 'center_of_mass',
+        'bounding_box' and 'histogram'. Default is ['count', 'sum', 'mean'].
+    histogram : tuple, optional
+        The (min, max, bins) of the histogram, required if 'histogram' is
+        calculated.
+    threads : int, optional
+        The number of threads that process slabs of the array along its
+        first axis, each with its own tables that are combined afterwards.
+        The threads run without the global interpreter lock. Default is 1.
+
+    Returns
+    -------
+    result : dict
+        The value of each statistic. If `index` is a sequence, each value
+        is an array with a first axis of the length of `index`:
+
+        - count : the number of elements.
+        - sum, mean, variance, standard_deviation, minimum, maximum : floats.
+          As with `numpy.min` and `numpy.max`, the extrema of an object
+          that contains NaN values are NaN.
+        - minimum_position, maximum_position : the coordinates of the first
+          minimum or maximum, or of the first NaN value, with a last axis
+          of the rank of `input`.
+        - center_of_mass : coordinates, with a last axis of the rank of
+          `input`.
+        - bounding_box : the start and end coordinates of the smallest box
+          that contains the object, with shape (2, rank), or -1 if the
+          object does not exist.
+        - histogram : the counts in each bin.
+
+    See also
+    --------
+    sum, mean, variance, minimum, maximum, extrema, center_of_mass, histogram
+
+    Examples
+    --------
+    >>> a = np.array([[1, 2, 0, 0],
+    ...               [5, 3, 0, 4],
+    ...               [0, 0, 0, 7],
+    ...               [9, 3, 0, 0]])
+    >>> lbl, nlbl = ndimage.label(a)
+    >>> s = ndimage.labeled_statistics(a, lbl, [1, 2, 3],
+    ...                                ['sum', 'maximum', 'bounding_box'])
+    >>> s['sum']
+    array([ 11.,  11.,  12.])
+    >>> s['maximum']
+    array([ 5.,  7.,  9.])
+    >>> s['bounding_box'][1]
+    array([[1, 3],
+           [3, 4]])
+
+    """
+    input = numpy.asarray(input)
+    if numpy.iscomplexobj(input):
+        raise TypeError('Complex type not supported')
+    if statistics is None:
+        statistics = ['count', 'sum', 'mean']
+    for name in statistics:
+        if name not in _statistics:
+            raise ValueError('unknown statistic: %s' % name)
+    threads = _ni_support._check_threads(threads)
+    edges = None
+    if 'histogram' in statistics:
+        if histogram is None:
+            raise ValueError('histogram range and bins not given')
+        hmin, hmax, bins = histogram
+        edges = numpy.linspace(hmin, hmax, int(bins) + 1)
+    if labels is not None:
+        labels = numpy.asarray(labels)
+        if numpy.iscomplexobj(labels):
+            raise TypeError('Complex type not supported')
+        input, labels = numpy.broadcast_arrays(input, labels)
+
+    # map the labels to rows of the tables through a lookup table, or
+    # replace them by the rows if their range is too large. Without a
+    # table, all positive labels map to the first row:
+    min_label = max_label = 0
+    indices = None
+    scalar = labels is None or index is None or numpy.isscalar(index)
+    if labels is None or index is None:
+        inverse = numpy.zeros(1, numpy.intp)
+        nresults = 1
+        if labels is not None and labels.dtype.kind not in 'biu':
+            labels = labels > 0
+    else:
+        unique, inverse = numpy.unique(numpy.atleast_1d(index),
+                                       return_inverse=True)
+        nresults = unique.size
+        if (labels.dtype.kind in 'biu' and
+                unique[0] >= numpy.iinfo(numpy.intp).min and
+                unique[-1] <= numpy.iinfo(numpy.intp).max and
+                float(unique[-1]) - unique[0] < 2 * labels.size + nresults):
+            min_label, max_label = int(unique[0]), int(unique[-1])
+            indices = numpy.zeros(max_label - min_label + 1, numpy.intp) - 1
+            indices[unique - min_label] = numpy.arange(nresults)
+        else:
+            rows = numpy.searchsorted(unique, labels)
+            rows[rows >= nresults] = 0
+            rows[unique[rows] != labels] = -1
+            labels = rows
+            min_label, max_label = 0, nresults - 1
+            indices = numpy.arange(nresults, dtype=numpy.intp)
+
+    def table(name, dtype, *shape):
+        if name in statistics:
+            return numpy.zeros((nresults,) + shape, dtype)
+        return None
+    rank = input.ndim
+    count = numpy.zeros(nresults, numpy.intp)
+    sums = table('sum', numpy.float64)
+    if sums is None and ('mean' in statistics or
+                         'center_of_mass' in statistics):
+        sums = numpy.zeros(nresults, numpy.float64)
+    m2 = None
+    if 'variance' in statistics or 'standard_deviation' in statistics:
+        m2 = numpy.zeros(nresults, numpy.float64)
+    minimum = table('minimum', numpy.float64)
+    maximum = table('maximum', numpy.float64)
+    min_pos = table('minimum_position', numpy.intp)
+    if min_pos is not None and minimum is None:
+        minimum = numpy.zeros(nresults, numpy.float64)
+    max_pos = table('maximum_position', numpy.intp)
+    if max_pos is not None and maximum is None:
+        maximum = numpy.zeros(nresults, numpy.float64)
+    center = table('center_of_mass', numpy.float64, rank)
+    box = table('bounding_box', numpy.intp, 2, rank)
+    hist = None
+    if edges is not None:
+        hist = table('histogram', numpy.intp, edges.size - 1)
+    _nd_image.statistics(input, labels, min_label, max_label, indices, count,
+                         sums, m2, minimum, maximum, min_pos, max_pos, center,
+                         box, hist, edges, threads)
+
+    dims = numpy.array(input.shape)
+    dim_prod = numpy.cumprod([1] + list(dims[:0:-1]))[::-1]
+    result = {}
+    for name in statistics:
+        if name == 'count':
+            value = count
+        elif name == 'sum':
+            value = sums
+        elif name == 'mean':
+            value = sums / count
+        elif name == 'variance':
+            value = m2 / count
+        elif name == 'standard_deviation':
+            value = numpy.sqrt(m2 / count)
+        elif name == 'minimum':
+            value = minimum
+        elif name == 'maximum':
+            value = maximum
+        elif name == 'minimum_position':
+            value = (min_pos.reshape(-1, 1) // dim_prod) % dims
+        elif name == 'maximum_position':
+            value = (max_pos.reshape(-1, 1) // dim_prod) % dims
+        elif name == 'center_of_mass':
+            value = center / sums.reshape(-1, 1)
+        elif name == 'bounding_box':
+            value = box
+        elif name == 'histogram':
+            value = hist
+        value = value[inverse]
+        if scalar:
+            value = value[0]
+        result[name] = value
+    return result
+
 def _safely_castable_to_int(dt):
     """Test whether the numpy data type `dt` can be safely cast to an int."""
     int_size = np.dtype(int).itemsize
@@ -690,6 +920,29 @@ def _select(input, labels = None, index = None, find_min=False, find_max=False,
             masked_positions = positions[mask]
         return single_group(input[mask], masked_positions)
 
+    if (input.dtype.kind == 'f' or
+            (input.dtype.kind in 'biu' and input.dtype.itemsize <= 4)):
+        # the extrema are exact as doubles, find them in one pass:
+        names = []
+        if find_min:
+            names += ['minimum']
+        if find_min_positions:
+            names += ['minimum_position']
+        if find_max:
+            names += ['maximum']
+        if find_max_positions:
+            names += ['maximum_position']
+        stats = labeled_statistics(input, labels, index, names)
+        dims = numpy.array(input.shape)
+        dim_prod = numpy.cumprod([1] + list(dims[:0:-1]))[::-1]
+        result = []
+        for name in names:
+            if name.endswith('position'):
+                result += [numpy.dot(stats[name], dim_prod).astype(float)]
+            else:
+                result += [stats[name].astype(input.dtype)]
+        return result
+
     order = input.ravel().argsort()
     input = input.ravel()[order]
     labels = labels.ravel()[order]
@@ -774,7 +1027,8 @@ def minimum(input, labels = None, index = None):
     -----
 
     The function returns a Python list and not a Numpy array, use
-    `np.array` to convert the list to an array.
+    `np.array` to convert the list to an array. As with `np.min`, the
+    minimum of a region that contains NaN values is NaN.
 
     Examples
     --------
@@ -835,7 +1089,8 @@ def maximum(input, labels = None, index = None):
     Notes
     -----
     The function returns a Python list and not a Numpy array, use
-    `np.array` to convert the list to an array.
+    `np.array` to convert the list to an array. As with `np.max`, the
+    maximum of a region that contains NaN values is NaN.
 
     Examples
     --------
@@ -1032,15 +1287,13 @@ def center_of_mass(input, labels = None, index = None):
 
     """
 
-    normalizer = sum(input, labels, index)
-    grids = numpy.ogrid[[slice(0, i) for i in input.shape]]
+    results = labeled_statistics(input, labels, index,
+                                 ['center_of_mass'])['center_of_mass']
 
-    results = [sum(input * grids[dir].astype(float), labels, index) / normalizer for dir in range(input.ndim)]
-
-    if numpy.isscalar(results[0]):
+    if results.ndim == 1:
         return tuple(results)
 
-    return [tuple(v) for v in numpy.array(results).T]
+    return [tuple(v) for v in results]
 
 def histogram(input, min, max, bins, labels = None, index = None):
     """
@@ -1094,12 +1347,21 @@ def histogram(input, min, max, bins, labels = None, index = None):
 
     """
 
-    _bins = numpy.linspace(min, max, bins + 1)
-
-    def _hist(vals):
-        return numpy.histogram(vals, _bins)[0]
-
-    return labeled_comprehension(input, labels, index, _hist, object, None, pass_positions=False)
+    stats = labeled_statistics(input, labels, index, ['count', 'histogram'],
+                               histogram=(min, max, bins))
+    # objects that do not exist have no histogram:
+    if stats['count'].ndim == 0:
+        if labels is not None and index is not None and stats['count'] == 0:
+            return None
+        return stats['histogram']
+
+    result = numpy.zeros(stats['count'].shape, object)
+    for ii in range(result.size):
+        if stats['count'][ii] > 0:
+            result[ii] = stats['histogram'][ii]
+        else:
+            result[ii] = None
+    return result
 
 def watershed_ift(input, markers, structure = None, output = None):
     """Apply watershed from markers using a iterative forest transform
@@ -1110,6 +1372,9 @@ def watershed_ift(input, markers, structure = None, output = None):
     the connectivity of the object can be provided. If none is
     provided an element is generated iwth a squared connecitiviy equal
     to one. An output array can optionally be provided.
+
+    Only 8 and 16 bit unsigned inputs are supported; `watershed` floods
+    inputs of any real type.
     """
     input = numpy.asarray(input)
     if input.dtype.type not in [numpy.uint8, numpy.uint16]:
@@ -1147,3 +1412,101 @@ def watershed_ift(input, markers, structure = None, output = None):
     output, return_value = _ni_support._get_output(output, input)
     _nd_image.watershed_ift(input, markers, structure, output)
     return return_value
+
+def watershed(input, markers, structure = None, mask = None,
+              compactness = 0.0, output = None):
+    """
+    Flood an array from markers in the order of its values.
+
+    Starting from the markers, the neighbors of labeled elements are
+    labeled in the order of increasing value of `input`, each with the
+    label of the element it was reached from.
+
+    Parameters
+    ----------
+    input : array_like
+        The priorities of the elements, typically a gradient magnitude.
+        Can be of any real type, including floating point.
+    markers : array_like
+        Integer array of the same shape as `input`, with the labels of the
+        markers and zero elsewhere.
+    structure : array_like, optional
+        The connectivity, with the same rank as `input` and odd sizes,
+        centered on the element. The default is a squared connectivity
+        equal to one.
+    mask : array_like, optional
+        If given, only elements where `mask` is True are labeled.
+    compactness : float, optional
+        If greater than zero, the Euclidean distance to the marker that an
+        element is reached from, multiplied by `compactness`, is added to
+        its value, which gives more regularly shaped regions. Default is 0.
+    output : ndarray or dtype, optional
+        The array or type of the labels, int32 or int64. The default is
+        int64 if `markers` has 64-bit integers and int32 otherwise.
+
+    Returns
+    -------
+    output : ndarray
+        The labels. None if `output` is an array.
+
+    See also
+    --------
+    watershed_ift, label
+
+    Notes
+    -----
+    Elements of equal priority are labeled in the order they were reached.
+    Besides the output, the memory used is one byte per element and the
+    queue of the flooding front.
+
+    Examples
+    --------
+    >>> a = np.array([0.1, 0.3, 0.9, 0.2, 0.0])
+    >>> ndimage.watershed(a, [1, 0, 0, 0, 2])
+    array([1, 1, 2, 2, 2])
+
+    """
+    input = numpy.asarray(input)
+    if numpy.iscomplexobj(input):
+        raise TypeError('Complex type not supported')
+    # half and extended precision values are flooded as doubles:
+    if input.dtype.kind == 'f' and input.dtype.itemsize not in (4, 8):
+        input = input.astype(numpy.float64)
+    if structure is None:
+        structure = morphology.generate_binary_structure(input.ndim, 1)
+    structure = numpy.asarray(structure, dtype = bool)
+    if structure.ndim != input.ndim:
+        raise RuntimeError('structure and input must have equal rank')
+    for ii in structure.shape:
+        if ii % 2 != 1:
+            raise RuntimeError('structure dimensions must be odd')
+    if not structure.flags.contiguous:
+        structure = structure.copy()
+    markers = numpy.asarray(markers)
+    if input.shape != markers.shape:
+        raise RuntimeError('input and markers must have equal shape')
+    if markers.dtype.kind not in 'iu':
+        raise RuntimeError('marker should be of integer type')
+    if mask is not None:
+        mask = numpy.asarray(mask, dtype = bool)
+        if mask.shape != input.shape:
+            raise RuntimeError('input and mask must have equal shape')
+        if not mask.flags.contiguous:
+            mask = mask.copy()
+    # compare dtypes, not their types: longlong is also a 64-bit integer
+    labels_types = [numpy.dtype(numpy.int32), numpy.dtype(numpy.int64)]
+    if isinstance(output, numpy.ndarray):
+        if output.dtype not in labels_types:
+            raise RuntimeError('output type must be int32 or int64')
+    elif output is not None:
+        if numpy.dtype(output) not in labels_types:
+            raise RuntimeError('output type must be int32 or int64')
+        output = numpy.dtype(output).type
+    elif markers.dtype.itemsize > 4:
+        output = numpy.int64
+    else:
+        output = numpy.int32
+    output, return_value = _ni_support._get_output(output, input)
+    _nd_image.watershed(input, markers, structure, mask, float(compactness),
+                        output)
+    return return_value
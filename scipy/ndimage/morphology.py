@@ -244,8 +244,13 @@ def _binary_erosion(input, structure, iterations, mask, output,
         output = bool
     output, return_value = _ni_support._get_output(output, input)
 
-
-    if iterations == 1:
+    if iterations >= 1 and not brute_force and input.ndim > 0:
+        # a fixed number of iterations runs on bit-packed lines:
+        _nd_image.packed_binary_erosion(input, structure, mask, output,
+                                        border_value, origin, invert,
+                                        iterations)
+        return return_value
+    elif iterations == 1:
         _nd_image.binary_erosion(input, structure, mask, output,
                                      border_value, origin, invert, cit, 0)
         return return_value
@@ -328,6 +333,12 @@ def binary_erosion(input, structure = None, iterations = 1, mask = None,
     border_value: int (cast to 0 or 1)
         Value at the border in the output array.
 
+    brute_force: boolean, optional
+        By default a fixed number of iterations is computed on bit-packed
+        lines, and the iteration until convergence only revisits elements
+        that changed in the previous iteration. If True, every element is
+        recomputed at each iteration.
+
 
     Returns
     -------
@@ -431,6 +442,12 @@ def binary_dilation(input, structure = None, iterations = 1, mask = None,
     border_value : int (cast to 0 or 1)
         Value at the border in the output array.
 
+    brute_force : boolean, optional
+        By default a fixed number of iterations is computed on bit-packed
+        lines, and the iteration until convergence only revisits elements
+        that changed in the previous iteration. If True, every element is
+        recomputed at each iteration.
+
 
     Returns
     -------
@@ -2038,7 +2055,7 @@ def distance_transform_cdt(input, metric = 'chessboard',
 
 def distance_transform_edt(input, sampling = None,
                         return_distances = True, return_indices = False,
-                        distances = None, indices = None):
+                        distances = None, indices = None, threads = 1):
     """
     Exact euclidean distance transform.
 
@@ -2060,10 +2077,15 @@ def distance_transform_edt(input, sampling = None,
         return_distances/return_indices must be True. Default is True.
     return_indices : bool, optional
         Whether to return indices matrix. Default is False.
-    distance : ndarray, optional
-        Used for output of distance array, must be of type float64.
+    distances : ndarray or dtype, optional
+        Used for output of distance array, must be of type float64 or
+        float32. If a dtype, the type of the returned distances, float64
+        by default.
     indices : ndarray, optional
         Used for output of indices, must be of type int32.
+    threads : int, optional
+        The number of threads over which the lines along each axis are
+        divided if only the distances are calculated. Default is 1.
 
     Returns
     -------
@@ -2085,6 +2107,10 @@ def distance_transform_edt(input, sampling = None,
     Euclidean distance to input points x[i], and n is the
     number of dimensions.
 
+    If the indices are not requested, the distances are calculated
+    directly by one dimensional transforms along each axis in turn, in
+    linear time and without the memory of the feature transform.
+
     Examples
     --------
     >>> a = np.array(([0,1,1,1,1],
@@ -2149,15 +2175,39 @@ def distance_transform_edt(input, sampling = None,
     if (not return_distances) and (not return_indices):
         msg = 'at least one of distances/indices must be specified'
         raise RuntimeError(msg)
+    threads = _ni_support._check_threads(threads)
     ft_inplace = isinstance(indices, numpy.ndarray)
     dt_inplace = isinstance(distances, numpy.ndarray)
-    # calculate the feature transform
+    if dt_inplace:
+        dt_type = distances.dtype.type
+    elif distances is None:
+        dt_type = numpy.float64
+    else:
+        dt_type = numpy.dtype(distances).type
+    if dt_type not in (numpy.float32, numpy.float64):
+        raise RuntimeError('distances must be of float64 or float32 type')
     input = numpy.where(input, 1, 0).astype(numpy.int8)
     if sampling is not None:
         sampling = _ni_support._normalize_sequence(sampling, input.ndim)
         sampling = numpy.asarray(sampling, dtype = numpy.float64)
         if not sampling.flags.contiguous:
             sampling = sampling.copy()
+    if dt_inplace and distances.shape != input.shape:
+        raise RuntimeError('distances has wrong shape')
+    if not return_indices:
+        # calculate the distances without the feature transform
+        if dt_inplace:
+            dt = distances
+        else:
+            dt = numpy.zeros(input.shape, dtype = dt_type)
+        _nd_image.euclidean_distance_transform(input, sampling, dt, threads)
+        # without background elements all distances are infinite; the
+        # feature transform then gives the same distances as with indices:
+        if dt.size == 0 or not numpy.isinf(dt.flat[0]):
+            if dt_inplace:
+                return None
+            return dt
+    # calculate the feature transform
     if ft_inplace:
         ft = indices
         if ft.shape != (input.ndim,) + input.shape:
@@ -2176,17 +2226,12 @@ def distance_transform_edt(input, sampling = None,
             for ii in range(len(sampling)):
                 dt[ii, ...] *= sampling[ii]
         numpy.multiply(dt, dt, dt)
+        dt = numpy.add.reduce(dt, axis = 0)
         if dt_inplace:
-            dt = numpy.add.reduce(dt, axis = 0)
-            if distances.shape != dt.shape:
-                raise RuntimeError('indices has wrong shape')
-            if distances.dtype.type != numpy.float64:
-                raise RuntimeError('indices must be of float64 type')
             numpy.sqrt(dt, distances)
             del dt
         else:
-            dt = numpy.add.reduce(dt, axis = 0)
-            dt = numpy.sqrt(dt)
+            dt = numpy.sqrt(dt).astype(dt_type)
     # construct and return the result
     result = []
     if return_distances and not dt_inplace:
@@ -39,6 +39,7 @@
 #include "ni_measure.h"
 
 #include "numpy/npy_3kcompat.h"
+#include <string.h>
 
 typedef struct {
     PyObject *function;
@@ -46,6 +47,51 @@ typedef struct {
     PyObject *extra_keywords;
 } NI_PythonCallbackData;
 
+/* The signatures of the C functions that may be passed in a capsule to
+     generic_filter (per element or per block), generic_filter1d and
+     geometric_transform: */
+#define NI_FILTER_SIGNATURE "int (double *, npy_intp, double *, void *)"
+#define NI_FILTER1D_SIGNATURE \
+    "int (double *, npy_intp, double *, npy_intp, void *)"
+#define NI_MAPPING_SIGNATURE "int (npy_intp *, double *, int, int, void *)"
+#define NI_BLOCK_FILTER_SIGNATURE \
+    "int (double *, npy_intp, npy_intp, double *, void *)"
+
+/* Get the function pointer and the user data of a low-level callback: a
+     capsule with the function as its pointer and the user data as its
+     context. A capsule with a name must be named by the signature of the
+     function, and returns 2: it is called without the GIL. Unnamed
+     capsules (and CObjects on Python 2) are accepted unchecked, and
+     return 1: as before, they are called with the GIL, since they may
+     use the Python API. Returns 0 if the object is not a capsule, and -1
+     with an exception set for an invalid capsule: */
+static int NI_GetCallback(PyObject *fnc, const char *signature,
+                          void **func, void **data)
+{
+#if PY_VERSION_HEX >= 0x02070000
+    if (PyCapsule_CheckExact(fnc)) {
+        const char *name = PyCapsule_GetName(fnc);
+        if (name && strcmp(name, signature) != 0) {
+            PyErr_Format(PyExc_ValueError,
+                         "invalid callback signature \"%s\", expected \"%s\"",
+                         name, signature);
+            return -1;
+        }
+        *func = PyCapsule_GetPointer(fnc, name);
+        if (!*func)
+            return -1;
+        *data = PyCapsule_GetContext(fnc);
+        return name ? 2 : 1;
+    }
+#endif
+    if (NpyCapsule_Check(fnc)) {
+        *func = NpyCapsule_AsVoidPtr(fnc);
+        *data = NpyCapsule_GetDesc(fnc);
+        return 1;
+    }
+    return 0;
+}
+
 /* Convert an input array of any type, not necessarily contiguous */
 static int
 NI_ObjectToInputArray(PyObject *object, PyArrayObject **array)
@@ -130,7 +176,7 @@ NI_ObjectToLongSequence(PyObject *object, npy_intp **sequence)
 static PyObject *Py_Correlate1D(PyObject *obj, PyObject *args)
 {
     PyArrayObject *input = NULL, *output = NULL, *weights = NULL;
-    int axis, mode;
+    int axis, mode, threads;
     double cval;
 #if PY_VERSION_HEX < 0x02050000
     long origin;
@@ -140,17 +186,39 @@ static PyObject *Py_Correlate1D(PyObject *obj, PyObject *args)
 #define FMT "n"
 #endif
 
-    if (!PyArg_ParseTuple(args, "O&O&iO&id" FMT,
+    if (!PyArg_ParseTuple(args, "O&O&iO&id" FMT "i",
                           NI_ObjectToInputArray, &input,
                           NI_ObjectToInputArray, &weights, &axis,
                           NI_ObjectToOutputArray, &output, &mode, &cval,
-                          &origin))
+                          &origin, &threads))
         goto exit;
 
 #undef FMT
 
     if (!NI_Correlate1D(input, weights, axis, output,
-                                            (NI_ExtendMode)mode, cval, origin))
+                                            (NI_ExtendMode)mode, cval, origin, threads))
+        goto exit;
+exit:
+    Py_XDECREF(input);
+    Py_XDECREF(weights);
+    Py_XDECREF(output);
+    return PyErr_Occurred() ? NULL : Py_BuildValue("");
+}
+
+static PyObject *Py_Correlate1DPyramid(PyObject *obj, PyObject *args)
+{
+    PyArrayObject *input = NULL, *output = NULL, *weights = NULL;
+    int axis, mode, expand, threads;
+    double cval;
+
+    if (!PyArg_ParseTuple(args, "O&O&iO&idii",
+                          NI_ObjectToInputArray, &input,
+                          NI_ObjectToInputArray, &weights, &axis,
+                          NI_ObjectToOutputArray, &output, &mode, &cval,
+                          &expand, &threads))
+        goto exit;
+    if (!NI_Correlate1DPyramid(input, weights, axis, output,
+                               (NI_ExtendMode)mode, cval, expand, threads))
         goto exit;
 exit:
     Py_XDECREF(input);
@@ -187,7 +255,7 @@ exit:
 static PyObject *Py_UniformFilter1D(PyObject *obj, PyObject *args)
 {
     PyArrayObject *input = NULL, *output = NULL;
-    int axis, mode;
+    int axis, mode, threads;
 #if PY_VERSION_HEX < 0x02050000
     long filter_size, origin;
 #define FMT "l"
@@ -197,17 +265,56 @@ static PyObject *Py_UniformFilter1D(PyObject *obj, PyObject *args)
 #endif
     double cval;
 
-    if (!PyArg_ParseTuple(args, "O&" FMT "iO&id" FMT,
+    if (!PyArg_ParseTuple(args, "O&" FMT "iO&id" FMT "i",
                           NI_ObjectToInputArray, &input,
                           &filter_size, &axis,
                           NI_ObjectToOutputArray, &output,
-                          &mode, &cval, &origin))
+                          &mode, &cval, &origin, &threads))
         goto exit;
     if (!NI_UniformFilter1D(input, filter_size, axis, output,
-                            (NI_ExtendMode)mode, cval, origin))
+                            (NI_ExtendMode)mode, cval, origin, threads))
+        goto exit;
+exit:
+    Py_XDECREF(input);
+    Py_XDECREF(output);
+    return PyErr_Occurred() ? NULL : Py_BuildValue("");
+}
+
+static PyObject *Py_RecursiveFilter1D(PyObject *obj, PyObject *args)
+{
+    PyArrayObject *input = NULL, *output = NULL, *causal = NULL;
+    PyArrayObject *anticausal = NULL, *denominator = NULL;
+    int axis, mode, threads;
+#if PY_VERSION_HEX < 0x02050000
+    long extension;
+#define FMT "l"
+#else
+    npy_intp extension;
+#define FMT "n"
+#endif
+    double cval;
+
+    if (!PyArg_ParseTuple(args, "O&O&O&O&" FMT "iO&idi",
+                          NI_ObjectToInputArray, &input,
+                          NI_ObjectToInputArray, &causal,
+                          NI_ObjectToInputArray, &anticausal,
+                          NI_ObjectToInputArray, &denominator,
+                          &extension, &axis,
+                          NI_ObjectToOutputArray, &output,
+                          &mode, &cval, &threads))
+        goto exit;
+
+#undef FMT
+
+    if (!NI_RecursiveFilter1D(input, causal, anticausal, denominator,
+                              extension, axis, output, (NI_ExtendMode)mode,
+                              cval, threads))
         goto exit;
 exit:
     Py_XDECREF(input);
+    Py_XDECREF(causal);
+    Py_XDECREF(anticausal);
+    Py_XDECREF(denominator);
     Py_XDECREF(output);
     return PyErr_Occurred() ? NULL : Py_BuildValue("");
 }
@@ -215,7 +322,7 @@ exit:
 static PyObject *Py_MinOrMaxFilter1D(PyObject *obj, PyObject *args)
 {
     PyArrayObject *input = NULL, *output = NULL;
-    int axis, mode, minimum;
+    int axis, mode, minimum, threads;
 #if PY_VERSION_HEX < 0x02050000
     long filter_size, origin;
 #define FMT "l"
@@ -225,15 +332,16 @@ static PyObject *Py_MinOrMaxFilter1D(PyObject *obj, PyObject *args)
 #endif
     double cval;
 
-    if (!PyArg_ParseTuple(args, "O&" FMT "iO&id" FMT "i",
+    if (!PyArg_ParseTuple(args, "O&" FMT "iO&id" FMT "ii",
                           NI_ObjectToInputArray, &input,
                           &filter_size, &axis,
                           NI_ObjectToOutputArray, &output,
-                          &mode, &cval, &origin, &minimum))
+                          &mode, &cval, &origin, &minimum, &threads))
         goto exit;
 #undef FMT
     if (!NI_MinOrMaxFilter1D(input, filter_size, axis, output,
-                                                            (NI_ExtendMode)mode, cval, origin, minimum))
+                                                            (NI_ExtendMode)mode, cval, origin, minimum,
+                             threads))
         goto exit;
 exit:
     Py_XDECREF(input);
@@ -337,7 +445,7 @@ static PyObject *Py_GenericFilter1D(PyObject *obj, PyObject *args)
     PyObject *fnc = NULL, *extra_arguments = NULL, *extra_keywords = NULL;
     void *func = Py_Filter1DFunc, *data = NULL;
     NI_PythonCallbackData cbdata;
-    int axis, mode;
+    int axis, mode, threads, callback;
 #if PY_VERSION_HEX < 0x02050000
     long origin, filter_size;
 #define FMT "l"
@@ -347,12 +455,12 @@ static PyObject *Py_GenericFilter1D(PyObject *obj, PyObject *args)
 #endif
     double cval;
 
-    if (!PyArg_ParseTuple(args, "O&O" FMT "iO&id" FMT "OO",
+    if (!PyArg_ParseTuple(args, "O&O" FMT "iO&id" FMT "OOi",
                           NI_ObjectToInputArray, &input,
                           &fnc, &filter_size, &axis,
                           NI_ObjectToOutputArray, &output,
                           &mode, &cval, &origin,
-                          &extra_arguments, &extra_keywords))
+                          &extra_arguments, &extra_keywords, &threads))
         goto exit;
 #undef FMT
 
@@ -365,21 +473,26 @@ static PyObject *Py_GenericFilter1D(PyObject *obj, PyObject *args)
                                         "extra_keywords must be a dictionary");
         goto exit;
     }
-    if (NpyCapsule_Check(fnc)) {
-        func = NpyCapsule_AsVoidPtr(fnc);
-        data = NpyCapsule_GetDesc(fnc);
-    } else if (PyCallable_Check(fnc)) {
+    callback = NI_GetCallback(fnc, NI_FILTER1D_SIGNATURE, &func, &data);
+    if (callback < 0) {
+        goto exit;
+    } else if (callback == 1) {
+        /* unchecked callbacks may use the Python API: */
+        threads = 0;
+    } else if (!callback && PyCallable_Check(fnc)) {
         cbdata.function = fnc;
         cbdata.extra_arguments = extra_arguments;
         cbdata.extra_keywords = extra_keywords;
         data = (void*)&cbdata;
-    } else {
+        /* Python functions need the GIL: */
+        threads = 0;
+    } else if (!callback) {
         PyErr_SetString(PyExc_RuntimeError,
                                         "function parameter is not callable");
         goto exit;
     }
     if (!NI_GenericFilter1D(input, func, data, filter_size, axis, output,
-                            (NI_ExtendMode)mode, cval, origin))
+                            (NI_ExtendMode)mode, cval, origin, threads))
         goto exit;
 exit:
     Py_XDECREF(input);
@@ -415,25 +528,78 @@ exit:
     return PyErr_Occurred() ? 0 : 1;
 }
 
+static int Py_BlockFilterFunc(double *buffer, npy_intp block,
+                              npy_intp filter_size, double *output,
+                              void *data)
+{
+    PyArrayObject *py_buffer = NULL, *py_output = NULL;
+    PyObject *rv = NULL, *args = NULL, *tmp = NULL;
+    npy_intp shape[2], ii;
+    double *po = NULL;
+    NI_PythonCallbackData *cbdata = (NI_PythonCallbackData*)data;
+
+    shape[0] = block;
+    shape[1] = filter_size;
+    py_buffer = NA_NewArray(buffer, PyArray_DOUBLE, 2, shape);
+    if (!py_buffer)
+        goto exit;
+    tmp = Py_BuildValue("(O)", py_buffer);
+    if (!tmp)
+        goto exit;
+    args = PySequence_Concat(tmp, cbdata->extra_arguments);
+    if (!args)
+        goto exit;
+    rv = PyObject_Call(cbdata->function, args, cbdata->extra_keywords);
+    if (!rv)
+        goto exit;
+    py_output = NA_InputArray(rv, PyArray_DOUBLE, NPY_CARRAY);
+    if (!py_output)
+        goto exit;
+    if (PyArray_SIZE(py_output) != block) {
+        PyErr_SetString(PyExc_ValueError,
+                        "filter function must return one value per row");
+        goto exit;
+    }
+    po = (double*)PyArray_DATA(py_output);
+    for(ii = 0; ii < block; ii++)
+        output[ii] = po[ii];
+exit:
+    Py_XDECREF(py_buffer);
+    Py_XDECREF(py_output);
+    Py_XDECREF(rv);
+    Py_XDECREF(args);
+    Py_XDECREF(tmp);
+    return PyErr_Occurred() ? 0 : 1;
+}
+
 static PyObject *Py_GenericFilter(PyObject *obj, PyObject *args)
 {
     PyArrayObject *input = NULL, *output = NULL, *footprint = NULL;
     PyObject *fnc = NULL, *extra_arguments = NULL, *extra_keywords = NULL;
     void *func = Py_FilterFunc, *data = NULL;
     NI_PythonCallbackData cbdata;
-    int mode;
+    int mode, threads, callback;
     npy_intp *origin = NULL;
+#if PY_VERSION_HEX < 0x02050000
+    long block;
+#define FMT "l"
+#else
+    npy_intp block;
+#define FMT "n"
+#endif
     double cval;
 
-    if (!PyArg_ParseTuple(args, "O&OO&O&idO&OO",
+    if (!PyArg_ParseTuple(args, "O&OO&O&idO&OOi" FMT,
                           NI_ObjectToInputArray, &input,
                           &fnc,
                           NI_ObjectToInputArray, &footprint,
                           NI_ObjectToOutputArray, &output,
                           &mode, &cval,
                                                 NI_ObjectToLongSequence, &origin,
-                                                &extra_arguments, &extra_keywords))
+                                                &extra_arguments, &extra_keywords,
+                                                &threads, &block))
         goto exit;
+#undef FMT
     if (!PyTuple_Check(extra_arguments)) {
         PyErr_SetString(PyExc_RuntimeError, "extra_arguments must be a tuple");
         goto exit;
@@ -443,22 +609,42 @@ static PyObject *Py_GenericFilter(PyObject *obj, PyObject *args)
                                         "extra_keywords must be a dictionary");
         goto exit;
     }
-    if (NpyCapsule_Check(fnc)) {
-        func = NpyCapsule_AsVoidPtr(fnc);
-        data = NpyCapsule_GetDesc(fnc);
-    } else if (PyCallable_Check(fnc)) {
+    /* a positive block size selects the functions called per block: */
+    if (block > 0)
+        func = Py_BlockFilterFunc;
+    callback = NI_GetCallback(fnc, block > 0 ? NI_BLOCK_FILTER_SIGNATURE :
+                              NI_FILTER_SIGNATURE, &func, &data);
+    if (callback < 0) {
+        goto exit;
+    } else if (callback == 1 && block > 0) {
+        /* an unchecked function could have the per element signature: */
+        PyErr_SetString(PyExc_ValueError, "a block filter must be in a "
+                        "capsule named \"" NI_BLOCK_FILTER_SIGNATURE "\"");
+        goto exit;
+    } else if (callback == 1) {
+        /* unchecked callbacks may use the Python API: */
+        threads = 0;
+    } else if (!callback && PyCallable_Check(fnc)) {
         cbdata.function = fnc;
         cbdata.extra_arguments = extra_arguments;
         cbdata.extra_keywords = extra_keywords;
         data = (void*)&cbdata;
-    } else {
+        /* Python functions need the GIL: */
+        threads = 0;
+    } else if (!callback) {
         PyErr_SetString(PyExc_RuntimeError,
                                         "function parameter is not callable");
         goto exit;
     }
-    if (!NI_GenericFilter(input, func, data, footprint, output,
-                                                (NI_ExtendMode)mode, cval, origin))
+    if (block > 0) {
+        if (!NI_GenericBlockFilter(input, func, data, block, footprint,
+                                   output, (NI_ExtendMode)mode, cval, origin,
+                                   threads))
+            goto exit;
+    } else if (!NI_GenericFilter(input, func, data, footprint, output,
+                                 (NI_ExtendMode)mode, cval, origin, threads)) {
         goto exit;
+    }
 exit:
     Py_XDECREF(input);
     Py_XDECREF(output);
@@ -468,10 +654,42 @@ exit:
     return PyErr_Occurred() ? NULL : Py_BuildValue("");
 }
 
+static PyObject *Py_SeparableFilter(PyObject *obj, PyObject *args)
+{
+    PyArrayObject *input = NULL, *output = NULL, *weights = NULL;
+    npy_intp *kinds = NULL, *sizes = NULL, *origins = NULL;
+    int mode, threads;
+    double cval;
+
+    if (!PyArg_ParseTuple(args, "O&O&O&O&O&O&idi",
+                          NI_ObjectToInputArray, &input,
+                          NI_ObjectToLongSequence, &kinds,
+                          NI_ObjectToLongSequence, &sizes,
+                          NI_ObjectToLongSequence, &origins,
+                          NI_ObjectToInputArray, &weights,
+                          NI_ObjectToOutputArray, &output,
+                          &mode, &cval, &threads))
+        goto exit;
+    if (!NI_SeparableFilter(input, kinds, sizes, origins, weights, output,
+                            (NI_ExtendMode)mode, cval, threads))
+        goto exit;
+exit:
+    Py_XDECREF(input);
+    Py_XDECREF(weights);
+    Py_XDECREF(output);
+    if (kinds)
+        free(kinds);
+    if (sizes)
+        free(sizes);
+    if (origins)
+        free(origins);
+    return PyErr_Occurred() ? NULL : Py_BuildValue("");
+}
+
 static PyObject *Py_FourierFilter(PyObject *obj, PyObject *args)
 {
     PyArrayObject *input = NULL, *output = NULL, *parameters = NULL;
-    int axis, filter_type;
+    int axis, filter_type, nbatch;
 #if PY_VERSION_HEX < 0x02050000
     long n;
 #define FMT "l"
@@ -480,16 +698,17 @@ static PyObject *Py_FourierFilter(PyObject *obj, PyObject *args)
 #define FMT "n"
 #endif
 
-    if (!PyArg_ParseTuple(args, "O&O&" FMT "iO&i",
+    if (!PyArg_ParseTuple(args, "O&O&" FMT "iO&ii",
                           NI_ObjectToInputArray, &input,
                           NI_ObjectToInputArray, &parameters,
                           &n, &axis,
                           NI_ObjectToOutputArray, &output,
-                          &filter_type))
+                          &filter_type, &nbatch))
         goto exit;
 #undef FMT
 
-    if (!NI_FourierFilter(input, parameters, n, axis, output, filter_type))
+    if (!NI_FourierFilter(input, parameters, n, axis, output, filter_type,
+                          nbatch))
         goto exit;
 
 exit:
@@ -502,7 +721,7 @@ exit:
 static PyObject *Py_FourierShift(PyObject *obj, PyObject *args)
 {
     PyArrayObject *input = NULL, *output = NULL, *shifts = NULL;
-    int axis;
+    int axis, nbatch;
 #if PY_VERSION_HEX < 0x02050000
     long n;
 #define FMT "l"
@@ -511,15 +730,16 @@ static PyObject *Py_FourierShift(PyObject *obj, PyObject *args)
 #define FMT "n"
 #endif
 
-    if (!PyArg_ParseTuple(args, "O&O&" FMT "iO&",
+    if (!PyArg_ParseTuple(args, "O&O&" FMT "iO&i",
                           NI_ObjectToInputArray, &input,
                           NI_ObjectToInputArray, &shifts,
                           &n, &axis,
-                                        NI_ObjectToOutputArray, &output))
+                                        NI_ObjectToOutputArray, &output,
+                          &nbatch))
         goto exit;
 #undef FMT
 
-    if (!NI_FourierShift(input, shifts, n, axis, output))
+    if (!NI_FourierShift(input, shifts, n, axis, output, nbatch))
         goto exit;
 
 exit:
@@ -532,15 +752,15 @@ exit:
 static PyObject *Py_SplineFilter1D(PyObject *obj, PyObject *args)
 {
     PyArrayObject *input = NULL, *output = NULL;
-    int axis, order;
+    int axis, order, threads;
 
-    if (!PyArg_ParseTuple(args, "O&iiO&",
+    if (!PyArg_ParseTuple(args, "O&iiO&i",
                           NI_ObjectToInputArray, &input,
                           &order, &axis,
-                          NI_ObjectToOutputArray, &output))
+                          NI_ObjectToOutputArray, &output, &threads))
         goto exit;
 
-    if (!NI_SplineFilter1D(input, order, axis, output))
+    if (!NI_SplineFilter1D(input, order, axis, output, threads))
         goto exit;
 
 exit:
@@ -596,12 +816,12 @@ static PyObject *Py_GeometricTransform(PyObject *obj, PyObject *args)
     PyArrayObject *input = NULL, *output = NULL;
     PyArrayObject *coordinates = NULL, *matrix = NULL, *shift = NULL;
     PyObject *fnc = NULL, *extra_arguments = NULL, *extra_keywords = NULL;
-    int mode, order;
+    int mode, order, threads;
     double cval;
     void *func = NULL, *data = NULL;
     NI_PythonCallbackData cbdata;
 
-    if (!PyArg_ParseTuple(args, "O&OO&O&O&O&iidOO",
+    if (!PyArg_ParseTuple(args, "O&OO&O&O&O&iidOOi",
                           NI_ObjectToInputArray, &input,
                           &fnc,
                           NI_ObjectToOptionalInputArray, &coordinates,
@@ -609,10 +829,11 @@ static PyObject *Py_GeometricTransform(PyObject *obj, PyObject *args)
                           NI_ObjectToOptionalInputArray, &shift,
                           NI_ObjectToOutputArray, &output,
                           &order, &mode, &cval,
-                          &extra_arguments, &extra_keywords))
+                          &extra_arguments, &extra_keywords, &threads))
         goto exit;
 
     if (fnc != Py_None) {
+        int callback;
         if (!PyTuple_Check(extra_arguments)) {
             PyErr_SetString(PyExc_RuntimeError,
                                             "extra_arguments must be a tuple");
@@ -623,16 +844,21 @@ static PyObject *Py_GeometricTransform(PyObject *obj, PyObject *args)
                                             "extra_keywords must be a dictionary");
             goto exit;
         }
-        if (NpyCapsule_Check(fnc)) {
-            func = NpyCapsule_AsVoidPtr(fnc);
-            data = NpyCapsule_GetDesc(fnc);
-        } else if (PyCallable_Check(fnc)) {
+        callback = NI_GetCallback(fnc, NI_MAPPING_SIGNATURE, &func, &data);
+        if (callback < 0) {
+            goto exit;
+        } else if (callback == 1) {
+            /* unchecked callbacks may use the Python API: */
+            threads = 0;
+        } else if (!callback && PyCallable_Check(fnc)) {
             func = Py_Map;
             cbdata.function = fnc;
             cbdata.extra_arguments = extra_arguments;
             cbdata.extra_keywords = extra_keywords;
             data = (void*)&cbdata;
-        } else {
+            /* Python functions need the GIL: */
+            threads = 0;
+        } else if (!callback) {
             PyErr_SetString(PyExc_RuntimeError,
                                             "function parameter is not callable");
             goto exit;
@@ -640,7 +866,8 @@ static PyObject *Py_GeometricTransform(PyObject *obj, PyObject *args)
     }
 
     if (!NI_GeometricTransform(input, func, data, matrix, shift, coordinates,
-                                                    output, order, (NI_ExtendMode)mode, cval))
+                                                    output, order, (NI_ExtendMode)mode, cval,
+                                                    threads))
         goto exit;
 
 exit:
@@ -656,19 +883,19 @@ static PyObject *Py_ZoomShift(PyObject *obj, PyObject *args)
 {
     PyArrayObject *input = NULL, *output = NULL, *shift = NULL;
     PyArrayObject *zoom = NULL;
-    int mode, order;
+    int mode, order, threads;
     double cval;
 
-    if (!PyArg_ParseTuple(args, "O&O&O&O&iid",
+    if (!PyArg_ParseTuple(args, "O&O&O&O&iidi",
                           NI_ObjectToInputArray, &input,
                           NI_ObjectToOptionalInputArray, &zoom,
                           NI_ObjectToOptionalInputArray, &shift,
                           NI_ObjectToOutputArray, &output,
-                          &order, &mode, &cval))
+                          &order, &mode, &cval, &threads))
         goto exit;
 
     if (!NI_ZoomShift(input, zoom, shift, output, order, (NI_ExtendMode)mode,
-                                        cval))
+                                        cval, threads))
         goto exit;
 
 exit:
@@ -679,37 +906,122 @@ exit:
     return PyErr_Occurred() ? NULL : Py_BuildValue("");
 }
 
+/* Convert the regions found for each label to a list of tuples of
+     slices, with None for labels that were not found: */
+static PyObject *NI_RegionsToList(npy_intp *regions, npy_intp max_label,
+                                  int rank)
+{
+    PyObject *result = NULL, *tuple = NULL, *start = NULL, *end = NULL;
+    PyObject *slc = NULL;
+    npy_intp ii;
+    int jj;
+
+    result = PyList_New(max_label);
+    if (!result) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+
+    for(ii = 0; ii < max_label; ii++) {
+        npy_intp idx = rank > 0 ? 2 * rank * ii : ii;
+        if (regions[idx] >= 0) {
+            tuple = PyTuple_New(rank);
+            if (!tuple) {
+                PyErr_NoMemory();
+                goto exit;
+            }
+            for(jj = 0; jj < rank; jj++) {
+#if PY_VERSION_HEX < 0x02060000
+                start = PyLong_FromLong(regions[idx + jj]);
+                end = PyLong_FromLong(regions[idx + jj + rank]);
+#else
+                start = PyLong_FromSsize_t(regions[idx + jj]);
+                end = PyLong_FromSsize_t(regions[idx + jj + rank]);
+#endif
+                if (!start || !end) {
+                    PyErr_NoMemory();
+                    goto exit;
+                }
+                slc = PySlice_New(start, end, NULL);
+                if (!slc) {
+                    PyErr_NoMemory();
+                    goto exit;
+                }
+                Py_XDECREF(start);
+                Py_XDECREF(end);
+                start = end = NULL;
+                PyTuple_SetItem(tuple, jj, slc);
+                slc = NULL;
+            }
+            PyList_SetItem(result, ii, tuple);
+            tuple = NULL;
+        } else {
+            Py_INCREF(Py_None);
+            PyList_SetItem(result, ii, Py_None);
+        }
+    }
+
+ exit:
+    Py_XDECREF(tuple);
+    Py_XDECREF(start);
+    Py_XDECREF(end);
+    Py_XDECREF(slc);
+    if (PyErr_Occurred()) {
+        Py_XDECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
 static PyObject *Py_Label(PyObject *obj, PyObject *args)
 {
     PyArrayObject *input = NULL, *output = NULL, *strct = NULL;
-    npy_intp max_label;
+    PyObject *objects = NULL, *result = NULL;
+    npy_intp max_label, *regions = NULL;
+    int threads, find_objects;
 
-    if (!PyArg_ParseTuple(args, "O&O&O&",
+    if (!PyArg_ParseTuple(args, "O&O&O&ii",
                           NI_ObjectToInputArray, &input,
                           NI_ObjectToInputArray, &strct,
-                          NI_ObjectToOutputArray, &output))
+                          NI_ObjectToOutputArray, &output,
+                          &threads, &find_objects))
         goto exit;
 
-    if (!NI_Label(input, strct, &max_label, output))
+    if (!NI_Label(input, strct, &max_label, output, threads,
+                  find_objects ? &regions : NULL))
         goto exit;
 
+#if PY_VERSION_HEX < 0x02050000
+    result = Py_BuildValue("l", (long)max_label);
+#else
+    result = Py_BuildValue("n", (npy_intp)max_label);
+#endif
+    if (result && find_objects) {
+        /* return the regions of the objects with the number of labels: */
+        objects = NI_RegionsToList(regions, max_label, input->nd);
+        if (!objects)
+            goto exit;
+        result = Py_BuildValue("NO", result, objects);
+    }
+
 exit:
     Py_XDECREF(input);
     Py_XDECREF(strct);
     Py_XDECREF(output);
-#if PY_VERSION_HEX < 0x02050000
-    return PyErr_Occurred() ? NULL : Py_BuildValue("l", (long)max_label);
-#else
-    return PyErr_Occurred() ? NULL : Py_BuildValue("n", (npy_intp)max_label);
-#endif
+    Py_XDECREF(objects);
+    if (regions)
+        free(regions);
+    if (PyErr_Occurred()) {
+        Py_XDECREF(result);
+        return NULL;
+    }
+    return result;
 }
 
 static PyObject *Py_FindObjects(PyObject *obj, PyObject *args)
 {
     PyArrayObject *input = NULL;
-    PyObject *result = NULL, *tuple = NULL, *start = NULL, *end = NULL;
-    PyObject *slc = NULL;
-    int jj;
+    PyObject *result = NULL;
 #if PY_VERSION_HEX < 0x02050000
     long max_label;
 #define FMT "l"
@@ -717,7 +1029,7 @@ static PyObject *Py_FindObjects(PyObject *obj, PyObject *args)
     npy_intp max_label;
 #define FMT "n"
 #endif
-    npy_intp ii, *regions = NULL;
+    npy_intp *regions = NULL;
 
     if (!PyArg_ParseTuple(args, "O&" FMT,
                           NI_ObjectToInputArray, &input, &max_label))
@@ -742,60 +1054,10 @@ static PyObject *Py_FindObjects(PyObject *obj, PyObject *args)
     if (!NI_FindObjects(input, max_label, regions))
         goto exit;
 
-    result = PyList_New(max_label);
-    if (!result) {
-        PyErr_NoMemory();
-        goto exit;
-    }
-
-    for(ii = 0; ii < max_label; ii++) {
-        npy_intp idx = input->nd > 0 ? 2 * input->nd * ii : ii;
-        if (regions[idx] >= 0) {
-            PyObject *tuple = PyTuple_New(input->nd);
-            if (!tuple) {
-                PyErr_NoMemory();
-                goto exit;
-            }
-            for(jj = 0; jj < input->nd; jj++) {
-#if PY_VERSION_HEX < 0x02060000
-                start = PyLong_FromLong(regions[idx + jj]);
-                end = PyLong_FromLong(regions[idx + jj + input->nd]);
-#else
-                start = PyLong_FromSsize_t(regions[idx + jj]);
-                end = PyLong_FromSsize_t(regions[idx + jj + input->nd]);
-#endif
-                if (!start || !end) {
-                    PyErr_NoMemory();
-                    goto exit;
-                }
-                slc = PySlice_New(start, end, NULL);
-                if (!slc) {
-                    PyErr_NoMemory();
-                    goto exit;
-                }
-                Py_XDECREF(start);
-                Py_XDECREF(end);
-                start = end = NULL;
-                PyTuple_SetItem(tuple, jj, slc);
-                slc = NULL;
-            }
-            PyList_SetItem(result, ii, tuple);
-            tuple = NULL;
-        } else {
-            Py_INCREF(Py_None);
-            PyList_SetItem(result, ii, Py_None);
-        }
-    }
-
-    Py_INCREF(result);
+    result = NI_RegionsToList(regions, max_label, input->nd);
 
  exit:
     Py_XDECREF(input);
-    Py_XDECREF(result);
-    Py_XDECREF(tuple);
-    Py_XDECREF(start);
-    Py_XDECREF(end);
-    Py_XDECREF(slc);
     if (regions)
         free(regions);
     if (PyErr_Occurred()) {
@@ -806,6 +1068,84 @@ static PyObject *Py_FindObjects(PyObject *obj, PyObject *args)
     }
 }
 
+static PyObject *Py_Statistics(PyObject *obj, PyObject *args)
+{
+    PyArrayObject *input = NULL, *labels = NULL, *indices = NULL;
+    PyArrayObject *count = NULL, *sum = NULL, *m2 = NULL, *minimum = NULL;
+    PyArrayObject *maximum = NULL, *min_pos = NULL, *max_pos = NULL;
+    PyArrayObject *center = NULL, *box = NULL, *histogram = NULL;
+    PyArrayObject *edges = NULL;
+    NI_StatisticsTables tables;
+#if PY_VERSION_HEX < 0x02050000
+    long min_label, max_label;
+#define FMT "ll"
+#else
+    npy_intp min_label, max_label;
+#define FMT "nn"
+#endif
+    int threads;
+
+    if (!PyArg_ParseTuple(args, "O&O&" FMT "O&O&O&O&O&O&O&O&O&O&O&O&i",
+                          NI_ObjectToInputArray, &input,
+                          NI_ObjectToOptionalInputArray, &labels,
+                          &min_label, &max_label,
+                          NI_ObjectToOptionalInputArray, &indices,
+                          NI_ObjectToOutputArray, &count,
+                          NI_ObjectToOptionalOutputArray, &sum,
+                          NI_ObjectToOptionalOutputArray, &m2,
+                          NI_ObjectToOptionalOutputArray, &minimum,
+                          NI_ObjectToOptionalOutputArray, &maximum,
+                          NI_ObjectToOptionalOutputArray, &min_pos,
+                          NI_ObjectToOptionalOutputArray, &max_pos,
+                          NI_ObjectToOptionalOutputArray, &center,
+                          NI_ObjectToOptionalOutputArray, &box,
+                          NI_ObjectToOptionalOutputArray, &histogram,
+                          NI_ObjectToOptionalInputArray, &edges,
+                          &threads))
+        goto exit;
+#undef FMT
+
+    /* the tables are contiguous arrays of the right types: */
+    tables.count = (npy_intp*)PyArray_DATA(count);
+    tables.sum = sum ? (double*)PyArray_DATA(sum) : NULL;
+    tables.m2 = m2 ? (double*)PyArray_DATA(m2) : NULL;
+    tables.minimum = minimum ? (double*)PyArray_DATA(minimum) : NULL;
+    tables.maximum = maximum ? (double*)PyArray_DATA(maximum) : NULL;
+    tables.min_pos = min_pos ? (npy_intp*)PyArray_DATA(min_pos) : NULL;
+    tables.max_pos = max_pos ? (npy_intp*)PyArray_DATA(max_pos) : NULL;
+    tables.center = center ? (double*)PyArray_DATA(center) : NULL;
+    tables.box = box ? (npy_intp*)PyArray_DATA(box) : NULL;
+    tables.histogram = histogram ? (npy_intp*)PyArray_DATA(histogram) : NULL;
+    tables.mean = NULL;
+    if (histogram && (!edges || PyArray_SIZE(edges) < 2)) {
+        PyErr_SetString(PyExc_RuntimeError, "histogram edges not given");
+        goto exit;
+    }
+
+    NI_Statistics(input, labels, min_label, max_label,
+                  indices ? (npy_intp*)PyArray_DATA(indices) : NULL,
+                  PyArray_SIZE(count), &tables,
+                  edges ? (double*)PyArray_DATA(edges) : NULL,
+                  edges ? PyArray_SIZE(edges) - 1 : 0, threads);
+
+exit:
+    Py_XDECREF(input);
+    Py_XDECREF(labels);
+    Py_XDECREF(indices);
+    Py_XDECREF(count);
+    Py_XDECREF(sum);
+    Py_XDECREF(m2);
+    Py_XDECREF(minimum);
+    Py_XDECREF(maximum);
+    Py_XDECREF(min_pos);
+    Py_XDECREF(max_pos);
+    Py_XDECREF(center);
+    Py_XDECREF(box);
+    Py_XDECREF(histogram);
+    Py_XDECREF(edges);
+    return PyErr_Occurred() ? NULL : Py_BuildValue("");
+}
+
 static PyObject *Py_WatershedIFT(PyObject *obj, PyObject *args)
 {
     PyArrayObject *input = NULL, *output = NULL, *markers = NULL;
@@ -827,6 +1167,30 @@ exit:
     return PyErr_Occurred() ? NULL : Py_BuildValue("");
 }
 
+static PyObject *Py_Watershed(PyObject *obj, PyObject *args)
+{
+    PyArrayObject *input = NULL, *output = NULL, *markers = NULL;
+    PyArrayObject *strct = NULL, *mask = NULL;
+    double compactness;
+
+    if (!PyArg_ParseTuple(args, "O&O&O&O&dO&", NI_ObjectToInputArray, &input,
+                    NI_ObjectToInputArray, &markers, NI_ObjectToInputArray,
+                    &strct, NI_ObjectToOptionalInputArray, &mask,
+                    &compactness, NI_ObjectToOutputArray, &output))
+        goto exit;
+
+    if (!NI_Watershed(input, markers, strct, mask, compactness, output))
+        goto exit;
+
+exit:
+    Py_XDECREF(input);
+    Py_XDECREF(markers);
+    Py_XDECREF(strct);
+    Py_XDECREF(mask);
+    Py_XDECREF(output);
+    return PyErr_Occurred() ? NULL : Py_BuildValue("");
+}
+
 static PyObject *Py_DistanceTransformBruteForce(PyObject *obj,
                                                                                                 PyObject *args)
 {
@@ -889,6 +1253,26 @@ exit:
     return PyErr_Occurred() ? NULL : Py_BuildValue("");
 }
 
+static PyObject *Py_EuclideanDistanceTransform(PyObject *obj, PyObject *args)
+{
+    PyArrayObject *input = NULL, *distances = NULL, *sampling = NULL;
+    int threads;
+
+    if (!PyArg_ParseTuple(args, "O&O&O&i",
+                          NI_ObjectToInputArray, &input,
+                          NI_ObjectToOptionalInputArray, &sampling,
+                          NI_ObjectToOutputArray, &distances,
+                          &threads))
+        goto exit;
+    if (!NI_EuclideanDistanceTransform(input, sampling, distances, threads))
+        goto exit;
+exit:
+    Py_XDECREF(input);
+    Py_XDECREF(sampling);
+    Py_XDECREF(distances);
+    return PyErr_Occurred() ? NULL : Py_BuildValue("");
+}
+
 #ifdef NPY_PY3K
 static void _FreeCoordinateList(PyObject *obj)
 {
@@ -979,13 +1363,44 @@ exit:
     return PyErr_Occurred() ? NULL : Py_BuildValue("");
 }
 
+static PyObject *Py_PackedBinaryErosion(PyObject *obj, PyObject *args)
+{
+    PyArrayObject *input = NULL, *output = NULL, *strct = NULL, *mask = NULL;
+    int border_value, invert, iterations;
+    npy_intp *origins = NULL;
+
+    if (!PyArg_ParseTuple(args, "O&O&O&O&iO&ii",
+                          NI_ObjectToInputArray, &input,
+                          NI_ObjectToInputArray, &strct,
+                          NI_ObjectToOptionalInputArray, &mask,
+                          NI_ObjectToOutputArray, &output,
+                          &border_value,
+                          NI_ObjectToLongSequence, &origins,
+                          &invert, &iterations))
+        goto exit;
+    if (!NI_PackedBinaryErosion(input, strct, mask, output, border_value,
+                                origins, invert, iterations))
+        goto exit;
+exit:
+    Py_XDECREF(input);
+    Py_XDECREF(strct);
+    Py_XDECREF(mask);
+    Py_XDECREF(output);
+    if (origins) free(origins);
+    return PyErr_Occurred() ? NULL : Py_BuildValue("");
+}
+
 static PyMethodDef methods[] = {
     {"correlate1d",           (PyCFunction)Py_Correlate1D,
      METH_VARARGS, NULL},
+    {"correlate1d_pyramid",   (PyCFunction)Py_Correlate1DPyramid,
+     METH_VARARGS, NULL},
     {"correlate",             (PyCFunction)Py_Correlate,
      METH_VARARGS, NULL},
     {"uniform_filter1d",      (PyCFunction)Py_UniformFilter1D,
      METH_VARARGS, NULL},
+    {"recursive_filter1d",    (PyCFunction)Py_RecursiveFilter1D,
+     METH_VARARGS, NULL},
     {"min_or_max_filter1d",   (PyCFunction)Py_MinOrMaxFilter1D,
         METH_VARARGS, NULL},
     {"min_or_max_filter",     (PyCFunction)Py_MinOrMaxFilter,
@@ -994,6 +1409,8 @@ static PyMethodDef methods[] = {
      METH_VARARGS, NULL},
     {"generic_filter",        (PyCFunction)Py_GenericFilter,
      METH_VARARGS, NULL},
+    {"separable_filter",      (PyCFunction)Py_SeparableFilter,
+     METH_VARARGS, NULL},
     {"generic_filter1d",      (PyCFunction)Py_GenericFilter1D,
      METH_VARARGS, NULL},
     {"fourier_filter",        (PyCFunction)Py_FourierFilter,
@@ -1010,8 +1427,12 @@ static PyMethodDef methods[] = {
      METH_VARARGS, NULL},
     {"find_objects",          (PyCFunction)Py_FindObjects,
      METH_VARARGS, NULL},
+    {"statistics",            (PyCFunction)Py_Statistics,
+     METH_VARARGS, NULL},
     {"watershed_ift",         (PyCFunction)Py_WatershedIFT,
      METH_VARARGS, NULL},
+    {"watershed",             (PyCFunction)Py_Watershed,
+     METH_VARARGS, NULL},
     {"distance_transform_bf", (PyCFunction)Py_DistanceTransformBruteForce,
      METH_VARARGS, NULL},
     {"distance_transform_op", (PyCFunction)Py_DistanceTransformOnePass,
@@ -1019,10 +1440,15 @@ static PyMethodDef methods[] = {
     {"euclidean_feature_transform",
      (PyCFunction)Py_EuclideanFeatureTransform, 
      METH_VARARGS, NULL},
+    {"euclidean_distance_transform",
+     (PyCFunction)Py_EuclideanDistanceTransform,
+     METH_VARARGS, NULL},
     {"binary_erosion",        (PyCFunction)Py_BinaryErosion,
      METH_VARARGS, NULL},
     {"binary_erosion2",       (PyCFunction)Py_BinaryErosion2,
      METH_VARARGS, NULL},
+    {"packed_binary_erosion", (PyCFunction)Py_PackedBinaryErosion,
+     METH_VARARGS, NULL},
     {NULL, NULL, 0, NULL}
 };
 
@@ -34,23 +34,144 @@
 #include <stdlib.h>
 #include <math.h>
 
-#define BUFFER_SIZE 256000
 
-int NI_Correlate1D(PyArrayObject *input, PyArrayObject *weights,
-                                     int axis, PyArrayObject *output, NI_ExtendMode mode,
-                   double cval, npy_intp origin)
+typedef struct {
+    Float64 *weights;
+    npy_intp size1, size2;
+    int symmetric;
+} NI_Correlate1DData;
+
+static int NI_Correlate1DLine(double *iline, npy_intp ilength,
+                              double *oline, npy_intp length, void *data,
+                              double *work)
 {
-    int symmetric = 0, more;
-    npy_intp ii, jj, ll, lines, length, size1, size2, filter_size;
-    double *ibuffer = NULL, *obuffer = NULL;
-    Float64 *fw;
-    NI_LineBuffer iline_buffer, oline_buffer;
+    NI_Correlate1DData *cd = (NI_Correlate1DData*)data;
+    Float64 *fw = cd->weights;
+    npy_intp ll, jj, size1 = cd->size1, size2 = cd->size2;
+
+    iline += size1;
+    /* the correlation calculation: */
+    if (cd->symmetric > 0) {
+        for(ll = 0; ll < length; ll++) {
+            oline[ll] = iline[0] * fw[0];
+            for(jj = -size1 ; jj < 0; jj++)
+                oline[ll] += (iline[jj] + iline[-jj]) * fw[jj];
+            ++iline;
+        }
+    } else if (cd->symmetric < 0) {
+        for(ll = 0; ll < length; ll++) {
+            oline[ll] = iline[0] * fw[0];
+            for(jj = -size1 ; jj < 0; jj++)
+                oline[ll] += (iline[jj] - iline[-jj]) * fw[jj];
+            ++iline;
+        }
+    } else {
+        for(ll = 0; ll < length; ll++) {
+            oline[ll] = iline[size2] * fw[size2];
+            for(jj = -size1; jj < size2; jj++)
+                oline[ll] += iline[jj] * fw[jj];
+            ++iline;
+        }
+    }
+    return 1;
+}
+
+#define NI_INTEGER_WEIGHTS 32
+
+typedef struct {
+    Int32 weights[NI_INTEGER_WEIGHTS];
+    npy_intp filter_size;
+    int shift;
+} NI_IntegerCorrelateData;
+
+/* Test if the values of the input fit in 32-bit integers, with the
+     constant of the constant mode, and return the largest magnitude: */
+static npy_int64 NI_IntegerInputMaximum(PyArrayObject *input,
+                                        PyArrayObject *output,
+                                        NI_ExtendMode mode, double cval)
+{
+    npy_int64 maximum = NI_IntegerLineMaximum(input, output);
+
+    if (maximum && mode == NI_EXTEND_CONSTANT) {
+        if (cval != floor(cval) || fabs(cval) > 65536.0)
+            return 0;
+        if (fabs(cval) > maximum)
+            maximum = (npy_int64)fabs(cval);
+    }
+    return maximum;
+}
+
+/* Test if a correlation can be done exactly in 32-bit integers: the
+     weights must be integers divided by a power of two, and the sums
+     can not overflow: */
+static int NI_IntegerCorrelateWeights(PyArrayObject *input,
+                                      PyArrayObject *output, Float64 *fw,
+                                      npy_intp filter_size,
+                                      NI_ExtendMode mode, double cval,
+                                      NI_IntegerCorrelateData *ic)
+{
+    npy_int64 maximum, total;
+    npy_intp ii;
+    int shift;
+
+    if (filter_size > NI_INTEGER_WEIGHTS)
+        return 0;
+    maximum = NI_IntegerInputMaximum(input, output, mode, cval);
+    if (!maximum)
+        return 0;
+    for(shift = 0; shift <= 16; shift++) {
+        double scale = (double)(1 << shift);
+        total = 0;
+        for(ii = 0; ii < filter_size; ii++) {
+            double weight = fw[ii] * scale;
+            if (weight != floor(weight) || fabs(weight) > 65536.0)
+                break;
+            ic->weights[ii] = (Int32)weight;
+            total += (npy_int64)fabs(weight);
+        }
+        if (ii == filter_size)
+            break;
+    }
+    if (shift > 16 || total * maximum > 2147483647)
+        return 0;
+    ic->filter_size = filter_size;
+    ic->shift = shift;
+    return 1;
+}
+
+static void NI_IntegerCorrelate1DLine(Int32 *iline, Int32 *oline,
+                                      npy_intp length, npy_intp nlines,
+                                      void *data)
+{
+    NI_IntegerCorrelateData *ic = (NI_IntegerCorrelateData*)data;
+    npy_intp ll, jj, size = length * nlines;
+    int shift = ic->shift;
+
+    for(ll = 0; ll < size; ll++)
+        oline[ll] = 0;
+    /* the lines are interleaved, so each weight is accumulated over all
+         of them in one loop, which the compiler can vectorize: */
+    for(jj = 0; jj < ic->filter_size; jj++) {
+        Int32 weight = ic->weights[jj], *pi = iline + jj * nlines;
+        if (weight == 0)
+            continue;
+        for(ll = 0; ll < size; ll++)
+            oline[ll] += weight * pi[ll];
+    }
+    /* divide by the power of two, rounding towards zero like the
+         conversion of a double: */
+    if (shift > 0)
+        for(ll = 0; ll < size; ll++)
+            oline[ll] = oline[ll] < 0 ? -((-oline[ll]) >> shift) :
+                                        oline[ll] >> shift;
+}
+
+/* Test a filter of odd size for symmetry (1) or anti-symmetry (-1): */
+static int NI_Correlate1DSymmetry(Float64 *fw, npy_intp filter_size)
+{
+    int symmetric = 0;
+    npy_intp ii, size1 = filter_size / 2;
 
-    /* test for symmetry or anti-symmetry: */
-    filter_size = weights->dimensions[0];
-    size1 = filter_size / 2;
-    size2 = filter_size - size1 - 1;
-    fw = (void *)PyArray_DATA(weights);
     if (filter_size & 0x1) {
         symmetric = 1;
         for(ii = 1; ii <= filter_size / 2; ii++) {
@@ -69,63 +190,150 @@ int NI_Correlate1D(PyArrayObject *input, PyArrayObject *weights,
             }
         }
     }
-    /* allocate and initialize the line buffers: */
-    lines = -1;
-    if (!NI_AllocateLineBuffer(input, axis, size1 + origin, size2 - origin,
-                                                         &lines, BUFFER_SIZE, &ibuffer))
-        goto exit;
-    if (!NI_AllocateLineBuffer(output, axis, 0, 0, &lines, BUFFER_SIZE,
-                                                         &obuffer))
-        goto exit;
-    if (!NI_InitLineBuffer(input, axis, size1 + origin, size2 - origin,
-                                                            lines, ibuffer, mode, cval, &iline_buffer))
-        goto exit;
-    if (!NI_InitLineBuffer(output, axis, 0, 0, lines, obuffer, mode, 0.0,
-                                                 &oline_buffer))
-        goto exit;
-    length = input->nd > 0 ? input->dimensions[axis] : 1;
-    fw += size1;
+    return symmetric;
+}
+
+static int NI_Correlate1DWeights(PyArrayObject *input, Float64 *fw,
+                                 npy_intp filter_size, int axis,
+                                 PyArrayObject *output, NI_ExtendMode mode,
+                                 double cval, npy_intp origin, int threads)
+{
+    npy_intp size1, size2;
+    NI_Correlate1DData cd;
+    NI_IntegerCorrelateData ic;
+
+    size1 = filter_size / 2;
+    size2 = filter_size - size1 - 1;
+    /* small integer types with weights that are integers divided by a
+         power of two are filtered exactly in integers: */
+    if (NI_IntegerCorrelateWeights(input, output, fw, filter_size, mode,
+                                   cval, &ic)) {
+        NI_IntegerFilterLines(input, output, axis, size1 + origin,
+                              size2 - origin, mode, (Int32)cval,
+                              NI_IntegerCorrelate1DLine, &ic, threads);
+        return PyErr_Occurred() ? 0 : 1;
+    }
+    cd.weights = fw + size1;
+    cd.size1 = size1;
+    cd.size2 = size2;
+    cd.symmetric = NI_Correlate1DSymmetry(fw, filter_size);
     /* iterate over all the array lines: */
-    do {
-        /* copy lines from array to buffer: */
-        if (!NI_ArrayToLineBuffer(&iline_buffer, &lines, &more))
-            goto exit;
-        /* iterate over the lines in the buffers: */
-        for(ii = 0; ii < lines; ii++) {
-            /* get lines: */
-            double *iline = NI_GET_LINE(iline_buffer, ii) + size1;
-            double *oline = NI_GET_LINE(oline_buffer, ii);
-            /* the correlation calculation: */
-            if (symmetric > 0) {
-                for(ll = 0; ll < length; ll++) {
-                    oline[ll] = iline[0] * fw[0];
-                    for(jj = -size1 ; jj < 0; jj++)
-                        oline[ll] += (iline[jj] + iline[-jj]) * fw[jj];
-                    ++iline;
-                }
-            } else if (symmetric < 0) {
-                for(ll = 0; ll < length; ll++) {
-                    oline[ll] = iline[0] * fw[0];
-                    for(jj = -size1 ; jj < 0; jj++)
-                        oline[ll] += (iline[jj] - iline[-jj]) * fw[jj];
-                    ++iline;
-                }
-            } else {
-                for(ll = 0; ll < length; ll++) {
-                    oline[ll] = iline[size2] * fw[size2];
-                    for(jj = -size1; jj < size2; jj++)
-                        oline[ll] += iline[jj] * fw[jj];
-                    ++iline;
+    NI_FilterLines(input, output, axis, size1 + origin, size2 - origin,
+                   mode, cval, NI_Correlate1DLine, &cd, 0, threads);
+    return PyErr_Occurred() ? 0 : 1;
+}
+
+int NI_Correlate1D(PyArrayObject *input, PyArrayObject *weights,
+                                     int axis, PyArrayObject *output, NI_ExtendMode mode,
+                   double cval, npy_intp origin, int threads)
+{
+    return NI_Correlate1DWeights(input, (void *)PyArray_DATA(weights),
+                                 weights->dimensions[0], axis, output, mode,
+                                 cval, origin, threads);
+}
+
+/* Correlate and keep every second point, the reduction of a pyramid: */
+static int NI_Correlate1DReduceLine(double *iline, npy_intp ilength,
+                                    double *oline, npy_intp length,
+                                    void *data, double *work)
+{
+    NI_Correlate1DData *cd = (NI_Correlate1DData*)data;
+    Float64 *fw = cd->weights;
+    npy_intp ll, jj, size1 = cd->size1, size2 = cd->size2;
+
+    iline += size1;
+    if (cd->symmetric > 0) {
+        for(ll = 0; ll < length; ll++) {
+            oline[ll] = iline[0] * fw[0];
+            for(jj = -size1 ; jj < 0; jj++)
+                oline[ll] += (iline[jj] + iline[-jj]) * fw[jj];
+            iline += 2;
+        }
+    } else {
+        for(ll = 0; ll < length; ll++) {
+            oline[ll] = iline[size2] * fw[size2];
+            for(jj = -size1; jj < size2; jj++)
+                oline[ll] += iline[jj] * fw[jj];
+            iline += 2;
+        }
+    }
+    return 1;
+}
+
+/* Correlate the line with zeros inserted between its points, the
+     expansion of a pyramid. Only the weights that meet the points of the
+     line are used, and the result is doubled to make up for the zeros: */
+static int NI_Correlate1DExpandLine(double *iline, npy_intp ilength,
+                                    double *oline, npy_intp length,
+                                    void *data, double *work)
+{
+    NI_Correlate1DData *cd = (NI_Correlate1DData*)data;
+    Float64 *fw = cd->weights;
+    npy_intp ll, jj, size1 = cd->size1, size2 = cd->size2;
+
+    iline += size1 / 2;
+    for(ll = 0; ll < length; ll++) {
+        double tmp = 0.0;
+        for(jj = -size1 + ((ll + size1) & 1); jj <= size2; jj += 2)
+            tmp += iline[(ll + jj) / 2] * fw[jj];
+        oline[ll] = 2.0 * tmp;
+    }
+    return 1;
+}
+
+int NI_Correlate1DPyramid(PyArrayObject *input, PyArrayObject *weights,
+                          int axis, PyArrayObject *output,
+                          NI_ExtendMode mode, double cval, int expand,
+                          int threads)
+{
+    npy_intp ii, size1, size2, filter_size, ilength, olength;
+    Float64 *fw;
+    NI_Correlate1DData cd;
+
+    if (input->nd != output->nd || axis < 0 || axis >= input->nd) {
+        PyErr_SetString(PyExc_RuntimeError, "output shape not correct");
+        return 0;
+    }
+    ilength = input->dimensions[axis];
+    olength = output->dimensions[axis];
+    for(ii = 0; ii < input->nd; ii++) {
+        if (ii != axis && input->dimensions[ii] != output->dimensions[ii]) {
+            PyErr_SetString(PyExc_RuntimeError, "output shape not correct");
+            return 0;
+        }
+    }
+    if (expand ? (olength + 1) / 2 != ilength :
+                 (ilength + 1) / 2 != olength) {
+        PyErr_SetString(PyExc_RuntimeError, "output shape not correct");
+        return 0;
+    }
+    filter_size = weights->dimensions[0];
+    size1 = filter_size / 2;
+    size2 = filter_size - size1 - 1;
+    fw = (void *)PyArray_DATA(weights);
+    cd.weights = fw + size1;
+    cd.size1 = size1;
+    cd.size2 = size2;
+    cd.symmetric = 0;
+    if (expand) {
+        /* the points of the line that the weights meet: */
+        npy_intp extend = (olength - 1 + size2) / 2 - (ilength - 1);
+        NI_FilterLines(input, output, axis, size1 / 2,
+                       extend > 0 ? extend : 0, mode, cval,
+                       NI_Correlate1DExpandLine, &cd, 0, threads);
+    } else {
+        if (filter_size & 0x1) {
+            cd.symmetric = 1;
+            for(ii = 1; ii <= size1; ii++) {
+                if (fabs(fw[ii + size1] - fw[size1 - ii]) > DBL_EPSILON) {
+                    cd.symmetric = 0;
+                    break;
                 }
             }
         }
-        /* copy lines from buffer to array: */
-        if (!NI_LineBufferToArray(&oline_buffer))
-            goto exit;
-    } while(more);
-exit:
-    if (ibuffer) free(ibuffer);
-    if (obuffer) free(obuffer);
+        NI_FilterLines(input, output, axis, size1, size2, mode, cval,
+                       NI_Correlate1DReduceLine, &cd, 0, threads);
+    }
     return PyErr_Occurred() ? 0 : 1;
 }
 
@@ -149,19 +357,81 @@ case t ## _type:                          \
     *(_type*)_po = (_type)_tmp;             \
     break
 
+/* Correlate a run of points that share the same filter offsets, one
+     filter tap at a time, so that the inner loop has no type dispatch
+     and runs over contiguous memory when the input is contiguous: */
+#define CASE_CORRELATE_RUN(_pi, _stride, _weights, _offsets, _filter_size, \
+                           _cvalue, _type, _res, _run, _mv)               \
+case t ## _type:                                                          \
+{                                                                         \
+    npy_intp _ii, _jj;                                                    \
+    for(_ii = 0; _ii < _filter_size; _ii++) {                             \
+        npy_intp _oo = _offsets[_ii];                                     \
+        double _ww = _weights[_ii];                                       \
+        if (_oo == _mv) {                                                 \
+            double _cc = _ww * _cvalue;                                   \
+            for(_jj = 0; _jj < _run; _jj++)                               \
+                _res[_jj] += _cc;                                         \
+        } else if (_stride == sizeof(_type)) {                            \
+            _type *_pp = (_type*)(_pi + _oo);                             \
+            for(_jj = 0; _jj < _run; _jj++)                               \
+                _res[_jj] += _ww * (double)_pp[_jj];                      \
+        } else {                                                          \
+            char *_pp = _pi + _oo;                                        \
+            for(_jj = 0; _jj < _run; _jj++)                               \
+                _res[_jj] += _ww * (double)*(_type*)(_pp + _jj * _stride); \
+        }                                                                 \
+    }                                                                     \
+}                                                                         \
+break
+
+#define CASE_FILTER_OUT_RUN(_po, _stride, _res, _run, _type) \
+case t ## _type:                                             \
+{                                                            \
+    npy_intp _jj;                                            \
+    for(_jj = 0; _jj < _run; _jj++)                          \
+        *(_type*)(_po + _jj * _stride) = (_type)_res[_jj];   \
+}                                                            \
+break
+
+/* Check that the type of an array is one of the types filtered: */
+static int NI_CheckFilterType(PyArrayObject *array)
+{
+    switch (NI_CanonicalType(array->descr->type_num)) {
+    case tBool:
+    case tUInt8:
+    case tUInt16:
+    case tUInt32:
+#if HAS_UINT64
+    case tUInt64:
+#endif
+    case tInt8:
+    case tInt16:
+    case tInt32:
+    case tInt64:
+    case tFloat32:
+    case tFloat64:
+        return 1;
+    default:
+        PyErr_SetString(PyExc_RuntimeError, "array type not supported");
+        return 0;
+    }
+}
+
 int NI_Correlate(PyArrayObject* input, PyArrayObject* weights,
                                                 PyArrayObject* output, NI_ExtendMode mode,
                  double cvalue, npy_intp *origins)
 {
     Bool *pf = NULL;
     npy_intp fsize, jj, kk, filter_size = 0, border_flag_value;
-    npy_intp *offsets = NULL, *oo, size;
+    npy_intp *offsets = NULL, *oo, size, run;
     NI_FilterIterator fi;
     NI_Iterator ii, io;
     char *pi, *po;
     Float64 *pw;
     Float64 *ww = NULL;
-    int ll;
+    double *buffer = NULL;
+    int ll, itype, otype, last = input->nd - 1;
 
     /* get the the footprint: */
     fsize = 1;
@@ -213,11 +483,85 @@ int NI_Correlate(PyArrayObject* input, PyArrayObject* weights,
     size = 1;
     for(ll = 0; ll < input->nd; ll++)
         size *= input->dimensions[ll];
+    /* the points of a line along the last axis that are in the interior
+         share the same offsets, and are filtered together: */
+    run = 0;
+    if (last >= 0 && fi.bound2[last] > fi.bound1[last]) {
+        run = fi.bound2[last] - fi.bound1[last] + 1;
+        buffer = (double*)malloc(run * sizeof(double));
+        if (!buffer) {
+            PyErr_NoMemory();
+            goto exit;
+        }
+    }
+    /* the types are checked before the GIL is released: */
+    if (!NI_CheckFilterType(input) || !NI_CheckFilterType(output))
+        goto exit;
+    itype = NI_CanonicalType(input->descr->type_num);
+    otype = NI_CanonicalType(output->descr->type_num);
+    Py_BEGIN_ALLOW_THREADS
     /* iterator over the elements: */
     oo = offsets;
     for(jj = 0; jj < size; jj++) {
         double tmp = 0.0;
-        switch (input->descr->type_num) {
+        if (run > 0 && ii.coordinates[last] == fi.bound1[last]) {
+            npy_intp istride = ii.strides[last], ostride = io.strides[last];
+            for(kk = 0; kk < run; kk++)
+                buffer[kk] = 0.0;
+            switch (itype) {
+                CASE_CORRELATE_RUN(pi, istride, ww, oo, filter_size, cvalue, Bool,
+                               buffer, run, border_flag_value);
+                CASE_CORRELATE_RUN(pi, istride, ww, oo, filter_size, cvalue, UInt8,
+                               buffer, run, border_flag_value);
+                CASE_CORRELATE_RUN(pi, istride, ww, oo, filter_size, cvalue, UInt16,
+                               buffer, run, border_flag_value);
+                CASE_CORRELATE_RUN(pi, istride, ww, oo, filter_size, cvalue, UInt32,
+                               buffer, run, border_flag_value);
+#if HAS_UINT64
+                CASE_CORRELATE_RUN(pi, istride, ww, oo, filter_size, cvalue, UInt64,
+                               buffer, run, border_flag_value);
+#endif
+                CASE_CORRELATE_RUN(pi, istride, ww, oo, filter_size, cvalue, Int8,
+                               buffer, run, border_flag_value);
+                CASE_CORRELATE_RUN(pi, istride, ww, oo, filter_size, cvalue, Int16,
+                               buffer, run, border_flag_value);
+                CASE_CORRELATE_RUN(pi, istride, ww, oo, filter_size, cvalue, Int32,
+                               buffer, run, border_flag_value);
+                CASE_CORRELATE_RUN(pi, istride, ww, oo, filter_size, cvalue, Int64,
+                               buffer, run, border_flag_value);
+                CASE_CORRELATE_RUN(pi, istride, ww, oo, filter_size, cvalue, Float32,
+                               buffer, run, border_flag_value);
+                CASE_CORRELATE_RUN(pi, istride, ww, oo, filter_size, cvalue, Float64,
+                               buffer, run, border_flag_value);
+            default:
+                break;
+            }
+            switch (otype) {
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Bool);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, UInt8);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, UInt16);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, UInt32);
+#if HAS_UINT64
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, UInt64);
+#endif
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Int8);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Int16);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Int32);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Int64);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Float32);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Float64);
+            default:
+                break;
+            }
+            /* move to the last point of the run: */
+            ii.coordinates[last] += run - 1;
+            pi += (run - 1) * istride;
+            po += (run - 1) * ostride;
+            jj += run - 1;
+            NI_FILTER_NEXT2(fi, ii, io, oo, pi, po);
+            continue;
+        }
+        switch (itype) {
             CASE_CORRELATE_POINT(pi, ww, oo, filter_size, cvalue, Bool,
                                                      tmp, border_flag_value);
             CASE_CORRELATE_POINT(pi, ww, oo, filter_size, cvalue, UInt8,
@@ -243,10 +587,9 @@ int NI_Correlate(PyArrayObject* input, PyArrayObject* weights,
             CASE_CORRELATE_POINT(pi, ww, oo, filter_size, cvalue, Float64,
                                                      tmp, border_flag_value);
         default:
-            PyErr_SetString(PyExc_RuntimeError, "array type not supported");
-            goto exit;
+            break;
         }
-        switch (output->descr->type_num) {
+        switch (otype) {
             CASE_FILTER_OUT(po, tmp, Bool);
             CASE_FILTER_OUT(po, tmp, UInt8);
             CASE_FILTER_OUT(po, tmp, UInt16);
@@ -261,142 +604,301 @@ int NI_Correlate(PyArrayObject* input, PyArrayObject* weights,
             CASE_FILTER_OUT(po, tmp, Float32);
             CASE_FILTER_OUT(po, tmp, Float64);
         default:
-            PyErr_SetString(PyExc_RuntimeError, "array type not supported");
-            goto exit;
+            break;
         }
         NI_FILTER_NEXT2(fi, ii, io, oo, pi, po);
     }
+    Py_END_ALLOW_THREADS
 exit:
     if (offsets) free(offsets);
     if (ww) free(ww);
     if (pf) free(pf);
+    if (buffer) free(buffer);
     return PyErr_Occurred() ? 0 : 1;
 }
 
+static int NI_UniformFilter1DLine(double *iline, npy_intp ilength,
+                                  double *oline, npy_intp length,
+                                  void *data, double *work)
+{
+    npy_intp ll, filter_size = *(npy_intp*)data;
+    double tmp = 0.0;
+    double *l1 = iline;
+    double *l2 = iline + filter_size;
+
+    /* do the uniform filter: */
+    for(ll = 0; ll < filter_size; ll++)
+        tmp += iline[ll];
+    tmp /= (double)filter_size;
+    oline[0] = tmp;
+    for(ll = 1; ll < length; ll++) {
+        tmp += (*l2++ - *l1++) / (double)filter_size;
+        oline[ll] = tmp;
+    }
+    return 1;
+}
+
+static void NI_IntegerUniformFilter1DLine(Int32 *iline, Int32 *oline,
+                                          npy_intp length, npy_intp nlines,
+                                          void *data)
+{
+    npy_intp ll, kk, filter_size = *(npy_intp*)data;
+    npy_intp size = length * nlines;
+    double fsize = (double)filter_size;
+
+    /* running sums of the interleaved lines: */
+    for(kk = 0; kk < nlines; kk++)
+        oline[kk] = 0;
+    for(ll = 0; ll < filter_size; ll++)
+        for(kk = 0; kk < nlines; kk++)
+            oline[kk] += iline[ll * nlines + kk];
+    if (nlines == 1) {
+        Int32 tmp = oline[0];
+        for(ll = 1; ll < size; ll++) {
+            tmp += iline[ll + filter_size - 1] - iline[ll - 1];
+            oline[ll] = tmp;
+        }
+    } else {
+        for(ll = nlines; ll < size; ll++)
+            oline[ll] = oline[ll - nlines] + iline[ll + (filter_size - 1) *
+                                                nlines] - iline[ll - nlines];
+    }
+    /* the quotient of the double division is exact enough to round
+         towards zero exactly, since the sums and the filter size are
+         small: */
+    for(ll = 0; ll < size; ll++)
+        oline[ll] = (Int32)(oline[ll] / fsize);
+}
+
 int
 NI_UniformFilter1D(PyArrayObject *input, npy_intp filter_size,
                                      int axis, PyArrayObject *output, NI_ExtendMode mode,
-                   double cval, npy_intp origin)
+                   double cval, npy_intp origin, int threads)
 {
-    npy_intp lines, kk, ll, length, size1, size2;
-    int more;
-    double *ibuffer = NULL, *obuffer = NULL;
-    NI_LineBuffer iline_buffer, oline_buffer;
+    npy_intp size1, size2;
+    npy_int64 maximum;
 
     size1 = filter_size / 2;
     size2 = filter_size - size1 - 1;
-    /* allocate and initialize the line buffers: */
-    lines = -1;
-    if (!NI_AllocateLineBuffer(input, axis, size1 + origin, size2 - origin,
-                                                         &lines, BUFFER_SIZE, &ibuffer))
-        goto exit;
-    if (!NI_AllocateLineBuffer(output, axis, 0, 0, &lines, BUFFER_SIZE,
-                                                         &obuffer))
-        goto exit;
-    if (!NI_InitLineBuffer(input, axis, size1 + origin, size2 - origin,
-                                                            lines, ibuffer, mode, cval, &iline_buffer))
-        goto exit;
-    if (!NI_InitLineBuffer(output, axis, 0, 0, lines, obuffer, mode, 0.0,
-                                                 &oline_buffer))
-        goto exit;
+    /* small integer types are filtered exactly with integer sums: */
+    maximum = NI_IntegerInputMaximum(input, output, mode, cval);
+    if (maximum && filter_size * maximum <= 2147483647 &&
+        filter_size < 4194304) {
+        NI_IntegerFilterLines(input, output, axis, size1 + origin,
+                              size2 - origin, mode, (Int32)cval,
+                              NI_IntegerUniformFilter1DLine, &filter_size,
+                              threads);
+        return PyErr_Occurred() ? 0 : 1;
+    }
+    /* iterate over all the array lines: */
+    NI_FilterLines(input, output, axis, size1 + origin, size2 - origin,
+                   mode, cval, NI_UniformFilter1DLine, &filter_size, 0,
+                   threads);
+    return PyErr_Occurred() ? 0 : 1;
+}
+
+/* Causal or anti-causal pass of a recursive filter over a line of
+     length n. The recursion is started from its steady state for a
+     constant line equal to the first (or last) element: */
+static void NI_RecursiveLine(double *x, double *y, npy_intp n, double *num,
+                             npy_intp nnum, double *den, npy_intp nden,
+                             npy_intp first, npy_intp step)
+{
+    npy_intp kk, ii, start = nnum - 1 + first > nden ? nnum - 1 + first
+                                                       : nden;
+    double x0, y0, sum = 0.0, tmp;
+
+    if (n <= 0)
+        return;
+    /* steady state response to the end value: */
+    x0 = step > 0 ? x[0] : x[n - 1];
+    tmp = 1.0;
+    for(ii = 0; ii < nnum; ii++)
+        sum += num[ii];
+    for(ii = 0; ii < nden; ii++)
+        tmp += den[ii];
+    y0 = x0 * sum / tmp;
+    if (step < 0) {
+        x += n - 1;
+        y += n - 1;
+    }
+    /* the first elements, which use the steady state as history: */
+    if (start > n)
+        start = n;
+    for(kk = 0; kk < start; kk++) {
+        tmp = 0.0;
+        for(ii = 0; ii < nnum; ii++)
+            tmp += num[ii] * (kk >= ii + first ? x[-(ii + first) * step]
+                                               : x0);
+        for(ii = 0; ii < nden; ii++)
+            tmp -= den[ii] * (kk > ii ? y[-(ii + 1) * step] : y0);
+        *y = tmp;
+        x += step;
+        y += step;
+    }
+    for(kk = start; kk < n; kk++) {
+        tmp = 0.0;
+        for(ii = 0; ii < nnum; ii++)
+            tmp += num[ii] * x[-(ii + first) * step];
+        for(ii = 0; ii < nden; ii++)
+            tmp -= den[ii] * y[-(ii + 1) * step];
+        *y = tmp;
+        x += step;
+        y += step;
+    }
+}
+
+typedef struct {
+    double *causal, *anticausal, *denominator;
+    npy_intp ncausal, nanticausal, ndenominator, extension;
+} NI_RecursiveFilter1DData;
+
+static int NI_RecursiveFilter1DLine(double *iline, npy_intp ilength,
+                                    double *oline, npy_intp length,
+                                    void *data, double *work)
+{
+    NI_RecursiveFilter1DData *rd = (NI_RecursiveFilter1DData*)data;
+    double *yc = work, *ya = work + ilength;
+    npy_intp ll;
+
+    NI_RecursiveLine(iline, yc, ilength, rd->causal, rd->ncausal,
+                     rd->denominator, rd->ndenominator, 0, 1);
+    NI_RecursiveLine(iline, ya, ilength, rd->anticausal, rd->nanticausal,
+                     rd->denominator, rd->ndenominator, 1, -1);
+    for(ll = 0; ll < length; ll++)
+        oline[ll] = yc[ll + rd->extension] + ya[ll + rd->extension];
+    return 1;
+}
+
+/* A recursive filter, the sum of a causal and an anti-causal part,
+     which share their denominator: the causal part uses the current and
+     previous input elements, the anti-causal part the following ones.
+     The lines are extended by the given number of elements according to
+     the mode, and the recursions are started from a steady state at the
+     ends of the extended lines: */
+int NI_RecursiveFilter1D(PyArrayObject *input, PyArrayObject *causal,
+                         PyArrayObject *anticausal,
+                         PyArrayObject *denominator, npy_intp extension,
+                         int axis, PyArrayObject *output,
+                         NI_ExtendMode mode, double cval, int threads)
+{
+    NI_RecursiveFilter1DData rd;
+    npy_intp length;
+
+    rd.ncausal = causal->dimensions[0];
+    rd.nanticausal = anticausal->dimensions[0];
+    rd.ndenominator = denominator->dimensions[0];
+    rd.causal = (void *)PyArray_DATA(causal);
+    rd.anticausal = (void *)PyArray_DATA(anticausal);
+    rd.denominator = (void *)PyArray_DATA(denominator);
+    rd.extension = extension;
     length = input->nd > 0 ? input->dimensions[axis] : 1;
+    /* iterate over all the array lines, with work space for the causal
+         and anti-causal parts: */
+    NI_FilterLines(input, output, axis, extension, extension, mode, cval,
+                   NI_RecursiveFilter1DLine, &rd,
+                   2 * (length + 2 * extension), threads);
+    return PyErr_Occurred() ? 0 : 1;
+}
 
-    /* iterate over all the array lines: */
-    do {
-        /* copy lines from array to buffer: */
-        if (!NI_ArrayToLineBuffer(&iline_buffer, &lines, &more))
-            goto exit;
-        /* iterate over the lines in the buffers: */
-        for(kk = 0; kk < lines; kk++) {
-            /* get lines: */
-            double *iline = NI_GET_LINE(iline_buffer, kk);
-            double *oline = NI_GET_LINE(oline_buffer, kk);
-            /* do the uniform filter: */
-            double tmp = 0.0;
-            double *l1 = iline;
-            double *l2 = iline + filter_size;
-            for(ll = 0; ll < filter_size; ll++)
-                tmp += iline[ll];
-            tmp /= (double)filter_size;
-            oline[0] = tmp;
-            for(ll = 1; ll < length; ll++) {
-                tmp += (*l2++ - *l1++) / (double)filter_size;
-                oline[ll] = tmp;
-            }
+/* Running minimum or maximum of a line by the van Herk/Gil-Werman
+     algorithm. The extended input line is divided into blocks of
+     filter_size elements, and the cumulative minimum (or maximum) is
+     computed within each block from the left (g) and from the right (h).
+     A window starting at ll covers the tail of one block and the head of
+     the next, so its minimum is the smaller of h[ll] and
+     g[ll + filter_size - 1]. This costs three comparisons per element,
+     independent of the filter size: */
+static void NI_MinOrMaxLine(double *iline, npy_intp length,
+                            npy_intp filter_size, double *oline, double *g,
+                            double *h, int minimum)
+{
+    npy_intp ll, kk, end, nn = length + filter_size - 1;
+
+    for(ll = 0; ll < nn; ll += filter_size) {
+        end = ll + filter_size < nn ? ll + filter_size : nn;
+        g[ll] = iline[ll];
+        h[end - 1] = iline[end - 1];
+        if (minimum) {
+            for(kk = ll + 1; kk < end; kk++)
+                g[kk] = iline[kk] < g[kk - 1] ? iline[kk] : g[kk - 1];
+            for(kk = end - 2; kk >= ll; kk--)
+                h[kk] = iline[kk] < h[kk + 1] ? iline[kk] : h[kk + 1];
+        } else {
+            for(kk = ll + 1; kk < end; kk++)
+                g[kk] = iline[kk] > g[kk - 1] ? iline[kk] : g[kk - 1];
+            for(kk = end - 2; kk >= ll; kk--)
+                h[kk] = iline[kk] > h[kk + 1] ? iline[kk] : h[kk + 1];
         }
-        /* copy lines from buffer to array: */
-        if (!NI_LineBufferToArray(&oline_buffer))
-            goto exit;
-    } while(more);
+    }
+    g += filter_size - 1;
+    if (minimum) {
+        for(ll = 0; ll < length; ll++)
+            oline[ll] = g[ll] < h[ll] ? g[ll] : h[ll];
+    } else {
+        for(ll = 0; ll < length; ll++)
+            oline[ll] = g[ll] > h[ll] ? g[ll] : h[ll];
+    }
+}
 
- exit:
-    if (ibuffer) free(ibuffer);
-    if (obuffer) free(obuffer);
-    return PyErr_Occurred() ? 0 : 1;
+typedef struct {
+    npy_intp filter_size, size1, size2;
+    int minimum;
+} NI_MinOrMaxFilter1DData;
+
+static int NI_MinOrMaxFilter1DLine(double *iline, npy_intp ilength,
+                                   double *oline, npy_intp length,
+                                   void *data, double *work)
+{
+    NI_MinOrMaxFilter1DData *md = (NI_MinOrMaxFilter1DData*)data;
+    npy_intp ll, jj, size1 = md->size1, size2 = md->size2;
+    int minimum = md->minimum;
+
+    if (work) {
+        NI_MinOrMaxLine(iline, length, md->filter_size, oline, work,
+                        work + length + md->filter_size, minimum);
+        return 1;
+    }
+    iline += size1;
+    for(ll = 0; ll < length; ll++) {
+    /* find minimum or maximum filter: */
+        double val = iline[ll - size1];
+        for(jj = -size1 + 1; jj <= size2; jj++) {
+            double tmp = iline[ll + jj];
+            if (minimum) {
+                if (tmp < val)
+                    val = tmp;
+            } else {
+                if (tmp > val)
+                    val = tmp;
+            }
+        }
+        oline[ll] = val;
+    }
+    return 1;
 }
 
 int
 NI_MinOrMaxFilter1D(PyArrayObject *input, npy_intp filter_size,
                                         int axis, PyArrayObject *output, NI_ExtendMode mode,
-                    double cval, npy_intp origin, int minimum)
+                    double cval, npy_intp origin, int minimum, int threads)
 {
-    npy_intp lines, kk, jj, ll, length, size1, size2;
-    int more;
-    double *ibuffer = NULL, *obuffer = NULL;
-    NI_LineBuffer iline_buffer, oline_buffer;
+    NI_MinOrMaxFilter1DData md;
+    npy_intp length, work_size = 0;
 
-    size1 = filter_size / 2;
-    size2 = filter_size - size1 - 1;
-    /* allocate and initialize the line buffers: */
-    lines = -1;
-    if (!NI_AllocateLineBuffer(input, axis, size1 + origin, size2 - origin,
-                                                         &lines, BUFFER_SIZE, &ibuffer))
-        goto exit;
-    if (!NI_AllocateLineBuffer(output, axis, 0, 0, &lines, BUFFER_SIZE,
-                                                         &obuffer))
-        goto exit;
-    if (!NI_InitLineBuffer(input, axis, size1 + origin, size2 - origin,
-                                                             lines, ibuffer, mode, cval, &iline_buffer))
-        goto exit;
-    if (!NI_InitLineBuffer(output, axis, 0, 0, lines, obuffer, mode, 0.0,
-                                                 &oline_buffer))
-        goto exit;
+    md.filter_size = filter_size;
+    md.size1 = filter_size / 2;
+    md.size2 = filter_size - md.size1 - 1;
+    md.minimum = minimum;
     length = input->nd > 0 ? input->dimensions[axis] : 1;
-
+    /* work space for the van Herk/Gil-Werman algorithm, which is used for
+         all but the smallest filters: */
+    if (filter_size > 3)
+        work_size = 2 * (length + filter_size);
     /* iterate over all the array lines: */
-    do {
-        /* copy lines from array to buffer: */
-        if (!NI_ArrayToLineBuffer(&iline_buffer, &lines, &more))
-            goto exit;
-        /* iterate over the lines in the buffers: */
-        for(kk = 0; kk < lines; kk++) {
-            /* get lines: */
-            double *iline = NI_GET_LINE(iline_buffer, kk) + size1;
-            double *oline = NI_GET_LINE(oline_buffer, kk);
-            for(ll = 0; ll < length; ll++) {
-            /* find minimum or maximum filter: */
-                double val = iline[ll - size1];
-                for(jj = -size1 + 1; jj <= size2; jj++) {
-                    double tmp = iline[ll + jj];
-                    if (minimum) {
-                        if (tmp < val)
-                            val = tmp;
-                    } else {
-                        if (tmp > val)
-                            val = tmp;
-                    }
-                }
-                oline[ll] = val;
-            }
-        }
-        /* copy lines from buffer to array: */
-        if (!NI_LineBufferToArray(&oline_buffer))
-            goto exit;
-    } while(more);
-
- exit:
-    if (ibuffer) free(ibuffer);
-    if (obuffer) free(obuffer);
+    NI_FilterLines(input, output, axis, md.size1 + origin, md.size2 - origin,
+                   mode, cval, NI_MinOrMaxFilter1DLine, &md, work_size,
+                   threads);
     return PyErr_Occurred() ? 0 : 1;
 }
 
@@ -426,6 +928,50 @@ case t ## _type:                                                  \
 }                                                                 \
 break
 
+/* Find the minimum or maximum of a run of points that share the same
+     filter offsets, one filter tap at a time, in a buffer of the input
+     type, which is then converted to double: */
+#define CASE_MIN_OR_MAX_RUN(_pi, _stride, _offsets, _filter_size, _cval, \
+                            _type, _minimum, _mv, _values, _res, _run)   \
+case t ## _type:                                                         \
+{                                                                        \
+    npy_intp _ii, _jj;                                                   \
+    _type *_vv = (_type*)(_values), _tmp;                                \
+    for(_ii = 0; _ii < _filter_size; _ii++) {                            \
+        npy_intp _oo = _offsets[_ii];                                    \
+        char *_pp = _pi + _oo;                                           \
+        if (_oo == _mv) {                                                \
+            _tmp = (_type)_cval;                                         \
+            for(_jj = 0; _jj < _run; _jj++)                              \
+                if (_ii == 0 || (_minimum ? _tmp < _vv[_jj] :            \
+                                            _tmp > _vv[_jj]))            \
+                    _vv[_jj] = _tmp;                                     \
+        } else if (_stride == sizeof(_type)) {                           \
+            _type *_qq = (_type*)_pp;                                    \
+            if (_ii == 0) {                                              \
+                for(_jj = 0; _jj < _run; _jj++)                          \
+                    _vv[_jj] = _qq[_jj];                                 \
+            } else if (_minimum) {                                       \
+                for(_jj = 0; _jj < _run; _jj++)                          \
+                    _vv[_jj] = _qq[_jj] < _vv[_jj] ? _qq[_jj] : _vv[_jj]; \
+            } else {                                                     \
+                for(_jj = 0; _jj < _run; _jj++)                          \
+                    _vv[_jj] = _qq[_jj] > _vv[_jj] ? _qq[_jj] : _vv[_jj]; \
+            }                                                            \
+        } else {                                                         \
+            for(_jj = 0; _jj < _run; _jj++) {                            \
+                _tmp = *(_type*)(_pp + _jj * _stride);                   \
+                if (_ii == 0 || (_minimum ? _tmp < _vv[_jj] :            \
+                                            _tmp > _vv[_jj]))            \
+                    _vv[_jj] = _tmp;                                     \
+            }                                                            \
+        }                                                                \
+    }                                                                    \
+    for(_jj = 0; _jj < _run; _jj++)                                      \
+        _res[_jj] = (double)_vv[_jj];                                    \
+}                                                                        \
+break
+
 int NI_MinOrMaxFilter(PyArrayObject* input, PyArrayObject* footprint,
                 PyArrayObject* structure, PyArrayObject* output,
                       NI_ExtendMode mode, double cvalue, npy_intp *origins,
@@ -433,12 +979,12 @@ int NI_MinOrMaxFilter(PyArrayObject* input, PyArrayObject* footprint,
 {
     Bool *pf = NULL;
     npy_intp fsize, jj, kk, filter_size = 0, border_flag_value;
-    npy_intp *offsets = NULL, *oo, size;
+    npy_intp *offsets = NULL, *oo, size, run;
     NI_FilterIterator fi;
     NI_Iterator ii, io;
     char *pi, *po;
-    int ll;
-    double *ss = NULL;
+    int ll, itype, otype, last = input->nd - 1;
+    double *ss = NULL, *buffer = NULL;
     Float64 *ps;
 
     /* get the the footprint: */
@@ -485,11 +1031,97 @@ int NI_MinOrMaxFilter(PyArrayObject* input, PyArrayObject* footprint,
     size = 1;
     for(ll = 0; ll < input->nd; ll++)
         size *= input->dimensions[ll];
+    /* the points of a line along the last axis that are in the interior
+         share the same offsets, and are filtered together, if there is
+         no structure to add in the input type: */
+    run = 0;
+    if (last >= 0 && fi.bound2[last] > fi.bound1[last] && filter_size > 0 &&
+        !ss) {
+        run = fi.bound2[last] - fi.bound1[last] + 1;
+        /* results, followed by values of the input type: */
+        buffer = (double*)malloc(2 * run * sizeof(double));
+        if (!buffer) {
+            PyErr_NoMemory();
+            goto exit;
+        }
+    }
+    /* the types are checked before the GIL is released: */
+    if (!NI_CheckFilterType(input) || !NI_CheckFilterType(output))
+        goto exit;
+    itype = NI_CanonicalType(input->descr->type_num);
+    otype = NI_CanonicalType(output->descr->type_num);
+    Py_BEGIN_ALLOW_THREADS
     /* iterator over the elements: */
     oo = offsets;
     for(jj = 0; jj < size; jj++) {
         double tmp = 0.0;
-        switch (input->descr->type_num) {
+        if (run > 0 && ii.coordinates[last] == fi.bound1[last]) {
+            npy_intp istride = ii.strides[last], ostride = io.strides[last];
+            switch (itype) {
+                CASE_MIN_OR_MAX_RUN(pi, istride, oo, filter_size, cvalue, Bool,
+                                minimum, border_flag_value, buffer + run,
+                                buffer, run);
+                CASE_MIN_OR_MAX_RUN(pi, istride, oo, filter_size, cvalue, UInt8,
+                                minimum, border_flag_value, buffer + run,
+                                buffer, run);
+                CASE_MIN_OR_MAX_RUN(pi, istride, oo, filter_size, cvalue, UInt16,
+                                minimum, border_flag_value, buffer + run,
+                                buffer, run);
+                CASE_MIN_OR_MAX_RUN(pi, istride, oo, filter_size, cvalue, UInt32,
+                                minimum, border_flag_value, buffer + run,
+                                buffer, run);
+#if HAS_UINT64
+                CASE_MIN_OR_MAX_RUN(pi, istride, oo, filter_size, cvalue, UInt64,
+                                minimum, border_flag_value, buffer + run,
+                                buffer, run);
+#endif
+                CASE_MIN_OR_MAX_RUN(pi, istride, oo, filter_size, cvalue, Int8,
+                                minimum, border_flag_value, buffer + run,
+                                buffer, run);
+                CASE_MIN_OR_MAX_RUN(pi, istride, oo, filter_size, cvalue, Int16,
+                                minimum, border_flag_value, buffer + run,
+                                buffer, run);
+                CASE_MIN_OR_MAX_RUN(pi, istride, oo, filter_size, cvalue, Int32,
+                                minimum, border_flag_value, buffer + run,
+                                buffer, run);
+                CASE_MIN_OR_MAX_RUN(pi, istride, oo, filter_size, cvalue, Int64,
+                                minimum, border_flag_value, buffer + run,
+                                buffer, run);
+                CASE_MIN_OR_MAX_RUN(pi, istride, oo, filter_size, cvalue, Float32,
+                                minimum, border_flag_value, buffer + run,
+                                buffer, run);
+                CASE_MIN_OR_MAX_RUN(pi, istride, oo, filter_size, cvalue, Float64,
+                                minimum, border_flag_value, buffer + run,
+                                buffer, run);
+            default:
+                break;
+            }
+            switch (otype) {
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Bool);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, UInt8);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, UInt16);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, UInt32);
+#if HAS_UINT64
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, UInt64);
+#endif
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Int8);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Int16);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Int32);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Int64);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Float32);
+                CASE_FILTER_OUT_RUN(po, ostride, buffer, run, Float64);
+            default:
+                break;
+            }
+            /* move to the last point of the run: */
+            ii.coordinates[last] += run - 1;
+            pi += (run - 1) * istride;
+            po += (run - 1) * ostride;
+            jj += run - 1;
+            NI_FILTER_NEXT2(fi, ii, io, oo, pi, po);
+            continue;
+        }
+        switch (itype) {
             CASE_MIN_OR_MAX_POINT(pi, oo, filter_size, cvalue, Bool,
                                                         minimum, tmp, border_flag_value, ss);
             CASE_MIN_OR_MAX_POINT(pi, oo, filter_size, cvalue, UInt8,
@@ -515,10 +1147,9 @@ int NI_MinOrMaxFilter(PyArrayObject* input, PyArrayObject* footprint,
             CASE_MIN_OR_MAX_POINT(pi, oo, filter_size, cvalue, Float64,
                                                         minimum, tmp, border_flag_value, ss);
         default:
-            PyErr_SetString(PyExc_RuntimeError, "array type not supported");
-            goto exit;
+            break;
         }
-        switch (output->descr->type_num) {
+        switch (otype) {
             CASE_FILTER_OUT(po, tmp, Bool);
             CASE_FILTER_OUT(po, tmp, UInt8);
             CASE_FILTER_OUT(po, tmp, UInt16);
@@ -533,14 +1164,15 @@ int NI_MinOrMaxFilter(PyArrayObject* input, PyArrayObject* footprint,
             CASE_FILTER_OUT(po, tmp, Float32);
             CASE_FILTER_OUT(po, tmp, Float64);
         default:
-            PyErr_SetString(PyExc_RuntimeError, "array type not supported");
-            goto exit;
+            break;
         }
         NI_FILTER_NEXT2(fi, ii, io, oo, pi, po);
     }
+    Py_END_ALLOW_THREADS
 exit:
     if (offsets) free(offsets);
     if (ss) free(ss);
+    if (buffer) free(buffer);
     return PyErr_Occurred() ? 0 : 1;
 }
 
@@ -594,18 +1226,72 @@ case t ## _type:                                                   \
 }                                                                  \
 break
 
+/* Rank filters of 8 and 16 bit unsigned integers use a sliding histogram
+     (Huang's algorithm, generalized to arbitrary footprints): when moving
+     one element along the last axis, the values under the left edges of
+     the footprint leave the window and those under its right edges enter
+     it. The histogram has coarse and fine bins, so a rank is found in at
+     most 2 * 2^(bits/2) steps, instead of a selection over the footprint: */
+#define CASE_RANK_HISTOGRAM(_pi, _oo, _list, _nlist, _delta, _mv, _cval, \
+                            _coarse, _fine, _shift, _type)               \
+case t ## _type:                                                         \
+{                                                                        \
+    npy_intp _ii, _vv;                                                   \
+    for(_ii = 0; _ii < _nlist; _ii++) {                                  \
+        npy_intp _offset = _oo[_list[_ii]];                              \
+        if (_offset == _mv)                                              \
+            _vv = _cval;                                                 \
+        else                                                             \
+            _vv = *(_type*)(_pi + _offset);                              \
+        _coarse[_vv >> _shift] += _delta;                                \
+        _fine[_vv] += _delta;                                            \
+    }                                                                    \
+}                                                                        \
+break
+
+static void NI_UpdateRankHistogram(char *pi, npy_intp *oo, npy_intp *list,
+                                   npy_intp nlist, npy_intp delta, int type,
+                                   npy_intp mv, npy_intp cval,
+                                   npy_intp *coarse, npy_intp *fine,
+                                   int shift)
+{
+    switch (type) {
+        CASE_RANK_HISTOGRAM(pi, oo, list, nlist, delta, mv, cval,
+                            coarse, fine, shift, UInt8);
+        CASE_RANK_HISTOGRAM(pi, oo, list, nlist, delta, mv, cval,
+                            coarse, fine, shift, UInt16);
+    default:
+        break;
+    }
+}
+
+static npy_intp NI_SelectRankHistogram(npy_intp *coarse, npy_intp *fine,
+                                       int shift, npy_intp rank)
+{
+    npy_intp cc = 0, ff, sum = 0;
+
+    while(sum + coarse[cc] <= rank)
+        sum += coarse[cc++];
+    ff = cc << shift;
+    while(sum + fine[ff] <= rank)
+        sum += fine[ff++];
+    return ff;
+}
+
 int NI_RankFilter(PyArrayObject* input, int rank,
                                     PyArrayObject* footprint, PyArrayObject* output,
                   NI_ExtendMode mode, double cvalue, npy_intp *origins)
 {
     npy_intp fsize, jj, filter_size = 0, border_flag_value;
     npy_intp *offsets = NULL, *oo, size;
+    npy_intp *coarse = NULL, *fine = NULL, *edges = NULL, *oo_prev = NULL;
+    npy_intp nleft = 0, nright = 0, hcval = 0;
     NI_FilterIterator fi;
     NI_Iterator ii, io;
-    char *pi, *po;
+    char *pi, *po, *pi_prev = NULL;
     Bool *pf = NULL;
     double *buffer = NULL;
-    int ll;
+    int ll, type, otype, shift = 0, last = input->nd - 1;
 
     /* get the the footprint: */
     fsize = 1;
@@ -623,6 +1309,45 @@ int NI_RankFilter(PyArrayObject* input, int rank,
         PyErr_NoMemory();
         goto exit;
     }
+    type = NI_CanonicalType(input->descr->type_num);
+    /* the rank is selected among values of the input type, so a constant
+         value at the borders that is out of the range of 8 and 16 bit
+         integers is clamped, rather than converted with undefined
+         behavior: */
+    if (type == tUInt8 || type == tUInt16) {
+        double vmax = type == tUInt8 ? 255.0 : 65535.0;
+        if (!(cvalue >= 0.0))
+            cvalue = 0.0;
+        else if (cvalue > vmax)
+            cvalue = vmax;
+    }
+    /* histograms and footprint edges for 8 and 16 bit integers: */
+    if (last >= 0 && ((type == tUInt8 && filter_size > 8) ||
+                      (type == tUInt16 && filter_size > 64))) {
+        int bits = type == tUInt8 ? 8 : 16;
+        npy_intp kk = 0, flen = footprint->dimensions[last];
+        shift = bits / 2;
+        coarse = (npy_intp*)calloc((1 << shift) + (1 << bits),
+                                   sizeof(npy_intp));
+        edges = (npy_intp*)malloc(3 * filter_size * sizeof(npy_intp));
+        if (!coarse || !edges) {
+            PyErr_NoMemory();
+            goto exit;
+        }
+        fine = coarse + (1 << shift);
+        for(jj = 0; jj < fsize; jj++) {
+            if (pf[jj]) {
+                npy_intp col = jj % flen;
+                edges[kk] = kk;
+                if (col == 0 || !pf[jj - 1])
+                    edges[filter_size + nleft++] = kk;
+                if (col == flen - 1 || !pf[jj + 1])
+                    edges[2 * filter_size + nright++] = kk;
+                ++kk;
+            }
+        }
+        hcval = (npy_intp)cvalue;
+    }
     /* iterator over the elements: */
     oo = offsets;
     /* initialize filter offsets: */
@@ -645,11 +1370,38 @@ int NI_RankFilter(PyArrayObject* input, int rank,
     size = 1;
     for(ll = 0; ll < input->nd; ll++)
         size *= input->dimensions[ll];
+    /* the types are checked before the GIL is released: */
+    if (!NI_CheckFilterType(input) || !NI_CheckFilterType(output))
+        goto exit;
+    otype = NI_CanonicalType(output->descr->type_num);
+    Py_BEGIN_ALLOW_THREADS
     /* iterator over the elements: */
     oo = offsets;
     for(jj = 0; jj < size; jj++) {
         double tmp = 0.0;
-        switch (input->descr->type_num) {
+        if (coarse) {
+            if (oo == oo_prev && ii.coordinates[last] > 0) {
+                /* same region, one element further along the line: */
+                NI_UpdateRankHistogram(pi_prev, oo, edges + filter_size,
+                                       nleft, -1, type, border_flag_value,
+                                       hcval, coarse, fine, shift);
+                NI_UpdateRankHistogram(pi, oo, edges + 2 * filter_size,
+                                       nright, 1, type, border_flag_value,
+                                       hcval, coarse, fine, shift);
+            } else {
+                if (oo_prev)
+                    NI_UpdateRankHistogram(pi_prev, oo_prev, edges,
+                                           filter_size, -1, type,
+                                           border_flag_value, hcval,
+                                           coarse, fine, shift);
+                NI_UpdateRankHistogram(pi, oo, edges, filter_size, 1, type,
+                                       border_flag_value, hcval, coarse,
+                                       fine, shift);
+            }
+            pi_prev = pi;
+            oo_prev = oo;
+            tmp = NI_SelectRankHistogram(coarse, fine, shift, rank);
+        } else switch (type) {
             CASE_RANK_POINT(pi, oo, filter_size, cvalue, Bool,
                                             rank, buffer, tmp, border_flag_value);
             CASE_RANK_POINT(pi, oo, filter_size, cvalue, UInt8,
@@ -675,10 +1427,9 @@ int NI_RankFilter(PyArrayObject* input, int rank,
             CASE_RANK_POINT(pi, oo, filter_size, cvalue, Float64,
                                             rank, buffer, tmp, border_flag_value);
         default:
-            PyErr_SetString(PyExc_RuntimeError, "array type not supported");
-            goto exit;
+            break;
         }
-        switch (output->descr->type_num) {
+        switch (otype) {
             CASE_FILTER_OUT(po, tmp, Bool);
             CASE_FILTER_OUT(po, tmp, UInt8);
             CASE_FILTER_OUT(po, tmp, UInt16);
@@ -693,73 +1444,54 @@ int NI_RankFilter(PyArrayObject* input, int rank,
             CASE_FILTER_OUT(po, tmp, Float32);
             CASE_FILTER_OUT(po, tmp, Float64);
         default:
-            PyErr_SetString(PyExc_RuntimeError, "array type not supported");
-            goto exit;
+            break;
         }
         NI_FILTER_NEXT2(fi, ii, io, oo, pi, po);
     }
+    Py_END_ALLOW_THREADS
 exit:
     if (offsets) free(offsets);
     if (buffer) free(buffer);
+    if (coarse) free(coarse);
+    if (edges) free(edges);
     return PyErr_Occurred() ? 0 : 1;
 }
 
+typedef struct {
+    int (*function)(double*, npy_intp, double*, npy_intp, void*);
+    void *data;
+} NI_GenericFilter1DData;
+
+static int NI_GenericFilter1DLine(double *iline, npy_intp ilength,
+                                  double *oline, npy_intp length,
+                                  void *data, double *work)
+{
+    NI_GenericFilter1DData *gd = (NI_GenericFilter1DData*)data;
+
+    return gd->function(iline, ilength, oline, length, gd->data);
+}
+
 int NI_GenericFilter1D(PyArrayObject *input,
             int (*function)(double*, npy_intp, double*, npy_intp, void*),
             void* data, npy_intp filter_size, int axis, PyArrayObject *output,
-            NI_ExtendMode mode, double cval, npy_intp origin)
+            NI_ExtendMode mode, double cval, npy_intp origin, int threads)
 {
-    int more;
-    npy_intp ii, lines, length, size1, size2;
-    double *ibuffer = NULL, *obuffer = NULL;
-    NI_LineBuffer iline_buffer, oline_buffer;
+    npy_intp size1, size2;
+    NI_GenericFilter1DData gd;
 
-    /* allocate and initialize the line buffers: */
     size1 = filter_size / 2;
     size2 = filter_size - size1 - 1;
-    lines = -1;
-    if (!NI_AllocateLineBuffer(input, axis, size1 + origin, size2 - origin,
-                                                         &lines, BUFFER_SIZE, &ibuffer))
-        goto exit;
-    if (!NI_AllocateLineBuffer(output, axis, 0, 0, &lines, BUFFER_SIZE,
-                                                         &obuffer))
-        goto exit;
-    if (!NI_InitLineBuffer(input, axis, size1 + origin, size2 - origin,
-                                                            lines, ibuffer, mode, cval, &iline_buffer))
-        goto exit;
-    if (!NI_InitLineBuffer(output, axis, 0, 0, lines, obuffer, mode, 0.0,
-                                                 &oline_buffer))
-        goto exit;
-    length = input->nd > 0 ? input->dimensions[axis] : 1;
-    /* iterate over all the array lines: */
-    do {
-        /* copy lines from array to buffer: */
-        if (!NI_ArrayToLineBuffer(&iline_buffer, &lines, &more))
-            goto exit;
-        /* iterate over the lines in the buffers: */
-        for(ii = 0; ii < lines; ii++) {
-            /* get lines: */
-            double *iline = NI_GET_LINE(iline_buffer, ii);
-            double *oline = NI_GET_LINE(oline_buffer, ii);
-            if (!function(iline, length + size1 + size2, oline, length, data)) {
-                if (!PyErr_Occurred())
-                    PyErr_SetString(PyExc_RuntimeError,
-                                                    "unknown error in line processing function");
-                goto exit;
-            }
-        }
-        /* copy lines from buffer to array: */
-        if (!NI_LineBufferToArray(&oline_buffer))
-            goto exit;
-    } while(more);
-exit:
-    if (ibuffer) free(ibuffer);
-    if (obuffer) free(obuffer);
+    gd.function = function;
+    gd.data = data;
+    /* iterate over all the array lines, the function sets an error or
+         returns zero on failure: */
+    NI_FilterLines(input, output, axis, size1 + origin, size2 - origin,
+                   mode, cval, NI_GenericFilter1DLine, &gd, 0, threads);
     return PyErr_Occurred() ? 0 : 1;
 }
 
 #define CASE_FILTER_POINT(_pi, _offsets, _filter_size, _cvalue, _type, \
-                                                    _res, _mv, _function, _data, _buffer)        \
+                          _mv, _buffer)                                \
 case t ## _type:                                                       \
 {                                                                      \
     npy_intp _ii, _offset;                                             \
@@ -770,120 +1502,697 @@ case t ## _type:                                                       \
         else                                                               \
             _buffer[_ii] = (double)*(_type*)(_pi + _offset);                 \
     }                                                                    \
-    if (!_function(_buffer, _filter_size, &_res, _data)) {               \
-        if (!PyErr_Occurred())                                             \
-            PyErr_SetString(PyExc_RuntimeError,                              \
-                                            "unknown error in filter function");             \
-            goto exit;                                                       \
-    }                                                                    \
 }                                                                      \
 break
 
-
-int NI_GenericFilter(PyArrayObject* input,
-            int (*function)(double*, npy_intp, double*, void*), void *data,
-            PyArrayObject* footprint, PyArrayObject* output,
-            NI_ExtendMode mode, double cvalue, npy_intp *origins)
-{
-    Bool *pf = NULL;
-    npy_intp fsize, jj, filter_size = 0, border_flag_value;
-    npy_intp *offsets = NULL, *oo, size;
+typedef struct {
+    PyArrayObject *input, *output;
+    int (*function)(double*, npy_intp, double*, void*);
+    int (*block_function)(double*, npy_intp, npy_intp, double*, void*);
+    void *data;
+    npy_intp *offsets, filter_size, border_flag_value, block;
+    double cvalue, *buffers, *results;
+    char **targets;
     NI_FilterIterator fi;
     NI_Iterator ii, io;
-    char *pi, *po;
-    double *buffer = NULL;
+} NI_GenericFilterData;
+
+/* filter a range of the elements, in C order, with the buffers of a
+     thread; the iterators are copied and moved to the first element. The
+     values of up to block elements are gathered before the function is
+     called, and the results are then written to the output: */
+static int NI_GenericFilterRange(void *data, npy_intp first,
+                                 npy_intp count, int thread)
+{
+    NI_GenericFilterData *gd = (NI_GenericFilterData*)data;
+    PyArrayObject *input = gd->input, *output = gd->output;
+    NI_FilterIterator fi = gd->fi;
+    NI_Iterator ii = gd->ii, io = gd->io;
+    npy_intp coordinates[MAXDIM], filter_size = gd->filter_size;
+    npy_intp border_flag_value = gd->border_flag_value, jj, kk, tmp = first;
+    npy_intp block = gd->block, nblock;
+    npy_intp *oo;
+    double *buffers = gd->buffers + thread * block * filter_size;
+    double *results = gd->results + thread * block, cvalue = gd->cvalue;
+    char **targets = gd->targets + thread * block, *pi, *po;
     int ll;
 
+    for(ll = input->nd - 1; ll >= 0; ll--) {
+        coordinates[ll] = tmp % input->dimensions[ll];
+        tmp /= input->dimensions[ll];
+    }
+    NI_ITERATOR_GOTO(ii, coordinates, (char*)PyArray_DATA(input), pi);
+    NI_ITERATOR_GOTO(io, coordinates, (char*)PyArray_DATA(output), po);
+    NI_FILTER_GOTO(fi, ii, gd->offsets, oo);
+    for(jj = 0; jj < count; jj += nblock) {
+        nblock = count - jj < block ? count - jj : block;
+        for(kk = 0; kk < nblock; kk++) {
+            double *buffer = buffers + kk * filter_size;
+            switch (NI_CanonicalType(input->descr->type_num)) {
+                CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Bool,
+                                  border_flag_value, buffer);
+                CASE_FILTER_POINT(pi, oo, filter_size, cvalue, UInt8,
+                                  border_flag_value, buffer);
+                CASE_FILTER_POINT(pi, oo, filter_size, cvalue, UInt16,
+                                  border_flag_value, buffer);
+                CASE_FILTER_POINT(pi, oo, filter_size, cvalue, UInt32,
+                                  border_flag_value, buffer);
+#if HAS_UINT64
+                CASE_FILTER_POINT(pi, oo, filter_size, cvalue, UInt64,
+                                  border_flag_value, buffer);
+#endif
+                CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Int8,
+                                  border_flag_value, buffer);
+                CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Int16,
+                                  border_flag_value, buffer);
+                CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Int32,
+                                  border_flag_value, buffer);
+                CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Int64,
+                                  border_flag_value, buffer);
+                CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Float32,
+                                  border_flag_value, buffer);
+                CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Float64,
+                                  border_flag_value, buffer);
+            default:
+                return 0;
+            }
+            targets[kk] = po;
+            NI_FILTER_NEXT2(fi, ii, io, oo, pi, po);
+        }
+        if (gd->block_function) {
+            if (!gd->block_function(buffers, nblock, filter_size, results,
+                                    gd->data))
+                return 0;
+        } else {
+            results[0] = 0.0;
+            if (!gd->function(buffers, filter_size, results, gd->data))
+                return 0;
+        }
+        for(kk = 0; kk < nblock; kk++) {
+            char *pt = targets[kk];
+            switch (NI_CanonicalType(output->descr->type_num)) {
+                CASE_FILTER_OUT(pt, results[kk], Bool);
+                CASE_FILTER_OUT(pt, results[kk], UInt8);
+                CASE_FILTER_OUT(pt, results[kk], UInt16);
+                CASE_FILTER_OUT(pt, results[kk], UInt32);
+#if HAS_UINT64
+                CASE_FILTER_OUT(pt, results[kk], UInt64);
+#endif
+                CASE_FILTER_OUT(pt, results[kk], Int8);
+                CASE_FILTER_OUT(pt, results[kk], Int16);
+                CASE_FILTER_OUT(pt, results[kk], Int32);
+                CASE_FILTER_OUT(pt, results[kk], Int64);
+                CASE_FILTER_OUT(pt, results[kk], Float32);
+                CASE_FILTER_OUT(pt, results[kk], Float64);
+            default:
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Set up the filter of a generic filter and run it over the threads: */
+static int NI_RunGenericFilter(NI_GenericFilterData *gd,
+                               PyArrayObject *footprint, NI_ExtendMode mode,
+                               npy_intp *origins, int threads)
+{
+    PyArrayObject *input = gd->input;
+    Bool *pf = NULL;
+    npy_intp fsize, jj, size;
+    int ll, nbuffers;
+
+    gd->offsets = NULL;
+    gd->buffers = NULL;
+    gd->results = NULL;
+    gd->targets = NULL;
     /* get the the footprint: */
     fsize = 1;
     for(ll = 0; ll < footprint->nd; ll++)
         fsize *= footprint->dimensions[ll];
     pf = (Bool*)PyArray_DATA(footprint);
+    gd->filter_size = 0;
     for(jj = 0; jj < fsize; jj++) {
         if (pf[jj])
-            ++filter_size;
+            ++gd->filter_size;
     }
+    /* the types are checked here, the threads can not set errors: */
+    if (!NI_CheckFilterType(input) || !NI_CheckFilterType(gd->output))
+        goto exit;
     /* initialize filter offsets: */
     if (!NI_InitFilterOffsets(input, pf, footprint->dimensions, origins,
-                                                        mode, &offsets, &border_flag_value, NULL))
+                              mode, &gd->offsets, &gd->border_flag_value,
+                              NULL))
         goto exit;
     /* initialize filter iterator: */
     if (!NI_InitFilterIterator(input->nd, footprint->dimensions,
-                                                         filter_size, input->dimensions, origins, &fi))
+                               gd->filter_size, input->dimensions, origins,
+                               &gd->fi))
         goto exit;
     /* initialize input element iterator: */
-    if (!NI_InitPointIterator(input, &ii))
+    if (!NI_InitPointIterator(input, &gd->ii))
         goto exit;
     /* initialize output element iterator: */
-    if (!NI_InitPointIterator(output, &io))
+    if (!NI_InitPointIterator(gd->output, &gd->io))
         goto exit;
-    /* get data pointers an array size: */
-    pi = (void *)PyArray_DATA(input);
-    po = (void *)PyArray_DATA(output);
     size = 1;
     for(ll = 0; ll < input->nd; ll++)
         size *= input->dimensions[ll];
-    /* buffer for filter calculation: */
-    buffer = (double*)malloc(filter_size * sizeof(double));
-    if (!buffer) {
+    /* buffers for filter calculation, one set for each thread: */
+    if (threads > NI_MAX_THREADS)
+        threads = NI_MAX_THREADS;
+    nbuffers = threads < 1 ? 1 : threads;
+    gd->buffers = (double*)malloc(nbuffers * gd->block * gd->filter_size *
+                                  sizeof(double) + 1);
+    gd->results = (double*)malloc(nbuffers * gd->block * sizeof(double));
+    gd->targets = (char**)malloc(nbuffers * gd->block * sizeof(char*));
+    if (!gd->buffers || !gd->results || !gd->targets) {
         PyErr_NoMemory();
         goto exit;
     }
-    /* iterate over the elements: */
-    oo = offsets;
-    for(jj = 0; jj < size; jj++) {
-        double tmp = 0.0;
-        switch (input->descr->type_num) {
-            CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Bool,
-                                                tmp, border_flag_value, function, data, buffer);
-            CASE_FILTER_POINT(pi, oo, filter_size, cvalue, UInt8,
-                                                tmp, border_flag_value, function, data, buffer);
-            CASE_FILTER_POINT(pi, oo, filter_size, cvalue, UInt16,
-                                                tmp, border_flag_value, function, data, buffer);
-            CASE_FILTER_POINT(pi, oo, filter_size, cvalue, UInt32,
-                                                tmp, border_flag_value, function, data, buffer);
+    /* iterate over the elements, the function sets an error or returns
+         zero on failure: */
+    if (size > 0 && !NI_RunThreads(size, threads, NI_GenericFilterRange, gd)
+            && !PyErr_Occurred())
+        PyErr_SetString(PyExc_RuntimeError,
+                        "unknown error in filter function");
+exit:
+    if (gd->offsets) free(gd->offsets);
+    if (gd->buffers) free(gd->buffers);
+    if (gd->results) free(gd->results);
+    if (gd->targets) free(gd->targets);
+    return PyErr_Occurred() ? 0 : 1;
+}
+
+int NI_GenericFilter(PyArrayObject* input,
+            int (*function)(double*, npy_intp, double*, void*), void *data,
+            PyArrayObject* footprint, PyArrayObject* output,
+            NI_ExtendMode mode, double cvalue, npy_intp *origins,
+            int threads)
+{
+    NI_GenericFilterData gd;
+
+    gd.input = input;
+    gd.output = output;
+    gd.function = function;
+    gd.block_function = NULL;
+    gd.data = data;
+    gd.cvalue = cvalue;
+    gd.block = 1;
+    return NI_RunGenericFilter(&gd, footprint, mode, origins, threads);
+}
+
+/* The block filter calls the function with the values of up to block
+     elements at once, as the rows of a buffer of filter_size columns, and
+     the function stores one result for each row: */
+int NI_GenericBlockFilter(PyArrayObject* input,
+            int (*function)(double*, npy_intp, npy_intp, double*, void*),
+            void *data, npy_intp block, PyArrayObject* footprint,
+            PyArrayObject* output, NI_ExtendMode mode, double cvalue,
+            npy_intp *origins, int threads)
+{
+    NI_GenericFilterData gd;
+
+    if (block < 1) {
+        PyErr_SetString(PyExc_RuntimeError, "block size must be positive");
+        return 0;
+    }
+    gd.input = input;
+    gd.output = output;
+    gd.function = NULL;
+    gd.block_function = function;
+    gd.data = data;
+    gd.cvalue = cvalue;
+    gd.block = block;
+    return NI_RunGenericFilter(&gd, footprint, mode, origins, threads);
+}
+
+/* Separable filters applied to cache-sized tiles: each tile is read from
+     the input once, with a halo large enough for all filters, filtered
+     along all axes in a buffer of doubles, and written to the output. */
+
+#define TILE_SIZE 2097152
+
+/* Estimated costs per element of a pass over the array with a
+     one-dimensional filter, and of filtering a line, in multiplications: */
+#define NI_SEPARABLE_PASS 8.0
+
+static double NI_SeparableCost(int kind, npy_intp filter_size,
+                               int symmetric)
+{
+    switch (kind) {
+    case NI_SEPARABLE_CORRELATE:
+        return symmetric ? (double)(filter_size / 2 + 1) :
+                           (double)filter_size;
+    case NI_SEPARABLE_UNIFORM:
+        return 2.0;
+    case NI_SEPARABLE_MINIMUM:
+    case NI_SEPARABLE_MAXIMUM:
+        return 4.0;
+    default:
+        return 0.0;
+    }
+}
+
+/* Filter one line of the tile; iline has size1 + length + size2
+     elements: */
+static void NI_SeparableLine(double *iline, npy_intp length, double *oline,
+                             int kind, npy_intp filter_size,
+                             NI_Correlate1DData *cd, double *work)
+{
+    npy_intp ll;
+
+    switch (kind) {
+    case NI_SEPARABLE_CORRELATE:
+        NI_Correlate1DLine(iline, length + filter_size - 1, oline, length,
+                           cd, work);
+        break;
+    case NI_SEPARABLE_UNIFORM:
+        NI_UniformFilter1DLine(iline, length + filter_size - 1, oline,
+                               length, &filter_size, work);
+        break;
+    case NI_SEPARABLE_MINIMUM:
+    case NI_SEPARABLE_MAXIMUM:
+        NI_MinOrMaxLine(iline, length, filter_size, oline, work,
+                        work + length + filter_size,
+                        kind == NI_SEPARABLE_MINIMUM);
+        break;
+    default:
+        for(ll = 0; ll < length; ll++)
+            oline[ll] = iline[ll];
+        break;
+    }
+}
+
+#define CASE_SEPARABLE_READ(_pi, _map, _stride, _length, _tile, _type) \
+case t ## _type:                                                     \
+{                                                                    \
+    npy_intp _ii;                                                    \
+    for(_ii = 0; _ii < _length; _ii++)                               \
+        _tile[_ii] = _map[_ii] < 0 ? cval :                          \
+                            (double)*(_type*)(_pi + _map[_ii] * _stride); \
+}                                                                    \
+break
+
+#define CASE_SEPARABLE_WRITE(_po, _stride, _length, _tile, _type) \
+case t ## _type:                                                \
+{                                                               \
+    npy_intp _ii;                                               \
+    for(_ii = 0; _ii < _length; _ii++)                          \
+        *(_type*)(_po + _ii * _stride) = (_type)_tile[_ii];     \
+}                                                               \
+break
+
+typedef struct {
+    PyArrayObject *input, *output;
+    npy_intp *kinds, *sizes;
+    npy_intp size1[MAXDIM], size2[MAXDIM], tshape[MAXDIM], ntiles[MAXDIM];
+    NI_Correlate1DData correlate[MAXDIM];
+    double cval;
+    NI_ExtendMode mode;
+    char *buffers[NI_MAX_THREADS];
+    npy_intp tile_size, line_size;
+} NI_SeparableData;
+
+/* filter the tiles first to first + count - 1 with the buffers of a
+     thread: */
+static int NI_SeparableTiles(void *data, npy_intp first, npy_intp count,
+                             int thread)
+{
+    NI_SeparableData *sd = (NI_SeparableData*)data;
+    PyArrayObject *input = sd->input, *output = sd->output;
+    npy_intp *size1 = sd->size1, *size2 = sd->size2, *kinds = sd->kinds;
+    npy_intp tstart[MAXDIM], tlength[MAXDIM], extent[MAXDIM];
+    npy_intp tstrides[MAXDIM], lo[MAXDIM], hi[MAXDIM], cc[MAXDIM];
+    npy_intp *maps[MAXDIM];
+    npy_intp index, jj, kk;
+    double *tile, *iline, *oline, *work, cval = sd->cval;
+    int nd = input->nd, ll, more;
+    int itype = NI_CanonicalType(input->descr->type_num);
+    int otype = NI_CanonicalType(output->descr->type_num);
+    char *pi = (void *)PyArray_DATA(input);
+    char *po = (void *)PyArray_DATA(output);
+
+    tile = (double*)sd->buffers[thread];
+    iline = tile + sd->tile_size;
+    oline = iline + sd->line_size;
+    work = oline + sd->line_size;
+    maps[0] = (npy_intp*)(work + 4 * sd->line_size);
+
+    for(index = first; index < first + count; index++) {
+        char *ptr;
+        npy_intp tt = index;
+        /* position and extent of the tile, and its extension maps: */
+        for(ll = nd - 1; ll >= 0; ll--) {
+            tstart[ll] = (tt % sd->ntiles[ll]) * sd->tshape[ll];
+            tt /= sd->ntiles[ll];
+        }
+        for(ll = 0; ll < nd; ll++) {
+            tlength[ll] = input->dimensions[ll] - tstart[ll];
+            if (tlength[ll] > sd->tshape[ll])
+                tlength[ll] = sd->tshape[ll];
+            extent[ll] = tlength[ll] + size1[ll] + size2[ll];
+            if (ll > 0)
+                maps[ll] = maps[ll - 1] + sd->tshape[ll - 1] +
+                                                size1[ll - 1] + size2[ll - 1];
+            for(jj = 0; jj < extent[ll]; jj++)
+                maps[ll][jj] = NI_ExtendIndex(tstart[ll] - size1[ll] + jj,
+                                              input->dimensions[ll], sd->mode);
+        }
+        tstrides[nd - 1] = 1;
+        for(ll = nd - 2; ll >= 0; ll--)
+            tstrides[ll] = tstrides[ll + 1] * extent[ll + 1];
+
+        /* read the tile and its halo, line by line along the last axis: */
+        for(ll = 0; ll < nd; ll++)
+            cc[ll] = 0;
+        do {
+            int outside = 0;
+            ptr = pi;
+            kk = 0;
+            for(ll = 0; ll < nd - 1; ll++) {
+                if (maps[ll][cc[ll]] < 0)
+                    outside = 1;
+                else
+                    ptr += maps[ll][cc[ll]] * input->strides[ll];
+                kk += cc[ll] * tstrides[ll];
+            }
+            if (outside) {
+                for(jj = 0; jj < extent[nd - 1]; jj++)
+                    tile[kk + jj] = cval;
+            } else {
+                switch (itype) {
+                    CASE_SEPARABLE_READ(ptr, maps[nd - 1],
+                        input->strides[nd - 1], extent[nd - 1], (tile + kk), Bool);
+                    CASE_SEPARABLE_READ(ptr, maps[nd - 1],
+                        input->strides[nd - 1], extent[nd - 1], (tile + kk), UInt8);
+                    CASE_SEPARABLE_READ(ptr, maps[nd - 1],
+                        input->strides[nd - 1], extent[nd - 1], (tile + kk), UInt16);
+                    CASE_SEPARABLE_READ(ptr, maps[nd - 1],
+                        input->strides[nd - 1], extent[nd - 1], (tile + kk), UInt32);
 #if HAS_UINT64
-            CASE_FILTER_POINT(pi, oo, filter_size, cvalue, UInt64,
-                                                tmp, border_flag_value, function, data, buffer);
+                    CASE_SEPARABLE_READ(ptr, maps[nd - 1],
+                        input->strides[nd - 1], extent[nd - 1], (tile + kk), UInt64);
 #endif
-            CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Int8,
-                                                tmp, border_flag_value, function, data, buffer);
-            CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Int16,
-                                                tmp, border_flag_value, function, data, buffer);
-            CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Int32,
-                                                tmp, border_flag_value, function, data, buffer);
-            CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Int64,
-                                                tmp, border_flag_value, function, data, buffer);
-            CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Float32,
-                                                tmp, border_flag_value, function, data, buffer);
-            CASE_FILTER_POINT(pi, oo, filter_size, cvalue, Float64,
-                                                tmp, border_flag_value, function, data, buffer);
-        default:
-            PyErr_SetString(PyExc_RuntimeError, "array type not supported");
-            goto exit;
+                    CASE_SEPARABLE_READ(ptr, maps[nd - 1],
+                        input->strides[nd - 1], extent[nd - 1], (tile + kk), Int8);
+                    CASE_SEPARABLE_READ(ptr, maps[nd - 1],
+                        input->strides[nd - 1], extent[nd - 1], (tile + kk), Int16);
+                    CASE_SEPARABLE_READ(ptr, maps[nd - 1],
+                        input->strides[nd - 1], extent[nd - 1], (tile + kk), Int32);
+                    CASE_SEPARABLE_READ(ptr, maps[nd - 1],
+                        input->strides[nd - 1], extent[nd - 1], (tile + kk), Int64);
+                    CASE_SEPARABLE_READ(ptr, maps[nd - 1],
+                        input->strides[nd - 1], extent[nd - 1], (tile + kk), Float32);
+                    CASE_SEPARABLE_READ(ptr, maps[nd - 1],
+                        input->strides[nd - 1], extent[nd - 1], (tile + kk), Float64);
+                default:
+                    return 0;
+                }
+            }
+            more = 0;
+            for(ll = nd - 2; ll >= 0; ll--) {
+                if (++cc[ll] < extent[ll]) {
+                    more = 1;
+                    break;
+                }
+                cc[ll] = 0;
+            }
+        } while(more);
+
+        /* filter along each axis. Axes that were already filtered are
+             only needed in the tile itself, the others with their halo.
+             In the constant mode the halo outside of the array stays
+             constant, as for a sequence of one-dimensional filters: */
+        for(kk = 0; kk < nd; kk++) {
+            if (kinds[kk] == NI_SEPARABLE_NONE)
+                continue;
+            for(ll = 0; ll < nd; ll++) {
+                lo[ll] = ll < kk ? size1[ll] : 0;
+                hi[ll] = ll < kk ? size1[ll] + tlength[ll] : extent[ll];
+                cc[ll] = lo[ll];
+            }
+            lo[kk] = 0;
+            hi[kk] = 1;
+            cc[kk] = 0;
+            do {
+                int outside = 0;
+                double *pt = tile;
+                for(ll = 0; ll < nd; ll++) {
+                    pt += cc[ll] * tstrides[ll];
+                    if (ll != kk && maps[ll][cc[ll]] < 0)
+                        outside = 1;
+                }
+                if (outside) {
+                    for(jj = 0; jj < tlength[kk]; jj++)
+                        pt[(jj + size1[kk]) * tstrides[kk]] = cval;
+                } else {
+                    for(jj = 0; jj < extent[kk]; jj++)
+                        iline[jj] = pt[jj * tstrides[kk]];
+                    NI_SeparableLine(iline, tlength[kk], oline, kinds[kk],
+                                     sd->sizes[kk], sd->correlate + kk, work);
+                    for(jj = 0; jj < tlength[kk]; jj++)
+                        pt[(jj + size1[kk]) * tstrides[kk]] = oline[jj];
+                }
+                more = 0;
+                for(ll = nd - 1; ll >= 0; ll--) {
+                    if (++cc[ll] < hi[ll]) {
+                        more = 1;
+                        break;
+                    }
+                    cc[ll] = lo[ll];
+                }
+            } while(more);
         }
-        switch (output->descr->type_num) {
-            CASE_FILTER_OUT(po, tmp, Bool);
-            CASE_FILTER_OUT(po, tmp, UInt8);
-            CASE_FILTER_OUT(po, tmp, UInt16);
-            CASE_FILTER_OUT(po, tmp, UInt32);
+
+        /* write the tile without its halo: */
+        for(ll = 0; ll < nd; ll++)
+            cc[ll] = 0;
+        do {
+            double *pt = tile;
+            ptr = po;
+            for(ll = 0; ll < nd; ll++) {
+                pt += (cc[ll] + size1[ll]) * tstrides[ll];
+                if (ll < nd - 1)
+                    ptr += (tstart[ll] + cc[ll]) * output->strides[ll];
+            }
+            ptr += tstart[nd - 1] * output->strides[nd - 1];
+            switch (otype) {
+                CASE_SEPARABLE_WRITE(ptr, output->strides[nd - 1],
+                                     tlength[nd - 1], pt, Bool);
+                CASE_SEPARABLE_WRITE(ptr, output->strides[nd - 1],
+                                     tlength[nd - 1], pt, UInt8);
+                CASE_SEPARABLE_WRITE(ptr, output->strides[nd - 1],
+                                     tlength[nd - 1], pt, UInt16);
+                CASE_SEPARABLE_WRITE(ptr, output->strides[nd - 1],
+                                     tlength[nd - 1], pt, UInt32);
 #if HAS_UINT64
-            CASE_FILTER_OUT(po, tmp, UInt64);
+                CASE_SEPARABLE_WRITE(ptr, output->strides[nd - 1],
+                                     tlength[nd - 1], pt, UInt64);
 #endif
-            CASE_FILTER_OUT(po, tmp, Int8);
-            CASE_FILTER_OUT(po, tmp, Int16);
-            CASE_FILTER_OUT(po, tmp, Int32);
-            CASE_FILTER_OUT(po, tmp, Int64);
-            CASE_FILTER_OUT(po, tmp, Float32);
-            CASE_FILTER_OUT(po, tmp, Float64);
+                CASE_SEPARABLE_WRITE(ptr, output->strides[nd - 1],
+                                     tlength[nd - 1], pt, Int8);
+                CASE_SEPARABLE_WRITE(ptr, output->strides[nd - 1],
+                                     tlength[nd - 1], pt, Int16);
+                CASE_SEPARABLE_WRITE(ptr, output->strides[nd - 1],
+                                     tlength[nd - 1], pt, Int32);
+                CASE_SEPARABLE_WRITE(ptr, output->strides[nd - 1],
+                                     tlength[nd - 1], pt, Int64);
+                CASE_SEPARABLE_WRITE(ptr, output->strides[nd - 1],
+                                     tlength[nd - 1], pt, Float32);
+                CASE_SEPARABLE_WRITE(ptr, output->strides[nd - 1],
+                                     tlength[nd - 1], pt, Float64);
+            default:
+                return 0;
+            }
+            more = 0;
+            for(ll = nd - 2; ll >= 0; ll--) {
+                if (++cc[ll] < tlength[ll]) {
+                    more = 1;
+                    break;
+                }
+                cc[ll] = 0;
+            }
+        } while(more);
+    }
+    return 1;
+}
+
+int NI_SeparableFilter(PyArrayObject *input, npy_intp *kinds,
+                       npy_intp *sizes, npy_intp *origins,
+                       PyArrayObject *weights, PyArrayObject *output,
+                       NI_ExtendMode mode, double cval, int threads)
+{
+    NI_SeparableData sd;
+    npy_intp extent, total, tiles, max_line = 1, max_tile, nmaps = 0;
+    double *pw = NULL, tiled, single;
+    int nd = input->nd, ll, ii, type;
+
+    for(ii = 0; ii < NI_MAX_THREADS; ii++)
+        sd.buffers[ii] = NULL;
+    if (nd < 1) {
+        PyErr_SetString(PyExc_RuntimeError, "array must have dimensions");
+        goto exit;
+    }
+    /* check the types here, the tiles are processed without the GIL: */
+    for(ii = 0; ii < 2; ii++) {
+        type = NI_CanonicalType((ii ? output : input)->descr->type_num);
+        switch (type) {
+        case tBool:
+        case tUInt8:
+        case tUInt16:
+        case tUInt32:
+#if HAS_UINT64
+        case tUInt64:
+#endif
+        case tInt8:
+        case tInt16:
+        case tInt32:
+        case tInt64:
+        case tFloat32:
+        case tFloat64:
+            break;
         default:
             PyErr_SetString(PyExc_RuntimeError, "array type not supported");
             goto exit;
         }
-        NI_FILTER_NEXT2(fi, ii, io, oo, pi, po);
     }
+    sd.input = input;
+    sd.output = output;
+    sd.kinds = kinds;
+    sd.sizes = sizes;
+    sd.mode = mode;
+    sd.cval = cval;
+    /* halo and filter weights of each axis: */
+    if (weights)
+        pw = (double*)PyArray_DATA(weights);
+    for(ll = 0; ll < nd; ll++) {
+        if (kinds[ll] == NI_SEPARABLE_NONE) {
+            sd.size1[ll] = sd.size2[ll] = 0;
+        } else {
+            sd.size1[ll] = sizes[ll] / 2 + origins[ll];
+            sd.size2[ll] = sizes[ll] - sizes[ll] / 2 - 1 - origins[ll];
+        }
+        sd.correlate[ll].weights = pw;
+        sd.correlate[ll].size1 = sizes[ll] / 2;
+        sd.correlate[ll].size2 = sizes[ll] - sizes[ll] / 2 - 1;
+        sd.correlate[ll].symmetric = 0;
+        if (kinds[ll] == NI_SEPARABLE_CORRELATE) {
+            sd.correlate[ll].weights = pw + sizes[ll] / 2;
+            sd.correlate[ll].symmetric = NI_Correlate1DSymmetry(pw,
+                                                                sizes[ll]);
+            pw += sizes[ll];
+        }
+    }
+    /* tile shape: halve the first axes before the contiguous last one,
+         until the tile with its halo fits the tile size: */
+    max_tile = TILE_SIZE / sizeof(double);
+    for(ll = 0; ll < nd; ll++)
+        sd.tshape[ll] = input->dimensions[ll];
+    for(;;) {
+        int axis = -1;
+        total = 1;
+        for(ll = 0; ll < nd; ll++)
+            total *= sd.tshape[ll] + sd.size1[ll] + sd.size2[ll];
+        if (total <= max_tile)
+            break;
+        for(ll = 0; ll < nd - 1; ll++)
+            if (sd.tshape[ll] > 8 &&
+                    (axis < 0 || sd.tshape[ll] > sd.tshape[axis]))
+                axis = ll;
+        if (axis < 0 && sd.tshape[nd - 1] > 64)
+            axis = nd - 1;
+        if (axis < 0)
+            break;
+        sd.tshape[axis] = (sd.tshape[axis] + 1) / 2;
+    }
+    tiles = 1;
+    for(ll = 0; ll < nd; ll++) {
+        extent = sd.tshape[ll] + sd.size1[ll] + sd.size2[ll];
+        if (extent > max_line)
+            max_line = extent;
+        nmaps += extent;
+        sd.ntiles[ll] = sd.tshape[ll] > 0 ?
+            (input->dimensions[ll] + sd.tshape[ll] - 1) / sd.tshape[ll] : 0;
+        tiles *= sd.ntiles[ll];
+    }
+    if (tiles < 1)
+        goto exit;
+    /* the halos of the tiles are filtered along the axes before the last
+         axis that they extend, and are read once. If that costs more
+         than filtering each axis over the whole array in turn, or if the
+         halo does not fit in the tile size, do the latter: */
+    tiled = 1.0;
+    for(ll = 0; ll < nd; ll++)
+        tiled *= (double)(sd.tshape[ll] + sd.size1[ll] + sd.size2[ll]) /
+                                                    (double)sd.tshape[ll];
+    single = 0.0;
+    for(ll = 0; ll < nd; ll++) {
+        double cost = NI_SeparableCost(kinds[ll], sizes[ll],
+                                       sd.correlate[ll].symmetric);
+        if (kinds[ll] == NI_SEPARABLE_NONE)
+            continue;
+        single += cost + NI_SEPARABLE_PASS;
+        for(ii = ll + 1; ii < nd; ii++)
+            cost *= (double)(sd.tshape[ii] + sd.size1[ii] + sd.size2[ii]) /
+                                                    (double)sd.tshape[ii];
+        tiled += cost;
+    }
+    if (single > 0.0 && (total > max_tile || tiled > single)) {
+        PyArrayObject *tmp = input;
+        for(ll = 0; ll < nd; ll++) {
+            switch (kinds[ll]) {
+            case NI_SEPARABLE_CORRELATE:
+                NI_Correlate1DWeights(tmp, sd.correlate[ll].weights -
+                                      sizes[ll] / 2, sizes[ll], ll, output,
+                                      mode, cval, origins[ll], threads);
+                break;
+            case NI_SEPARABLE_UNIFORM:
+                NI_UniformFilter1D(tmp, sizes[ll], ll, output, mode, cval,
+                                   origins[ll], threads);
+                break;
+            case NI_SEPARABLE_MINIMUM:
+            case NI_SEPARABLE_MAXIMUM:
+                NI_MinOrMaxFilter1D(tmp, sizes[ll], ll, output, mode, cval,
+                                    origins[ll],
+                                    kinds[ll] == NI_SEPARABLE_MINIMUM,
+                                    threads);
+                break;
+            default:
+                continue;
+            }
+            if (PyErr_Occurred())
+                goto exit;
+            tmp = output;
+        }
+        goto exit;
+    }
+    /* allocate the tile, lines and extension maps of each thread: */
+    if (threads > tiles)
+        threads = (int)tiles;
+    if (threads > NI_MAX_THREADS)
+        threads = NI_MAX_THREADS;
+    if (threads < 1)
+        threads = 1;
+    sd.tile_size = total;
+    sd.line_size = max_line;
+    for(ii = 0; ii < threads; ii++) {
+        sd.buffers[ii] = malloc((total + 6 * max_line) * sizeof(double) +
+                                nmaps * sizeof(npy_intp));
+        if (!sd.buffers[ii]) {
+            PyErr_NoMemory();
+            goto exit;
+        }
+    }
+    /* the types were checked, the tiles do not fail otherwise: */
+    if (!NI_RunThreads(tiles, threads, NI_SeparableTiles, &sd) &&
+            !PyErr_Occurred())
+        PyErr_SetString(PyExc_RuntimeError,
+                        "unknown error in separable filter");
+
 exit:
-    if (offsets) free(offsets);
-    if (buffer) free(buffer);
+    for(ii = 0; ii < NI_MAX_THREADS; ii++)
+        if (sd.buffers[ii])
+            free(sd.buffers[ii]);
     return PyErr_Occurred() ? 0 : 1;
 }
@@ -32,14 +32,28 @@
 #ifndef NI_FILTERS_H
 #define NI_FILTERS_H
 
+/* the filters that NI_SeparableFilter applies along each axis: */
+typedef enum {
+    NI_SEPARABLE_NONE = 0,
+    NI_SEPARABLE_CORRELATE = 1,
+    NI_SEPARABLE_UNIFORM = 2,
+    NI_SEPARABLE_MINIMUM = 3,
+    NI_SEPARABLE_MAXIMUM = 4
+} NI_SeparableKind;
+
 int NI_Correlate1D(PyArrayObject*, PyArrayObject*, int, PyArrayObject*,
-                   NI_ExtendMode, double, npy_intp);
+                   NI_ExtendMode, double, npy_intp, int);
+int NI_Correlate1DPyramid(PyArrayObject*, PyArrayObject*, int,
+                          PyArrayObject*, NI_ExtendMode, double, int, int);
 int NI_Correlate(PyArrayObject*, PyArrayObject*, PyArrayObject*,
                  NI_ExtendMode, double, npy_intp*);
 int NI_UniformFilter1D(PyArrayObject*, npy_intp, int, PyArrayObject*,
-                       NI_ExtendMode, double, npy_intp);
+                       NI_ExtendMode, double, npy_intp, int);
+int NI_RecursiveFilter1D(PyArrayObject*, PyArrayObject*, PyArrayObject*,
+                         PyArrayObject*, npy_intp, int, PyArrayObject*,
+                         NI_ExtendMode, double, int);
 int NI_MinOrMaxFilter1D(PyArrayObject*, npy_intp, int, PyArrayObject*,
-                        NI_ExtendMode, double, npy_intp, int);
+                        NI_ExtendMode, double, npy_intp, int, int);
 int NI_MinOrMaxFilter(PyArrayObject*, PyArrayObject*, PyArrayObject*,
                       PyArrayObject*, NI_ExtendMode, double, npy_intp*,
                                             int);
@@ -47,8 +61,15 @@ int NI_RankFilter(PyArrayObject*, int, PyArrayObject*, PyArrayObject*,
                                     NI_ExtendMode, double, npy_intp*);
 int NI_GenericFilter1D(PyArrayObject*, int (*)(double*, npy_intp,
                        double*, npy_intp, void*), void*, npy_intp, int,
-                       PyArrayObject*, NI_ExtendMode, double, npy_intp);
+                       PyArrayObject*, NI_ExtendMode, double, npy_intp, int);
 int NI_GenericFilter(PyArrayObject*, int (*)(double*, npy_intp, double*,
                                          void*), void*, PyArrayObject*, PyArrayObject*,
-                     NI_ExtendMode, double, npy_intp*);
+                     NI_ExtendMode, double, npy_intp*, int);
+int NI_GenericBlockFilter(PyArrayObject*, int (*)(double*, npy_intp, npy_intp,
+                          double*, void*), void*, npy_intp, PyArrayObject*,
+                          PyArrayObject*, NI_ExtendMode, double, npy_intp*,
+                          int);
+int NI_SeparableFilter(PyArrayObject*, npy_intp*, npy_intp*, npy_intp*,
+                       PyArrayObject*, PyArrayObject*, NI_ExtendMode, double,
+                       int);
 #endif
@@ -152,52 +152,102 @@ static double _bessel_j1(double x)
     return p * SQ2OPI / sqrt(x);
 }
 
-#define CASE_FOURIER_OUT_RR(_po, _tmp, _type) \
-case t ## _type:                              \
-    *(_type*)_po = _tmp;                        \
-    break
+#define CASE_FOURIER_OUT_RR(_po, _stride, _length, _re, _type) \
+case t ## _type:                                               \
+{                                                              \
+    npy_intp _kk;                                              \
+    for(_kk = 0; _kk < _length; _kk++) {                       \
+        *(_type*)_po = _re[_kk];                               \
+        _po += _stride;                                        \
+    }                                                          \
+}                                                              \
+break
 
-#define CASE_FOURIER_OUT_RC(_po, _tmp, _type) \
-case t ## _type:                              \
-    (*(_type*)_po).real = tmp;                  \
-    (*(_type*)_po).imag = 0.0;                  \
-    break
+#define CASE_FOURIER_OUT_RC(_po, _stride, _length, _re, _type) \
+case t ## _type:                                               \
+{                                                              \
+    npy_intp _kk;                                              \
+    for(_kk = 0; _kk < _length; _kk++) {                       \
+        (*(_type*)_po).real = _re[_kk];                        \
+        (*(_type*)_po).imag = 0.0;                             \
+        _po += _stride;                                        \
+    }                                                          \
+}                                                              \
+break
 
-#define CASE_FOURIER_OUT_CC(_po, _tmp_r, _tmp_i, _type) \
-case t ## _type:                                        \
-    (*(_type*)_po).real = _tmp_r;                         \
-    (*(_type*)_po).imag = _tmp_i;                         \
-    break
+#define CASE_FOURIER_OUT_CC(_po, _stride, _length, _re, _im, _type) \
+case t ## _type:                                                    \
+{                                                                   \
+    npy_intp _kk;                                                   \
+    for(_kk = 0; _kk < _length; _kk++) {                            \
+        (*(_type*)_po).real = _re[_kk];                             \
+        (*(_type*)_po).imag = _im[_kk];                             \
+        _po += _stride;                                             \
+    }                                                               \
+}                                                                   \
+break
 
-#define CASE_FOURIER_FILTER_RC(_pi, _tmp, _tmp_r, _tmp_i, _type) \
-case t ## _type:                                                 \
-    _tmp_r = (*(_type*)_pi).real * _tmp;                           \
-    _tmp_i = (*(_type*)_pi).imag * _tmp;                           \
-    break;
+#define CASE_FOURIER_FILTER_RC(_pi, _stride, _length, _re, _im, _type) \
+case t ## _type:                                                       \
+{                                                                      \
+    npy_intp _kk;                                                      \
+    for(_kk = 0; _kk < _length; _kk++) {                               \
+        _im[_kk] = (*(_type*)_pi).imag * _re[_kk];                     \
+        _re[_kk] = (*(_type*)_pi).real * _re[_kk];                     \
+        _pi += _stride;                                                \
+    }                                                                  \
+}                                                                      \
+break
 
-#define CASE_FOURIER_FILTER_RR(_pi, _tmp, _type) \
-case t ## _type:                                 \
-    _tmp *= *(_type*)_pi;                          \
-    break;
+#define CASE_FOURIER_FILTER_RR(_pi, _stride, _length, _re, _type) \
+case t ## _type:                                                  \
+{                                                                 \
+    npy_intp _kk;                                                 \
+    for(_kk = 0; _kk < _length; _kk++) {                          \
+        _re[_kk] *= *(_type*)_pi;                                 \
+        _pi += _stride;                                           \
+    }                                                             \
+}                                                                 \
+break
+
+/* Prepare the iteration over the lines along the last axis of an array,
+     returning the number of lines: */
+static npy_intp NI_InitFourierLines(PyArrayObject *array, NI_Iterator *it,
+                                    npy_intp *length, npy_intp *stride)
+{
+    npy_intp size = 1;
+    int ll;
+
+    for(ll = 0; ll < array->nd; ll++)
+        size *= array->dimensions[ll];
+    *length = array->nd > 0 ? array->dimensions[array->nd - 1] : 1;
+    *stride = array->nd > 0 ? array->strides[array->nd - 1] : 0;
+    if (!NI_InitPointIterator(array, it))
+        return -1;
+    if (array->nd > 0 && !NI_LineIterator(it, array->nd - 1))
+        return -1;
+    return size > 0 ? size / *length : 0;
+}
 
 int NI_FourierFilter(PyArrayObject *input, PyArrayObject* parameter_array,
                      npy_intp n, int axis, PyArrayObject* output,
-                     int filter_type)
+                     int filter_type, int nbatch)
 {
     NI_Iterator ii, io;
     char *pi, *po;
-    double *parameters = NULL, **params = NULL;
-    npy_intp kk, hh, size;
+    double *parameters = NULL, **params = NULL, *lparams, *buffer = NULL;
+    npy_intp kk, hh, nlines, length, istride, ostride;
     Float64 *iparameters = (void *)PyArray_DATA(parameter_array);
-    int ll;
+    int last = input->nd - 1, rank = input->nd - nbatch;
 
-    /* precalculate the parameters: */
+    /* precalculate the parameters, the leading batch axes are not
+         filtered: */
     parameters = (double*)malloc(input->nd * sizeof(double));
     if (!parameters) {
         PyErr_NoMemory();
         goto exit;
     }
-    for(kk = 0; kk < input->nd; kk++) {
+    for(kk = nbatch; kk < input->nd; kk++) {
         /* along the direction of the real transform we must use the given
              length of that dimensons, unless a complex transform is assumed
              (n < 0): */
@@ -214,7 +264,8 @@ int NI_FourierFilter(PyArrayObject *input, PyArrayObject* parameter_array,
                 break;
         }
     }
-    /* allocate memory for tables: */
+    /* allocate memory for tables, axes without a table have a factor of
+         one (or a frequency of zero for the ellipsoid): */
     params = (double**) malloc(input->nd * sizeof(double*));
     if (!params) {
         PyErr_NoMemory();
@@ -222,7 +273,7 @@ int NI_FourierFilter(PyArrayObject *input, PyArrayObject* parameter_array,
     }
     for(kk = 0; kk < input->nd; kk++)
         params[kk] = NULL;
-    for(kk = 0; kk < input->nd; kk++) {
+    for(kk = nbatch; kk < input->nd; kk++) {
         if (input->dimensions[kk] > 1) {
             params[kk] = (double*)malloc(input->dimensions[kk] * sizeof(double));
             if (!params[kk]) {
@@ -295,112 +346,123 @@ int NI_FourierFilter(PyArrayObject *input, PyArrayObject* parameter_array,
                         for(kk = -(input->dimensions[hh] / 2); kk < 0; kk++)
                             params[hh][jj++] = (double)kk * tmp;
                     }
-                } else if (input->dimensions[hh] > 0) {
-                    params[hh][0] = 1.0;
                 }
             }
-            if (input->nd > 1)
+            if (rank > 1)
                 for(hh = 0; hh < input->nd; hh++)
-                    for(kk = 0; kk < input->dimensions[hh]; kk++)
-                        params[hh][kk] = params[hh][kk] * params[hh][kk];
+                    if (params[hh])
+                        for(kk = 0; kk < input->dimensions[hh]; kk++)
+                            params[hh][kk] = params[hh][kk] * params[hh][kk];
             break;
         default:
             break;
     }
-    /* initialize input element iterator: */
-    if (!NI_InitPointIterator(input, &ii))
+    /* initialize the iterators over the lines along the last axis: */
+    nlines = NI_InitFourierLines(input, &ii, &length, &istride);
+    if (nlines < 0 || NI_InitFourierLines(output, &io, &length, &ostride) < 0)
         goto exit;
-    /* initialize output element iterator: */
-    if (!NI_InitPointIterator(output, &io))
+    lparams = input->nd > 0 ? params[last] : NULL;
+    /* buffers for the real and imaginary parts of a line: */
+    buffer = (double*)malloc(2 * length * sizeof(double));
+    if (!buffer) {
+        PyErr_NoMemory();
         goto exit;
+    }
     pi = (void *)PyArray_DATA(input);
     po = (void *)PyArray_DATA(output);
-    size = 1;
-    for(ll = 0; ll < input->nd; ll++)
-        size *= input->dimensions[ll];
-    /* iterator over the elements: */
-    for(hh = 0; hh < size; hh++) {
-        double tmp = 1.0;
+    /* iterate over the lines: */
+    for(hh = 0; hh < nlines; hh++) {
+        double *re = buffer, *im = buffer + length, tmp;
+        char *pl = pi;
+        /* the factors of a line are the product of the factor of the
+             other axes with the table of the last axis: */
         switch (filter_type) {
         case _NI_GAUSSIAN:
         case _NI_UNIFORM:
-            for(kk = 0; kk < input->nd; kk++)
+            tmp = 1.0;
+            for(kk = 0; kk < last; kk++)
                 if (params[kk])
                     tmp *= params[kk][ii.coordinates[kk]];
+            for(kk = 0; kk < length; kk++)
+                re[kk] = lparams ? tmp * lparams[kk] : tmp;
             break;
         case _NI_ELLIPSOID:
-            switch (input->nd) {
-            case 1:
-                tmp = params[0][ii.coordinates[0]];
-                tmp = tmp > 0.0 ? sin(tmp) / (tmp) : 1.0;
-                break;
-            case 2:
-                tmp = 0.0;
-                for(kk = 0; kk < 2; kk++)
+            tmp = 0.0;
+            for(kk = 0; kk < last; kk++)
+                if (params[kk])
                     tmp += params[kk][ii.coordinates[kk]];
-                tmp = sqrt(tmp);
-                tmp = tmp > 0.0 ? 2.0 * _bessel_j1(tmp) / tmp : 1.0;
-                break;
-            case 3:
-                {
-                    double r = 0.0;
-                    for(kk = 0; kk < 3; kk++)
-                        r += params[kk][ii.coordinates[kk]];
+            for(kk = 0; kk < length; kk++) {
+                double r = lparams ? tmp + lparams[kk] : tmp;
+                switch (rank) {
+                case 1:
+                    re[kk] = r > 0.0 ? sin(r) / (r) : 1.0;
+                    break;
+                case 2:
+                    r = sqrt(r);
+                    re[kk] = r > 0.0 ? 2.0 * _bessel_j1(r) / r : 1.0;
+                    break;
+                case 3:
                     r = sqrt(r);
                     if (r > 0.0) {
-                        tmp = 3.0 * (sin(r) - r * cos(r));
-                        tmp /= r * r * r;
+                        re[kk] = 3.0 * (sin(r) - r * cos(r));
+                        re[kk] /= r * r * r;
                     } else {
-                        tmp = 1.0;
+                        re[kk] = 1.0;
                     }
+                    break;
+                default:
+                    re[kk] = 1.0;
+                    break;
                 }
-                break;
             }
             break;
         default:
+            for(kk = 0; kk < length; kk++)
+                re[kk] = 1.0;
             break;
         }
         if (input->descr->type_num == tComplex64 ||
                 input->descr->type_num == tComplex128) {
-            double tmp_r = 0.0, tmp_i = 0.0;
             switch (input->descr->type_num) {
-                CASE_FOURIER_FILTER_RC(pi, tmp, tmp_r, tmp_i, Complex64);
-                CASE_FOURIER_FILTER_RC(pi, tmp, tmp_r, tmp_i, Complex128);
+                CASE_FOURIER_FILTER_RC(pl, istride, length, re, im, Complex64);
+                CASE_FOURIER_FILTER_RC(pl, istride, length, re, im, Complex128);
             default:
                 PyErr_SetString(PyExc_RuntimeError, "data type not supported");
                 goto exit;
             }
+            pl = po;
             switch (output->descr->type_num) {
-                CASE_FOURIER_OUT_CC(po, tmp_r, tmp_i, Complex64);
-                CASE_FOURIER_OUT_CC(po, tmp_r, tmp_i, Complex128);
+                CASE_FOURIER_OUT_CC(pl, ostride, length, re, im, Complex64);
+                CASE_FOURIER_OUT_CC(pl, ostride, length, re, im, Complex128);
             default:
                 PyErr_SetString(PyExc_RuntimeError, "data type not supported");
                 goto exit;
             }
         } else {
             switch (input->descr->type_num) {
-                CASE_FOURIER_FILTER_RR(pi, tmp, Bool)
-                CASE_FOURIER_FILTER_RR(pi, tmp, UInt8)
-                CASE_FOURIER_FILTER_RR(pi, tmp, UInt16)
-                CASE_FOURIER_FILTER_RR(pi, tmp, UInt32)
+                CASE_FOURIER_FILTER_RR(pl, istride, length, re, Bool);
+                CASE_FOURIER_FILTER_RR(pl, istride, length, re, UInt8);
+                CASE_FOURIER_FILTER_RR(pl, istride, length, re, UInt16);
+                CASE_FOURIER_FILTER_RR(pl, istride, length, re, UInt32);
 #if HAS_UINT64
-                CASE_FOURIER_FILTER_RR(pi, tmp, UInt64)
+                CASE_FOURIER_FILTER_RR(pl, istride, length, re, UInt64);
 #endif
-                CASE_FOURIER_FILTER_RR(pi, tmp, Int8)
-                CASE_FOURIER_FILTER_RR(pi, tmp, Int16)
-                CASE_FOURIER_FILTER_RR(pi, tmp, Int32)
-                CASE_FOURIER_FILTER_RR(pi, tmp, Int64)
-                CASE_FOURIER_FILTER_RR(pi, tmp, Float32)
-                CASE_FOURIER_FILTER_RR(pi, tmp, Float64)
+                CASE_FOURIER_FILTER_RR(pl, istride, length, re, Int8);
+                CASE_FOURIER_FILTER_RR(pl, istride, length, re, Int16);
+                CASE_FOURIER_FILTER_RR(pl, istride, length, re, Int32);
+                CASE_FOURIER_FILTER_RR(pl, istride, length, re, Int64);
+                CASE_FOURIER_FILTER_RR(pl, istride, length, re, Float32);
+                CASE_FOURIER_FILTER_RR(pl, istride, length, re, Float64);
             default:
                 PyErr_SetString(PyExc_RuntimeError, "data type not supported");
                 goto exit;
             }
+            pl = po;
             switch (output->descr->type_num) {
-                CASE_FOURIER_OUT_RR(po, tmp, Float32);
-                CASE_FOURIER_OUT_RR(po, tmp, Float64);
-                CASE_FOURIER_OUT_RC(po, tmp, Complex64);
-                CASE_FOURIER_OUT_RC(po, tmp, Complex128);
+                CASE_FOURIER_OUT_RR(pl, ostride, length, re, Float32);
+                CASE_FOURIER_OUT_RR(pl, ostride, length, re, Float64);
+                CASE_FOURIER_OUT_RC(pl, ostride, length, re, Complex64);
+                CASE_FOURIER_OUT_RC(pl, ostride, length, re, Complex128);
             default:
                 PyErr_SetString(PyExc_RuntimeError, "data type not supported");
                 goto exit;
@@ -416,39 +478,54 @@ int NI_FourierFilter(PyArrayObject *input, PyArrayObject* parameter_array,
             if (params[kk]) free(params[kk]);
         free(params);
     }
+    if (buffer) free(buffer);
     return PyErr_Occurred() ? 0 : 1;
 }
 
-#define CASE_FOURIER_SHIFT_R(_pi, _tmp, _r, _i, _cost, _sint, _type) \
-case t ## _type:                                                     \
-    _tmp = *(_type*)_pi;                                               \
-    _r = _tmp * _cost;                                                 \
-    _i = _tmp * _sint;                                                 \
-    break;
+#define CASE_FOURIER_SHIFT_R(_pi, _stride, _length, _cos, _sin, _type) \
+case t ## _type:                                                       \
+{                                                                      \
+    npy_intp _kk;                                                      \
+    for(_kk = 0; _kk < _length; _kk++) {                               \
+        double _tmp = *(_type*)_pi;                                    \
+        _cos[_kk] *= _tmp;                                             \
+        _sin[_kk] *= _tmp;                                             \
+        _pi += _stride;                                                \
+    }                                                                  \
+}                                                                      \
+break
 
-#define CASE_FOURIER_SHIFT_C(_pi, _r, _i, _cost, _sint, _type)     \
-case t ## _type:                                                   \
-    _r = (*(_type*)_pi).real * _cost - (*(_type*)_pi).imag * _sint;  \
-    _i = (*(_type*)_pi).real * _sint + (*(_type*)_pi).imag * _cost;  \
-    break;
+#define CASE_FOURIER_SHIFT_C(_pi, _stride, _length, _cos, _sin, _type) \
+case t ## _type:                                                       \
+{                                                                      \
+    npy_intp _kk;                                                      \
+    for(_kk = 0; _kk < _length; _kk++) {                               \
+        double _r = (*(_type*)_pi).real, _i = (*(_type*)_pi).imag;     \
+        double _c = _cos[_kk], _s = _sin[_kk];                         \
+        _cos[_kk] = _r * _c - _i * _s;                                 \
+        _sin[_kk] = _r * _s + _i * _c;                                 \
+        _pi += _stride;                                                \
+    }                                                                  \
+}                                                                      \
+break
 
 int NI_FourierShift(PyArrayObject *input, PyArrayObject* shift_array,
-            npy_intp n, int axis, PyArrayObject* output)
+            npy_intp n, int axis, PyArrayObject* output, int nbatch)
 {
     NI_Iterator ii, io;
     char *pi, *po;
-    double *shifts = NULL, **params = NULL;
-    npy_intp kk, hh, size;
+    double *shifts = NULL, **params = NULL, *lparams, *buffer = NULL;
+    npy_intp kk, hh, nlines, length, istride, ostride;
     Float64 *ishifts = (void *)PyArray_DATA(shift_array);
-    int ll;
+    int last = input->nd - 1;
 
-    /* precalculate the shifts: */
+    /* precalculate the shifts, the leading batch axes are not shifted: */
     shifts = (double*)malloc(input->nd * sizeof(double));
     if (!shifts) {
         PyErr_NoMemory();
         goto exit;
     }
-    for(kk = 0; kk < input->nd; kk++) {
+    for(kk = nbatch; kk < input->nd; kk++) {
         /* along the direction of the real transform we must use the given
              length of that dimensons, unless a complex transform is assumed
              (n < 0): */
@@ -456,7 +533,8 @@ int NI_FourierShift(PyArrayObject *input, PyArrayObject* shift_array,
                         (n < 0 ? input->dimensions[kk] : n) : input->dimensions[kk];
         shifts[kk] = -2.0 * M_PI * *ishifts++ / (double)shape;
     }
-    /* allocate memory for tables: */
+    /* allocate memory for tables of the cosines and the sines of the
+         phases along each axis: */
     params = (double**) malloc(input->nd * sizeof(double*));
     if (!params) {
         PyErr_NoMemory();
@@ -464,9 +542,10 @@ int NI_FourierShift(PyArrayObject *input, PyArrayObject* shift_array,
     }
     for(kk = 0; kk < input->nd; kk++)
         params[kk] = NULL;
-    for(kk = 0; kk < input->nd; kk++) {
+    for(kk = nbatch; kk < input->nd; kk++) {
         if (input->dimensions[kk] > 1) {
-            params[kk] = (double*)malloc(input->dimensions[kk] * sizeof(double));
+            params[kk] = (double*)malloc(2 * input->dimensions[kk] *
+                                         sizeof(double));
             if (!params[kk]) {
                 PyErr_NoMemory();
                 goto exit;
@@ -475,62 +554,90 @@ int NI_FourierShift(PyArrayObject *input, PyArrayObject* shift_array,
     }
     for (hh = 0; hh < input->nd; hh++) {
         if (params[hh]) {
+            double *sines = params[hh] + input->dimensions[hh];
             if (hh == axis && n >= 0) {
-                for(kk = 0; kk < input->dimensions[hh]; kk++)
-                    params[hh][kk] = shifts[hh] * kk;
+                for(kk = 0; kk < input->dimensions[hh]; kk++) {
+                    params[hh][kk] = cos(shifts[hh] * kk);
+                    sines[kk] = sin(shifts[hh] * kk);
+                }
             } else {
                 int jj = 0;
                 for(kk = 0; kk < (input->dimensions[hh] + 1) / 2; kk++) {
-                    params[hh][jj++] = shifts[hh] * kk;
+                    params[hh][jj] = cos(shifts[hh] * kk);
+                    sines[jj++] = sin(shifts[hh] * kk);
                 }
                 for(kk = -(input->dimensions[hh] / 2); kk < 0; kk++) {
-                    params[hh][jj++] = shifts[hh] * kk;
+                    params[hh][jj] = cos(shifts[hh] * kk);
+                    sines[jj++] = sin(shifts[hh] * kk);
                 }
             }
         }
     }
-    /* initialize input element iterator: */
-    if (!NI_InitPointIterator(input, &ii))
+    /* initialize the iterators over the lines along the last axis: */
+    nlines = NI_InitFourierLines(input, &ii, &length, &istride);
+    if (nlines < 0 || NI_InitFourierLines(output, &io, &length, &ostride) < 0)
         goto exit;
-    /* initialize output element iterator: */
-    if (!NI_InitPointIterator(output, &io))
+    lparams = input->nd > 0 ? params[last] : NULL;
+    /* buffers for the real and imaginary parts of a line: */
+    buffer = (double*)malloc(2 * length * sizeof(double));
+    if (!buffer) {
+        PyErr_NoMemory();
         goto exit;
+    }
     pi = (void *)PyArray_DATA(input);
     po = (void *)PyArray_DATA(output);
-    size = 1;
-    for(ll = 0; ll < input->nd; ll++)
-        size *= input->dimensions[ll];
-    /* iterator over the elements: */
-    for(hh = 0; hh < size; hh++) {
-        double tmp = 0.0, sint, cost, r = 0.0, i = 0.0;
-        for(kk = 0; kk < input->nd; kk++)
-            if (params[kk])
-                tmp += params[kk][ii.coordinates[kk]];
-        sint = sin(tmp);
-        cost = cos(tmp);
+    /* iterate over the lines: */
+    for(hh = 0; hh < nlines; hh++) {
+        double *cost = buffer, *sint = buffer + length, c = 1.0, s = 0.0;
+        char *pl = pi;
+        /* the phase factor of the other axes, multiplied with the phase
+             factors along the last axis: */
+        for(kk = 0; kk < last; kk++) {
+            if (params[kk]) {
+                npy_intp jj = ii.coordinates[kk];
+                double ck = params[kk][jj];
+                double sk = params[kk][input->dimensions[kk] + jj];
+                double tmp = c * ck - s * sk;
+                s = c * sk + s * ck;
+                c = tmp;
+            }
+        }
+        if (lparams) {
+            double *lsines = lparams + length;
+            for(kk = 0; kk < length; kk++) {
+                cost[kk] = c * lparams[kk] - s * lsines[kk];
+                sint[kk] = c * lsines[kk] + s * lparams[kk];
+            }
+        } else {
+            for(kk = 0; kk < length; kk++) {
+                cost[kk] = c;
+                sint[kk] = s;
+            }
+        }
         switch (input->descr->type_num) {
-            CASE_FOURIER_SHIFT_R(pi, tmp, r, i, cost, sint, Bool)
-            CASE_FOURIER_SHIFT_R(pi, tmp, r, i, cost, sint, UInt8)
-            CASE_FOURIER_SHIFT_R(pi, tmp, r, i, cost, sint, UInt16)
-            CASE_FOURIER_SHIFT_R(pi, tmp, r, i, cost, sint, UInt32)
+            CASE_FOURIER_SHIFT_R(pl, istride, length, cost, sint, Bool);
+            CASE_FOURIER_SHIFT_R(pl, istride, length, cost, sint, UInt8);
+            CASE_FOURIER_SHIFT_R(pl, istride, length, cost, sint, UInt16);
+            CASE_FOURIER_SHIFT_R(pl, istride, length, cost, sint, UInt32);
 #if HAS_UINT64
-            CASE_FOURIER_SHIFT_R(pi, tmp, r, i, cost, sint, UInt64)
+            CASE_FOURIER_SHIFT_R(pl, istride, length, cost, sint, UInt64);
 #endif
-            CASE_FOURIER_SHIFT_R(pi, tmp, r, i, cost, sint, Int8)
-            CASE_FOURIER_SHIFT_R(pi, tmp, r, i, cost, sint, Int16)
-            CASE_FOURIER_SHIFT_R(pi, tmp, r, i, cost, sint, Int32)
-            CASE_FOURIER_SHIFT_R(pi, tmp, r, i, cost, sint, Int64)
-            CASE_FOURIER_SHIFT_R(pi, tmp, r, i, cost, sint, Float32)
-            CASE_FOURIER_SHIFT_R(pi, tmp, r, i, cost, sint, Float64)
-            CASE_FOURIER_SHIFT_C(pi, r, i, cost, sint, Complex64)
-            CASE_FOURIER_SHIFT_C(pi, r, i, cost, sint, Complex128)
+            CASE_FOURIER_SHIFT_R(pl, istride, length, cost, sint, Int8);
+            CASE_FOURIER_SHIFT_R(pl, istride, length, cost, sint, Int16);
+            CASE_FOURIER_SHIFT_R(pl, istride, length, cost, sint, Int32);
+            CASE_FOURIER_SHIFT_R(pl, istride, length, cost, sint, Int64);
+            CASE_FOURIER_SHIFT_R(pl, istride, length, cost, sint, Float32);
+            CASE_FOURIER_SHIFT_R(pl, istride, length, cost, sint, Float64);
+            CASE_FOURIER_SHIFT_C(pl, istride, length, cost, sint, Complex64);
+            CASE_FOURIER_SHIFT_C(pl, istride, length, cost, sint, Complex128);
         default:
             PyErr_SetString(PyExc_RuntimeError, "data type not supported");
             goto exit;
         }
+        pl = po;
         switch (output->descr->type_num) {
-            CASE_FOURIER_OUT_CC(po, r, i, Complex64);
-            CASE_FOURIER_OUT_CC(po, r, i, Complex128);
+            CASE_FOURIER_OUT_CC(pl, ostride, length, cost, sint, Complex64);
+            CASE_FOURIER_OUT_CC(pl, ostride, length, cost, sint, Complex128);
         default:
             PyErr_SetString(PyExc_RuntimeError, "data type not supported");
             goto exit;
@@ -545,5 +652,6 @@ int NI_FourierShift(PyArrayObject *input, PyArrayObject* shift_array,
             if (params[kk]) free(params[kk]);
         free(params);
     }
+    if (buffer) free(buffer);
     return PyErr_Occurred() ? 0 : 1;
 }
@@ -33,8 +33,8 @@
 #define NI_FOURIER_H
 
 int NI_FourierFilter(PyArrayObject*, PyArrayObject*, npy_intp, int,
-                                         PyArrayObject*, int);
+                                         PyArrayObject*, int, int);
 int NI_FourierShift(PyArrayObject*, PyArrayObject*, npy_intp, int,
-                                        PyArrayObject*);
+                                        PyArrayObject*, int);
 
 #endif
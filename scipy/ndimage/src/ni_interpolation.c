@@ -195,115 +195,107 @@ map_coordinate(double in, npy_intp len, int mode)
     return in;
 }
 
-#define BUFFER_SIZE 256000
 #define TOLERANCE 1e-15
 
+typedef struct {
+    double pole[2], weight;
+    int npoles;
+} NI_SplineFilter1DData;
+
+/* spline filter of a single line: */
+static int NI_SplineFilter1DLine(double *iline, npy_intp ilength,
+                                 double *ln, npy_intp len, void *data,
+                                 double *work)
+{
+    NI_SplineFilter1DData *sd = (NI_SplineFilter1DData*)data;
+    npy_intp ll;
+    int hh;
+
+    for(ll = 0; ll < len; ll++)
+        ln[ll] = iline[ll];
+    if (len > 1) {
+        for(ll = 0; ll < len; ll++)
+            ln[ll] *= sd->weight;
+        for(hh = 0; hh < sd->npoles; hh++) {
+            double p = sd->pole[hh];
+            int max = (int)ceil(log(TOLERANCE) / log(fabs(p)));
+            if (max < len) {
+                double zn = p;
+                double sum = ln[0];
+                for(ll = 1; ll < max; ll++) {
+                    sum += zn * ln[ll];
+                    zn *= p;
+                }
+                ln[0] = sum;
+            } else {
+                double zn = p;
+                double iz = 1.0 / p;
+                double z2n = pow(p, (double)(len - 1));
+                double sum = ln[0] + z2n * ln[len - 1];
+                z2n *= z2n * iz;
+                for(ll = 1; ll <= len - 2; ll++) {
+                    sum += (zn + z2n) * ln[ll];
+                    zn *= p;
+                    z2n *= iz;
+                }
+                ln[0] = sum / (1.0 - zn * zn);
+            }
+            for(ll = 1; ll < len; ll++)
+                ln[ll] += p * ln[ll - 1];
+            ln[len-1] = (p / (p * p - 1.0)) * (ln[len-1] + p * ln[len-2]);
+            for(ll = len - 2; ll >= 0; ll--)
+                ln[ll] = p * (ln[ll + 1] - ln[ll]);
+        }
+    }
+    return 1;
+}
+
 /* one-dimensional spline filter: */
 int NI_SplineFilter1D(PyArrayObject *input, int order, int axis,
-                                            PyArrayObject *output)
+                      PyArrayObject *output, int threads)
 {
-    int hh, npoles = 0, more;
-    npy_intp kk, ll, lines, len;
-    double *buffer = NULL, weight, pole[2];
-    NI_LineBuffer iline_buffer, oline_buffer;
+    int hh;
+    npy_intp len;
+    NI_SplineFilter1DData sd;
 
     len = input->nd > 0 ? input->dimensions[axis] : 1;
     if (len < 1)
         goto exit;
 
     /* these are used in the spline filter calculation below: */
+    sd.npoles = 0;
     switch (order) {
     case 2:
-        npoles = 1;
-        pole[0] = sqrt(8.0) - 3.0;
+        sd.npoles = 1;
+        sd.pole[0] = sqrt(8.0) - 3.0;
         break;
     case 3:
-        npoles = 1;
-        pole[0] = sqrt(3.0) - 2.0;
+        sd.npoles = 1;
+        sd.pole[0] = sqrt(3.0) - 2.0;
         break;
     case 4:
-        npoles = 2;
-        pole[0] = sqrt(664.0 - sqrt(438976.0)) + sqrt(304.0) - 19.0;
-        pole[1] = sqrt(664.0 + sqrt(438976.0)) - sqrt(304.0) - 19.0;
+        sd.npoles = 2;
+        sd.pole[0] = sqrt(664.0 - sqrt(438976.0)) + sqrt(304.0) - 19.0;
+        sd.pole[1] = sqrt(664.0 + sqrt(438976.0)) - sqrt(304.0) - 19.0;
         break;
     case 5:
-        npoles = 2;
-        pole[0] = sqrt(67.5 - sqrt(4436.25)) + sqrt(26.25) - 6.5;
-        pole[1] = sqrt(67.5 + sqrt(4436.25)) - sqrt(26.25) - 6.5;
+        sd.npoles = 2;
+        sd.pole[0] = sqrt(67.5 - sqrt(4436.25)) + sqrt(26.25) - 6.5;
+        sd.pole[1] = sqrt(67.5 + sqrt(4436.25)) - sqrt(26.25) - 6.5;
         break;
     default:
         break;
     }
 
-    weight = 1.0;
-    for(hh = 0; hh < npoles; hh++)
-        weight *= (1.0 - pole[hh]) * (1.0 - 1.0 / pole[hh]);
-
-    /* allocate an initialize the line buffer, only a single one is used,
-         because the calculation is in-place: */
-    lines = -1;
-    if (!NI_AllocateLineBuffer(input, axis, 0, 0, &lines, BUFFER_SIZE,
-                                                         &buffer))
-        goto exit;
-    if (!NI_InitLineBuffer(input, axis, 0, 0, lines, buffer,
-                                                 NI_EXTEND_DEFAULT, 0.0, &iline_buffer))
-        goto exit;
-    if (!NI_InitLineBuffer(output, axis, 0, 0, lines, buffer,
-                                                 NI_EXTEND_DEFAULT, 0.0, &oline_buffer))
-        goto exit;
+    sd.weight = 1.0;
+    for(hh = 0; hh < sd.npoles; hh++)
+        sd.weight *= (1.0 - sd.pole[hh]) * (1.0 - 1.0 / sd.pole[hh]);
 
     /* iterate over all the array lines: */
-    do {
-        /* copy lines from array to buffer: */
-        if (!NI_ArrayToLineBuffer(&iline_buffer, &lines, &more))
-            goto exit;
-        /* iterate over the lines in the buffer: */
-        for(kk = 0; kk < lines; kk++) {
-            /* get line: */
-            double *ln = NI_GET_LINE(iline_buffer, kk);
-            /* spline filter: */
-            if (len > 1) {
-                for(ll = 0; ll < len; ll++)
-                    ln[ll] *= weight;
-                for(hh = 0; hh < npoles; hh++) {
-                    double p = pole[hh];
-                    int max = (int)ceil(log(TOLERANCE) / log(fabs(p)));
-                    if (max < len) {
-                        double zn = p;
-                        double sum = ln[0];
-                        for(ll = 1; ll < max; ll++) {
-                            sum += zn * ln[ll];
-                            zn *= p;
-                        }
-                        ln[0] = sum;
-                    } else {
-                        double zn = p;
-                        double iz = 1.0 / p;
-                        double z2n = pow(p, (double)(len - 1));
-                        double sum = ln[0] + z2n * ln[len - 1];
-                        z2n *= z2n * iz;
-                        for(ll = 1; ll <= len - 2; ll++) {
-                            sum += (zn + z2n) * ln[ll];
-                            zn *= p;
-                            z2n *= iz;
-                        }
-                        ln[0] = sum / (1.0 - zn * zn);
-                    }
-                    for(ll = 1; ll < len; ll++)
-                        ln[ll] += p * ln[ll - 1];
-                    ln[len-1] = (p / (p * p - 1.0)) * (ln[len-1] + p * ln[len-2]);
-                    for(ll = len - 2; ll >= 0; ll--)
-                        ln[ll] = p * (ln[ll + 1] - ln[ll]);
-                }
-            }
-        }
-        /* copy lines from buffer to array: */
-        if (!NI_LineBufferToArray(&oline_buffer))
-            goto exit;
-    } while(more);
+    NI_FilterLines(input, output, axis, 0, 0, NI_EXTEND_DEFAULT, 0.0,
+                   NI_SplineFilter1DLine, &sd, 0, threads);
 
  exit:
-    if (buffer) free(buffer);
     return PyErr_Occurred() ? 0 : 1;
 }
 
@@ -344,107 +336,86 @@ case t ## _type:                            \
     *(_type*)_po = (_type)_t;                 \
     break;
 
-int
-NI_GeometricTransform(PyArrayObject *input, int (*map)(npy_intp*, double*,
-                int, int, void*), void* map_data, PyArrayObject* matrix_ar,
-                PyArrayObject* shift_ar, PyArrayObject *coordinates,
-                PyArrayObject *output, int order, int mode, double cval)
-{
-    char *po, *pi, *pc = NULL;
-    npy_intp **edge_offsets = NULL, **data_offsets = NULL, filter_size;
-    npy_intp ftmp[MAXDIM], *fcoordinates = NULL, *foffsets = NULL;
-    npy_intp cstride = 0, kk, hh, ll, jj, *idxs = NULL;
-    npy_intp size;
-    double **splvals = NULL, icoor[MAXDIM];
-    npy_intp idimensions[MAXDIM], istrides[MAXDIM];
-    NI_Iterator io, ic;
-    Float64 *matrix = matrix_ar ? (Float64*)PyArray_DATA(matrix_ar) : NULL;
-    Float64 *shift = shift_ar ? (Float64*)PyArray_DATA(shift_ar) : NULL;
-    int irank = 0, orank, qq;
+/* the highest spline order supported: */
+#define MAX_SPLINE_ORDER 5
 
-    for(kk = 0; kk < input->nd; kk++) {
-        idimensions[kk] = input->dimensions[kk];
-        istrides[kk] = input->strides[kk];
-    }
-    irank = input->nd;
-    orank = output->nd;
+/* the number of output elements of a tile, which is a cube over the last
+     three axes at most. Tiles only pay off when the rows of the output
+     map across many rows of an input that does not fit in the cache, as
+     in rotations close to 90 degrees; otherwise they cost about as much
+     as rows, and serve to divide the output over the threads: */
+#define INTERP_TILE_SIZE 4096
 
-    /* if the mapping is from array coordinates: */
-    if (coordinates) {
-        /* initialze a line iterator along the first axis: */
-        if (!NI_InitPointIterator(coordinates, &ic))
-            goto exit;
-        cstride = ic.strides[0];
-        if (!NI_LineIterator(&ic, 0))
-            goto exit;
-        pc = (void *)(PyArray_DATA(coordinates));
-    }
-
-    /* offsets used at the borders: */
-    edge_offsets = (npy_intp**)malloc(irank * sizeof(npy_intp*));
-    data_offsets = (npy_intp**)malloc(irank * sizeof(npy_intp*));
-    if (!edge_offsets || !data_offsets) {
-        PyErr_NoMemory();
-        goto exit;
-    }
-    for(jj = 0; jj < irank; jj++)
-        data_offsets[jj] = NULL;
-    for(jj = 0; jj < irank; jj++) {
-        data_offsets[jj] = (npy_intp*)malloc((order + 1) * sizeof(npy_intp));
-        if (!data_offsets[jj]) {
-            PyErr_NoMemory();
-            goto exit;
-        }
-    }
-    /* will hold the spline coefficients: */
-    splvals = (double**)malloc(irank * sizeof(double*));
-    if (!splvals) {
-        PyErr_NoMemory();
-        goto exit;
-    }
-    for(jj = 0; jj < irank; jj++)
-        splvals[jj] = NULL;
-    for(jj = 0; jj < irank; jj++) {
-        splvals[jj] = (double*)malloc((order + 1) * sizeof(double));
-        if (!splvals[jj]) {
-            PyErr_NoMemory();
-            goto exit;
-        }
+/* Check that the type of an array is one of the types interpolated, so
+     that the threads can not fail on the type: */
+static int NI_CheckInterpolationType(PyArrayObject *array)
+{
+    switch (NI_CanonicalType(array->descr->type_num)) {
+    case tBool:
+    case tUInt8:
+    case tUInt16:
+    case tUInt32:
+#if HAS_UINT64
+    case tUInt64:
+#endif
+    case tInt8:
+    case tInt16:
+    case tInt32:
+    case tInt64:
+    case tFloat32:
+    case tFloat64:
+        return 1;
+    default:
+        PyErr_SetString(PyExc_RuntimeError, "data type not supported");
+        return 0;
     }
+}
 
-    filter_size = 1;
-    for(jj = 0; jj < irank; jj++)
-        filter_size *= order + 1;
-    idxs = (npy_intp*)malloc(filter_size * sizeof(idxs));
-    if (!idxs) {
-        PyErr_NoMemory();
-        goto exit;
+/* store an interpolated value, rounded and clipped for integer types: */
+static void NI_StoreInterpolated(char *po, int type, double t)
+{
+    switch (type) {
+        CASE_INTERP_OUT(po, t, Bool);
+        CASE_INTERP_OUT_UINT(po, t, UInt8, 0, MAX_UINT8);
+        CASE_INTERP_OUT_UINT(po, t, UInt16, 0, MAX_UINT16);
+        CASE_INTERP_OUT_UINT(po, t, UInt32, 0, MAX_UINT32);
+#if HAS_UINT64
+        /* FIXME */
+        CASE_INTERP_OUT_UINT(po, t, UInt64, 0, MAX_UINT32);
+#endif
+        CASE_INTERP_OUT_INT(po, t, Int8, MIN_INT8, MAX_INT8);
+        CASE_INTERP_OUT_INT(po, t, Int16, MIN_INT16, MAX_INT16);
+        CASE_INTERP_OUT_INT(po, t, Int32, MIN_INT32, MAX_INT32);
+        CASE_INTERP_OUT_INT(po, t, Int64, MIN_INT64, MAX_INT64);
+        CASE_INTERP_OUT(po, t, Float32);
+        CASE_INTERP_OUT(po, t, Float64);
+    default:
+        break;
     }
+}
 
-    /* initialize output iterator: */
-    if (!NI_InitPointIterator(output, &io))
-        goto exit;
-
-    /* get data pointers: */
-    pi = (void *)PyArray_DATA(input);
-    po = (void *)PyArray_DATA(output);
+/* Make a table of all coordinates and offsets within the spline filter: */
+static int NI_InitSplineOffsets(int rank, npy_intp *istrides, int order,
+                                npy_intp filter_size,
+                                npy_intp **fcoordinates, npy_intp **foffsets)
+{
+    npy_intp ftmp[MAXDIM], hh, kk;
+    int jj;
 
-    /* make a table of all possible coordinates within the spline filter: */
-    fcoordinates = (npy_intp*)malloc(irank * filter_size * sizeof(npy_intp));
-    /* make a table of all offsets within the spline filter: */
-    foffsets = (npy_intp*)malloc(filter_size * sizeof(npy_intp));
-    if (!fcoordinates || !foffsets) {
+    *fcoordinates = (npy_intp*)malloc(rank * filter_size * sizeof(npy_intp));
+    *foffsets = (npy_intp*)malloc(filter_size * sizeof(npy_intp));
+    if (!*fcoordinates || !*foffsets) {
         PyErr_NoMemory();
-        goto exit;
+        return 0;
     }
-    for(jj = 0; jj < irank; jj++)
+    for(jj = 0; jj < rank; jj++)
         ftmp[jj] = 0;
     kk = 0;
     for(hh = 0; hh < filter_size; hh++) {
-        for(jj = 0; jj < irank; jj++)
-            fcoordinates[jj + hh * irank] = ftmp[jj];
-        foffsets[hh] = kk;
-        for(jj = irank - 1; jj >= 0; jj--) {
+        for(jj = 0; jj < rank; jj++)
+            (*fcoordinates)[jj + hh * rank] = ftmp[jj];
+        (*foffsets)[hh] = kk;
+        for(jj = rank - 1; jj >= 0; jj--) {
             if (ftmp[jj] < order) {
                 ftmp[jj]++;
                 kk += istrides[jj];
@@ -455,220 +426,414 @@ NI_GeometricTransform(PyArrayObject *input, int (*map)(npy_intp*, double*,
             }
         }
     }
+    return 1;
+}
 
-    size = 1;
-    for(qq = 0; qq < output->nd; qq++)
-        size *= output->dimensions[qq];
-    for(kk = 0; kk < size; kk++) {
-        double t = 0.0;
-        int constant = 0, edge = 0, offset = 0;
-        if (map) {
-            /* call mappint functions: */
-            if (!map(io.coordinates, icoor, orank, irank, map_data)) {
-                if (!PyErr_Occurred())
-                    PyErr_SetString(PyExc_RuntimeError,
-                                                    "unknown error in mapping function");
-                goto exit;
+typedef struct {
+    PyArrayObject *input, *output, *coordinates;
+    int (*map)(npy_intp*, double*, int, int, void*);
+    void *map_data;
+    Float64 *matrix, *shift;
+    int order, mode;
+    double cval;
+    npy_intp filter_size, *fcoordinates, *foffsets;
+    npy_intp tile_shape[MAXDIM], ntiles[MAXDIM];
+} NI_GeometricTransformData;
+
+/* interpolate the input at the given coordinates: */
+static double NI_InterpolatePoint(NI_GeometricTransformData *gd,
+                                  double *icoor)
+{
+    PyArrayObject *input = gd->input;
+    npy_intp data_offsets[MAXDIM][MAX_SPLINE_ORDER + 1];
+    npy_intp *edge_offsets[MAXDIM], *ff, offset = 0, hh, ll;
+    double splvals[MAXDIM][MAX_SPLINE_ORDER + 1], t = 0.0;
+    char *pi = (void *)PyArray_DATA(input);
+    int irank = input->nd, order = gd->order, edge = 0;
+    int type = NI_CanonicalType(input->descr->type_num);
+
+    /* iterate over axes: */
+    for(hh = 0; hh < irank; hh++) {
+        /* if the input coordinate is outside the borders, map it: */
+        double cc = map_coordinate(icoor[hh], input->dimensions[hh],
+                                   gd->mode);
+        npy_intp stride = input->strides[hh];
+        int start;
+        if (cc <= -1.0) {
+            /* we use the constant border condition: */
+            return gd->cval;
+        }
+        /* find the filter location along this axis: */
+        if (order & 1) {
+            start = (int)floor(cc) - order / 2;
+        } else {
+            start = (int)floor(cc + 0.5) - order / 2;
+        }
+        /* get the offset to the start of the filter: */
+        offset += stride * start;
+        if (start < 0 || start + order >= input->dimensions[hh]) {
+            /* implement border mapping, if outside border: */
+            edge = 1;
+            edge_offsets[hh] = data_offsets[hh];
+            for(ll = 0; ll <= order; ll++) {
+                int idx = start + ll;
+                int len = input->dimensions[hh];
+                if (len <= 1) {
+                    idx = 0;
+                } else {
+                    int s2 = 2 * len - 2;
+                    if (idx < 0) {
+                        idx = s2 * (int)(-idx / s2) + idx;
+                        idx = idx <= 1 - len ? idx + s2 : -idx;
+                    } else if (idx >= len) {
+                        idx -= s2 * (int)(idx / s2);
+                        if (idx >= len)
+                            idx = s2 - idx;
+                    }
+                }
+                /* calculate and store the offests at this edge: */
+                edge_offsets[hh][ll] = stride * (idx - start);
             }
-        } else if (matrix) {
-            /* do an affine transformation: */
-            Float64 *p = matrix;
-            for(hh = 0; hh < irank; hh++) {
-                icoor[hh] = 0.0;
-                for(ll = 0; ll < orank; ll++)
-                    icoor[hh] += io.coordinates[ll] * *p++;
-                icoor[hh] += shift[hh];
+        } else {
+            /* we are not at the border, use precalculated offsets: */
+            edge_offsets[hh] = NULL;
+        }
+        spline_coefficients(cc, order, splvals[hh]);
+    }
+    ff = gd->fcoordinates;
+    for(hh = 0; hh < gd->filter_size; hh++) {
+        npy_intp idx = 0;
+        double coeff = 0.0;
+        if (edge) {
+            for(ll = 0; ll < irank; ll++) {
+                if (edge_offsets[ll])
+                    idx += edge_offsets[ll][ff[ll]];
+                else
+                    idx += ff[ll] * input->strides[ll];
             }
-        } else if (coordinates) {
-            /* mapping is from an coordinates array: */
-            char *p = pc;
-            switch(coordinates->descr->type_num) {
-                CASE_MAP_COORDINATES(p, icoor, irank, cstride, Bool);
-                CASE_MAP_COORDINATES(p, icoor, irank, cstride, UInt8);
-                CASE_MAP_COORDINATES(p, icoor, irank, cstride, UInt16);
-                CASE_MAP_COORDINATES(p, icoor, irank, cstride, UInt32);
+        } else {
+            idx = gd->foffsets[hh];
+        }
+        idx += offset;
+        switch(type) {
+            CASE_INTERP_COEFF(coeff, pi, idx, Bool);
+            CASE_INTERP_COEFF(coeff, pi, idx, UInt8);
+            CASE_INTERP_COEFF(coeff, pi, idx, UInt16);
+            CASE_INTERP_COEFF(coeff, pi, idx, UInt32);
 #if HAS_UINT64
-                CASE_MAP_COORDINATES(p, icoor, irank, cstride, UInt64);
+            CASE_INTERP_COEFF(coeff, pi, idx, UInt64);
 #endif
-                CASE_MAP_COORDINATES(p, icoor, irank, cstride, Int8);
-                CASE_MAP_COORDINATES(p, icoor, irank, cstride, Int16);
-                CASE_MAP_COORDINATES(p, icoor, irank, cstride, Int32);
-                CASE_MAP_COORDINATES(p, icoor, irank, cstride, Int64);
-                CASE_MAP_COORDINATES(p, icoor, irank, cstride, Float32);
-                CASE_MAP_COORDINATES(p, icoor, irank, cstride, Float64);
-            default:
-                PyErr_SetString(PyExc_RuntimeError,
-                                                "coordinate array data type not supported");
-                goto exit;
-            }
+            CASE_INTERP_COEFF(coeff, pi, idx, Int8);
+            CASE_INTERP_COEFF(coeff, pi, idx, Int16);
+            CASE_INTERP_COEFF(coeff, pi, idx, Int32);
+            CASE_INTERP_COEFF(coeff, pi, idx, Int64);
+            CASE_INTERP_COEFF(coeff, pi, idx, Float32);
+            CASE_INTERP_COEFF(coeff, pi, idx, Float64);
+        default:
+            break;
         }
-        /* iterate over axes: */
-        for(hh = 0; hh < irank; hh++) {
-            /* if the input coordinate is outside the borders, map it: */
-            double cc = map_coordinate(icoor[hh], idimensions[hh], mode);
-            if (cc > -1.0) {
-                /* find the filter location along this axis: */
-                int start;
-                if (order & 1) {
-                    start = (int)floor(cc) - order / 2;
-                } else {
-                    start = (int)floor(cc + 0.5) - order / 2;
+        /* calculate the interpolated value: */
+        for(ll = 0; ll < irank; ll++)
+            if (order > 0)
+                coeff *= splvals[ll][ff[ll]];
+        t += coeff;
+        ff += irank;
+    }
+    return t;
+}
+
+/* Transform a range of the tiles of the output. The tiles are numbered
+     in C order and filled row by row, so that the input they map to stays
+     in the cache. Along a row an affine transform only adds the term of
+     the last axis to the sum of the others: */
+static int NI_GeometricTransformRange(void *data, npy_intp first,
+                                      npy_intp count, int thread)
+{
+    NI_GeometricTransformData *gd = (NI_GeometricTransformData*)data;
+    PyArrayObject *output = gd->output, *coordinates = gd->coordinates;
+    npy_intp start[MAXDIM], end[MAXDIM], oc[MAXDIM];
+    npy_intp jj, kk, tmp, cstride = 0;
+    double icoor[MAXDIM], partial[MAXDIM];
+    int irank = gd->input->nd, orank = output->nd, last = orank - 1;
+    int otype = NI_CanonicalType(output->descr->type_num), ctype = 0, hh, ll;
+
+    if (coordinates) {
+        cstride = coordinates->strides[0];
+        ctype = NI_CanonicalType(coordinates->descr->type_num);
+    }
+    for(jj = first; jj < first + count; jj++) {
+        /* find the box of the tile: */
+        tmp = jj;
+        for(ll = last; ll >= 0; ll--) {
+            start[ll] = (tmp % gd->ntiles[ll]) * gd->tile_shape[ll];
+            tmp /= gd->ntiles[ll];
+            end[ll] = start[ll] + gd->tile_shape[ll];
+            if (end[ll] > output->dimensions[ll])
+                end[ll] = output->dimensions[ll];
+            oc[ll] = start[ll];
+        }
+        for(;;) {
+            char *po = (void *)PyArray_DATA(output), *pc = NULL;
+            for(ll = 0; ll < last; ll++)
+                po += oc[ll] * output->strides[ll];
+            po += start[last] * output->strides[last];
+            if (coordinates) {
+                pc = (void *)PyArray_DATA(coordinates);
+                for(ll = 0; ll < last; ll++)
+                    pc += oc[ll] * coordinates->strides[ll + 1];
+                pc += start[last] * coordinates->strides[orank];
+            } else if (gd->matrix) {
+                /* the sum over all axes but the last: */
+                Float64 *p = gd->matrix;
+                for(hh = 0; hh < irank; hh++) {
+                    partial[hh] = 0.0;
+                    for(ll = 0; ll < last; ll++)
+                        partial[hh] += oc[ll] * *p++;
+                    p++;
                 }
-                /* get the offset to the start of the filter: */
-                offset += istrides[hh] * start;
-                if (start < 0 || start + order >= idimensions[hh]) {
-                    /* implement border mapping, if outside border: */
-                    edge = 1;
-                    edge_offsets[hh] = data_offsets[hh];
-                    for(ll = 0; ll <= order; ll++) {
-                        int idx = start + ll;
-                        int len = idimensions[hh];
-                        if (len <= 1) {
-                            idx = 0;
-                        } else {
-                            int s2 = 2 * len - 2;
-                            if (idx < 0) {
-                                idx = s2 * (int)(-idx / s2) + idx;
-                                idx = idx <= 1 - len ? idx + s2 : -idx;
-                            } else if (idx >= len) {
-                                idx -= s2 * (int)(idx / s2);
-                                if (idx >= len)
-                                    idx = s2 - idx;
-                            }
-                        }
-                        /* calculate and store the offests at this edge: */
-                        edge_offsets[hh][ll] = istrides[hh] * (idx - start);
+            }
+            for(kk = start[last]; kk < end[last]; kk++) {
+                oc[last] = kk;
+                if (gd->map) {
+                    /* call mapping functions: */
+                    if (!gd->map(oc, icoor, orank, irank, gd->map_data))
+                        return 0;
+                } else if (gd->matrix) {
+                    /* do an affine transformation: */
+                    for(hh = 0; hh < irank; hh++)
+                        icoor[hh] = partial[hh] +
+                                    kk * gd->matrix[hh * orank + last] +
+                                    gd->shift[hh];
+                } else if (coordinates) {
+                    /* mapping is from an coordinates array: */
+                    char *p = pc;
+                    switch(ctype) {
+                        CASE_MAP_COORDINATES(p, icoor, irank, cstride, Bool);
+                        CASE_MAP_COORDINATES(p, icoor, irank, cstride, UInt8);
+                        CASE_MAP_COORDINATES(p, icoor, irank, cstride, UInt16);
+                        CASE_MAP_COORDINATES(p, icoor, irank, cstride, UInt32);
+#if HAS_UINT64
+                        CASE_MAP_COORDINATES(p, icoor, irank, cstride, UInt64);
+#endif
+                        CASE_MAP_COORDINATES(p, icoor, irank, cstride, Int8);
+                        CASE_MAP_COORDINATES(p, icoor, irank, cstride, Int16);
+                        CASE_MAP_COORDINATES(p, icoor, irank, cstride, Int32);
+                        CASE_MAP_COORDINATES(p, icoor, irank, cstride, Int64);
+                        CASE_MAP_COORDINATES(p, icoor, irank, cstride,
+                                             Float32);
+                        CASE_MAP_COORDINATES(p, icoor, irank, cstride,
+                                             Float64);
+                    default:
+                        break;
                     }
-                } else {
-                    /* we are not at the border, use precalculated offsets: */
-                    edge_offsets[hh] = NULL;
+                    pc += coordinates->strides[orank];
                 }
-                spline_coefficients(cc, order, splvals[hh]);
-            } else {
-                /* we use the constant border condition: */
-                constant = 1;
+                NI_StoreInterpolated(po, otype, NI_InterpolatePoint(gd, icoor));
+                po += output->strides[last];
+            }
+            /* go to the next row of the tile: */
+            for(ll = last - 1; ll >= 0; ll--) {
+                if (++oc[ll] < end[ll])
+                    break;
+                oc[ll] = start[ll];
+            }
+            if (ll < 0)
+                break;
+        }
+    }
+    return 1;
+}
+
+int
+NI_GeometricTransform(PyArrayObject *input, int (*map)(npy_intp*, double*,
+                int, int, void*), void* map_data, PyArrayObject* matrix_ar,
+                PyArrayObject* shift_ar, PyArrayObject *coordinates,
+                PyArrayObject *output, int order, int mode, double cval,
+                int threads)
+{
+    NI_GeometricTransformData gd;
+    npy_intp size, ntiles, tile, jj;
+    int orank = output->nd, axes, ll;
+
+    gd.input = input;
+    gd.output = output;
+    gd.coordinates = coordinates;
+    gd.map = map;
+    gd.map_data = map_data;
+    gd.matrix = matrix_ar ? (Float64*)PyArray_DATA(matrix_ar) : NULL;
+    gd.shift = shift_ar ? (Float64*)PyArray_DATA(shift_ar) : NULL;
+    gd.order = order;
+    gd.mode = mode;
+    gd.cval = cval;
+    gd.fcoordinates = NULL;
+    gd.foffsets = NULL;
+
+    if (order < 0 || order > MAX_SPLINE_ORDER) {
+        PyErr_SetString(PyExc_RuntimeError, "spline order not supported");
+        goto exit;
+    }
+    /* the types are checked here, the threads can not set errors: */
+    if (!NI_CheckInterpolationType(input) ||
+            !NI_CheckInterpolationType(output))
+        goto exit;
+    if (coordinates && !NI_CheckInterpolationType(coordinates)) {
+        PyErr_Clear();
+        PyErr_SetString(PyExc_RuntimeError,
+                        "coordinate array data type not supported");
+        goto exit;
+    }
+
+    gd.filter_size = 1;
+    for(jj = 0; jj < input->nd; jj++)
+        gd.filter_size *= order + 1;
+    if (!NI_InitSplineOffsets(input->nd, input->strides, order,
+                              gd.filter_size, &gd.fcoordinates, &gd.foffsets))
+        goto exit;
+
+    /* the tiles are cubes over the last three axes at most: */
+    axes = orank < 3 ? orank : 3;
+    tile = axes == 1 ? INTERP_TILE_SIZE : axes == 2 ? 64 : 16;
+    size = 1;
+    ntiles = 1;
+    for(ll = 0; ll < orank; ll++) {
+        gd.tile_shape[ll] = ll < orank - axes ? 1 : tile;
+        gd.ntiles[ll] = (output->dimensions[ll] + gd.tile_shape[ll] - 1) /
+                        gd.tile_shape[ll];
+        size *= output->dimensions[ll];
+        ntiles *= gd.ntiles[ll];
+    }
+
+    if (size > 0 && !NI_RunThreads(ntiles, threads,
+                                   NI_GeometricTransformRange, &gd)
+            && !PyErr_Occurred())
+        PyErr_SetString(PyExc_RuntimeError,
+                        "unknown error in mapping function");
+
+ exit:
+    if (gd.foffsets)
+        free(gd.foffsets);
+    if (gd.fcoordinates)
+        free(gd.fcoordinates);
+    return PyErr_Occurred() ? 0 : 1;
+}
+
+typedef struct {
+    PyArrayObject *input, *output;
+    int order;
+    double cval;
+    npy_intp **zeros, **offsets, ***edge_offsets, filter_size;
+    npy_intp *fcoordinates, *foffsets;
+    double ***splvals;
+    NI_Iterator io;
+} NI_ZoomShiftData;
+
+/* Zoom or shift a range of the output elements, in C order. The offsets
+     and the spline coefficients along each axis were computed for each
+     output coordinate before: */
+static int NI_ZoomShiftRange(void *data, npy_intp first, npy_intp count,
+                             int thread)
+{
+    NI_ZoomShiftData *zd = (NI_ZoomShiftData*)data;
+    PyArrayObject *input = zd->input, *output = zd->output;
+    NI_Iterator io = zd->io;
+    npy_intp coordinates[MAXDIM], kk, hh, jj, tmp = first;
+    npy_intp **zeros = zd->zeros, **offsets = zd->offsets;
+    npy_intp ***edge_offsets = zd->edge_offsets;
+    double ***splvals = zd->splvals;
+    char *pi = (void *)PyArray_DATA(input), *po;
+    int rank = input->nd, order = zd->order;
+    int itype = NI_CanonicalType(input->descr->type_num);
+    int otype = NI_CanonicalType(output->descr->type_num);
+
+    for(jj = rank - 1; jj >= 0; jj--) {
+        coordinates[jj] = tmp % output->dimensions[jj];
+        tmp /= output->dimensions[jj];
+    }
+    NI_ITERATOR_GOTO(io, coordinates, (char*)PyArray_DATA(output), po);
+    for(kk = 0; kk < count; kk++) {
+        double t = 0.0;
+        int edge = 0, zero = 0;
+        npy_intp oo = 0;
+
+        for(hh = 0; hh < rank; hh++) {
+            if (zeros && zeros[hh][io.coordinates[hh]]) {
+                /* we use constant border condition */
+                zero = 1;
                 break;
             }
+            oo += offsets[hh][io.coordinates[hh]];
+            if (edge_offsets[hh][io.coordinates[hh]])
+                edge = 1;
         }
 
-        if (!constant) {
-            npy_intp *ff = fcoordinates;
-            for(hh = 0; hh < filter_size; hh++) {
-                int idx = 0;
+        if (!zero) {
+            npy_intp *ff = zd->fcoordinates;
+            for(hh = 0; hh < zd->filter_size; hh++) {
+                npy_intp idx = 0;
+                double coeff = 0.0;
                 if (edge) {
-                    for(ll = 0; ll < irank; ll++) {
-                        if (edge_offsets[ll])
-                            idx += edge_offsets[ll][ff[ll]];
+                    /* use precalculated edge offsets: */
+                    for(jj = 0; jj < rank; jj++) {
+                        if (edge_offsets[jj][io.coordinates[jj]])
+                            idx += edge_offsets[jj][io.coordinates[jj]][ff[jj]];
                         else
-                            idx += ff[ll] * istrides[ll];
+                            idx += ff[jj] * input->strides[jj];
                     }
+                    idx += oo;
                 } else {
-                    idx = foffsets[hh];
+                    /* use normal offsets: */
+                    idx += oo + zd->foffsets[hh];
                 }
-                idx += offset;
-                idxs[hh] = idx;
-                ff += irank;
-            }
-        }
-        if (!constant) {
-            npy_intp *ff = fcoordinates;
-            t = 0.0;
-            for(hh = 0; hh < filter_size; hh++) {
-                double coeff = 0.0;
-                switch(input->descr->type_num) {
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Bool);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], UInt8);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], UInt16);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], UInt32);
+                switch(itype) {
+                    CASE_INTERP_COEFF(coeff, pi, idx, Bool);
+                    CASE_INTERP_COEFF(coeff, pi, idx, UInt8);
+                    CASE_INTERP_COEFF(coeff, pi, idx, UInt16);
+                    CASE_INTERP_COEFF(coeff, pi, idx, UInt32);
 #if HAS_UINT64
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], UInt64);
+                    CASE_INTERP_COEFF(coeff, pi, idx, UInt64);
 #endif
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Int8);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Int16);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Int32);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Int64);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Float32);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Float64);
+                    CASE_INTERP_COEFF(coeff, pi, idx, Int8);
+                    CASE_INTERP_COEFF(coeff, pi, idx, Int16);
+                    CASE_INTERP_COEFF(coeff, pi, idx, Int32);
+                    CASE_INTERP_COEFF(coeff, pi, idx, Int64);
+                    CASE_INTERP_COEFF(coeff, pi, idx, Float32);
+                    CASE_INTERP_COEFF(coeff, pi, idx, Float64);
                 default:
-                    PyErr_SetString(PyExc_RuntimeError,
-                                                    "data type not supported");
-                    goto exit;
+                    break;
                 }
-                /* calculate the interpolated value: */
-                for(ll = 0; ll < irank; ll++)
+                /* calculate interpolated value: */
+                for(jj = 0; jj < rank; jj++)
                     if (order > 0)
-                        coeff *= splvals[ll][ff[ll]];
+                        coeff *= splvals[jj][io.coordinates[jj]][ff[jj]];
                 t += coeff;
-                ff += irank;
+                ff += rank;
             }
         } else {
-            t = cval;
+            t = zd->cval;
         }
-        /* store output value: */
-        switch (output->descr->type_num) {
-            CASE_INTERP_OUT(po, t, Bool);
-            CASE_INTERP_OUT_UINT(po, t, UInt8, 0, MAX_UINT8);
-            CASE_INTERP_OUT_UINT(po, t, UInt16, 0, MAX_UINT16);
-            CASE_INTERP_OUT_UINT(po, t, UInt32, 0, MAX_UINT32);
-#if HAS_UINT64
-            /* FIXME */
-            CASE_INTERP_OUT_UINT(po, t, UInt64, 0, MAX_UINT32);
-#endif
-            CASE_INTERP_OUT_INT(po, t, Int8, MIN_INT8, MAX_INT8);
-            CASE_INTERP_OUT_INT(po, t, Int16, MIN_INT16, MAX_INT16);
-            CASE_INTERP_OUT_INT(po, t, Int32, MIN_INT32, MAX_INT32);
-            CASE_INTERP_OUT_INT(po, t, Int64, MIN_INT64, MAX_INT64);
-            CASE_INTERP_OUT(po, t, Float32);
-            CASE_INTERP_OUT(po, t, Float64);
-        default:
-            PyErr_SetString(PyExc_RuntimeError, "data type not supported");
-            goto exit;
-        }
-        if (coordinates) {
-            NI_ITERATOR_NEXT2(io, ic, po, pc);
-        } else {
-            NI_ITERATOR_NEXT(io, po);
-        }
-    }
-
- exit:
-    if (edge_offsets)
-        free(edge_offsets);
-    if (data_offsets) {
-        for(jj = 0; jj < irank; jj++)
-            free(data_offsets[jj]);
-        free(data_offsets);
-    }
-    if (splvals) {
-        for(jj = 0; jj < irank; jj++)
-            free(splvals[jj]);
-        free(splvals);
+        /* store output: */
+        NI_StoreInterpolated(po, otype, t);
+        NI_ITERATOR_NEXT(io, po);
     }
-    if (foffsets)
-        free(foffsets);
-    if (fcoordinates)
-        free(fcoordinates);
-    if (idxs)
-        free(idxs);
-    return PyErr_Occurred() ? 0 : 1;
+    return 1;
 }
 
 int NI_ZoomShift(PyArrayObject *input, PyArrayObject* zoom_ar,
                                  PyArrayObject* shift_ar, PyArrayObject *output,
-                                 int order, int mode, double cval)
+                                 int order, int mode, double cval, int threads)
 {
-    char *po, *pi;
     npy_intp **zeros = NULL, **offsets = NULL, ***edge_offsets = NULL;
-    npy_intp ftmp[MAXDIM], *fcoordinates = NULL, *foffsets = NULL;
     npy_intp jj, hh, kk, filter_size, odimensions[MAXDIM];
-    npy_intp idimensions[MAXDIM], istrides[MAXDIM], *idxs = NULL;
+    npy_intp idimensions[MAXDIM], istrides[MAXDIM];
     npy_intp size;
     double ***splvals = NULL;
-    NI_Iterator io;
+    NI_ZoomShiftData zd;
     Float64 *zooms = zoom_ar ? (Float64*)PyArray_DATA(zoom_ar) : NULL;
     Float64 *shifts = shift_ar ? (Float64*)PyArray_DATA(shift_ar) : NULL;
     int rank = 0, qq;
 
+    zd.fcoordinates = NULL;
+    zd.foffsets = NULL;
     for(kk = 0; kk < input->nd; kk++) {
         idimensions[kk] = input->dimensions[kk];
         istrides[kk] = input->strides[kk];
@@ -676,6 +841,11 @@ int NI_ZoomShift(PyArrayObject *input, PyArrayObject* zoom_ar,
     }
     rank = input->nd;
 
+    /* the types are checked here, the threads can not set errors: */
+    if (!NI_CheckInterpolationType(input) ||
+            !NI_CheckInterpolationType(output))
+        goto exit;
+
     /* if the mode is 'constant' we need some temps later: */
     if (mode == NI_EXTEND_CONSTANT) {
         zeros = (npy_intp**)malloc(rank * sizeof(npy_intp*));
@@ -789,139 +959,26 @@ int NI_ZoomShift(PyArrayObject *input, PyArrayObject* zoom_ar,
     filter_size = 1;
     for(jj = 0; jj < rank; jj++)
         filter_size *= order + 1;
-    idxs = (npy_intp*)malloc(filter_size * sizeof(idxs));
-    if (!idxs) {
-        PyErr_NoMemory();
-        goto exit;
-    }
-
-    if (!NI_InitPointIterator(output, &io))
+    if (!NI_InitSplineOffsets(rank, istrides, order, filter_size,
+                              &zd.fcoordinates, &zd.foffsets))
         goto exit;
-
-    pi = (void *)PyArray_DATA(input);
-    po = (void *)PyArray_DATA(output);
-
-    /* store all coordinates and offsets with filter: */
-    fcoordinates = (npy_intp*)malloc(rank * filter_size * sizeof(npy_intp));
-    foffsets = (npy_intp*)malloc(filter_size * sizeof(npy_intp));
-    if (!fcoordinates || !foffsets) {
-        PyErr_NoMemory();
+    if (!NI_InitPointIterator(output, &zd.io))
         goto exit;
-    }
 
-    for(jj = 0; jj < rank; jj++)
-        ftmp[jj] = 0;
-    kk = 0;
-    for(hh = 0; hh < filter_size; hh++) {
-        for(jj = 0; jj < rank; jj++)
-            fcoordinates[jj + hh * rank] = ftmp[jj];
-        foffsets[hh] = kk;
-        for(jj = rank - 1; jj >= 0; jj--) {
-            if (ftmp[jj] < order) {
-                ftmp[jj]++;
-                kk += istrides[jj];
-                break;
-            } else {
-                ftmp[jj] = 0;
-                kk -= istrides[jj] * order;
-            }
-        }
-    }
+    zd.input = input;
+    zd.output = output;
+    zd.order = order;
+    zd.cval = cval;
+    zd.zeros = zeros;
+    zd.offsets = offsets;
+    zd.edge_offsets = edge_offsets;
+    zd.splvals = splvals;
+    zd.filter_size = filter_size;
     size = 1;
     for(qq = 0; qq < output->nd; qq++)
         size *= output->dimensions[qq];
-    for(kk = 0; kk < size; kk++) {
-        double t = 0.0;
-        int edge = 0, oo = 0, zero = 0;
-
-        for(hh = 0; hh < rank; hh++) {
-            if (zeros && zeros[hh][io.coordinates[hh]]) {
-                /* we use constant border condition */
-                zero = 1;
-                break;
-            }
-            oo += offsets[hh][io.coordinates[hh]];
-            if (edge_offsets[hh][io.coordinates[hh]])
-                edge = 1;
-        }
-
-        if (!zero) {
-            npy_intp *ff = fcoordinates;
-            for(hh = 0; hh < filter_size; hh++) {
-                int idx = 0;
-                if (edge) {
-                        /* use precalculated edge offsets: */
-                    for(jj = 0; jj < rank; jj++) {
-                        if (edge_offsets[jj][io.coordinates[jj]])
-                            idx += edge_offsets[jj][io.coordinates[jj]][ff[jj]];
-                        else
-                            idx += ff[jj] * istrides[jj];
-                    }
-                    idx += oo;
-                } else {
-                    /* use normal offsets: */
-                    idx += oo + foffsets[hh];
-                }
-                idxs[hh] = idx;
-                ff += rank;
-            }
-        }
-        if (!zero) {
-            npy_intp *ff = fcoordinates;
-            t = 0.0;
-            for(hh = 0; hh < filter_size; hh++) {
-                double coeff = 0.0;
-                switch(input->descr->type_num) {
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Bool);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], UInt8);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], UInt16);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], UInt32);
-#if HAS_UINT64
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], UInt64);
-#endif
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Int8);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Int16);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Int32);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Int64);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Float32);
-                    CASE_INTERP_COEFF(coeff, pi, idxs[hh], Float64);
-                default:
-                    PyErr_SetString(PyExc_RuntimeError,
-                                                    "data type not supported");
-                    goto exit;
-                }
-                /* calculate interpolated value: */
-                for(jj = 0; jj < rank; jj++)
-                    if (order > 0)
-                        coeff *= splvals[jj][io.coordinates[jj]][ff[jj]];
-                t += coeff;
-                ff += rank;
-            }
-        } else {
-            t = cval;
-        }
-        /* store output: */
-        switch (output->descr->type_num) {
-            CASE_INTERP_OUT(po, t, Bool);
-            CASE_INTERP_OUT_UINT(po, t, UInt8, 0, MAX_UINT8);
-            CASE_INTERP_OUT_UINT(po, t, UInt16, 0, MAX_UINT16);
-            CASE_INTERP_OUT_UINT(po, t, UInt32, 0, MAX_UINT32);
-#if HAS_UINT64
-            /* FIXME */
-            CASE_INTERP_OUT_UINT(po, t, UInt64, 0, MAX_UINT32);
-#endif
-            CASE_INTERP_OUT_INT(po, t, Int8, MIN_INT8, MAX_INT8);
-            CASE_INTERP_OUT_INT(po, t, Int16, MIN_INT16, MAX_INT16);
-            CASE_INTERP_OUT_INT(po, t, Int32, MIN_INT32, MAX_INT32);
-            CASE_INTERP_OUT_INT(po, t, Int64, MIN_INT64, MAX_INT64);
-            CASE_INTERP_OUT(po, t, Float32);
-            CASE_INTERP_OUT(po, t, Float64);
-        default:
-            PyErr_SetString(PyExc_RuntimeError, "data type not supported");
-            goto exit;
-        }
-        NI_ITERATOR_NEXT(io, po);
-    }
+    if (size > 0)
+        NI_RunThreads(size, threads, NI_ZoomShiftRange, &zd);
 
  exit:
     if (zeros) {
@@ -958,11 +1015,9 @@ int NI_ZoomShift(PyArrayObject *input, PyArrayObject* zoom_ar,
         }
         free(edge_offsets);
     }
-    if (foffsets)
-        free(foffsets);
-    if (fcoordinates)
-        free(fcoordinates);
-    if (idxs)
-        free(idxs);
+    if (zd.foffsets)
+        free(zd.foffsets);
+    if (zd.fcoordinates)
+        free(zd.fcoordinates);
     return PyErr_Occurred() ? 0 : 1;
 }
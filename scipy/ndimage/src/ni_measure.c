@@ -35,219 +35,484 @@
 #include <math.h>
 #include <float.h>
 #include <assert.h>
+#include <string.h>
 
+/* The labeling works on lines along the last axis. A first pass labels
+     slabs of rows along the first axis in parallel, each with its own
+     union-find forest. The forests are then joined, the labels at the
+     seams between slabs are merged, and a final parallel pass writes
+     the final labels and, optionally, the object regions: */
 typedef struct {
-    Int32 index1, index2;
-    void* next;
-} _index_pair;
+    PyArrayObject *input, *output;
+    int rank, wide, type, error, slabs;
+    npy_intp length, lines, row_lines, neighbors, *deltas, *offsets;
+    npy_intp istride, ostride, *work, *map, *row_base;
+    npy_intp slab_first[NI_MAX_THREADS], slab_rows[NI_MAX_THREADS];
+    npy_intp slab_labels[NI_MAX_THREADS], *parents[NI_MAX_THREADS];
+    npy_intp *regions[NI_MAX_THREADS], max_label;
+    Bool *masks;
+} NI_LabelData;
 
-#define CASE_LABEL(_p, _pi, _type) \
-case t ## _type:                   \
-    *_p = *(_type*)_pi ? -1 : 0;     \
-    break
+#define NI_LABEL_NO_MEMORY 1
+#define NI_LABEL_OVERFLOW 2
 
-int NI_Label(PyArrayObject* input, PyArrayObject* strct,
-                         npy_intp *max_label, PyArrayObject* output)
+#define NI_LOAD_LABEL(_po, _wide) \
+    ((_wide) ? (npy_intp)*(Int64*)(_po) : (npy_intp)*(Int32*)(_po))
+
+#define NI_STORE_LABEL(_po, _wide, _label) \
+{                                          \
+    if (_wide)                             \
+        *(Int64*)(_po) = (Int64)(_label);  \
+    else                                   \
+        *(Int32*)(_po) = (Int32)(_label);  \
+}
+
+#define CASE_LABEL_MASK(_pi, _stride, _mask, _length, _type) \
+case t ## _type:                                             \
+{                                                            \
+    npy_intp _ii;                                            \
+    for(_ii = 0; _ii < _length; _ii++)                       \
+        _mask[_ii] = *(_type*)(_pi + _ii * _stride) != 0;    \
+}                                                            \
+break
+
+/* Find the root of a label, halving the path to it: */
+static npy_intp NI_FindRoot(npy_intp *parents, npy_intp label)
 {
-    int kk;
-    npy_intp jj, ll, ssize, size, filter_size, *offsets = NULL;
-    npy_intp mask_value, *oo;
-    Bool *ps, *footprint = NULL;
+    while (parents[label] != label) {
+        parents[label] = parents[parents[label]];
+        label = parents[label];
+    }
+    return label;
+}
+
+/* Merge the sets of two labels. The smallest root becomes the root, so
+     that a label never points to a larger label: */
+static npy_intp NI_MergeLabels(npy_intp *parents, npy_intp label1,
+                               npy_intp label2)
+{
+    label1 = NI_FindRoot(parents, label1);
+    label2 = NI_FindRoot(parents, label2);
+    if (label1 < label2) {
+        parents[label2] = label1;
+        return label1;
+    }
+    parents[label1] = label2;
+    return label2;
+}
+
+/* Get the pointers to a line and its first coordinates, and find the
+     neighbours that lie inside the array, and in rows from first_row
+     on. If seam is true, only neighbours in the previous row are used: */
+static npy_intp NI_LabelLine(NI_LabelData *ld, npy_intp line,
+                             npy_intp first_row, int seam, char **pi,
+                             char **po, npy_intp *coordinates,
+                             npy_intp *offsets, npy_intp *deltas)
+{
+    npy_intp kk, count = 0;
+    int ll, rank = ld->rank;
+
+    *pi = (void *)PyArray_DATA(ld->input);
+    *po = (void *)PyArray_DATA(ld->output);
+    for(ll = rank - 2; ll >= 0; ll--) {
+        coordinates[ll] = line % ld->input->dimensions[ll];
+        line /= ld->input->dimensions[ll];
+        *pi += coordinates[ll] * ld->input->strides[ll];
+        *po += coordinates[ll] * ld->output->strides[ll];
+    }
+    if (!offsets)
+        return 0;
+    for(kk = 0; kk < ld->neighbors; kk++) {
+        npy_intp *dd = ld->deltas + kk * rank;
+        int inside = !seam || dd[0] < 0;
+        for(ll = 0; ll < rank - 1 && inside; ll++) {
+            npy_intp cc = coordinates[ll] + dd[ll];
+            if (cc < 0 || cc >= ld->input->dimensions[ll])
+                inside = 0;
+        }
+        if (inside && rank > 1 && coordinates[0] + dd[0] < first_row)
+            inside = 0;
+        if (inside) {
+            offsets[count] = ld->offsets[kk];
+            deltas[count] = dd[rank - 1];
+            ++count;
+        }
+    }
+    return count;
+}
+
+/* Label a slab of rows, with labels that are local to the slab: */
+static int NI_LabelSlab(void *data, npy_intp first, npy_intp count,
+                        int thread)
+{
+    NI_LabelData *ld = (NI_LabelData*)data;
+    npy_intp *offsets = ld->work + 2 * thread * ld->neighbors;
+    npy_intp *deltas = offsets + ld->neighbors, coordinates[NI_MAXDIM];
+    npy_intp line, jj, kk, nn, labels = 0, size = 0, *parents = NULL;
+    npy_intp max_label = ld->wide ? NPY_MAX_INT64 : NPY_MAX_INT32;
+    Bool *mask = ld->masks + thread * ld->length;
+    char *pi, *po;
+
+    ld->slab_first[thread] = first;
+    ld->slab_rows[thread] = count;
+    for(line = first * ld->row_lines; line < (first + count) * ld->row_lines;
+        line++) {
+        nn = NI_LabelLine(ld, line, first, 0, &pi, &po, coordinates,
+                          offsets, deltas);
+        switch (ld->type) {
+        CASE_LABEL_MASK(pi, ld->istride, mask, ld->length, Bool);
+        CASE_LABEL_MASK(pi, ld->istride, mask, ld->length, UInt8);
+        CASE_LABEL_MASK(pi, ld->istride, mask, ld->length, UInt16);
+        CASE_LABEL_MASK(pi, ld->istride, mask, ld->length, UInt32);
+#if HAS_UINT64
+        CASE_LABEL_MASK(pi, ld->istride, mask, ld->length, UInt64);
+#endif
+        CASE_LABEL_MASK(pi, ld->istride, mask, ld->length, Int8);
+        CASE_LABEL_MASK(pi, ld->istride, mask, ld->length, Int16);
+        CASE_LABEL_MASK(pi, ld->istride, mask, ld->length, Int32);
+        CASE_LABEL_MASK(pi, ld->istride, mask, ld->length, Int64);
+        CASE_LABEL_MASK(pi, ld->istride, mask, ld->length, Float32);
+        CASE_LABEL_MASK(pi, ld->istride, mask, ld->length, Float64);
+        default:
+            break;
+        }
+        for(jj = 0; jj < ld->length; jj++, po += ld->ostride) {
+            npy_intp label = 0;
+            if (!mask[jj]) {
+                NI_STORE_LABEL(po, ld->wide, 0);
+                continue;
+            }
+            for(kk = 0; kk < nn; kk++) {
+                npy_intp tt;
+                if ((deltas[kk] < 0 && jj == 0) ||
+                    (deltas[kk] > 0 && jj == ld->length - 1))
+                    continue;
+                tt = NI_LOAD_LABEL(po + offsets[kk], ld->wide);
+                if (tt > 0) {
+                    if (!label)
+                        label = tt;
+                    else if (tt != label)
+                        label = NI_MergeLabels(parents, label, tt);
+                }
+            }
+            if (!label) {
+                /* this may be a new object: */
+                if (labels >= max_label) {
+                    ld->error = NI_LABEL_OVERFLOW;
+                    goto exit;
+                }
+                if (labels + 1 >= size) {
+                    npy_intp *tmp;
+                    size = size ? 2 * size : 1024;
+                    tmp = (npy_intp*)realloc(parents, size * sizeof(npy_intp));
+                    if (!tmp) {
+                        ld->error = NI_LABEL_NO_MEMORY;
+                        goto exit;
+                    }
+                    parents = tmp;
+                }
+                label = ++labels;
+                parents[label] = label;
+            }
+            NI_STORE_LABEL(po, ld->wide, label);
+        }
+    }
+    /* labels point to smaller labels, so one pass finds all roots: */
+    for(jj = 1; jj <= labels; jj++)
+        parents[jj] = parents[parents[jj]];
+exit:
+    ld->parents[thread] = parents;
+    ld->slab_labels[thread] = labels;
+    return ld->error ? 0 : 1;
+}
+
+/* Write the final labels of a range of rows, and find the regions of
+     the objects in them: */
+static int NI_LabelRelabel(void *data, npy_intp first, npy_intp count,
+                           int thread)
+{
+    NI_LabelData *ld = (NI_LabelData*)data;
+    npy_intp line, jj, coordinates[NI_MAXDIM], *regions = ld->regions[thread];
+    int ll, rank = ld->rank;
     char *pi, *po;
-    Int32 index = 0, *index_map = NULL;
-    NI_FilterIterator fi;
-    NI_Iterator ii, io;
-    _index_pair *pairs = NULL;
 
-    /* structure size */
+    for(line = first * ld->row_lines; line < (first + count) * ld->row_lines;
+        line++) {
+        npy_intp base;
+        NI_LabelLine(ld, line, 0, 0, &pi, &po, coordinates, NULL, NULL);
+        base = ld->row_base[rank > 1 ? coordinates[0] : 0];
+        for(jj = 0; jj < ld->length; jj++, po += ld->ostride) {
+            npy_intp label = NI_LOAD_LABEL(po, ld->wide), *pr;
+            if (label <= 0)
+                continue;
+            label = ld->map[base + label];
+            NI_STORE_LABEL(po, ld->wide, label);
+            if (!regions)
+                continue;
+            if (rank == 0) {
+                regions[label - 1] = 1;
+                continue;
+            }
+            coordinates[rank - 1] = jj;
+            pr = regions + 2 * rank * (label - 1);
+            if (pr[0] < 0) {
+                for(ll = 0; ll < rank; ll++) {
+                    pr[ll] = coordinates[ll];
+                    pr[ll + rank] = coordinates[ll] + 1;
+                }
+            } else {
+                for(ll = 0; ll < rank; ll++) {
+                    if (coordinates[ll] < pr[ll])
+                        pr[ll] = coordinates[ll];
+                    if (coordinates[ll] + 1 > pr[ll + rank])
+                        pr[ll + rank] = coordinates[ll] + 1;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+int NI_Label(PyArrayObject* input, PyArrayObject* strct,
+             npy_intp *max_label, PyArrayObject* output, int threads,
+             npy_intp **regions)
+{
+    NI_LabelData ld;
+    npy_intp jj, kk, ssize, rows, total, rsize = 0, *map = NULL;
+    npy_intp coordinates[NI_MAXDIM];
+    int ll, tt, rank = input->nd;
+    Bool *ps;
+
+    ld.input = input;
+    ld.output = output;
+    ld.rank = rank;
+    ld.error = 0;
+    ld.deltas = ld.offsets = ld.work = ld.row_base = NULL;
+    ld.masks = NULL;
+    ld.max_label = 0;
+    for(tt = 0; tt < NI_MAX_THREADS; tt++) {
+        ld.parents[tt] = ld.regions[tt] = NULL;
+        ld.slab_labels[tt] = ld.slab_rows[tt] = 0;
+    }
+    if (regions)
+        *regions = NULL;
+    ld.type = NI_CanonicalType(input->descr->type_num);
+    switch (ld.type) {
+    case tBool:
+    case tUInt8:
+    case tUInt16:
+    case tUInt32:
+#if HAS_UINT64
+    case tUInt64:
+#endif
+    case tInt8:
+    case tInt16:
+    case tInt32:
+    case tInt64:
+    case tFloat32:
+    case tFloat64:
+        break;
+    default:
+        PyErr_SetString(PyExc_RuntimeError, "data type not supported");
+        goto exit;
+    }
+    switch (NI_CanonicalType(output->descr->type_num)) {
+    case tInt32:
+        ld.wide = 0;
+        break;
+    case tInt64:
+        ld.wide = 1;
+        break;
+    default:
+        PyErr_SetString(PyExc_RuntimeError, "output type must be int32 or int64");
+        goto exit;
+    }
+    /* lines along the last axis, grouped in rows along the first axis: */
+    ld.length = rank > 0 ? input->dimensions[rank - 1] : 1;
+    ld.istride = rank > 0 ? input->strides[rank - 1] : 0;
+    ld.ostride = rank > 0 ? output->strides[rank - 1] : 0;
+    ld.lines = ld.row_lines = 1;
+    for(ll = 0; ll < rank - 1; ll++) {
+        ld.lines *= input->dimensions[ll];
+        if (ll > 0)
+            ld.row_lines *= input->dimensions[ll];
+    }
+    rows = rank > 1 ? input->dimensions[0] : 1;
+    if (ld.length == 0 || ld.lines == 0) {
+        *max_label = 0;
+        goto exit;
+    }
+    /* the neighbours are given by the first half of the structure: */
     ssize = 1;
-    for(kk = 0; kk < strct->nd; kk++)
-        ssize *= strct->dimensions[kk];
-    /* we only use the first half of the structure data, so we make a
-         temporary structure for use with the filter functions: */
-    footprint = (Bool*)malloc(ssize * sizeof(Bool));
-    if (!footprint) {
+    for(ll = 0; ll < strct->nd; ll++)
+        ssize *= strct->dimensions[ll];
+    ld.deltas = (npy_intp*)malloc((rank > 0 ? rank : 1) * (ssize / 2 + 1) *
+                                  sizeof(npy_intp));
+    ld.offsets = (npy_intp*)malloc((ssize / 2 + 1) * sizeof(npy_intp));
+    if (!ld.deltas || !ld.offsets) {
         PyErr_NoMemory();
         goto exit;
     }
     ps = (Bool*)PyArray_DATA(strct);
-    filter_size = 0;
+    ld.neighbors = 0;
     for(jj = 0; jj < ssize / 2; jj++) {
-        footprint[jj] = ps[jj];
-        if (ps[jj])
-            ++filter_size;
+        npy_intp idx = jj, *dd = ld.deltas + ld.neighbors * rank;
+        if (!ps[jj])
+            continue;
+        ld.offsets[ld.neighbors] = 0;
+        for(ll = rank - 1; ll >= 0; ll--) {
+            dd[ll] = idx % strct->dimensions[ll] - strct->dimensions[ll] / 2;
+            idx /= strct->dimensions[ll];
+            ld.offsets[ld.neighbors] += dd[ll] * output->strides[ll];
+        }
+        ++ld.neighbors;
     }
-    for(jj = ssize / 2; jj < ssize; jj++)
-        footprint[jj] = 0;
-    /* get data and size */
-    pi = (void *)PyArray_DATA(input);
-    po = (void *)PyArray_DATA(output);
-    size = 1;
-    for(kk = 0; kk < output->nd; kk++)
-        size *= output->dimensions[kk];
-    if (!NI_InitPointIterator(input, &ii))
-        goto exit;
-    if (!NI_InitPointIterator(output, &io))
+    /* one slab of rows for each thread: */
+    if (threads > NI_MAX_THREADS)
+        threads = NI_MAX_THREADS;
+    if (threads > rows)
+        threads = (int)rows;
+    if (threads < 1)
+        threads = 1;
+    ld.slabs = threads;
+    ld.work = (npy_intp*)malloc(2 * threads * (ld.neighbors + 1) *
+                                sizeof(npy_intp));
+    ld.masks = (Bool*)malloc(threads * ld.length * sizeof(Bool));
+    if (!ld.work || !ld.masks) {
+        PyErr_NoMemory();
         goto exit;
-    /* set all elements in the output corresponding to non-zero elements
-         in input to -1: */
-    for(jj = 0; jj < size; jj++) {
-        Int32 *p = (Int32*)po;
-        switch (input->descr->type_num) {
-        CASE_LABEL(p, pi, Bool);
-        CASE_LABEL(p, pi, UInt8);
-        CASE_LABEL(p, pi, UInt16);
-        CASE_LABEL(p, pi, UInt32);
-#if HAS_UINT64
-        CASE_LABEL(p, pi, UInt64);
-#endif
-        CASE_LABEL(p, pi, Int8);
-        CASE_LABEL(p, pi, Int16);
-        CASE_LABEL(p, pi, Int32);
-        CASE_LABEL(p, pi, Int64);
-        CASE_LABEL(p, pi, Float32);
-        CASE_LABEL(p, pi, Float64);
-        default:
-            PyErr_SetString(PyExc_RuntimeError, "data type not supported");
-            goto exit;
-        }
-        NI_ITERATOR_NEXT2(ii, io, pi, po);
     }
-
-    /* calculate the filter offsets: */
-    if (!NI_InitFilterOffsets(output, footprint, strct->dimensions, NULL,
-                                                    NI_EXTEND_CONSTANT, &offsets, &mask_value, NULL))
+    NI_RunThreads(rows, threads, NI_LabelSlab, &ld);
+    if (ld.error)
         goto exit;
-    /* initialize filter iterator: */
-    if (!NI_InitFilterIterator(input->nd, strct->dimensions, filter_size,
-                                                                                     input->dimensions, NULL, &fi))
+    /* join the forests of the slabs, with labels numbered in the order
+         of the slabs: */
+    ld.row_base = (npy_intp*)malloc(rows * sizeof(npy_intp));
+    if (!ld.row_base) {
+        PyErr_NoMemory();
         goto exit;
-    /* reset output iterator: */
-    NI_ITERATOR_RESET(io);
-    po = (void *)PyArray_DATA(output);
-    /* iterator over the elements: */
-    oo = offsets;
-    for(jj = 0; jj < size; jj++) {
-        if (*(Int32*)po < 0) {
-            Int32 neighbor = 0;
-            /* iterate over structuring element: */
-            for(ll = 0; ll < filter_size; ll++) {
-                int offset = oo[ll];
-                if (offset != mask_value) {
-                    Int32 tt = *(Int32*)(po + offset);
-                    if (tt > 0) {
-                        /* this element is next to an already found object: */
-                        if (neighbor && neighbor != tt) {
-                            /* we have two objects that must be merged later: */
-                            _index_pair* tp = (_index_pair*)malloc(sizeof(_index_pair));
-                            if (!tp) {
-                                PyErr_NoMemory();
-                                goto exit;
-                            }
-                            tp->next = pairs;
-                            /* the pairs must be ordered: */
-                            if (neighbor < tt) {
-                                tp->index1 = neighbor;
-                                tp->index2 = tt;
-                            } else {
-                                tp->index1 = tt;
-                                tp->index2 = neighbor;
-                            }
-                            pairs = tp;
-                        } else {
-                            neighbor = tt;
-                        }
-                    }
+    }
+    total = 0;
+    for(tt = 0; tt < ld.slabs; tt++) {
+        for(jj = 0; jj < ld.slab_rows[tt]; jj++)
+            ld.row_base[ld.slab_first[tt] + jj] = total;
+        total += ld.slab_labels[tt];
+    }
+    map = (npy_intp*)malloc((total + 1) * sizeof(npy_intp));
+    if (!map) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+    map[0] = 0;
+    for(tt = 0; tt < ld.slabs; tt++) {
+        npy_intp base = ld.row_base[ld.slab_first[tt]];
+        for(jj = 1; jj <= ld.slab_labels[tt]; jj++)
+            map[base + jj] = base + ld.parents[tt][jj];
+        free(ld.parents[tt]);
+        ld.parents[tt] = NULL;
+    }
+    /* merge the objects that touch at the seams between slabs: */
+    for(tt = 1; tt < ld.slabs; tt++) {
+        npy_intp row = ld.slab_first[tt], line;
+        npy_intp base = ld.row_base[row], pbase = ld.row_base[row - 1];
+        npy_intp *offsets = ld.work, *deltas = ld.work + ld.neighbors, nn;
+        for(line = row * ld.row_lines; line < (row + 1) * ld.row_lines;
+            line++) {
+            char *pi, *po;
+            nn = NI_LabelLine(&ld, line, row - 1, 1, &pi, &po, coordinates,
+                              offsets, deltas);
+            for(jj = 0; jj < ld.length && nn > 0; jj++, po += ld.ostride) {
+                npy_intp label = NI_LOAD_LABEL(po, ld.wide);
+                if (label <= 0)
+                    continue;
+                for(kk = 0; kk < nn; kk++) {
+                    npy_intp nb;
+                    if ((deltas[kk] < 0 && jj == 0) ||
+                        (deltas[kk] > 0 && jj == ld.length - 1))
+                        continue;
+                    nb = NI_LOAD_LABEL(po + offsets[kk], ld.wide);
+                    if (nb > 0)
+                        NI_MergeLabels(map, base + label, pbase + nb);
                 }
             }
-            if (neighbor) {
-                /* this point belongs to an existing object */
-                *(Int32*)po = neighbor;
-            } else {
-                /* this may be a new object: */
-                *(Int32*)po = ++index;
-            }
         }
-        NI_FILTER_NEXT(fi, io, oo, po);
-    }
-    *max_label = index;
-    /* merge any touching objects: */
-    if (pairs) {
-        Int32 counter;
-        index_map = (Int32*)malloc(index * sizeof(Int32));
-        if (!index_map) {
-            PyErr_NoMemory();
-            goto exit;
+    }
+    /* number the objects in the order of their first point. A label
+         points to a smaller one, which is already renumbered: */
+    for(jj = 1; jj <= total; jj++) {
+        if (map[jj] == jj)
+            map[jj] = ++ld.max_label;
+        else
+            map[jj] = map[map[jj]];
+    }
+    if (!ld.wide && ld.max_label > NPY_MAX_INT32) {
+        ld.error = NI_LABEL_OVERFLOW;
+        goto exit;
+    }
+    ld.map = map;
+    if (regions && ld.max_label > 0) {
+        rsize = rank > 0 ? 2 * rank * ld.max_label : ld.max_label;
+        for(tt = 0; tt < ld.slabs; tt++) {
+            ld.regions[tt] = (npy_intp*)malloc(rsize * sizeof(npy_intp));
+            if (!ld.regions[tt]) {
+                PyErr_NoMemory();
+                goto exit;
+            }
+            for(jj = 0; jj < rsize; jj++)
+                ld.regions[tt][jj] = -1;
         }
-        for(jj = 0; jj < index; jj++)
-            index_map[jj] = (Int32)jj;
-        while (pairs) {
-            Int32 idx1 = pairs->index1 - 1;
-            Int32 idx2 = pairs->index2 - 1;
-            if (index_map[idx2] == idx1 || index_map[idx2] == idx2) {
-                /* if this pair was already processed, or if idx2 was not
-                     mapped yet, we delete this pair and map idx2 to idx1: */
-                _index_pair *tp = pairs;
-                pairs = tp->next;
-                free(tp);
-                index_map[idx2] = idx1;
-            } else {
-                /* idx2 was already mapped, therefore we find what it was
-                     mapped to and change the current pair to the result of
-                     that and idx1. Since the pair is not destroyed, it will be
-                     re-processed with the adapted values.  */
-                idx2 = index_map[idx2];
-                /* keep the pairs ordered: */
-                if (idx1 < idx2) {
-                    pairs->index1 = idx1 + 1;
-                    pairs->index2 = idx2 + 1;
-                } else {
-                    pairs->index1 = idx2 + 1;
-                    pairs->index2 = idx1 + 1;
+    }
+    NI_RunThreads(rows, ld.slabs, NI_LabelRelabel, &ld);
+    /* combine the regions found by the threads: */
+    if (regions && ld.max_label > 0) {
+        npy_intp *pr = ld.regions[0];
+        for(tt = 1; tt < ld.slabs; tt++) {
+            npy_intp *pt = ld.regions[tt];
+            for(jj = 0; jj < ld.max_label; jj++) {
+                npy_intp idx = rank > 0 ? 2 * rank * jj : jj;
+                if (pt[idx] < 0)
+                    continue;
+                if (rank == 0 || pr[idx] < 0) {
+                    for(ll = 0; ll < (rank > 0 ? 2 * rank : 1); ll++)
+                        pr[idx + ll] = pt[idx + ll];
+                    continue;
+                }
+                for(ll = 0; ll < rank; ll++) {
+                    if (pt[idx + ll] < pr[idx + ll])
+                        pr[idx + ll] = pt[idx + ll];
+                    if (pt[idx + ll + rank] > pr[idx + ll + rank])
+                        pr[idx + ll + rank] = pt[idx + ll + rank];
                 }
             }
         }
-        for(jj = 0; jj < index; jj++) {
-            /* if the current index maps to a index that is also mapped,
-                 change it to map to that index. Since an index always maps to
-                 a lower index or to itself, this will make sure that at the
-                 end all indices map to an unmapped index. */
-            if (index_map[index_map[jj]] < index_map[jj])
-                index_map[jj] = index_map[index_map[jj]];
-        }
-        /* renumber the indices that are not mapped: */
-        counter = 0;
-        for(jj = 0; jj < index; jj++)
-            if (index_map[jj] == jj)
-                index_map[jj] = ++counter;
-            else
-                index_map[jj] = index_map[index_map[jj]];
+        *regions = pr;
+        ld.regions[0] = NULL;
     }
-
-    /* relabel the output if we merged some objects: */
-    if (index_map) {
-        *max_label = 0;
-        NI_ITERATOR_RESET(io);
-        po = (void *)PyArray_DATA(output);
-        for(jj = 0; jj < size; jj++) {
-            Int32 p = *(Int32*)po;
-            if (p > 0 )
-                *(Int32*)po = index_map[p - 1];
-            if (*(Int32*)po > *max_label)
-                *max_label = *(Int32*)po;
-            NI_ITERATOR_NEXT(io, po);
-        }
+    *max_label = ld.max_label;
+exit:
+    if (ld.error == NI_LABEL_NO_MEMORY)
+        PyErr_NoMemory();
+    else if (ld.error == NI_LABEL_OVERFLOW)
+        PyErr_SetString(PyExc_RuntimeError,
+                        "too many labels for an int32 output");
+    for(tt = 0; tt < NI_MAX_THREADS; tt++) {
+        if (ld.parents[tt])
+            free(ld.parents[tt]);
+        if (ld.regions[tt])
+            free(ld.regions[tt]);
     }
- exit:
-    if (offsets) free(offsets);
-    if (index_map) free(index_map);
-    while (pairs) {
-        _index_pair *tp = pairs;
-        pairs = (_index_pair*)pairs->next;
-        free(tp);
-    }
-    if (footprint)
-        free(footprint);
+    if (ld.deltas)
+        free(ld.deltas);
+    if (ld.offsets)
+        free(ld.offsets);
+    if (ld.work)
+        free(ld.work);
+    if (ld.masks)
+        free(ld.masks);
+    if (ld.row_base)
+        free(ld.row_base);
+    if (map)
+        free(map);
     return PyErr_Occurred() ? 0 : 1;
 }
 
@@ -515,143 +780,437 @@ int NI_FindObjects(PyArrayObject* input, npy_intp max_label,
 }
 #endif
 
-int NI_Statistics(PyArrayObject *input, PyArrayObject *labels,
-    npy_intp min_label, npy_intp max_label, npy_intp *indices,
-    npy_intp n_results, double *sum, npy_intp *total, double *variance,
-    double *minimum, double *maximum, npy_intp* min_pos, npy_intp* max_pos)
+/* Test if a value replaces the current extremum. As with the minimum
+     and maximum of numpy, the first NaN value is the extremum: */
+#define NI_MINIMUM_BEFORE(_val, _ext) \
+    ((_val) < (_ext) || ((_val) != (_val) && (_ext) == (_ext)))
+#define NI_MAXIMUM_BEFORE(_val, _ext) \
+    ((_val) > (_ext) || ((_val) != (_val) && (_ext) == (_ext)))
+
+typedef struct {
+    PyArrayObject *input, *labels;
+    npy_intp min_label, max_label, *indices, n_results, bins;
+    npy_intp length, row_lines, table_size;
+    double *edges, *values;
+    npy_intp *label_buffer;
+    NI_StatisticsTables tables[NI_MAX_THREADS];
+    int rank, input_type, labels_type;
+} NI_StatisticsData;
+
+#define CASE_STATISTICS_VALUES(_pi, _stride, _values, _length, _type) \
+case t ## _type:                                                     \
+{                                                                    \
+    npy_intp _ii;                                                    \
+    for(_ii = 0; _ii < _length; _ii++)                               \
+        _values[_ii] = (double)*(_type*)(_pi + _ii * _stride);       \
+}                                                                    \
+break
+
+#define CASE_STATISTICS_LABELS(_pl, _stride, _labels, _length, _type) \
+case t ## _type:                                                      \
+{                                                                     \
+    npy_intp _ii;                                                     \
+    for(_ii = 0; _ii < _length; _ii++)                                \
+        _labels[_ii] = (npy_intp)*(_type*)(_pl + _ii * _stride);      \
+}                                                                     \
+break
+
+/* Allocate the tables of a thread, with the same statistics as the
+     tables given, or initialize them: */
+static int NI_InitStatisticsTables(NI_StatisticsTables *tables,
+                                   NI_StatisticsTables *like,
+                                   npy_intp n, int rank, npy_intp bins)
 {
-    char *pi = NULL, *pm = NULL;
-    NI_Iterator ii, mi;
-    npy_intp jj, size, idx = 0, label = 1, doit = 1;
-    int qq;
+    npy_intp jj;
 
-    /* input iterator: */
-    if (!NI_InitPointIterator(input, &ii))
-        return 0;
-    /* input data: */
-    pi = (void *)PyArray_DATA(input);
-    if (labels) {
-        if (!NI_InitPointIterator(labels, &mi))
+    if (like) {
+        tables->count = (npy_intp*)malloc(n * sizeof(npy_intp));
+        tables->sum = like->sum ? (double*)malloc(n * sizeof(double)) : NULL;
+        tables->m2 = like->m2 ? (double*)malloc(n * sizeof(double)) : NULL;
+        tables->minimum = like->minimum ?
+                                (double*)malloc(n * sizeof(double)) : NULL;
+        tables->maximum = like->maximum ?
+                                (double*)malloc(n * sizeof(double)) : NULL;
+        tables->min_pos = like->min_pos ?
+                                (npy_intp*)malloc(n * sizeof(npy_intp)) : NULL;
+        tables->max_pos = like->max_pos ?
+                                (npy_intp*)malloc(n * sizeof(npy_intp)) : NULL;
+        tables->center = like->center ?
+                        (double*)malloc(n * rank * sizeof(double)) : NULL;
+        tables->box = like->box ?
+                    (npy_intp*)malloc(2 * n * rank * sizeof(npy_intp)) : NULL;
+        tables->histogram = like->histogram ?
+                        (npy_intp*)malloc(n * bins * sizeof(npy_intp)) : NULL;
+        if (!tables->count || (like->sum && !tables->sum) ||
+            (like->m2 && !tables->m2) ||
+            (like->minimum && !tables->minimum) ||
+            (like->maximum && !tables->maximum) ||
+            (like->min_pos && !tables->min_pos) ||
+            (like->max_pos && !tables->max_pos) ||
+            (like->center && !tables->center) ||
+            (like->box && !tables->box) ||
+            (like->histogram && !tables->histogram))
             return 0;
-        pm = (void *)PyArray_DATA(labels);
     }
-    /* input size: */
-    size = 1;
-    for(qq = 0; qq < input->nd; qq++)
-        size *= input->dimensions[qq];
-    for(jj = 0; jj < n_results; jj++) {
-        if (sum)
-            sum[jj] = 0.0;
-        if (total)
-            total[jj] = 0;
-        if (variance)
-            variance[jj] = 0;
-        if (minimum)
-            minimum[jj] = DBL_MAX;
-        if (maximum)
-            maximum[jj] = -DBL_MAX;
-        if (min_pos)
-            min_pos[jj] = 0;
-        if (max_pos)
-            max_pos[jj] = 0;
+    tables->mean = NULL;
+    if (tables->m2) {
+        tables->mean = (double*)malloc(n * sizeof(double));
+        if (!tables->mean)
+            return 0;
     }
-    /* iterate over array: */
-    for(jj = 0; jj < size; jj++) {
-        NI_GET_LABEL(pm, label, labels->descr->type_num);
-        if (min_label >= 0) {
-            if (label >= min_label && label <= max_label) {
-                idx = indices[label - min_label];
-                doit = idx >= 0;
-            } else {
-                doit = 0;
-            }
-        } else {
-            doit = label != 0;
+    for(jj = 0; jj < n; jj++) {
+        tables->count[jj] = 0;
+        if (tables->sum)
+            tables->sum[jj] = 0.0;
+        if (tables->m2)
+            tables->mean[jj] = tables->m2[jj] = 0.0;
+        if (tables->minimum)
+            tables->minimum[jj] = DBL_MAX;
+        if (tables->maximum)
+            tables->maximum[jj] = -DBL_MAX;
+        if (tables->min_pos)
+            tables->min_pos[jj] = 0;
+        if (tables->max_pos)
+            tables->max_pos[jj] = 0;
+    }
+    if (tables->center)
+        for(jj = 0; jj < n * rank; jj++)
+            tables->center[jj] = 0.0;
+    if (tables->box)
+        for(jj = 0; jj < 2 * n * rank; jj++)
+            tables->box[jj] = -1;
+    if (tables->histogram)
+        for(jj = 0; jj < n * bins; jj++)
+            tables->histogram[jj] = 0;
+    return 1;
+}
+
+static void NI_FreeStatisticsTables(NI_StatisticsTables *tables, int all)
+{
+    if (all) {
+        free(tables->count);
+        free(tables->sum);
+        free(tables->m2);
+        free(tables->minimum);
+        free(tables->maximum);
+        free(tables->min_pos);
+        free(tables->max_pos);
+        free(tables->center);
+        free(tables->box);
+        free(tables->histogram);
+    }
+    free(tables->mean);
+}
+
+/* Add the tables of a thread to the tables of the threads that
+     processed the preceding rows: */
+static void NI_MergeStatisticsTables(NI_StatisticsTables *tables,
+                                     NI_StatisticsTables *other,
+                                     npy_intp n, int rank, npy_intp bins)
+{
+    npy_intp jj, kk;
+
+    for(jj = 0; jj < n; jj++) {
+        npy_intp n1 = tables->count[jj], n2 = other->count[jj];
+        if (n2 == 0)
+            continue;
+        if (tables->sum)
+            tables->sum[jj] += other->sum[jj];
+        if (tables->m2) {
+            double delta = other->mean[jj] - tables->mean[jj];
+            tables->mean[jj] += delta * n2 / (n1 + n2);
+            tables->m2[jj] += other->m2[jj] +
+                                    delta * delta * ((double)n1 * n2 / (n1 + n2));
         }
-        if (doit) {
-            double val;
-            NI_GET_VALUE(pi, val, input->descr->type_num);
-            if (sum)
-                sum[idx] += val;
-            if (total)
-                total[idx]++;
-            if (minimum && val < minimum[idx]) {
-                minimum[idx] = val;
-                if (min_pos)
-                    min_pos[idx] = jj;
-            }
-            if (maximum && (val > maximum[idx])) {
-                maximum[idx] = val;
-                if (max_pos)
-                    max_pos[idx] = jj;
-            }
+        /* on equal values the first position is kept: */
+        if (tables->minimum && (n1 == 0 ||
+                NI_MINIMUM_BEFORE(other->minimum[jj], tables->minimum[jj]))) {
+            tables->minimum[jj] = other->minimum[jj];
+            if (tables->min_pos)
+                tables->min_pos[jj] = other->min_pos[jj];
         }
-        if (labels) {
-            NI_ITERATOR_NEXT2(ii, mi, pi, pm);
-        } else {
-            NI_ITERATOR_NEXT(ii, pi);
+        if (tables->maximum && (n1 == 0 ||
+                NI_MAXIMUM_BEFORE(other->maximum[jj], tables->maximum[jj]))) {
+            tables->maximum[jj] = other->maximum[jj];
+            if (tables->max_pos)
+                tables->max_pos[jj] = other->max_pos[jj];
         }
-    }
-    if (minimum) {
-        for(jj = 0; jj < n_results; jj++) {
-            if (!(minimum[jj] < DBL_MAX))
-                minimum[jj] = 0.0;
+        if (tables->center)
+            for(kk = 0; kk < rank; kk++)
+                tables->center[jj * rank + kk] += other->center[jj * rank + kk];
+        if (tables->box) {
+            npy_intp *pb = tables->box + 2 * rank * jj;
+            npy_intp *ob = other->box + 2 * rank * jj;
+            if (n1 == 0) {
+                for(kk = 0; kk < 2 * rank; kk++)
+                    pb[kk] = ob[kk];
+            } else {
+                for(kk = 0; kk < rank; kk++) {
+                    if (ob[kk] < pb[kk])
+                        pb[kk] = ob[kk];
+                    if (ob[kk + rank] > pb[kk + rank])
+                        pb[kk + rank] = ob[kk + rank];
+                }
+            }
         }
+        if (tables->histogram)
+            for(kk = 0; kk < bins; kk++)
+                tables->histogram[jj * bins + kk] +=
+                                                other->histogram[jj * bins + kk];
+        tables->count[jj] = n1 + n2;
     }
-    if (maximum) {
-        for(jj = 0; jj < n_results; jj++) {
-            if (!(maximum[jj] > -DBL_MAX))
-                maximum[jj] = 0.0;
-        }
+}
+
+/* Accumulate the statistics of a range of rows: */
+static int NI_StatisticsRows(void *data, npy_intp first, npy_intp count,
+                             int thread)
+{
+    NI_StatisticsData *sd = (NI_StatisticsData*)data;
+    NI_StatisticsTables *tb = sd->tables + thread;
+    double *values = sd->values + thread * sd->length;
+    npy_intp *labels = sd->label_buffer + thread * sd->length;
+    npy_intp line, jj, kk, coordinates[NI_MAXDIM];
+    npy_intp bins = sd->bins, rank = sd->rank;
+    double hmin = 0.0, hscale = 0.0;
+
+    if (tb->histogram) {
+        hmin = sd->edges[0];
+        hscale = bins / (sd->edges[bins] - sd->edges[0]);
     }
-    if (variance) {
-        int do_var = 0;
-        for(jj = 0; jj < n_results; jj++)
-            if (total[jj] > 1) {
-                do_var = 1;
+    for(line = first * sd->row_lines; line < (first + count) * sd->row_lines;
+        line++) {
+        char *pi = (void *)PyArray_DATA(sd->input), *pl = NULL;
+        npy_intp tmp = line, istride, lstride = 0;
+        int ll;
+        if (sd->labels)
+            pl = (void *)PyArray_DATA(sd->labels);
+        for(ll = sd->rank - 2; ll >= 0; ll--) {
+            coordinates[ll] = tmp % sd->input->dimensions[ll];
+            tmp /= sd->input->dimensions[ll];
+            pi += coordinates[ll] * sd->input->strides[ll];
+            if (pl)
+                pl += coordinates[ll] * sd->labels->strides[ll];
+        }
+        istride = rank > 0 ? sd->input->strides[rank - 1] : 0;
+        switch (sd->input_type) {
+        CASE_STATISTICS_VALUES(pi, istride, values, sd->length, Bool);
+        CASE_STATISTICS_VALUES(pi, istride, values, sd->length, UInt8);
+        CASE_STATISTICS_VALUES(pi, istride, values, sd->length, UInt16);
+        CASE_STATISTICS_VALUES(pi, istride, values, sd->length, UInt32);
+#if HAS_UINT64
+        CASE_STATISTICS_VALUES(pi, istride, values, sd->length, UInt64);
+#endif
+        CASE_STATISTICS_VALUES(pi, istride, values, sd->length, Int8);
+        CASE_STATISTICS_VALUES(pi, istride, values, sd->length, Int16);
+        CASE_STATISTICS_VALUES(pi, istride, values, sd->length, Int32);
+        CASE_STATISTICS_VALUES(pi, istride, values, sd->length, Int64);
+        CASE_STATISTICS_VALUES(pi, istride, values, sd->length, Float32);
+        CASE_STATISTICS_VALUES(pi, istride, values, sd->length, Float64);
+        default:
+            break;
+        }
+        /* find the result that each point contributes to: */
+        if (pl) {
+            lstride = rank > 0 ? sd->labels->strides[rank - 1] : 0;
+            switch (sd->labels_type) {
+            CASE_STATISTICS_LABELS(pl, lstride, labels, sd->length, Bool);
+            CASE_STATISTICS_LABELS(pl, lstride, labels, sd->length, UInt8);
+            CASE_STATISTICS_LABELS(pl, lstride, labels, sd->length, UInt16);
+            CASE_STATISTICS_LABELS(pl, lstride, labels, sd->length, UInt32);
+#if HAS_UINT64
+            CASE_STATISTICS_LABELS(pl, lstride, labels, sd->length, UInt64);
+#endif
+            CASE_STATISTICS_LABELS(pl, lstride, labels, sd->length, Int8);
+            CASE_STATISTICS_LABELS(pl, lstride, labels, sd->length, Int16);
+            CASE_STATISTICS_LABELS(pl, lstride, labels, sd->length, Int32);
+            CASE_STATISTICS_LABELS(pl, lstride, labels, sd->length, Int64);
+            CASE_STATISTICS_LABELS(pl, lstride, labels, sd->length, Float32);
+            CASE_STATISTICS_LABELS(pl, lstride, labels, sd->length, Float64);
+            default:
                 break;
             }
-        if (do_var) {
-            /* reset input iterator: */
-            NI_ITERATOR_RESET(ii);
-            pi = (void *)PyArray_DATA(input);
-            if (labels) {
-                /* reset label iterator: */
-                NI_ITERATOR_RESET(mi);
-                pm = (void *)PyArray_DATA(labels);
+            for(jj = 0; jj < sd->length; jj++) {
+                npy_intp label = labels[jj];
+                if (!sd->indices)
+                    labels[jj] = label > 0 ? 0 : -1;
+                else if (label >= sd->min_label && label <= sd->max_label)
+                    labels[jj] = sd->indices[label - sd->min_label];
+                else
+                    labels[jj] = -1;
+            }
+        } else {
+            for(jj = 0; jj < sd->length; jj++)
+                labels[jj] = 0;
+        }
+        for(jj = 0; jj < sd->length; jj++) {
+            npy_intp idx = labels[jj];
+            double val = values[jj];
+            if (idx < 0)
+                continue;
+            if (rank > 0)
+                coordinates[rank - 1] = jj;
+            tb->count[idx]++;
+            if (tb->sum)
+                tb->sum[idx] += val;
+            if (tb->m2) {
+                double delta = val - tb->mean[idx];
+                tb->mean[idx] += delta / tb->count[idx];
+                tb->m2[idx] += delta * (val - tb->mean[idx]);
+            }
+            if (tb->minimum && (tb->count[idx] == 1 ||
+                                NI_MINIMUM_BEFORE(val, tb->minimum[idx]))) {
+                tb->minimum[idx] = val;
+                if (tb->min_pos)
+                    tb->min_pos[idx] = line * sd->length + jj;
+            }
+            if (tb->maximum && (tb->count[idx] == 1 ||
+                                NI_MAXIMUM_BEFORE(val, tb->maximum[idx]))) {
+                tb->maximum[idx] = val;
+                if (tb->max_pos)
+                    tb->max_pos[idx] = line * sd->length + jj;
             }
-            for(jj = 0; jj < size; jj++) {
-                NI_GET_LABEL(pm, label, labels->descr->type_num);
-                if (min_label >= 0) {
-                    if (label >= min_label && label <= max_label) {
-                        idx = indices[label - min_label];
-                        doit = idx >= 0;
-                    } else {
-                        doit = 0;
+            if (tb->center)
+                for(kk = 0; kk < rank; kk++)
+                    tb->center[idx * rank + kk] += val * coordinates[kk];
+            if (tb->box) {
+                npy_intp *pb = tb->box + 2 * rank * idx;
+                if (tb->count[idx] == 1) {
+                    for(kk = 0; kk < rank; kk++) {
+                        pb[kk] = coordinates[kk];
+                        pb[kk + rank] = coordinates[kk] + 1;
                     }
                 } else {
-                    doit = label != 0;
-                }
-                if (doit) {
-                    double val;
-                    NI_GET_VALUE(pi, val, input->descr->type_num);
-                    val = val - sum[idx] / total[idx];
-                    variance[idx] += val * val;
-                }
-                if (labels) {
-                    NI_ITERATOR_NEXT2(ii, mi, pi, pm);
-                } else {
-                    NI_ITERATOR_NEXT(ii, pi);
+                    for(kk = 0; kk < rank; kk++) {
+                        if (coordinates[kk] < pb[kk])
+                            pb[kk] = coordinates[kk];
+                        if (coordinates[kk] + 1 > pb[kk + rank])
+                            pb[kk + rank] = coordinates[kk] + 1;
+                    }
                 }
             }
-            for(jj = 0; jj < n_results; jj++)
-                variance[jj] = (total[jj] > 1 ?
-                                                variance[jj] / (total[jj] - 1) : 0.0);
+            if (tb->histogram && val >= sd->edges[0] && val <= sd->edges[bins]) {
+                /* estimate the bin, and correct it with the edges: */
+                npy_intp bin = (npy_intp)((val - hmin) * hscale);
+                if (bin >= bins)
+                    bin = bins - 1;
+                if (bin > 0 && val < sd->edges[bin])
+                    --bin;
+                else if (bin < bins - 1 && val >= sd->edges[bin + 1])
+                    ++bin;
+                tb->histogram[idx * bins + bin]++;
+            }
         }
     }
     return 1;
 }
 
+int NI_Statistics(PyArrayObject *input, PyArrayObject *labels,
+                  npy_intp min_label, npy_intp max_label, npy_intp *indices,
+                  npy_intp n_results, NI_StatisticsTables *tables,
+                  double *edges, npy_intp bins, int threads)
+{
+    NI_StatisticsData sd;
+    npy_intp jj, rows, lines = 1;
+    int ll, tt, rank = input->nd;
+
+    sd.input = input;
+    sd.labels = labels;
+    sd.min_label = min_label;
+    sd.max_label = max_label;
+    sd.indices = indices;
+    sd.n_results = n_results;
+    sd.edges = edges;
+    sd.bins = bins;
+    sd.rank = rank;
+    sd.values = NULL;
+    sd.label_buffer = NULL;
+    sd.input_type = NI_CanonicalType(input->descr->type_num);
+    sd.labels_type = labels ? NI_CanonicalType(labels->descr->type_num) : 0;
+    for(tt = 0; tt < 2; tt++) {
+        switch (tt == 0 ? sd.input_type : sd.labels_type) {
+        case tBool:
+        case tUInt8:
+        case tUInt16:
+        case tUInt32:
+#if HAS_UINT64
+        case tUInt64:
+#endif
+        case tInt8:
+        case tInt16:
+        case tInt32:
+        case tInt64:
+        case tFloat32:
+        case tFloat64:
+            break;
+        default:
+            if (tt == 0 || labels) {
+                PyErr_SetString(PyExc_RuntimeError, "data type not supported");
+                return 0;
+            }
+        }
+    }
+    /* lines along the last axis, divided over threads in rows along the
+         first axis: */
+    sd.length = rank > 0 ? input->dimensions[rank - 1] : 1;
+    for(ll = 0; ll < rank - 1; ll++)
+        lines *= input->dimensions[ll];
+    rows = rank > 1 ? input->dimensions[0] : 1;
+    sd.row_lines = rows > 0 ? lines / rows : 0;
+    if (threads > NI_MAX_THREADS)
+        threads = NI_MAX_THREADS;
+    if (threads > rows)
+        threads = (int)rows;
+    if (threads < 1)
+        threads = 1;
+    /* the first thread fills the tables given, the others their own: */
+    sd.tables[0] = *tables;
+    for(tt = 1; tt < threads; tt++)
+        memset(sd.tables + tt, 0, sizeof(NI_StatisticsTables));
+    for(tt = 0; tt < threads; tt++)
+        sd.tables[tt].mean = NULL;
+    if (!NI_InitStatisticsTables(sd.tables, NULL, n_results, rank, bins)) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+    for(tt = 1; tt < threads; tt++) {
+        if (!NI_InitStatisticsTables(sd.tables + tt, sd.tables, n_results,
+                                     rank, bins)) {
+            PyErr_NoMemory();
+            goto exit;
+        }
+    }
+    sd.values = (double*)malloc(threads * sd.length * sizeof(double));
+    sd.label_buffer = (npy_intp*)malloc(threads * sd.length *
+                                        sizeof(npy_intp));
+    if (!sd.values || !sd.label_buffer) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+    if (sd.length > 0 && lines > 0)
+        NI_RunThreads(rows, threads, NI_StatisticsRows, &sd);
+    for(tt = 1; tt < threads; tt++)
+        NI_MergeStatisticsTables(sd.tables, sd.tables + tt, n_results, rank,
+                                 bins);
+    /* results without points have zero extrema: */
+    for(jj = 0; jj < n_results; jj++) {
+        if (tables->count[jj] > 0)
+            continue;
+        if (tables->minimum)
+            tables->minimum[jj] = 0.0;
+        if (tables->maximum)
+            tables->maximum[jj] = 0.0;
+    }
+exit:
+    NI_FreeStatisticsTables(sd.tables, 0);
+    for(tt = 1; tt < threads; tt++)
+        NI_FreeStatisticsTables(sd.tables + tt, 1);
+    if (sd.values)
+        free(sd.values);
+    if (sd.label_buffer)
+        free(sd.label_buffer);
+    return PyErr_Occurred() ? 0 : 1;
+}
+
 
 int NI_CenterOfMass(PyArrayObject *input, PyArrayObject *labels,
                     npy_intp min_label, npy_intp max_label, npy_intp *indices,
@@ -690,7 +1249,7 @@ int NI_CenterOfMass(PyArrayObject *input, PyArrayObject *labels,
     /* iterate over array: */
     for(jj = 0; jj < size; jj++) {
         NI_GET_LABEL(pm, label, labels->descr->type_num);
-        if (min_label >= 0) {
+        if (indices) {
             if (label >= min_label && label <= max_label) {
                 idx = indices[label - min_label];
                 doit = idx >= 0;
@@ -763,7 +1322,7 @@ int NI_Histogram(PyArrayObject *input, PyArrayObject *labels,
     /* iterate over array: */
     for(jj = 0; jj < size; jj++) {
         NI_GET_LABEL(pm, label, labels->descr->type_num);
-        if (min_label >= 0) {
+        if (indices) {
             if (label >= min_label && label <= max_label) {
                 idx = indices[label - min_label];
                 doit = idx >= 0;
@@ -1199,3 +1758,338 @@ int NI_WatershedIFT(PyArrayObject* input, PyArrayObject* markers,
         free(nstrides);
     return PyErr_Occurred() ? 0 : 1;
 }
+
+#define CASE_WS_VALUE(_index, _strides, _array, _contiguous, _value, \
+                      _type)                                           \
+case t ## _type:                                                       \
+{                                                                      \
+    npy_intp _offset;                                                  \
+    WS_GET_INDEX(_index, _strides, _array->strides, _array->nd,        \
+                 _offset, _contiguous, _type);                         \
+    _value = (double)*(_type*)((char*)PyArray_DATA(_array) + _offset); \
+}                                                                      \
+break
+
+#define WS_FREE   0
+#define WS_QUEUED 1
+#define WS_DONE   2
+#define WS_MASKED 3
+
+/* An element in the queue of the watershed. Elements of equal priority
+     are taken in the order they were queued, and source is the marker
+     that the element was reached from: */
+typedef struct {
+    double priority;
+    npy_intp age, index, source;
+} NI_WatershedItem;
+
+typedef struct {
+    NI_WatershedItem *items;
+    npy_intp size, allocated;
+} NI_WatershedHeap;
+
+#define WS_BEFORE(_a, _b) \
+    ((_a).priority < (_b).priority || \
+     ((_a).priority == (_b).priority && (_a).age < (_b).age))
+
+static int NI_WatershedPush(NI_WatershedHeap *heap, NI_WatershedItem item)
+{
+    npy_intp ii;
+
+    if (heap->size == heap->allocated) {
+        npy_intp allocated = heap->allocated > 0 ? 2 * heap->allocated : 1024;
+        NI_WatershedItem *items = (NI_WatershedItem*)realloc(heap->items,
+                                      allocated * sizeof(NI_WatershedItem));
+        if (!items)
+            return 0;
+        heap->items = items;
+        heap->allocated = allocated;
+    }
+    ii = heap->size++;
+    while(ii > 0) {
+        npy_intp parent = (ii - 1) / 2;
+        if (!WS_BEFORE(item, heap->items[parent]))
+            break;
+        heap->items[ii] = heap->items[parent];
+        ii = parent;
+    }
+    heap->items[ii] = item;
+    return 1;
+}
+
+static NI_WatershedItem NI_WatershedPop(NI_WatershedHeap *heap)
+{
+    NI_WatershedItem top = heap->items[0];
+    NI_WatershedItem last = heap->items[--heap->size];
+    npy_intp ii = 0, child;
+
+    while((child = 2 * ii + 1) < heap->size) {
+        if (child + 1 < heap->size &&
+            WS_BEFORE(heap->items[child + 1], heap->items[child]))
+            ++child;
+        if (!WS_BEFORE(heap->items[child], last))
+            break;
+        heap->items[ii] = heap->items[child];
+        ii = child;
+    }
+    heap->items[ii] = last;
+    return top;
+}
+
+/* Pointer to a label of the output, given by its index in C order: */
+static char *NI_WatershedLabel(PyArrayObject *output, npy_intp index,
+                               npy_intp *strides, int contiguous, int wide)
+{
+    npy_intp offset;
+
+    if (wide)
+        WS_GET_INDEX(index, strides, output->strides, output->nd, offset,
+                     contiguous, Int64);
+    else
+        WS_GET_INDEX(index, strides, output->strides, output->nd, offset,
+                     contiguous, Int32);
+    return (char*)PyArray_DATA(output) + offset;
+}
+
+static double NI_WatershedValue(PyArrayObject *input, npy_intp index,
+                                npy_intp *strides, int contiguous, int type)
+{
+    double value = 0.0;
+
+    switch (type) {
+    CASE_WS_VALUE(index, strides, input, contiguous, value, Bool);
+    CASE_WS_VALUE(index, strides, input, contiguous, value, UInt8);
+    CASE_WS_VALUE(index, strides, input, contiguous, value, UInt16);
+    CASE_WS_VALUE(index, strides, input, contiguous, value, UInt32);
+#if HAS_UINT64
+    CASE_WS_VALUE(index, strides, input, contiguous, value, UInt64);
+#endif
+    CASE_WS_VALUE(index, strides, input, contiguous, value, Int8);
+    CASE_WS_VALUE(index, strides, input, contiguous, value, Int16);
+    CASE_WS_VALUE(index, strides, input, contiguous, value, Int32);
+    CASE_WS_VALUE(index, strides, input, contiguous, value, Int64);
+    CASE_WS_VALUE(index, strides, input, contiguous, value, Float32);
+    CASE_WS_VALUE(index, strides, input, contiguous, value, Float64);
+    default:
+        break;
+    }
+    return value;
+}
+
+/* Watershed by flooding from the markers, in the order of the values of
+     the input. Each element is queued once, by the first labeled
+     neighbor that reaches it, and takes its label. With a compactness,
+     the priority adds the weighted distance to the marker that the
+     element is reached from, and an element may be queued by several
+     markers; it takes the label of the first one to leave the queue, as
+     described in: P. Neubert, P. Protzel, "Compact watershed and
+     preemptive SLIC", ICPR 2014. Besides the labels in the output, only
+     a state byte per element and the queue of the front are stored. */
+int NI_Watershed(PyArrayObject* input, PyArrayObject* markers,
+                 PyArrayObject* strct, PyArrayObject* mask,
+                 double compactness, PyArrayObject* output)
+{
+    npy_intp size, jj, kk, ssize, nneigh = 0, age = 0;
+    npy_intp strides[NI_MAXDIM], coordinates[NI_MAXDIM];
+    npy_intp scoordinates[NI_MAXDIM];
+    npy_intp *offsets = NULL, *deltas = NULL;
+    UInt8 *state = NULL;
+    NI_WatershedHeap heap;
+    NI_Iterator mi, li;
+    char *pm, *pl;
+    Bool *ps, *pk = NULL;
+    int rank = input->nd, ll, wide, type, mtype, i_contiguous, o_contiguous;
+
+    heap.items = NULL;
+    heap.size = heap.allocated = 0;
+    type = NI_CanonicalType(input->descr->type_num);
+    switch (type) {
+    case tBool:
+    case tUInt8:
+    case tUInt16:
+    case tUInt32:
+#if HAS_UINT64
+    case tUInt64:
+#endif
+    case tInt8:
+    case tInt16:
+    case tInt32:
+    case tInt64:
+    case tFloat32:
+    case tFloat64:
+        break;
+    default:
+        PyErr_SetString(PyExc_RuntimeError, "data type not supported");
+        goto exit;
+    }
+    switch (NI_CanonicalType(output->descr->type_num)) {
+    case tInt32:
+        wide = 0;
+        break;
+    case tInt64:
+        wide = 1;
+        break;
+    default:
+        PyErr_SetString(PyExc_RuntimeError, "output type must be int32 or int64");
+        goto exit;
+    }
+    mtype = NI_CanonicalType(markers->descr->type_num);
+    i_contiguous = PyArray_ISCONTIGUOUS(input);
+    o_contiguous = PyArray_ISCONTIGUOUS(output);
+    size = 1;
+    for(ll = rank - 1; ll >= 0; ll--) {
+        strides[ll] = size;
+        size *= input->dimensions[ll];
+    }
+    ssize = 1;
+    for(ll = 0; ll < strct->nd; ll++)
+        ssize *= strct->dimensions[ll];
+    /* offsets and coordinate steps of the neighbors: */
+    offsets = (npy_intp*)malloc(ssize * sizeof(npy_intp));
+    deltas = (npy_intp*)malloc((ssize * rank + 1) * sizeof(npy_intp));
+    state = (UInt8*)malloc(size > 0 ? size : 1);
+    if (!offsets || !deltas || !state) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+    ps = (Bool*)PyArray_DATA(strct);
+    for(kk = 0; kk < ssize; kk++) {
+        npy_intp tmp = kk, offset = 0;
+        int center = 1;
+        if (!ps[kk])
+            continue;
+        for(ll = rank - 1; ll >= 0; ll--) {
+            npy_intp delta = tmp % strct->dimensions[ll] -
+                                                    strct->dimensions[ll] / 2;
+            tmp /= strct->dimensions[ll];
+            deltas[nneigh * rank + ll] = delta;
+            offset += delta * strides[ll];
+            if (delta != 0)
+                center = 0;
+        }
+        if (!center)
+            offsets[nneigh++] = offset;
+    }
+    /* copy the markers to the output and queue them: */
+    if (mask)
+        pk = (Bool*)PyArray_DATA(mask);
+    if (!NI_InitPointIterator(markers, &mi))
+        goto exit;
+    if (!NI_InitPointIterator(output, &li))
+        goto exit;
+    pm = (void *)PyArray_DATA(markers);
+    pl = (void *)PyArray_DATA(output);
+    for(jj = 0; jj < size; jj++) {
+        npy_intp label = 0;
+        switch(mtype) {
+        CASE_GET_LABEL(label, pm, UInt8);
+        CASE_GET_LABEL(label, pm, UInt16);
+        CASE_GET_LABEL(label, pm, UInt32);
+#if HAS_UINT64
+        CASE_GET_LABEL(label, pm, UInt64);
+#endif
+        CASE_GET_LABEL(label, pm, Int8);
+        CASE_GET_LABEL(label, pm, Int16);
+        CASE_GET_LABEL(label, pm, Int32);
+        CASE_GET_LABEL(label, pm, Int64);
+        default:
+            PyErr_SetString(PyExc_RuntimeError, "data type not supported");
+            goto exit;
+        }
+        state[jj] = WS_FREE;
+        if (pk && !pk[jj]) {
+            state[jj] = WS_MASKED;
+            label = 0;
+        }
+        NI_STORE_LABEL(pl, wide, label);
+        if (label != 0) {
+            NI_WatershedItem item;
+            item.priority = NI_WatershedValue(input, jj, strides, i_contiguous,
+                                              type);
+            item.age = age++;
+            item.index = item.source = jj;
+            state[jj] = WS_DONE;
+            if (!NI_WatershedPush(&heap, item)) {
+                PyErr_NoMemory();
+                goto exit;
+            }
+        }
+        NI_ITERATOR_NEXT2(mi, li, pm, pl);
+    }
+    /* flooding: */
+    while(heap.size > 0) {
+        NI_WatershedItem item = NI_WatershedPop(&heap);
+        npy_intp label, tmp = item.index;
+        if (compactness > 0.0) {
+            /* the element may have been labeled from another marker: */
+            if (state[item.index] == WS_DONE && item.index != item.source)
+                continue;
+            state[item.index] = WS_DONE;
+            label = NI_LOAD_LABEL(NI_WatershedLabel(output, item.source,
+                                          strides, o_contiguous, wide), wide);
+            NI_STORE_LABEL(NI_WatershedLabel(output, item.index, strides,
+                                             o_contiguous, wide), wide, label);
+            tmp = item.source;
+            for(ll = rank - 1; ll >= 0; ll--) {
+                scoordinates[ll] = tmp % input->dimensions[ll];
+                tmp /= input->dimensions[ll];
+            }
+            tmp = item.index;
+        } else {
+            label = NI_LOAD_LABEL(NI_WatershedLabel(output, item.index,
+                                          strides, o_contiguous, wide), wide);
+        }
+        for(ll = rank - 1; ll >= 0; ll--) {
+            coordinates[ll] = tmp % input->dimensions[ll];
+            tmp /= input->dimensions[ll];
+        }
+        for(kk = 0; kk < nneigh; kk++) {
+            npy_intp *delta = deltas + kk * rank, index;
+            NI_WatershedItem next;
+            for(ll = 0; ll < rank; ll++) {
+                npy_intp cc = coordinates[ll] + delta[ll];
+                if (cc < 0 || cc >= input->dimensions[ll])
+                    break;
+            }
+            if (ll < rank)
+                continue;
+            index = item.index + offsets[kk];
+            if (state[index] == WS_DONE || state[index] == WS_MASKED ||
+                (state[index] == WS_QUEUED && compactness <= 0.0))
+                continue;
+            next.priority = NI_WatershedValue(input, index, strides,
+                                              i_contiguous, type);
+            next.age = age++;
+            next.index = index;
+            next.source = item.source;
+            if (compactness > 0.0) {
+                double distance = 0.0;
+                for(ll = 0; ll < rank; ll++) {
+                    double d = (double)(coordinates[ll] + delta[ll] -
+                                        scoordinates[ll]);
+                    distance += d * d;
+                }
+                next.priority += compactness * sqrt(distance);
+                state[index] = WS_QUEUED;
+            } else {
+                state[index] = WS_DONE;
+                NI_STORE_LABEL(NI_WatershedLabel(output, index, strides,
+                                                 o_contiguous, wide), wide, label);
+            }
+            if (!NI_WatershedPush(&heap, next)) {
+                PyErr_NoMemory();
+                goto exit;
+            }
+        }
+    }
+ exit:
+    if (offsets)
+        free(offsets);
+    if (deltas)
+        free(deltas);
+    if (state)
+        free(state);
+    if (heap.items)
+        free(heap.items);
+    return PyErr_Occurred() ? 0 : 1;
+}
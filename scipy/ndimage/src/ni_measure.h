@@ -39,7 +39,8 @@ typedef struct {
     int start[NI_MAXDIM], end[NI_MAXDIM];
 } NI_ObjectRegion;
 
-int NI_Label(PyArrayObject*, PyArrayObject*, npy_intp*, PyArrayObject*);
+int NI_Label(PyArrayObject*, PyArrayObject*, npy_intp*, PyArrayObject*, int,
+             npy_intp**);
 
 int NI_FindObjects(PyArrayObject*, npy_intp, npy_intp*);
 
@@ -50,11 +51,23 @@ int NI_Histogram(PyArrayObject*, PyArrayObject*, npy_intp, npy_intp,
                  npy_intp*, npy_intp, PyArrayObject**, double, double,
                  npy_intp);
 
+/* tables of statistics, with one entry for each result, rank entries
+     for the center, the start and end coordinates for the box, and the
+     bins of the histogram. The count is required, the others are only
+     calculated if not NULL. The mean is used internally for the sum of
+     squared deviations, m2: */
+typedef struct {
+    npy_intp *count, *min_pos, *max_pos, *box, *histogram;
+    double *sum, *mean, *m2, *minimum, *maximum, *center;
+} NI_StatisticsTables;
+
 int NI_Statistics(PyArrayObject*, PyArrayObject*, npy_intp, npy_intp,
-                  npy_intp*, npy_intp, double*, npy_intp*, double*,
-                  double*, double*, npy_intp*, npy_intp*);
+                  npy_intp*, npy_intp, NI_StatisticsTables*, double*,
+                  npy_intp, int);
 
 int NI_WatershedIFT(PyArrayObject*, PyArrayObject*, PyArrayObject*, 
                                         PyArrayObject*);
+int NI_Watershed(PyArrayObject*, PyArrayObject*, PyArrayObject*,
+                 PyArrayObject*, double, PyArrayObject*);
 
 #endif
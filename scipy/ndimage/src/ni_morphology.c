@@ -500,6 +500,321 @@ typedef struct {
     void *next;
 } NI_BorderElement;
 
+/* Binary erosion and dilation of bit-packed arrays: the lines along the
+     last axis are packed 64 elements per word, and the structure is
+     applied by shifting and combining whole words. The bits past the end
+     of a line hold the border value, so that shifts read it there. */
+
+typedef npy_uint64 NI_BitWord;
+
+#define NI_WORD_BITS 64
+
+#define CASE_PACK_LINE(_pi, _stride, _length, _words, _type) \
+case t ## _type:                                             \
+{                                                            \
+    npy_intp _kk, _ww;                                       \
+    for(_ww = 0; _ww * NI_WORD_BITS < _length; _ww++) {      \
+        NI_BitWord _word = 0;                                \
+        npy_intp _end = _length - _ww * NI_WORD_BITS;        \
+        if (_end > NI_WORD_BITS)                             \
+            _end = NI_WORD_BITS;                             \
+        for(_kk = 0; _kk < _end; _kk++) {                    \
+            _word |= (NI_BitWord)(*(_type*)_pi != 0) << _kk; \
+            _pi += _stride;                                  \
+        }                                                    \
+        _words[_ww] = _word;                                 \
+    }                                                        \
+}                                                            \
+break
+
+#define CASE_UNPACK_LINE(_po, _stride, _length, _words, _type) \
+case t ## _type:                                               \
+{                                                              \
+    npy_intp _kk;                                              \
+    for(_kk = 0; _kk < _length; _kk++) {                       \
+        *(_type*)_po = (_type)((_words[_kk / NI_WORD_BITS] >>  \
+                                (_kk % NI_WORD_BITS)) & 1);    \
+        _po += _stride;                                        \
+    }                                                          \
+}                                                              \
+break
+
+/* Pack the lines of an array along the last axis, in C order, into
+     nwords words each: */
+static int NI_PackBits(PyArrayObject *array, npy_intp length,
+                       npy_intp nwords, npy_intp nlines, NI_BitWord *words)
+{
+    NI_Iterator ii;
+    npy_intp jj, stride = array->nd > 0 ? array->strides[array->nd - 1] : 0;
+    char *pi = (void *)PyArray_DATA(array);
+
+    if (!NI_InitPointIterator(array, &ii))
+        return 0;
+    if (array->nd > 0 && !NI_LineIterator(&ii, array->nd - 1))
+        return 0;
+    for(jj = 0; jj < nlines; jj++) {
+        char *pl = pi;
+        switch(NI_CanonicalType(array->descr->type_num)) {
+            CASE_PACK_LINE(pl, stride, length, words, Bool);
+            CASE_PACK_LINE(pl, stride, length, words, UInt8);
+            CASE_PACK_LINE(pl, stride, length, words, UInt16);
+            CASE_PACK_LINE(pl, stride, length, words, UInt32);
+#if HAS_UINT64
+            CASE_PACK_LINE(pl, stride, length, words, UInt64);
+#endif
+            CASE_PACK_LINE(pl, stride, length, words, Int8);
+            CASE_PACK_LINE(pl, stride, length, words, Int16);
+            CASE_PACK_LINE(pl, stride, length, words, Int32);
+            CASE_PACK_LINE(pl, stride, length, words, Int64);
+            CASE_PACK_LINE(pl, stride, length, words, Float32);
+            CASE_PACK_LINE(pl, stride, length, words, Float64);
+        default:
+            PyErr_SetString(PyExc_RuntimeError, "data type not supported");
+            return 0;
+        }
+        words += nwords;
+        NI_ITERATOR_NEXT(ii, pi);
+    }
+    return 1;
+}
+
+/* Unpack the bits of the lines into an array: */
+static int NI_UnpackBits(NI_BitWord *words, npy_intp length, npy_intp nwords,
+                         npy_intp nlines, PyArrayObject *array)
+{
+    NI_Iterator io;
+    npy_intp jj, stride = array->nd > 0 ? array->strides[array->nd - 1] : 0;
+    char *po = (void *)PyArray_DATA(array);
+
+    if (!NI_InitPointIterator(array, &io))
+        return 0;
+    if (array->nd > 0 && !NI_LineIterator(&io, array->nd - 1))
+        return 0;
+    for(jj = 0; jj < nlines; jj++) {
+        char *pl = po;
+        switch(NI_CanonicalType(array->descr->type_num)) {
+            CASE_UNPACK_LINE(pl, stride, length, words, Bool);
+            CASE_UNPACK_LINE(pl, stride, length, words, UInt8);
+            CASE_UNPACK_LINE(pl, stride, length, words, UInt16);
+            CASE_UNPACK_LINE(pl, stride, length, words, UInt32);
+#if HAS_UINT64
+            CASE_UNPACK_LINE(pl, stride, length, words, UInt64);
+#endif
+            CASE_UNPACK_LINE(pl, stride, length, words, Int8);
+            CASE_UNPACK_LINE(pl, stride, length, words, Int16);
+            CASE_UNPACK_LINE(pl, stride, length, words, Int32);
+            CASE_UNPACK_LINE(pl, stride, length, words, Int64);
+            CASE_UNPACK_LINE(pl, stride, length, words, Float32);
+            CASE_UNPACK_LINE(pl, stride, length, words, Float64);
+        default:
+            PyErr_SetString(PyExc_RuntimeError, "data type not supported");
+            return 0;
+        }
+        words += nwords;
+        NI_ITERATOR_NEXT(io, po);
+    }
+    return 1;
+}
+
+/* Word w of a line shifted by shift elements, so that bit j is element
+     64 * w + j + shift of the line, or the border outside of the line: */
+static NI_BitWord NI_ShiftedWord(NI_BitWord *line, npy_intp nwords,
+                                 npy_intp w, npy_intp shift,
+                                 NI_BitWord border)
+{
+    npy_intp q = shift >= 0 ? shift / NI_WORD_BITS :
+                            -((NI_WORD_BITS - 1 - shift) / NI_WORD_BITS);
+    int b = (int)(shift - q * NI_WORD_BITS);
+    NI_BitWord lo, hi;
+
+    w += q;
+    lo = w >= 0 && w < nwords ? line[w] : border;
+    if (b == 0)
+        return lo;
+    hi = w + 1 >= 0 && w + 1 < nwords ? line[w + 1] : border;
+    return (lo >> b) | (hi << (NI_WORD_BITS - b));
+}
+
+int NI_PackedBinaryErosion(PyArrayObject* input, PyArrayObject* strct,
+                           PyArrayObject* mask, PyArrayObject* output,
+                           int bdr_value, npy_intp *origins, int invert,
+                           int iterations)
+{
+    NI_BitWord *words = NULL, *next = NULL, *mwords = NULL, *tmp;
+    NI_BitWord border, last_bits;
+    npy_intp *soffsets = NULL, *sshifts = NULL, *lsteps = NULL;
+    npy_intp length, nwords, nlines, size, ssize, nelements = 0;
+    npy_intp coordinates[MAXDIM], ldims[MAXDIM], jj, kk, ll, w;
+    char *dirty = NULL, *ndirty = NULL, *ctmp;
+    Bool *ps = (Bool*)PyArray_DATA(strct);
+    int rank = input->nd, lrank = rank > 0 ? rank - 1 : 0, iter, any;
+
+    size = 1;
+    for(ll = 0; ll < rank; ll++)
+        size *= input->dimensions[ll];
+    if (size == 0)
+        goto exit;
+    length = rank > 0 ? input->dimensions[rank - 1] : 1;
+    nwords = (length + NI_WORD_BITS - 1) / NI_WORD_BITS;
+    nlines = size / length;
+    for(ll = 0; ll < lrank; ll++)
+        ldims[ll] = input->dimensions[ll];
+    /* the bits of the last word of a line that are within the line: */
+    last_bits = length % NI_WORD_BITS ?
+                ((NI_BitWord)1 << (length % NI_WORD_BITS)) - 1 : ~(NI_BitWord)0;
+    border = bdr_value ? ~(NI_BitWord)0 : 0;
+
+    /* the offsets of the structure elements, as the offsets of the lines
+         along the other axes and a shift along the last axis: */
+    ssize = 1;
+    for(ll = 0; ll < rank; ll++)
+        ssize *= strct->dimensions[ll];
+    soffsets = (npy_intp*)malloc((ssize * lrank + 1) * sizeof(npy_intp));
+    sshifts = (npy_intp*)malloc(ssize * sizeof(npy_intp));
+    lsteps = (npy_intp*)malloc(ssize * sizeof(npy_intp));
+    if (!soffsets || !sshifts || !lsteps) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+    for(jj = 0; jj < ssize; jj++) {
+        npy_intp idx = jj, step = 0, stride = 1;
+        if (!ps[jj])
+            continue;
+        for(ll = rank - 1; ll >= 0; ll--) {
+            npy_intp sdim = strct->dimensions[ll];
+            npy_intp offset = idx % sdim - sdim / 2 - origins[ll];
+            idx /= sdim;
+            if (ll == rank - 1) {
+                sshifts[nelements] = offset;
+            } else {
+                soffsets[nelements * lrank + ll] = offset;
+                step += offset * stride;
+                stride *= ldims[ll];
+            }
+        }
+        if (rank == 0)
+            sshifts[nelements] = 0;
+        lsteps[nelements++] = step;
+    }
+
+    words = (NI_BitWord*)malloc(nlines * nwords * sizeof(NI_BitWord));
+    next = (NI_BitWord*)malloc(nlines * nwords * sizeof(NI_BitWord));
+    dirty = (char*)malloc(nlines);
+    ndirty = (char*)malloc(nlines);
+    if (!words || !next || !dirty || !ndirty) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+    if (!NI_PackBits(input, length, nwords, nlines, words))
+        goto exit;
+    if (mask) {
+        mwords = (NI_BitWord*)malloc(nlines * nwords * sizeof(NI_BitWord));
+        if (!mwords) {
+            PyErr_NoMemory();
+            goto exit;
+        }
+        if (!NI_PackBits(mask, length, nwords, nlines, mwords))
+            goto exit;
+    }
+    /* set the bits past the end of the lines to the border value: */
+    for(jj = 0; jj < nlines; jj++) {
+        NI_BitWord *line = words + jj * nwords;
+        line[nwords - 1] = (line[nwords - 1] & last_bits) |
+                           (border & ~last_bits);
+    }
+
+    for(iter = 0; iterations < 1 || iter < iterations; iter++) {
+        any = 0;
+        for(ll = 0; ll < lrank; ll++)
+            coordinates[ll] = 0;
+        for(jj = 0; jj < nlines; jj++) {
+            NI_BitWord *line = words + jj * nwords, *out = next + jj * nwords;
+            int update = iter == 0;
+            /* after the first iteration, a line changes only if one of the
+                 lines the structure covers changed in the last one: */
+            for(kk = 0; kk < nelements && !update; kk++) {
+                npy_intp *so = soffsets + kk * lrank;
+                for(ll = 0; ll < lrank; ll++) {
+                    npy_intp cc = coordinates[ll] + so[ll];
+                    if (cc < 0 || cc >= ldims[ll])
+                        break;
+                }
+                if (ll == lrank && dirty[jj + lsteps[kk]]) {
+                    update = 1;
+                    break;
+                }
+            }
+            ndirty[jj] = 0;
+            if (update) {
+                for(w = 0; w < nwords; w++) {
+                    NI_BitWord acc = invert ? 0 : ~(NI_BitWord)0;
+                    for(kk = 0; kk < nelements; kk++) {
+                        npy_intp *so = soffsets + kk * lrank;
+                        NI_BitWord value;
+                        for(ll = 0; ll < lrank; ll++) {
+                            npy_intp cc = coordinates[ll] + so[ll];
+                            if (cc < 0 || cc >= ldims[ll])
+                                break;
+                        }
+                        if (ll < lrank)
+                            value = border;
+                        else
+                            value = NI_ShiftedWord(words + (jj + lsteps[kk]) *
+                                                   nwords, nwords, w,
+                                                   sshifts[kk], border);
+                        if (invert) {
+                            acc |= value;
+                        } else {
+                            acc &= value;
+                            if (!acc)
+                                break;
+                        }
+                    }
+                    /* elements outside of the mask do not change: */
+                    if (mwords)
+                        acc = (acc & mwords[jj * nwords + w]) |
+                              (line[w] & ~mwords[jj * nwords + w]);
+                    if (w == nwords - 1)
+                        acc = (acc & last_bits) | (border & ~last_bits);
+                    if (acc != line[w])
+                        ndirty[jj] = 1;
+                    out[w] = acc;
+                }
+                any |= ndirty[jj];
+            } else {
+                for(w = 0; w < nwords; w++)
+                    out[w] = line[w];
+            }
+            for(ll = lrank - 1; ll >= 0; ll--) {
+                if (++coordinates[ll] < ldims[ll])
+                    break;
+                coordinates[ll] = 0;
+            }
+        }
+        tmp = words;
+        words = next;
+        next = tmp;
+        ctmp = dirty;
+        dirty = ndirty;
+        ndirty = ctmp;
+        if (!any)
+            break;
+    }
+    if (!NI_UnpackBits(words, length, nwords, nlines, output))
+        goto exit;
+
+ exit:
+    if (soffsets) free(soffsets);
+    if (sshifts) free(sshifts);
+    if (lsteps) free(lsteps);
+    if (words) free(words);
+    if (next) free(next);
+    if (mwords) free(mwords);
+    if (dirty) free(dirty);
+    if (ndirty) free(ndirty);
+    return PyErr_Occurred() ? 0 : 1;
+}
+
 int NI_DistanceTransformBruteForce(PyArrayObject* input, int metric,
                                                                      PyArrayObject *sampling_arr,
                                                                      PyArrayObject* distances,
@@ -954,3 +1269,200 @@ int NI_EuclideanFeatureTransform(PyArrayObject* input,
 
     return PyErr_Occurred() ? 0 : 1;
 }
+
+#define CASE_EDT_GET(_pd, _stride, _buffer, _length, _type) \
+case t ## _type:                                            \
+{                                                           \
+    npy_intp _ii;                                           \
+    for(_ii = 0; _ii < _length; _ii++)                      \
+        _buffer[_ii] = *(_type*)(_pd + _ii * _stride);      \
+}                                                           \
+break
+
+#define CASE_EDT_SET(_pd, _stride, _buffer, _length, _root, _type) \
+case t ## _type:                                                   \
+{                                                                  \
+    npy_intp _ii;                                                  \
+    if (_root)                                                     \
+        for(_ii = 0; _ii < _length; _ii++)                         \
+            *(_type*)(_pd + _ii * _stride) = sqrt(_buffer[_ii]);   \
+    else                                                           \
+        for(_ii = 0; _ii < _length; _ii++)                         \
+            *(_type*)(_pd + _ii * _stride) = _buffer[_ii];         \
+}                                                                  \
+break
+
+typedef struct {
+    PyArrayObject *input, *distances;
+    Float64 *sampling;
+    double *buffers;
+    npy_intp *vertices, max_length;
+    int axis, last;
+} NI_DistanceData;
+
+/* One pass of the distance transform over a range of the lines along
+     an axis. The first pass finds the distance to the nearest background
+     element on the line itself, the following passes take the lower
+     envelope of the parabolas rooted at the squared distances of the
+     previous pass: */
+static int NI_DistanceLines(void *data, npy_intp first, npy_intp count,
+                            int thread)
+{
+    NI_DistanceData *dd = (NI_DistanceData*)data;
+    PyArrayObject *distances = dd->distances;
+    int rank = distances->nd, axis = dd->axis, type;
+    npy_intp length = rank > 0 ? distances->dimensions[axis] : 1;
+    npy_intp dstride = rank > 0 ? distances->strides[axis] : 0;
+    npy_intp istride = rank > 0 ? dd->input->strides[axis] : 0;
+    double *f = dd->buffers + thread * (3 * dd->max_length + 1);
+    double *d = f + dd->max_length, *z = d + dd->max_length;
+    npy_intp *v = dd->vertices + thread * dd->max_length;
+    double w = 1.0;
+    npy_intp line, ii;
+
+    if (dd->sampling)
+        w = dd->sampling[axis] * dd->sampling[axis];
+    type = NI_CanonicalType(distances->descr->type_num);
+    for(line = first; line < first + count; line++) {
+        char *pd = (void *)PyArray_DATA(distances);
+        char *pi = (void *)PyArray_DATA(dd->input);
+        npy_intp tmp = line;
+        int ll;
+        /* the lines are numbered with the last axis varying fastest: */
+        for(ll = rank - 1; ll >= 0; ll--) {
+            npy_intp cc;
+            if (ll == axis)
+                continue;
+            cc = tmp % distances->dimensions[ll];
+            tmp /= distances->dimensions[ll];
+            pd += cc * distances->strides[ll];
+            pi += cc * dd->input->strides[ll];
+        }
+        if (axis == rank - 1 || rank == 0) {
+            npy_intp last = -1;
+            /* distances to the nearest background element on the line: */
+            for(ii = 0; ii < length; ii++) {
+                if (!*(Int8*)(pi + ii * istride))
+                    last = ii;
+                d[ii] = last >= 0 ? (double)(ii - last) : HUGE_VAL;
+            }
+            last = -1;
+            for(ii = length - 1; ii >= 0; ii--) {
+                if (!*(Int8*)(pi + ii * istride))
+                    last = ii;
+                if (last >= 0 && last - ii < d[ii])
+                    d[ii] = (double)(last - ii);
+                if (d[ii] < HUGE_VAL)
+                    d[ii] *= d[ii] * w;
+            }
+        } else {
+            npy_intp k = -1, q;
+            switch (type) {
+            CASE_EDT_GET(pd, dstride, f, length, Float32);
+            CASE_EDT_GET(pd, dstride, f, length, Float64);
+            default:
+                return 0;
+            }
+            /* lower envelope of the parabolas w (x - q)^2 + f[q], with
+                 v[k] the vertex of the k-th parabola of the envelope and
+                 z[k] the point where it starts to be the lowest: */
+            for(q = 0; q < length; q++) {
+                double s = -HUGE_VAL;
+                if (f[q] == HUGE_VAL)
+                    continue;
+                while(k >= 0) {
+                    npy_intp p = v[k];
+                    s = ((f[q] + w * q * q) - (f[p] + w * p * p)) /
+                                                        (2.0 * w * (q - p));
+                    if (s > z[k])
+                        break;
+                    s = -HUGE_VAL;
+                    --k;
+                }
+                ++k;
+                v[k] = q;
+                z[k] = s;
+            }
+            if (k < 0) {
+                /* no background on the line and its subspace: */
+                for(ii = 0; ii < length; ii++)
+                    d[ii] = HUGE_VAL;
+            } else {
+                npy_intp jj = 0;
+                for(ii = 0; ii < length; ii++) {
+                    double t;
+                    while(jj < k && z[jj + 1] < ii)
+                        ++jj;
+                    t = (double)(ii - v[jj]);
+                    d[ii] = w * t * t + f[v[jj]];
+                }
+            }
+        }
+        switch (type) {
+        CASE_EDT_SET(pd, dstride, d, length, dd->last, Float32);
+        CASE_EDT_SET(pd, dstride, d, length, dd->last, Float64);
+        default:
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Exact euclidean distance transform without a feature transform, by
+     separable passes of one dimensional transforms along each axis, as
+     described in: P. F. Felzenszwalb, D. P. Huttenlocher, "Distance
+     transforms of sampled functions", Cornell Computing and Information
+     Science TR2004-1963, 2004. The lines along an axis are independent
+     and divided over the threads. */
+int NI_EuclideanDistanceTransform(PyArrayObject* input,
+                                  PyArrayObject *sampling_arr,
+                                  PyArrayObject* distances, int threads)
+{
+    NI_DistanceData dd;
+    npy_intp size = 1;
+    int ii, result = 1;
+
+    dd.buffers = NULL;
+    dd.vertices = NULL;
+    dd.input = input;
+    dd.distances = distances;
+    dd.sampling = sampling_arr ? (void *)PyArray_DATA(sampling_arr) : NULL;
+    dd.max_length = 1;
+    for(ii = 0; ii < input->nd; ii++) {
+        size *= input->dimensions[ii];
+        if (input->dimensions[ii] > dd.max_length)
+            dd.max_length = input->dimensions[ii];
+    }
+    if (size == 0)
+        goto exit;
+    if (threads < 1)
+        threads = 1;
+    if (threads > NI_MAX_THREADS)
+        threads = NI_MAX_THREADS;
+    dd.buffers = (double*)malloc(threads * (3 * dd.max_length + 1) *
+                                 sizeof(double));
+    dd.vertices = (npy_intp*)malloc(threads * dd.max_length *
+                                    sizeof(npy_intp));
+    if (!dd.buffers || !dd.vertices) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+    /* the first pass runs along the last axis, the square root is taken
+         in the pass along the first axis: */
+    ii = input->nd > 0 ? input->nd - 1 : 0;
+    for(; ii >= 0 && result; ii--) {
+        npy_intp lines = input->nd > 0 ? size / input->dimensions[ii] : 1;
+        dd.axis = ii;
+        dd.last = ii == 0;
+        result = NI_RunThreads(lines, threads, NI_DistanceLines, &dd);
+    }
+    if (!result)
+        PyErr_SetString(PyExc_RuntimeError, "data type not supported");
+
+ exit:
+    if (dd.buffers)
+        free(dd.buffers);
+    if (dd.vertices)
+        free(dd.vertices);
+    return PyErr_Occurred() ? 0 : 1;
+}
@@ -36,11 +36,15 @@ int NI_BinaryErosion(PyArrayObject*, PyArrayObject*, PyArrayObject*,
          PyArrayObject*, int, npy_intp*, int, int, int*, NI_CoordinateList**);
 int NI_BinaryErosion2(PyArrayObject*, PyArrayObject*, PyArrayObject*,
                       int, npy_intp*, int, NI_CoordinateList**);
+int NI_PackedBinaryErosion(PyArrayObject*, PyArrayObject*, PyArrayObject*,
+                           PyArrayObject*, int, npy_intp*, int, int);
 int NI_DistanceTransformBruteForce(PyArrayObject*, int, PyArrayObject*,
                                                                      PyArrayObject*, PyArrayObject*);
 int NI_DistanceTransformOnePass(PyArrayObject*, PyArrayObject *,
                                                                 PyArrayObject*);
 int NI_EuclideanFeatureTransform(PyArrayObject*, PyArrayObject*, 
                                                                  PyArrayObject*);
+int NI_EuclideanDistanceTransform(PyArrayObject*, PyArrayObject*,
+                                  PyArrayObject*, int);
 
 #endif
@@ -31,6 +31,15 @@
 
 #include "ni_support.h"
 
+#if defined(_WIN32)
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
+#define BUFFER_SIZE 256000
+
 /* initialize iterations over single array elements: */
 int NI_InitPointIterator(PyArrayObject *array, NI_Iterator *iterator)
 {
@@ -170,6 +179,28 @@ int NI_InitLineBuffer(PyArrayObject *array, int axis, npy_intp size1,
         PyErr_SetString(PyExc_RuntimeError, "buffer too small");
         return 0;
     }
+    /* the supported types, checked here so that copying lines can not
+         fail in threads that run without the GIL: */
+    switch (NI_CanonicalType(PyArray_DESCR(array)->type_num)) {
+    case tBool:
+    case tUInt8:
+    case tUInt16:
+    case tUInt32:
+#if HAS_UINT64
+    case tUInt64:
+#endif
+    case tInt8:
+    case tInt16:
+    case tInt32:
+    case tInt64:
+    case tFloat32:
+    case tFloat64:
+        break;
+    default:
+        PyErr_Format(PyExc_RuntimeError, "array type %d not supported",
+                     PyArray_DESCR(array)->type_num);
+        return 0;
+    }
     /* Initialize a line iterator to move over the array: */
     if (!NI_InitPointIterator(array, &(buffer->iterator)))
         return 0;
@@ -319,6 +350,39 @@ int NI_ExtendLine(double *line, npy_intp length, npy_intp size1,
 }
 
 
+/* Index into a line of the given length, for an index outside of it
+     extended according to the mode, or -1 for a constant: */
+npy_intp NI_ExtendIndex(npy_intp index, npy_intp length, NI_ExtendMode mode)
+{
+    npy_intp period;
+
+    if (index >= 0 && index < length)
+        return index;
+    switch (mode) {
+    case NI_EXTEND_WRAP:
+        index %= length;
+        return index < 0 ? index + length : index;
+    case NI_EXTEND_MIRROR:
+        if (length == 1)
+            return 0;
+        period = 2 * length - 2;
+        index %= period;
+        if (index < 0)
+            index += period;
+        return index < length ? index : period - index;
+    case NI_EXTEND_REFLECT:
+        period = 2 * length;
+        index %= period;
+        if (index < 0)
+            index += period;
+        return index < length ? index : period - index - 1;
+    case NI_EXTEND_NEAREST:
+        return index < 0 ? 0 : length - 1;
+    default:
+        return -1;
+    }
+}
+
 #define CASE_COPY_DATA_TO_LINE(_pi, _po, _length, _stride, _type) \
 case t ## _type:                                                  \
 {                                                                 \
@@ -438,6 +502,491 @@ int NI_LineBufferToArray(NI_LineBuffer *buffer)
     return 1;
 }
 
+/* Restrict a line buffer to count lines, starting at line first. Must
+     be called before the first line is copied: */
+int NI_LineBufferRange(NI_LineBuffer *buffer, npy_intp first,
+                       npy_intp count)
+{
+    npy_intp index = first, coordinate;
+    int ii;
+
+    for(ii = buffer->iterator.rank_m1; ii >= 0; ii--) {
+        npy_intp dimension = buffer->iterator.dimensions[ii] + 1;
+        coordinate = dimension > 0 ? index % dimension : 0;
+        index = dimension > 0 ? index / dimension : 0;
+        buffer->iterator.coordinates[ii] = coordinate;
+        buffer->array_data += coordinate * buffer->iterator.strides[ii];
+    }
+    buffer->next_line = first;
+    buffer->array_lines = first + count;
+    return 1;
+}
+
+/******************************************************************/
+/* Threads */
+/******************************************************************/
+
+typedef struct {
+    NI_ThreadFunction function;
+    void *data;
+    npy_intp first, count;
+    int thread, result;
+} NI_ThreadTask;
+
+#if defined(_WIN32)
+static unsigned __stdcall NI_ThreadMain(void *arg)
+#else
+static void *NI_ThreadMain(void *arg)
+#endif
+{
+    NI_ThreadTask *task = (NI_ThreadTask*)arg;
+
+    task->result = task->function(task->data, task->first, task->count,
+                                  task->thread);
+    return 0;
+}
+
+/* Run a function over n items, divided in contiguous ranges over the
+     threads. The calling thread processes the first range. The GIL is
+     released, so the function must not use the Python API; it returns 0
+     to signal an error, which the caller reports. With less than one
+     thread the function runs in the calling thread with the GIL, for
+     functions that call back into Python: */
+int NI_RunThreads(npy_intp n, int threads, NI_ThreadFunction function,
+                  void *data)
+{
+    NI_ThreadTask tasks[NI_MAX_THREADS];
+#if defined(_WIN32)
+    HANDLE handles[NI_MAX_THREADS];
+#else
+    pthread_t handles[NI_MAX_THREADS];
+#endif
+    int started[NI_MAX_THREADS];
+    int ii, result = 1;
+
+    if (threads < 1)
+        return function(data, 0, n, 0);
+    if (threads > NI_MAX_THREADS)
+        threads = NI_MAX_THREADS;
+    if (threads > n)
+        threads = n > 0 ? (int)n : 1;
+    if (threads == 1) {
+        Py_BEGIN_ALLOW_THREADS
+        result = function(data, 0, n, 0);
+        Py_END_ALLOW_THREADS
+        return result;
+    }
+    for(ii = 0; ii < threads; ii++) {
+        tasks[ii].function = function;
+        tasks[ii].data = data;
+        tasks[ii].first = n * ii / threads;
+        tasks[ii].count = n * (ii + 1) / threads - tasks[ii].first;
+        tasks[ii].thread = ii;
+        tasks[ii].result = 0;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    for(ii = 1; ii < threads; ii++) {
+#if defined(_WIN32)
+        handles[ii] = (HANDLE)_beginthreadex(NULL, 0, NI_ThreadMain,
+                                             tasks + ii, 0, NULL);
+        started[ii] = handles[ii] != 0;
+#else
+        started[ii] = pthread_create(handles + ii, NULL, NI_ThreadMain,
+                                     tasks + ii) == 0;
+#endif
+    }
+    NI_ThreadMain(tasks);
+    for(ii = 1; ii < threads; ii++) {
+        /* if a thread could not be started, do its work here: */
+        if (!started[ii]) {
+            NI_ThreadMain(tasks + ii);
+            continue;
+        }
+#if defined(_WIN32)
+        WaitForSingleObject(handles[ii], INFINITE);
+        CloseHandle(handles[ii]);
+#else
+        pthread_join(handles[ii], NULL);
+#endif
+    }
+    Py_END_ALLOW_THREADS
+    for(ii = 0; ii < threads; ii++)
+        if (!tasks[ii].result)
+            result = 0;
+    return result;
+}
+
+typedef struct {
+    NI_LineBuffer *ibuffers, *obuffers;
+    NI_LineFunction function;
+    void *data;
+    double *work;
+    npy_intp work_size;
+} NI_FilterLinesData;
+
+/* filter a range of lines with the line buffers of a thread: */
+static int NI_FilterLineRange(void *data, npy_intp first, npy_intp count,
+                              int thread)
+{
+    NI_FilterLinesData *fd = (NI_FilterLinesData*)data;
+    NI_LineBuffer *iline_buffer = fd->ibuffers + thread;
+    NI_LineBuffer *oline_buffer = fd->obuffers + thread;
+    double *work = fd->work ? fd->work + thread * fd->work_size : NULL;
+    npy_intp ii, lines, length = oline_buffer->line_length;
+    npy_intp size = iline_buffer->line_length + iline_buffer->size1 +
+                    iline_buffer->size2;
+    int more;
+
+    NI_LineBufferRange(iline_buffer, first, count);
+    NI_LineBufferRange(oline_buffer, first, count);
+    do {
+        /* copy lines from array to buffer: */
+        if (!NI_ArrayToLineBuffer(iline_buffer, &lines, &more))
+            return 0;
+        /* iterate over the lines in the buffers: */
+        for(ii = 0; ii < lines; ii++) {
+            double *iline = NI_GET_LINE(*iline_buffer, ii);
+            double *oline = NI_GET_LINE(*oline_buffer, ii);
+            if (!fd->function(iline, size, oline, length, fd->data, work))
+                return 0;
+        }
+        /* copy lines from buffer to array: */
+        if (!NI_LineBufferToArray(oline_buffer))
+            return 0;
+    } while(more);
+    return 1;
+}
+
+int NI_FilterLines(PyArrayObject *input, PyArrayObject *output, int axis,
+                   npy_intp size1, npy_intp size2, NI_ExtendMode mode,
+                   double cval, NI_LineFunction function, void *data,
+                   npy_intp work_size, int threads)
+{
+    NI_LineBuffer ibuffers[NI_MAX_THREADS], obuffers[NI_MAX_THREADS];
+    double *ibuffer[NI_MAX_THREADS], *obuffer[NI_MAX_THREADS];
+    NI_FilterLinesData fd;
+    npy_intp lines, array_lines = 0;
+    int ii, nbuffers;
+
+    if (mode < NI_EXTEND_FIRST || mode > NI_EXTEND_LAST) {
+        PyErr_SetString(PyExc_RuntimeError, "mode not supported");
+        return 0;
+    }
+    /* no more threads than lines: */
+    lines = 1;
+    for(ii = 0; ii < input->nd; ii++)
+        if (ii != axis)
+            lines *= input->dimensions[ii];
+    if (threads > lines)
+        threads = (int)lines;
+    if (threads > NI_MAX_THREADS)
+        threads = NI_MAX_THREADS;
+    /* less than one thread keeps the GIL, with a single set of buffers: */
+    nbuffers = threads < 1 ? 1 : threads;
+    for(ii = 0; ii < nbuffers; ii++)
+        ibuffer[ii] = obuffer[ii] = NULL;
+    fd.ibuffers = ibuffers;
+    fd.obuffers = obuffers;
+    fd.function = function;
+    fd.data = data;
+    fd.work = NULL;
+    fd.work_size = work_size;
+    /* allocate and initialize the line buffers of each thread: */
+    for(ii = 0; ii < nbuffers; ii++) {
+        lines = -1;
+        if (!NI_AllocateLineBuffer(input, axis, size1, size2, &lines,
+                                   BUFFER_SIZE, &ibuffer[ii]))
+            goto exit;
+        if (!NI_AllocateLineBuffer(output, axis, 0, 0, &lines, BUFFER_SIZE,
+                                   &obuffer[ii]))
+            goto exit;
+        if (!NI_InitLineBuffer(input, axis, size1, size2, lines, ibuffer[ii],
+                               mode, cval, &ibuffers[ii]))
+            goto exit;
+        if (!NI_InitLineBuffer(output, axis, 0, 0, lines, obuffer[ii], mode,
+                               0.0, &obuffers[ii]))
+            goto exit;
+        array_lines = ibuffers[ii].array_lines;
+    }
+    if (work_size > 0) {
+        fd.work = (double*)malloc(nbuffers * work_size * sizeof(double));
+        if (!fd.work) {
+            PyErr_NoMemory();
+            goto exit;
+        }
+    }
+    if (!NI_RunThreads(array_lines, threads, NI_FilterLineRange, &fd) &&
+            !PyErr_Occurred())
+        PyErr_SetString(PyExc_RuntimeError,
+                        "unknown error in line processing function");
+exit:
+    for(ii = 0; ii < nbuffers; ii++) {
+        if (ibuffer[ii]) free(ibuffer[ii]);
+        if (obuffer[ii]) free(obuffer[ii]);
+    }
+    if (fd.work) free(fd.work);
+    return PyErr_Occurred() ? 0 : 1;
+}
+
+/* read a block of lines, adjacent in memory, interleaved: */
+#define CASE_INTEGER_READ(_pi, _stride, _bstride, _length, _nb, _line, \
+                          _type)                                       \
+case t ## _type:                                                       \
+{                                                                      \
+    npy_intp _ii, _jj;                                                 \
+    if (_nb == 1) {                                                    \
+        if (_stride == sizeof(_type)) {                                \
+            for(_ii = 0; _ii < _length; _ii++)                         \
+                _line[_ii] = ((_type*)_pi)[_ii];                       \
+        } else {                                                       \
+            for(_ii = 0; _ii < _length; _ii++)                         \
+                _line[_ii] = *(_type*)(_pi + _ii * _stride);           \
+        }                                                              \
+        break;                                                         \
+    }                                                                  \
+    for(_ii = 0; _ii < _length; _ii++) {                               \
+        Int32 *_pl = _line + _ii * _nb;                                \
+        if (_bstride == sizeof(_type)) {                               \
+            for(_jj = 0; _jj < _nb; _jj++)                             \
+                _pl[_jj] = ((_type*)_pi)[_jj];                         \
+        } else {                                                       \
+            for(_jj = 0; _jj < _nb; _jj++)                             \
+                _pl[_jj] = *(_type*)(_pi + _jj * _bstride);            \
+        }                                                              \
+        _pi += _stride;                                                \
+    }                                                                  \
+}                                                                      \
+break
+
+#define CASE_INTEGER_WRITE(_po, _stride, _bstride, _length, _nb, _line, \
+                           _type)                                       \
+case t ## _type:                                                        \
+{                                                                       \
+    npy_intp _ii, _jj;                                                  \
+    if (_nb == 1) {                                                     \
+        if (_stride == sizeof(_type)) {                                 \
+            for(_ii = 0; _ii < _length; _ii++)                          \
+                ((_type*)_po)[_ii] = (_type)_line[_ii];                 \
+        } else {                                                        \
+            for(_ii = 0; _ii < _length; _ii++)                          \
+                *(_type*)(_po + _ii * _stride) = (_type)_line[_ii];     \
+        }                                                               \
+        break;                                                          \
+    }                                                                   \
+    for(_ii = 0; _ii < _length; _ii++) {                                \
+        Int32 *_pl = _line + _ii * _nb;                                 \
+        if (_bstride == sizeof(_type)) {                                \
+            for(_jj = 0; _jj < _nb; _jj++)                              \
+                ((_type*)_po)[_jj] = (_type)_pl[_jj];                   \
+        } else {                                                        \
+            for(_jj = 0; _jj < _nb; _jj++)                              \
+                *(_type*)(_po + _jj * _bstride) = (_type)_pl[_jj];      \
+        }                                                               \
+        _po += _stride;                                                 \
+    }                                                                   \
+}                                                                       \
+break
+
+/* The largest magnitude of the values of an integer array type that
+     can be filtered in 32-bit integers, or 0 if not supported: */
+npy_int64 NI_IntegerLineMaximum(PyArrayObject *input, PyArrayObject *output)
+{
+    switch (NI_CanonicalType(output->descr->type_num)) {
+    case tUInt8:
+    case tUInt16:
+    case tUInt32:
+#if HAS_UINT64
+    case tUInt64:
+#endif
+    case tInt8:
+    case tInt16:
+    case tInt32:
+    case tInt64:
+        break;
+    default:
+        return 0;
+    }
+    switch (NI_CanonicalType(input->descr->type_num)) {
+    case tUInt8:
+        return 255;
+    case tInt8:
+        return 128;
+    case tUInt16:
+        return 65535;
+    case tInt16:
+        return 32768;
+    default:
+        return 0;
+    }
+}
+
+typedef struct {
+    NI_LineBuffer *ibuffers, *obuffers;
+    NI_IntegerLineFunction function;
+    void *data;
+    Int32 *lines, cval;
+    npy_intp *map, size1, size2, block, block_size;
+} NI_IntegerLinesData;
+
+/* filter a range of lines with the integer lines of a thread. Lines
+     that follow each other along the last axis of the iteration are
+     filtered together, interleaved, so that the filter loops run over
+     all of them at once, and so that they are read and written in
+     contiguous runs if the filtered axis is not the last one: */
+static int NI_IntegerLineRange(void *data, npy_intp first, npy_intp count,
+                               int thread)
+{
+    NI_IntegerLinesData *ld = (NI_IntegerLinesData*)data;
+    NI_LineBuffer *ib = ld->ibuffers + thread, *ob = ld->obuffers + thread;
+    npy_intp jj, kk, nb, length = ib->line_length, block = ld->block;
+    npy_intp size1 = ld->size1, extended = size1 + length + ld->size2;
+    int last = ib->iterator.rank_m1;
+    npy_intp istride = last >= 0 ? ib->iterator.strides[last] : 0;
+    npy_intp ostride = last >= 0 ? ob->iterator.strides[last] : 0;
+    Int32 *iline = ld->lines + thread * ld->block_size;
+    Int32 *oline = iline + extended * block;
+
+    NI_LineBufferRange(ib, first, count);
+    NI_LineBufferRange(ob, first, count);
+    for(jj = 0; jj < count; jj += nb) {
+        char *pi = ib->array_data, *po = ob->array_data;
+        Int32 *pl;
+        /* the lines of a block share their other coordinates: */
+        nb = count - jj < block ? count - jj : block;
+        if (block > 1 && nb > ib->iterator.dimensions[last] + 1 -
+                                            ib->iterator.coordinates[last])
+            nb = ib->iterator.dimensions[last] + 1 -
+                                            ib->iterator.coordinates[last];
+        pl = iline + size1 * nb;
+        switch (ib->array_type) {
+            CASE_INTEGER_READ(pi, ib->line_stride, istride, length, nb,
+                              pl, UInt8);
+            CASE_INTEGER_READ(pi, ib->line_stride, istride, length, nb,
+                              pl, UInt16);
+            CASE_INTEGER_READ(pi, ib->line_stride, istride, length, nb,
+                              pl, Int8);
+            CASE_INTEGER_READ(pi, ib->line_stride, istride, length, nb,
+                              pl, Int16);
+        default:
+            return 0;
+        }
+        /* extend the lines from their own elements: */
+        for(kk = 0; kk < extended; kk++) {
+            npy_intp ll;
+            Int32 *pk = iline + kk * nb, *ps;
+            if (kk == size1) {
+                kk += length - 1;
+                continue;
+            }
+            if (ld->map[kk] < 0) {
+                for(ll = 0; ll < nb; ll++)
+                    pk[ll] = ld->cval;
+            } else {
+                ps = pl + ld->map[kk] * nb;
+                for(ll = 0; ll < nb; ll++)
+                    pk[ll] = ps[ll];
+            }
+        }
+        ld->function(iline, oline, length, nb, ld->data);
+        switch (ob->array_type) {
+            CASE_INTEGER_WRITE(po, ob->line_stride, ostride, length, nb,
+                               oline, UInt8);
+            CASE_INTEGER_WRITE(po, ob->line_stride, ostride, length, nb,
+                               oline, UInt16);
+            CASE_INTEGER_WRITE(po, ob->line_stride, ostride, length, nb,
+                               oline, UInt32);
+#if HAS_UINT64
+            CASE_INTEGER_WRITE(po, ob->line_stride, ostride, length, nb,
+                               oline, UInt64);
+#endif
+            CASE_INTEGER_WRITE(po, ob->line_stride, ostride, length, nb,
+                               oline, Int8);
+            CASE_INTEGER_WRITE(po, ob->line_stride, ostride, length, nb,
+                               oline, Int16);
+            CASE_INTEGER_WRITE(po, ob->line_stride, ostride, length, nb,
+                               oline, Int32);
+            CASE_INTEGER_WRITE(po, ob->line_stride, ostride, length, nb,
+                               oline, Int64);
+        default:
+            return 0;
+        }
+        for(kk = 0; kk < nb; kk++) {
+            NI_ITERATOR_NEXT(ib->iterator, ib->array_data);
+            NI_ITERATOR_NEXT(ob->iterator, ob->array_data);
+        }
+    }
+    return 1;
+}
+
+int NI_IntegerFilterLines(PyArrayObject *input, PyArrayObject *output,
+                          int axis, npy_intp size1, npy_intp size2,
+                          NI_ExtendMode mode, Int32 cval,
+                          NI_IntegerLineFunction function, void *data,
+                          int threads)
+{
+    NI_LineBuffer ibuffers[NI_MAX_THREADS], obuffers[NI_MAX_THREADS];
+    NI_IntegerLinesData ld;
+    npy_intp lines, length;
+    int ii, nbuffers;
+
+    if (!NI_IntegerLineMaximum(input, output)) {
+        PyErr_SetString(PyExc_RuntimeError, "array type not supported");
+        return 0;
+    }
+    if (mode < NI_EXTEND_FIRST || mode > NI_EXTEND_LAST) {
+        PyErr_SetString(PyExc_RuntimeError, "mode not supported");
+        return 0;
+    }
+    /* no more threads than lines: */
+    lines = 1;
+    for(ii = 0; ii < input->nd; ii++)
+        if (ii != axis)
+            lines *= input->dimensions[ii];
+    if (threads > lines)
+        threads = (int)lines;
+    if (threads > NI_MAX_THREADS)
+        threads = NI_MAX_THREADS;
+    nbuffers = threads < 1 ? 1 : threads;
+    length = input->nd > 0 ? input->dimensions[axis] : 1;
+    ld.ibuffers = ibuffers;
+    ld.obuffers = obuffers;
+    ld.function = function;
+    ld.data = data;
+    ld.cval = cval;
+    ld.size1 = size1;
+    ld.size2 = size2;
+    /* the lines hold only the elements of one line, so the buffers of
+         the line buffer structures are not used: */
+    for(ii = 0; ii < nbuffers; ii++) {
+        if (!NI_InitLineBuffer(input, axis, size1, size2, 1, NULL, mode,
+                               0.0, &ibuffers[ii]))
+            return 0;
+        if (!NI_InitLineBuffer(output, axis, 0, 0, 1, NULL, mode, 0.0,
+                               &obuffers[ii]))
+            return 0;
+    }
+    if (ibuffers[0].array_lines == 0 || length == 0)
+        return 1;
+    ld.block = axis < input->nd - 1 ? NI_INTEGER_BLOCK : 1;
+    ld.block_size = (size1 + 2 * length + size2) * ld.block;
+    ld.lines = (Int32*)malloc(nbuffers * ld.block_size * sizeof(Int32));
+    ld.map = (npy_intp*)malloc((size1 + length + size2) * sizeof(npy_intp));
+    if (!ld.lines || !ld.map) {
+        PyErr_NoMemory();
+        goto exit;
+    }
+    /* the elements of the line that extend it at either side: */
+    for(ii = 0; ii < size1 + length + size2; ii++)
+        ld.map[ii] = NI_ExtendIndex(ii - size1, length, mode);
+    if (!NI_RunThreads(ibuffers[0].array_lines, threads, NI_IntegerLineRange,
+                       &ld) && !PyErr_Occurred())
+        PyErr_SetString(PyExc_RuntimeError, "array type not supported");
+exit:
+    if (ld.lines) free(ld.lines);
+    if (ld.map) free(ld.map);
+    return PyErr_Occurred() ? 0 : 1;
+}
+
 /******************************************************************/
 /* Multi-dimensional filter support functions */
 /******************************************************************/
@@ -169,6 +169,9 @@ typedef struct {
 #define NI_GET_LINE(_buffer, _line)                                      \
     ((_buffer).buffer_data + (_line) * ((_buffer).line_length +            \
                                                                             (_buffer).size1 + (_buffer).size2))
+/* The type number of the fixed size type of an ambiguous NumPy type: */
+int NI_CanonicalType(int);
+
 /* Allocate line buffer data */
 int NI_AllocateLineBuffer(PyArrayObject*, int, npy_intp, npy_intp,
                            npy_intp*, npy_intp, double**);
@@ -180,12 +183,65 @@ int NI_InitLineBuffer(PyArrayObject*, int, npy_intp, npy_intp, npy_intp,
 /* Extend a line in memory to implement boundary conditions: */
 int NI_ExtendLine(double*, npy_intp, npy_intp, npy_intp, NI_ExtendMode, double);
 
+/* Index into a line, extended according to the mode, or -1 for a
+     constant: */
+npy_intp NI_ExtendIndex(npy_intp, npy_intp, NI_ExtendMode);
+
 /* Copy a line from an array to a buffer: */
 int NI_ArrayToLineBuffer(NI_LineBuffer*, npy_intp*, int*);
 
 /* Copy a line from a buffer to an array: */
 int NI_LineBufferToArray(NI_LineBuffer*);
 
+/* Restrict a line buffer to a range of the lines of its array: */
+int NI_LineBufferRange(NI_LineBuffer*, npy_intp, npy_intp);
+
+/******************************************************************/
+/* Threads */
+/******************************************************************/
+
+#define NI_MAX_THREADS 64
+
+/* A function that processes a range of items, given by the first item
+     and the number of items, as the given thread: */
+typedef int (*NI_ThreadFunction)(void*, npy_intp, npy_intp, int);
+
+/* Divide a number of items over threads that run with the GIL
+     released. With less than one thread, the function runs directly
+     with the GIL, so that it may call Python: */
+int NI_RunThreads(npy_intp, int, NI_ThreadFunction, void*);
+
+/* A function that filters an extended input line of the given length
+     into an output line, with user data and a per-thread work array: */
+typedef int (*NI_LineFunction)(double*, npy_intp, double*, npy_intp,
+                               void*, double*);
+
+/* Filter all lines of an array along an axis with a line function, in
+     the given number of threads, each with its own line buffers and a
+     work array of the given size. The lines of the output may have a
+     different length than those of the input: */
+int NI_FilterLines(PyArrayObject*, PyArrayObject*, int, npy_intp, npy_intp,
+                   NI_ExtendMode, double, NI_LineFunction, void*, npy_intp,
+                   int);
+
+/* The largest magnitude of the input values, if the lines of the input
+     and output arrays can be filtered in 32-bit integers, or 0: */
+npy_int64 NI_IntegerLineMaximum(PyArrayObject*, PyArrayObject*);
+
+/* The largest number of lines filtered together by integer filters: */
+#define NI_INTEGER_BLOCK 64
+
+/* A function that filters a number of interleaved extended lines of
+     32-bit integers, of the given output length, with user data: */
+typedef void (*NI_IntegerLineFunction)(Int32*, Int32*, npy_intp, npy_intp,
+                                       void*);
+
+/* Filter all lines of an integer array along an axis with an integer
+     line function. The caller ensures that the sums can not overflow: */
+int NI_IntegerFilterLines(PyArrayObject*, PyArrayObject*, int, npy_intp,
+                          npy_intp, NI_ExtendMode, Int32,
+                          NI_IntegerLineFunction, void*, int);
+
 /******************************************************************/
 /* Multi-dimensional filter support functions */
 /******************************************************************/
@@ -1,6 +1,6 @@
 from numpy.testing import assert_, assert_array_almost_equal, assert_equal, \
                           assert_almost_equal, assert_array_equal, \
-                          run_module_suite, TestCase
+                          run_module_suite, TestCase, assert_raises
 import numpy as np
 
 import scipy.ndimage as ndimage
@@ -244,6 +244,44 @@ def test_label13():
         assert_array_almost_equal(out, expected)
         assert_equal(n, 1)
 
+def test_label_threads():
+    "label in slabs merged at their seams"
+    np.random.seed(0)
+    for shape in [(23, 19), (9, 7, 11), (1, 40), (40,)]:
+        data = np.random.random(shape) < 0.6
+        for rank in range(1, len(shape) + 1):
+            struct = ndimage.generate_binary_structure(len(shape), rank)
+            out, n = ndimage.label(data, struct)
+            for threads in [2, 3, 50]:
+                out2, n2, objects = ndimage.label(data, struct,
+                                                  threads=threads,
+                                                  objects=True)
+                assert_array_equal(out2, out)
+                assert_equal(n2, n)
+                assert_equal(objects, ndimage.find_objects(out))
+
+def test_label_int64():
+    "label with an int64 output"
+    data = np.array([[1, 0, 1], [0, 0, 1], [1, 1, 0]])
+    out, n = ndimage.label(data, output=np.int64)
+    assert_equal(out.dtype, np.int64)
+    assert_array_equal(out, [[1, 0, 2], [0, 0, 2], [3, 3, 0]])
+    assert_equal(n, 3)
+    out = np.zeros((3, 3), np.int64)
+    n, objects = ndimage.label(data, output=out, objects=True)
+    assert_equal(n, 3)
+    assert_equal(objects, [(slice(0, 1), slice(0, 1)),
+                           (slice(0, 2), slice(2, 3)),
+                           (slice(2, 3), slice(0, 2))])
+    for type in [np.int64, np.longlong]:
+        out, n = ndimage.label(data, output=type)
+        assert_equal(out.dtype.itemsize, 8)
+        assert_array_equal(out, [[1, 0, 2], [0, 0, 2], [3, 3, 0]])
+    n = ndimage.label(data, output=np.zeros((3, 3), np.longlong))
+    assert_equal(n, 3)
+    assert_raises(RuntimeError, ndimage.label, data,
+                  output=np.zeros((3, 3), np.int16))
+
 def test_find_objects01():
     "find_objects 1"
     data = np.ones([], dtype=int)
@@ -926,5 +964,67 @@ def test_histogram03():
     assert_array_almost_equal(output[0], expected1)
     assert_array_almost_equal(output[1], expected2)
 
+def test_histogram04():
+    "histogram 4"
+    labels = [1, 0, 1, 1, 2, 2, 2, 2]
+    input = np.array([1, 1, 3, 4, 3, 5, 3, 3])
+    assert_equal(ndimage.histogram(input, 0, 4, 5, labels, 3), None)
+
+def test_labeled_statistics():
+    "labeled_statistics against the single statistics"
+    np.random.seed(0)
+    data = np.random.random((17, 23))
+    labels = np.random.randint(0, 5, (17, 23))
+    index = [1, 3, 2, 7]
+    names = ['count', 'sum', 'mean', 'variance', 'minimum', 'maximum',
+             'minimum_position', 'maximum_position', 'center_of_mass',
+             'bounding_box', 'histogram']
+    for threads in [1, 3]:
+        s = ndimage.labeled_statistics(data, labels, index, names,
+                                       (0, 1, 4), threads=threads)
+        assert_array_equal(s['count'], [(labels == i).sum() for i in index])
+        assert_array_almost_equal(s['sum'], ndimage.sum(data, labels, index))
+        assert_array_almost_equal(s['minimum'][:3],
+                                  ndimage.minimum(data, labels, index[:3]))
+        assert_array_almost_equal(s['maximum'][:3],
+                                  ndimage.maximum(data, labels, index[:3]))
+        for i in range(3):
+            mask = labels == index[i]
+            pos = np.argmin(np.where(mask, data, np.inf))
+            assert_equal(tuple(s['minimum_position'][i]),
+                         np.unravel_index(pos, data.shape))
+            assert_almost_equal(s['variance'][i], data[mask].var())
+            assert_array_almost_equal(s['center_of_mass'][i],
+                        ndimage.center_of_mass(data, labels, index[i]))
+            assert_array_equal(s['histogram'][i],
+                               np.histogram(data[mask], 4, (0, 1))[0])
+            rows, cols = np.nonzero(mask)
+            assert_array_equal(s['bounding_box'][i],
+                               [[rows.min(), cols.min()],
+                                [rows.max() + 1, cols.max() + 1]])
+        assert_array_equal(s['bounding_box'][3], [[-1, -1], [-1, -1]])
+    s = ndimage.labeled_statistics(data, labels, statistics=['count'])
+    assert_equal(s['count'], (labels > 0).sum())
+    # negative labels are mapped through the table too:
+    data = np.array([7, 2, 4, 5, 9])
+    labels = np.array([-1, 1, 2, -1, 1])
+    assert_array_equal(ndimage.minimum(data, labels, [-1, 1, 2]), [5, 2, 4])
+    assert_array_equal(ndimage.maximum(data, labels, [-1, 1, 2]), [7, 9, 4])
+    # as in numpy, extrema of objects with NaN values are NaN:
+    data = np.array([[1.0, np.nan, 3.0, np.inf, np.nan, 2.0, np.nan, -1.0]]).T
+    labels = np.array([[1, 1, 1, 2, 2, 3, 3, 4]]).T
+    for threads in [1, 2]:
+        s = ndimage.labeled_statistics(data, labels, [1, 2, 3, 4],
+                      ['minimum', 'maximum', 'minimum_position'],
+                      threads=threads)
+        assert_array_equal(s['minimum'], [np.nan, np.nan, np.nan, -1.0])
+        assert_array_equal(s['maximum'], [np.nan, np.nan, np.nan, -1.0])
+        assert_array_equal(s['minimum_position'][:, 0], [1, 4, 6, 7])
+    assert_equal(ndimage.minimum(data), np.nan)
+    assert_equal(ndimage.maximum(data[3]), np.inf)
+    assert_equal(ndimage.minimum(data[3]), np.inf)
+    assert_raises(ValueError, ndimage.labeled_statistics, data, labels,
+                  statistics=['median'])
+
 if __name__ == "__main__":
     run_module_suite()
@@ -33,7 +33,7 @@ import numpy
 import numpy as np
 from numpy import fft
 from numpy.testing import assert_, assert_equal, assert_array_equal, \
-        TestCase, run_module_suite, \
+        assert_raises, TestCase, run_module_suite, \
         assert_array_almost_equal, assert_almost_equal
 import scipy.ndimage as ndimage
 
@@ -441,6 +441,46 @@ class TestNdimage:
                              mode='nearest', output=output, origin=1)
                 assert_array_almost_equal(output, tcov)
 
+    def test_correlate26(self):
+        "correlation 26"
+        numpy.random.seed(0)
+        array = (numpy.random.random((12, 70, 5)) * 255).astype(numpy.uint8)
+        for weights in [[-1, 0, 1], [1, 4, 6, 4, 1], [0.25, 0.5, 0.25],
+                        [0.3, 0.7]]:
+            for axis in range(3):
+                for mode in ['reflect', 'constant', 'wrap']:
+                    expected = ndimage.correlate1d(array.astype(numpy.float64),
+                                    weights, axis, mode=mode, cval=2)
+                    for type in [numpy.uint8, numpy.int16, numpy.int32]:
+                        output = ndimage.correlate1d(array, weights, axis,
+                                    output=type, mode=mode, cval=2)
+                        assert_array_equal(output, expected.astype(type))
+
+    def test_correlate_interior(self):
+        "correlation of interior and border points"
+        numpy.random.seed(0)
+        weights = numpy.random.random((3, 4))
+        footprint = weights > 0.3
+        for type in self.types:
+            array = (numpy.random.random((7, 23)) * 100).astype(type)
+            padded = numpy.zeros((9, 26))
+            padded[1:-1, 2:-1] = array
+            expected = numpy.zeros((7, 23))
+            minimum = numpy.zeros((7, 23)) + numpy.inf
+            for ii in range(3):
+                for jj in range(4):
+                    shifted = padded[ii:ii + 7, jj:jj + 23]
+                    expected += weights[ii, jj] * shifted
+                    if footprint[ii, jj]:
+                        minimum = numpy.minimum(minimum, shifted)
+            for input in [array, array.T.copy().T, array[:, ::-1][:, ::-1]]:
+                output = ndimage.correlate(input, weights, mode='constant',
+                                           output=numpy.float64)
+                assert_array_almost_equal(output, expected)
+                output = ndimage.minimum_filter(input, footprint=footprint,
+                                                mode='constant')
+                assert_array_almost_equal(output, minimum)
+
     def test_gauss01(self):
         "gaussian filter 1"
         input = numpy.array([[1, 2, 3],
@@ -503,6 +543,52 @@ class TestNdimage:
                                                             output=otype)
         assert_array_almost_equal(output1, output2)
 
+    def test_gauss_recursive01(self):
+        "recursive gaussian filter 1 - impulse responses"
+        for sigma in [1.0, 3.0, 20.0]:
+            input = numpy.zeros(int(20 * sigma) + 1)
+            input[len(input) // 2] = 1.0
+            for order, tol in [(0, 1e-3), (1, 5e-3), (2, 2e-2)]:
+                expected = ndimage.gaussian_filter1d(input, sigma,
+                                            order=order, mode='constant')
+                output = ndimage.gaussian_filter1d(input, sigma,
+                                            order=order, mode='constant',
+                                            recursive=True)
+                error = abs(output - expected).max() / abs(expected).max()
+                assert_(error < tol)
+        assert_raises(ValueError, ndimage.gaussian_filter1d, input, 2.0,
+                      order=3, recursive=True)
+
+    def test_gauss_recursive02(self):
+        "recursive gaussian filter 2 - modes and axes"
+        numpy.random.seed(0)
+        input = numpy.random.random((12, 40, 9))
+        for mode in ['reflect', 'nearest', 'wrap', 'mirror', 'constant']:
+            expected = ndimage.gaussian_filter(input, [1.0, 3.0, 2.0],
+                                               mode=mode, cval=0.5)
+            output = ndimage.gaussian_filter(input, [1.0, 3.0, 2.0],
+                                             mode=mode, cval=0.5,
+                                             recursive=True)
+            assert_array_almost_equal(expected, output, decimal=3)
+        # the borders are exact for a constant input:
+        input = numpy.ones((10, 20), numpy.float32)
+        for mode in ['reflect', 'nearest', 'wrap', 'mirror']:
+            output = ndimage.gaussian_filter(input, 4.0, mode=mode,
+                                             recursive=True)
+            assert_equal(output.dtype, numpy.float32)
+            assert_array_almost_equal(output, input, decimal=5)
+
+    def test_gauss_recursive03(self):
+        "recursive gaussian laplace and gradient magnitude"
+        numpy.random.seed(0)
+        input = ndimage.gaussian_filter(numpy.random.random((40, 50)), 2.0)
+        for func in [ndimage.gaussian_laplace,
+                     ndimage.gaussian_gradient_magnitude]:
+            expected = func(input, 3.0)
+            output = func(input, 3.0, recursive=True)
+            error = abs(output - expected).max() / abs(expected).max()
+            assert_(error < 2e-2)
+
     def test_prewitt01(self):
         "prewitt filter 1"
         for type in self.types:
@@ -687,6 +773,58 @@ class TestNdimage:
             numpy.sqrt(expected, expected)
             assert_array_almost_equal(expected, output)
 
+    def test_gaussian_pyramid01(self):
+        "gaussian pyramid 1"
+        numpy.random.seed(0)
+        array = numpy.random.random((37, 50, 3))
+        for mode in ['reflect', 'constant', 'wrap']:
+            pyramid = ndimage.gaussian_pyramid(array, sigma=1.5, mode=mode)
+            assert_equal([level.shape for level in pyramid],
+                         [(37, 50, 3), (19, 25, 2), (10, 13, 1), (5, 7, 1),
+                          (3, 4, 1), (2, 2, 1), (1, 1, 1)])
+            assert_(pyramid[0] is array)
+            for ii in range(1, len(pyramid)):
+                expected = ndimage.gaussian_filter(pyramid[ii - 1], 1.5,
+                                                   mode=mode)
+                assert_array_almost_equal(pyramid[ii],
+                                          expected[::2, ::2, ::2])
+
+    def test_gaussian_pyramid02(self):
+        "gaussian pyramid 2"
+        numpy.random.seed(0)
+        array = numpy.random.random((20, 9))
+        arena = numpy.zeros(200, numpy.float32)
+        pyramid = ndimage.gaussian_pyramid(array, 3, output=arena)
+        expected = ndimage.gaussian_pyramid(array, 3, output=numpy.float32)
+        for level, expect in zip(pyramid[1:], expected[1:]):
+            assert_equal(level.dtype, numpy.float32)
+            assert_array_almost_equal(level, expect)
+        assert_array_almost_equal(arena[:50], pyramid[1].ravel())
+        assert_array_almost_equal(arena[50:65], pyramid[2].ravel())
+        assert_raises(RuntimeError, ndimage.gaussian_pyramid, array, 4,
+                      output=arena[:60])
+
+    def test_laplacian_pyramid01(self):
+        "laplacian pyramid 1"
+        numpy.random.seed(0)
+        array = (numpy.random.random((23, 16)) * 255).astype(numpy.uint8)
+        weights = 2 * numpy.array(ndimage.filters._gaussian_kernel1d(1.0, 0))
+        pyramid = ndimage.laplacian_pyramid(array, 4, mode='constant')
+        gaussian = ndimage.gaussian_pyramid(array.astype(numpy.float64), 4,
+                                            mode='constant')
+        assert_equal(len(pyramid), 4)
+        assert_array_almost_equal(pyramid[3], gaussian[3])
+        # the expansion of a level equals filtering it with zeros
+        # inserted between its points:
+        for ii in range(3):
+            expanded = numpy.zeros(gaussian[ii].shape)
+            expanded[::2, ::2] = gaussian[ii + 1]
+            for axis in range(2):
+                expanded = ndimage.correlate1d(expanded, weights, axis,
+                                               mode='constant')
+            assert_equal(pyramid[ii].dtype, numpy.float64)
+            assert_array_almost_equal(pyramid[ii], gaussian[ii] - expanded)
+
     def test_generic_gradient_magnitude01(self):
         "generic gradient magnitude 1"
         array = numpy.array([[3, 2, 5, 1, 4],
@@ -753,6 +891,20 @@ class TestNdimage:
                 assert_array_almost_equal([[4, 6, 10], [10, 12, 16]], output)
                 assert_equal(output.dtype.type, type2)
 
+    def test_uniform07(self):
+        "uniform filter 7"
+        numpy.random.seed(0)
+        array = (numpy.random.random((9, 70)) * 255).astype(numpy.uint8)
+        for size in [2, 3, 7]:
+            for axis in range(2):
+                for mode in ['reflect', 'constant', 'nearest']:
+                    sums = ndimage.correlate1d(array.astype(numpy.int64),
+                                    numpy.ones(size), axis, mode=mode,
+                                    cval=3)
+                    output = ndimage.uniform_filter1d(array, size, axis,
+                                    output=numpy.int16, mode=mode, cval=3)
+                    assert_array_equal(output, sums // size)
+
     def test_minimum_filter01(self):
         "minimum filter 1"
         array = numpy.array([1, 2, 3, 4, 5])
@@ -927,6 +1079,87 @@ class TestNdimage:
                               [7, 9, 8, 9, 7],
                               [8, 8, 8, 7, 7]], output)
 
+    def test_minimum_maximum_filter_large(self):
+        "minimum and maximum filters with large windows"
+        numpy.random.seed(0)
+        array = numpy.random.randint(0, 100, (13, 37)).astype(numpy.float64)
+        for size in [4, 5, 9, 16, 40]:
+            # a flat structure is not separated into 1D filters:
+            structure = numpy.zeros((1, size))
+            for origin in [-(size // 2), 0, (size - 1) // 2]:
+                for mode in ['reflect', 'nearest', 'wrap', 'constant']:
+                    expected = ndimage.grey_erosion(array,
+                                    structure=structure, mode=mode,
+                                    origin=[0, origin], cval=50.0)
+                    output = ndimage.minimum_filter(array, size=(1, size),
+                                    mode=mode, origin=[0, origin], cval=50.0)
+                    assert_array_equal(expected, output)
+                    expected = -ndimage.grey_erosion(-array,
+                                    structure=structure, mode=mode,
+                                    origin=[0, origin], cval=-50.0)
+                    output = ndimage.maximum_filter(array, size=(1, size),
+                                    mode=mode, origin=[0, origin], cval=50.0)
+                    assert_array_equal(expected, output)
+
+    def test_separable_fused(self):
+        "separable filters applied along all axes in one pass"
+        numpy.random.seed(0)
+        # the large array is split into several tiles:
+        for shape in [(7, 1, 30), (5, 8, 9), (600, 700)]:
+            array = numpy.random.randint(0, 100, shape).astype(numpy.float64)
+            for mode in ['reflect', 'nearest', 'wrap', 'mirror', 'constant']:
+                expected = array
+                for axis, sigma in enumerate([1.0, 0.0, 2.0][:array.ndim]):
+                    if sigma > 0:
+                        expected = ndimage.gaussian_filter1d(expected, sigma,
+                                        axis, order=axis % 2, mode=mode,
+                                        cval=3.0)
+                output = ndimage.gaussian_filter(array,
+                                        [1.0, 0.0, 2.0][:array.ndim],
+                                        order=[0, 1, 0][:array.ndim],
+                                        mode=mode, cval=3.0)
+                assert_array_almost_equal(expected, output)
+                sizes = [3, 4, 7][:array.ndim]
+                origins = [1, -2, 0][:array.ndim]
+                expected = array
+                for axis in range(array.ndim):
+                    expected = ndimage.uniform_filter1d(expected,
+                                        sizes[axis], axis, mode=mode,
+                                        cval=3.0, origin=origins[axis])
+                output = ndimage.uniform_filter(array, sizes, mode=mode,
+                                        cval=3.0, origin=origins)
+                assert_array_almost_equal(expected, output)
+                for dtype in [numpy.uint8, numpy.int32, numpy.float64]:
+                    input = array.astype(dtype)
+                    expected = input
+                    for axis in range(array.ndim):
+                        expected = ndimage.maximum_filter1d(expected,
+                                        sizes[axis], axis, mode=mode,
+                                        cval=3.0, origin=origins[axis])
+                    output = ndimage.maximum_filter(input, sizes, mode=mode,
+                                        cval=3.0, origin=origins)
+                    assert_equal(output.dtype, dtype)
+                    assert_array_equal(expected, output)
+        # the input may be the output:
+        array = numpy.random.random((20, 30))
+        expected = ndimage.minimum_filter(array, 5)
+        ndimage.minimum_filter(array, 5, output=array)
+        assert_array_equal(expected, array)
+        # halos larger than the tiles are filtered along each axis in turn:
+        array = numpy.random.random((30, 40, 50))
+        expected = array
+        for axis in range(array.ndim):
+            expected = ndimage.gaussian_filter1d(expected, 10.0, axis,
+                                                 order=axis % 2)
+        output = ndimage.gaussian_filter(array, 10.0, order=[0, 1, 0])
+        assert_array_almost_equal(expected, output)
+        expected = array
+        for axis in range(array.ndim):
+            expected = ndimage.minimum_filter1d(expected, 41, axis,
+                                                origin=axis - 1)
+        output = ndimage.minimum_filter(array, 41, origin=[-1, 0, 1])
+        assert_array_equal(expected, output)
+
     def test_rank01(self):
         "rank filter 1"
         array = numpy.array([1, 2, 3, 4, 5])
@@ -1113,6 +1346,47 @@ class TestNdimage:
                                   footprint=footprint, origin=[-1, 0])
             assert_array_almost_equal(expected, output)
 
+    def test_rank_histogram(self):
+        "rank filters of 8 and 16 bit integers"
+        numpy.random.seed(0)
+        disk = numpy.add.outer(numpy.arange(-5, 6)**2,
+                               numpy.arange(-5, 6)**2) <= 25
+        footprints = [numpy.ones((9, 9), bool), disk,
+                      numpy.ones((1, 70), bool), numpy.ones((5, 4, 5), bool)]
+        for type in [numpy.uint8, numpy.uint16]:
+            for footprint in footprints:
+                shape = footprint.ndim == 2 and (23, 83) or (9, 8, 11)
+                array = numpy.random.randint(0, 200, shape).astype(type)
+                size = footprint.sum()
+                for mode in ['reflect', 'nearest', 'wrap', 'mirror',
+                             'constant']:
+                    for rank in [1, size // 2, -2]:
+                        expected = ndimage.rank_filter(
+                                array.astype(numpy.float64), rank,
+                                footprint=footprint, mode=mode, cval=7)
+                        output = ndimage.rank_filter(array, rank,
+                                footprint=footprint, mode=mode, cval=7)
+                        assert_equal(output.dtype, type)
+                        assert_array_equal(expected, output)
+                    origin = [0] * (footprint.ndim - 1) + [1]
+                    expected = ndimage.median_filter(
+                                array.astype(numpy.float64),
+                                footprint=footprint, mode=mode, origin=origin)
+                    output = ndimage.median_filter(array,
+                                footprint=footprint, mode=mode, origin=origin)
+                    assert_array_equal(expected, output)
+                # constant values out of the range of the type are clamped:
+                for cval in [-1, 2.5, 70000]:
+                    expected = ndimage.rank_filter(
+                                array.astype(numpy.float64), 1,
+                                footprint=footprint, mode='constant',
+                                cval=min(max(int(cval), 0),
+                                         numpy.iinfo(type).max))
+                    output = ndimage.rank_filter(array, 1,
+                                footprint=footprint, mode='constant',
+                                cval=cval)
+                    assert_array_equal(expected, output)
+
     def test_generic_filter1d01(self):
         "generic 1d filter 1"
         weights = numpy.array([1.1, 2.2, 3.3])
@@ -1132,6 +1406,37 @@ class TestNdimage:
                       extra_keywords={'total': weights.sum()})
             assert_array_almost_equal(r1, r2)
 
+    def test_threads(self):
+        "line filters divided over several threads"
+        numpy.random.seed(0)
+        array = numpy.random.random((13, 17, 11))
+        def run(threads):
+            result = []
+            for axis in range(3):
+                result.append(ndimage.correlate1d(array, [1, 3, -2], axis,
+                                                  threads=threads))
+                result.append(ndimage.uniform_filter1d(array, 4, axis,
+                                                       threads=threads))
+                result.append(ndimage.minimum_filter1d(array, 5, axis,
+                                                       threads=threads))
+                result.append(ndimage.gaussian_filter1d(array, 2.0, axis,
+                                        recursive=True, threads=threads))
+                result.append(ndimage.spline_filter1d(array, 3, axis,
+                                                      threads=threads))
+                result.append(ndimage.generic_filter1d(array,
+                        lambda input, output: output.__setitem__(Ellipsis,
+                                                    input[1:] - input[:-1]),
+                        2, axis, threads=threads))
+            result.append(ndimage.gaussian_filter(array, 1.5,
+                                                  threads=threads))
+            result.append(ndimage.maximum_filter(array.astype(numpy.int16),
+                                                 3, threads=threads))
+            return result
+        for threads in [2, 7, 100]:
+            for expected, output in zip(run(1), run(threads)):
+                assert_array_equal(expected, output)
+        assert_raises(ValueError, ndimage.uniform_filter, array, threads=0)
+
     def test_generic_filter01(self):
         "generic filter 1"
         filter_ = numpy.array([[1.0, 2.0], [3.0, 4.0]])
@@ -1150,6 +1455,133 @@ class TestNdimage:
                             extra_keywords={'total': cf.sum()})
             assert_array_almost_equal(r1, r2)
 
+    def test_generic_filter_block(self):
+        "generic filter called per block"
+        footprint = numpy.array([[1, 0, 1], [0, 1, 0]])
+        def _filter_func(buffer, total=1.0):
+            return buffer.std(axis=1) / total
+        for type in self.types:
+            a = numpy.arange(35, dtype=type)
+            a.shape = (5,7)
+            r1 = ndimage.generic_filter(a, lambda x: x.std() / 2.0,
+                                        footprint=footprint, mode='mirror')
+            for block in [1, 4, 7, 100]:
+                r2 = ndimage.generic_filter(a, _filter_func,
+                                footprint=footprint, mode='mirror',
+                                extra_keywords={'total': 2.0}, block=block)
+                assert_array_almost_equal(r1, r2)
+        assert_raises(ValueError, ndimage.generic_filter, a,
+                      lambda x: x.std(), size=3, block=4)
+
+    def test_generic_filter_capsule(self):
+        "generic filters with C functions in capsules"
+        import ctypes
+        new_capsule = ctypes.pythonapi.PyCapsule_New
+        new_capsule.restype = ctypes.py_object
+        new_capsule.argtypes = [ctypes.c_void_p, ctypes.c_char_p,
+                                ctypes.c_void_p]
+        set_context = ctypes.pythonapi.PyCapsule_SetContext
+        set_context.argtypes = [ctypes.py_object, ctypes.c_void_p]
+        double_p = ctypes.POINTER(ctypes.c_double)
+        filter_type = ctypes.CFUNCTYPE(ctypes.c_int, double_p,
+                                       ctypes.c_ssize_t, double_p,
+                                       ctypes.c_void_p)
+        filter1d_type = ctypes.CFUNCTYPE(ctypes.c_int, double_p,
+                                         ctypes.c_ssize_t, double_p,
+                                         ctypes.c_ssize_t, ctypes.c_void_p)
+        def _filter(buffer, size, result, data):
+            scale = ctypes.cast(data, double_p)[0]
+            result[0] = scale * sum([buffer[ii] for ii in range(size)])
+            return 1
+        def _filter1d(iline, ilength, oline, olength, data):
+            for ii in range(olength):
+                oline[ii] = iline[ii] + iline[ii + 1] + iline[ii + 2]
+            return 1
+        def _fail(buffer, size, result, data):
+            return 0
+        filter_func = filter_type(_filter)
+        filter1d_func = filter1d_type(_filter1d)
+        fail_func = filter_type(_fail)
+        signature = "int (double *, npy_intp, double *, void *)".encode()
+        signature1d = \
+            "int (double *, npy_intp, double *, npy_intp, void *)".encode()
+        scale = ctypes.c_double(2.0)
+        def capsule(func, name):
+            result = new_capsule(ctypes.cast(func, ctypes.c_void_p), name,
+                                 None)
+            set_context(result, ctypes.cast(ctypes.pointer(scale),
+                                            ctypes.c_void_p))
+            return result
+        a = numpy.arange(20.0).reshape(4, 5)
+        expected = 2 * ndimage.uniform_filter(a, 3) * 9
+        for threads in [1, 3]:
+            output = ndimage.generic_filter(a, capsule(filter_func,
+                                signature), size=3, threads=threads)
+            assert_array_almost_equal(output, expected)
+            output = ndimage.generic_filter1d(a, capsule(filter1d_func,
+                                signature1d), 3, threads=threads)
+            assert_array_almost_equal(output,
+                                      3 * ndimage.uniform_filter1d(a, 3))
+        assert_raises(ValueError, ndimage.generic_filter, a,
+                      capsule(filter_func, signature1d), 3)
+        assert_raises(RuntimeError, ndimage.generic_filter, a,
+                      capsule(fail_func, signature), 3)
+        # unnamed capsules are called with the GIL, from one thread:
+        import thread
+        idents = []
+        def _record(buffer, size, result, data):
+            idents.append(thread.get_ident())
+            return _filter(buffer, size, result, data)
+        record_func = filter_type(_record)
+        output = ndimage.generic_filter(a, capsule(record_func, None),
+                                        size=3, threads=3)
+        assert_array_almost_equal(output, expected)
+        assert_equal(set(idents), set([thread.get_ident()]))
+        # block filters have another signature, which is always checked:
+        assert_raises(ValueError, ndimage.generic_filter, a,
+                      capsule(filter_func, None), 3, block=4)
+
+    def test_chunked_filter(self):
+        "filters applied in slabs of a memory-mapped array"
+        import tempfile, os
+        numpy.random.seed(3)
+        data = numpy.random.random((37, 8, 6))
+        fd, name = tempfile.mkstemp()
+        os.close(fd)
+        try:
+            input = numpy.memmap(name, numpy.float64, 'w+', shape=data.shape)
+            input[...] = data
+            for func, keywords in [
+                    (ndimage.uniform_filter, {'size': 5, 'origin': 1}),
+                    (ndimage.median_filter, {'footprint': numpy.ones((4, 1,
+                                             2)), 'mode': 'constant'}),
+                    (ndimage.gaussian_filter, {'sigma': 1.5}),
+                    (ndimage.gaussian_filter, {'sigma': 1.5, 'mode': 'wrap'}),
+                    (ndimage.uniform_filter, {'size': 9, 'mode': 'wrap'}),
+                    (ndimage.correlate, {'weights': numpy.ones((3, 3, 3))})]:
+                expected = func(data, **keywords)
+                for axis, chunk_size, threads in [(0, 4, 1), (0, 5, 3),
+                                                  (1, 3, 2)]:
+                    output = ndimage.chunked_filter(func, input, axis=axis,
+                                chunk_size=chunk_size,
+                                extra_keywords=keywords, threads=threads)
+                    assert_array_almost_equal(output, expected)
+            expected = ndimage.sobel(data, 0)
+            ndimage.chunked_filter(ndimage.sobel, input, input, halo=1,
+                                   chunk_size=2, extra_arguments=(0,))
+            assert_array_almost_equal(input, expected)
+            input[...] = data
+            expected = ndimage.uniform_filter(data, 7, mode='wrap')
+            ndimage.chunked_filter(ndimage.uniform_filter, input, input,
+                                   chunk_size=5, threads=2,
+                                   extra_keywords={'size': 7, 'mode': 'wrap'})
+            assert_array_almost_equal(input, expected)
+            del input
+        finally:
+            os.remove(name)
+        assert_raises(RuntimeError, ndimage.chunked_filter, ndimage.sobel,
+                      data)
+
     def test_extend01(self):
         "line extension 1"
         array = numpy.array([1, 2, 3])
@@ -1446,6 +1878,25 @@ class TestNdimage:
                 a = fft.ifft(a, shape[0], 0)
                 assert_almost_equal(ndimage.sum(a.real), 1.0)
 
+    def test_fourier_batch01(self):
+        "fourier filters on a stack of spectra, in place"
+        numpy.random.seed(7)
+        data = numpy.random.random((4, 12, 9))
+        spectra = fft.fft(fft.rfft(data, axis=1), axis=2)
+        complex_spectra = fft.fft(fft.fft(data, axis=1), axis=2)
+        for func, param in [(ndimage.fourier_gaussian, [1.5, 2.0]),
+                            (ndimage.fourier_uniform, [3.0, 2.0]),
+                            (ndimage.fourier_ellipsoid, [3.0, 2.0]),
+                            (ndimage.fourier_shift, [1.0, -2.5])]:
+            for a, n in [(spectra, 12), (complex_spectra, -1)]:
+                expected = numpy.array([func(frame, param, n, -2)
+                                        for frame in a])
+                out = func(a, param, n, -2, batch=1)
+                assert_array_almost_equal(out, expected)
+                out = a.copy()
+                func(out, param, n, -2, out, batch=1)
+                assert_array_almost_equal(out, expected)
+
     def test_spline01(self):
         "spline filter 1"
         for type in self.types:
@@ -1777,6 +2228,51 @@ class TestNdimage:
                                                      order=order)
             assert_array_almost_equal(out1, out2)
 
+    def test_spline_interpolator01(self):
+        "spline interpolator"
+        data = numpy.array([[4, 1, 3, 2],
+                               [7, 6, 8, 5],
+                               [3, 5, 3, 6]])
+        idx = numpy.indices(data.shape, numpy.float64)
+        idx -= 0.5
+        matrix = [[0.9, 0.1], [-0.2, 1.1]]
+        for order in range(0, 6):
+            ip = ndimage.SplineInterpolator(data, order=order)
+            assert_array_almost_equal(ip(idx),
+                    ndimage.map_coordinates(data, idx, order=order))
+            assert_array_almost_equal(ip.shift(0.5),
+                    ndimage.shift(data, 0.5, order=order))
+            assert_array_almost_equal(ip.zoom(1.5),
+                    ndimage.zoom(data, 1.5, order=order))
+            assert_array_almost_equal(ip.affine_transform(matrix, 0.3),
+                    ndimage.affine_transform(data, matrix, 0.3,
+                                             order=order))
+            assert_array_almost_equal(ip.rotate(30),
+                    ndimage.rotate(data, 30, order=order))
+            assert_equal(ip.shift(0.5).dtype, data.dtype)
+
+    def test_spline_interpolator02(self):
+        "spline interpolator with single precision coefficients"
+        data = numpy.arange(60.0).reshape((6, 10)) ** 2
+        idx = numpy.indices(data.shape, numpy.float64)
+        idx -= 0.25
+        ip = ndimage.SplineInterpolator(data, dtype=numpy.float32,
+                                        mode='nearest')
+        assert_equal(ip.coefficients.dtype, numpy.float32)
+        assert_array_almost_equal(ip(idx) / data.max(),
+                    ndimage.map_coordinates(data, idx, mode='nearest')
+                                                  / data.max(), 5)
+
+    def test_spline_interpolator03(self):
+        "spline interpolator rotating three dimensions"
+        data = numpy.arange(120.0).reshape((4, 5, 6)) % 7
+        ip = ndimage.SplineInterpolator(data)
+        assert_array_almost_equal(ip.rotate(0), data)
+        for axes in [(1, 0), (2, 0), (1, 2)]:
+            for reshape in [True, False]:
+                assert_array_almost_equal(ip.rotate(30, axes, reshape),
+                        ndimage.rotate(data, 30, axes, reshape))
+
     def test_affine_transform01(self):
         "affine_transform 1"
         data = numpy.array([1])
@@ -2244,6 +2740,33 @@ class TestNdimage:
                                            reshape=False)
             assert_array_almost_equal(out, expected)
 
+    def test_interpolation_threads(self):
+        "interpolation divided over threads"
+        numpy.random.seed(3)
+        data = numpy.random.rand(70, 150)
+        volume = numpy.random.rand(20, 30, 25)
+        matrix = [[1, 0.1, 0], [0.05, 0.9, 0.1], [0, 0, 1.2]]
+        coordinates = numpy.random.rand(2, 13, 17) * 80 - 5
+        for order in [0, 1, 3]:
+            for mode in ['constant', 'wrap', 'mirror']:
+                kwargs = {'order': order, 'mode': mode}
+                out1 = ndimage.rotate(data, 33, **kwargs)
+                out2 = ndimage.rotate(data, 33, threads=3, **kwargs)
+                assert_array_equal(out1, out2)
+                out1 = ndimage.affine_transform(volume, matrix, [1, -2, 0.5],
+                                    output_shape=(22, 17, 33), **kwargs)
+                out2 = ndimage.affine_transform(volume, matrix, [1, -2, 0.5],
+                                    output_shape=(22, 17, 33), threads=4,
+                                    **kwargs)
+                assert_array_equal(out1, out2)
+                out1 = ndimage.zoom(volume, 1.7, **kwargs)
+                out2 = ndimage.zoom(volume, 1.7, threads=2, **kwargs)
+                assert_array_equal(out1, out2)
+                out1 = ndimage.map_coordinates(data, coordinates, **kwargs)
+                out2 = ndimage.map_coordinates(data, coordinates, threads=2,
+                                               **kwargs)
+                assert_array_equal(out1, out2)
+
     def test_watershed_ift01(self):
         "watershed_ift 1"
         data = numpy.array([[0, 0, 0, 0, 0, 0, 0],
@@ -2454,6 +2977,70 @@ class TestNdimage:
                     [-1, -1, -1, -1, -1, -1, -1]]
         assert_array_almost_equal(out, expected)
 
+    def test_watershed01(self):
+        "watershed 1"
+        data = numpy.array([[0.0, 0.2, 0.5, 0.9, 0.4, 0.1],
+                            [0.1, 0.3, 0.6, 0.8, 0.3, 0.0],
+                            [0.2, 0.4, 0.7, 0.7, 0.5, 0.2],
+                            [0.1, 0.3, 0.6, 0.9, 0.4, 0.1]])
+        markers = numpy.zeros(data.shape, numpy.int8)
+        markers[0, 0] = 1
+        markers[1, 5] = 2
+        expected = [[1, 1, 1, 2, 2, 2],
+                    [1, 1, 1, 2, 2, 2],
+                    [1, 1, 1, 2, 2, 2],
+                    [1, 1, 1, 2, 2, 2]]
+        for type in [numpy.float64, numpy.float32, numpy.float16,
+                     numpy.longdouble]:
+            out = ndimage.watershed(data.astype(type), markers)
+            assert_equal(out.dtype, numpy.int32)
+            assert_array_equal(out, expected)
+            out = ndimage.watershed(data.astype(type), markers,
+                                    numpy.ones((3, 3)))
+            assert_array_equal(out, expected)
+        out = ndimage.watershed((data * 10).astype(numpy.uint8), markers)
+        assert_array_equal(out, expected)
+        for type in [numpy.float64, numpy.float16, numpy.longdouble]:
+            out = ndimage.watershed(numpy.array([5, 9, 1, 0, 0], type),
+                                    [1, 0, 0, 0, 2])
+            assert_array_equal(out, [1, 2, 2, 2, 2])
+
+    def test_watershed02(self):
+        "watershed 2"
+        data = numpy.array([[0.0, 0.2, 0.5, 0.9, 0.4, 0.1],
+                            [0.1, 0.3, 0.6, 0.8, 0.3, 0.0],
+                            [0.2, 0.4, 0.7, 0.7, 0.5, 0.2],
+                            [0.1, 0.3, 0.6, 0.9, 0.4, 0.1]])
+        markers = numpy.zeros(data.shape, numpy.int64)
+        markers[0, 0] = 1
+        markers[1, 5] = 2
+        out = numpy.zeros((6, 4), numpy.int64).transpose()
+        ndimage.watershed(data, markers, mask=data < 0.65, output=out)
+        assert_array_equal(out, [[1, 1, 1, 0, 2, 2],
+                                 [1, 1, 1, 0, 2, 2],
+                                 [1, 1, 0, 0, 2, 2],
+                                 [1, 1, 1, 0, 2, 2]])
+        assert_raises(RuntimeError, ndimage.watershed, data, markers,
+                      output=numpy.int16)
+        for type in [numpy.longlong, numpy.ulonglong]:
+            out = ndimage.watershed(data, markers.astype(type),
+                                    output=numpy.longlong)
+            assert_equal(out.dtype.itemsize, 8)
+            assert_array_equal(out, ndimage.watershed(data, markers))
+
+    def test_watershed03(self):
+        "watershed 3"
+        markers = numpy.zeros((5, 9), numpy.int32)
+        markers[2, 0] = 1
+        markers[4, 8] = 2
+        out = ndimage.watershed(numpy.zeros((5, 9)), markers,
+                                compactness=1.0)
+        assert_array_equal(out, [[1, 1, 1, 1, 1, 2, 2, 2, 2],
+                                 [1, 1, 1, 1, 1, 2, 2, 2, 2],
+                                 [1, 1, 1, 1, 1, 2, 2, 2, 2],
+                                 [1, 1, 1, 1, 1, 2, 2, 2, 2],
+                                 [1, 1, 1, 1, 2, 2, 2, 2, 2]])
+
     def test_distance_transform_bf01(self):
         "brute force distance transform 1"
         for type in self.types:
@@ -2970,6 +3557,39 @@ class TestNdimage:
                                                        sampling=[2, 1])
         assert_array_almost_equal(ref, out)
 
+    def test_distance_transform_edt5(self):
+        "euclidean distance transform 5"
+        numpy.random.seed(0)
+        data = numpy.random.random((13, 11, 7)) > 0.1
+        for sampling in [None, [2, 1, 0.5]]:
+            ref = ndimage.distance_transform_bf(data, 'euclidean',
+                                                sampling=sampling)
+            for threads in [1, 3]:
+                out = ndimage.distance_transform_edt(data, sampling=sampling,
+                                                     threads=threads)
+                assert_equal(out.dtype, numpy.float64)
+                assert_array_almost_equal(ref, out)
+                out = ndimage.distance_transform_edt(data, sampling=sampling,
+                                  distances=numpy.float32, threads=threads)
+                assert_equal(out.dtype, numpy.float32)
+                assert_array_almost_equal(ref, out, decimal=5)
+        ref = ndimage.distance_transform_bf(data, 'euclidean')
+        out = numpy.zeros(data.shape, numpy.float32)
+        ndimage.distance_transform_edt(data, distances=out)
+        assert_array_almost_equal(ref, out, decimal=5)
+        # without background, as with the indices:
+        data = numpy.ones((4, 5))
+        for sampling in [None, [2, 1]]:
+            ref, ft = ndimage.distance_transform_edt(data, sampling=sampling,
+                                                     return_indices=True)
+            assert_array_almost_equal(ndimage.distance_transform_edt(data,
+                                                sampling=sampling), ref)
+            out = numpy.zeros(data.shape, numpy.float32)
+            ndimage.distance_transform_edt(data, sampling=sampling,
+                                           distances=out)
+            assert_array_almost_equal(out, ref, decimal=5)
+        assert_(numpy.isfinite(ref).all())
+
     def test_generate_structure01(self):
         "generation of a binary structure 1"
         struct = ndimage.generate_binary_structure(0, 1)
@@ -3598,6 +4218,25 @@ class TestNdimage:
                                        border_value=1, origin=(-1, -1))
         assert_array_almost_equal(out, expected)
 
+    def test_binary_erosion_packed(self):
+        "binary erosion and dilation on packed lines"
+        numpy.random.seed(12)
+        data = numpy.random.random((7, 9, 150)) > 0.4
+        mask = numpy.random.random(data.shape) > 0.3
+        struct = numpy.random.random((3, 2, 4)) > 0.5
+        for func in [ndimage.binary_erosion, ndimage.binary_dilation]:
+            for iterations in [1, 2, 3]:
+                for origin in [0, (1, 0, -2)]:
+                    for border_value in [0, 1]:
+                        kwargs = dict(iterations=iterations, mask=mask,
+                                      origin=origin,
+                                      border_value=border_value)
+                        expected = func(data, struct, brute_force=True,
+                                        **kwargs)
+                        out = func(data.astype(numpy.float32), struct,
+                                   **kwargs)
+                        assert_array_equal(out, expected)
+
     def test_binary_dilation01(self):
         "binary dilation 1"
         for type in self.types:
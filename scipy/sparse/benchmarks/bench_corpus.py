@@ -0,0 +1,300 @@
+"""benchmarks of the sparse module on a corpus of real-world matrices
+
+The corpus is every Matrix Market file (*.mtx, *.mtx.gz) in the directory
+named by the environment variable SCIPY_SPARSE_CORPUS, together with a few
+synthetic matrices built with scipy.sparse.construct.  For every matrix
+and format the operations are timed and reported as effective GB/s and
+GFLOP/s, and compared with the memory bandwidth of the machine measured
+by a copy kernel: for memory-bound kernels such as SpMV the ratio of the
+two is the fraction of the roofline that is attained.
+
+The byte counts are the minimum traffic of each operation (every array
+read or written once), so the reported bandwidth is a lower bound.
+
+Run as a script to select the corpus and write the results as JSON:
+
+    python bench_corpus.py --corpus ~/matrices --json results.json
+    python bench_corpus.py --compare before.json results.json
+
+Under the test runner (scipy.sparse.bench()) the results are written to
+the file named by SCIPY_SPARSE_BENCH_JSON, if set.
+"""
+
+import os
+import sys
+import glob
+import time
+import platform
+
+import numpy
+from numpy import ones, arange
+
+from numpy.testing import *
+
+from scipy import sparse
+from scipy.io import mmread
+from scipy.sparse.linalg import splu
+
+
+formats = ['csr', 'csc', 'coo', 'bsr', 'dia']
+
+
+def timeit(fn, min_time=0.2, min_iter=3):
+    """Return the best wall clock time of a call to fn()"""
+    fn() #warmup
+    best = numpy.inf
+    start = time.time()
+    iter = 0
+    while iter < min_iter or time.time() < start + min_time:
+        t0 = time.time()
+        fn()
+        best = min(best, time.time() - t0)
+        iter += 1
+    return best
+
+
+def memory_bandwidth(nbytes=2**27):
+    """Measured memory bandwidth in bytes/sec of a large array copy"""
+    a = numpy.zeros(nbytes // 16)
+    b = ones(nbytes // 16)
+    def copy():
+        a[:] = b
+    return 2 * a.nbytes / timeit(copy, min_iter=5)
+
+
+#------------------------------------------------------------------------------
+# corpus
+#------------------------------------------------------------------------------
+
+def synthetic_matrices():
+    """Matrices built with construct.py"""
+    def poisson1d(n):
+        return sparse.spdiags([-ones(n), 2*ones(n), -ones(n)], [-1,0,1], n, n)
+
+    yield 'Poisson2D', sparse.kronsum(poisson1d(300), poisson1d(300)).tocsr()
+    yield 'Block3x3', sparse.kron(sparse.kronsum(poisson1d(100), poisson1d(100)),
+                                  ones((3,3))).tocsr()
+    numpy.random.seed(0)
+    yield 'Random', (sparse.rand(5000, 5000, density=1e-3, format='csr')
+                     + sparse.identity(5000, format='csr'))
+
+
+def corpus_matrices(directory):
+    """Matrices read with io.mmread from the files in a directory"""
+    if directory is None:
+        return
+    files = glob.glob(os.path.join(directory, '*.mtx'))
+    files += glob.glob(os.path.join(directory, '*.mtx.gz'))
+    for filename in sorted(files):
+        A = mmread(filename)
+        if not sparse.isspmatrix(A):
+            continue
+        name = os.path.basename(filename).split('.')[0]
+        yield name, A.tocsr()
+
+
+#------------------------------------------------------------------------------
+# memory traffic and flop counts
+#------------------------------------------------------------------------------
+
+def matrix_bytes(A):
+    """Bytes of the arrays that store A"""
+    if A.format == 'coo':
+        arrays = [A.data, A.row, A.col]
+    elif A.format == 'dia':
+        arrays = [A.data, A.offsets]
+    else:
+        arrays = [A.data, A.indices, A.indptr]
+    return sum([a.nbytes for a in arrays])
+
+
+def spgemm_flops(A, B):
+    """Multiplications and additions of the product A*B"""
+    A = A.tocsc()
+    B = B.tocsr()
+    return 2 * numpy.dot(numpy.diff(A.indptr).astype(float),
+                         numpy.diff(B.indptr).astype(float))
+
+
+#------------------------------------------------------------------------------
+# benchmarks
+#------------------------------------------------------------------------------
+
+def bench_matrix(name, A, bandwidth):
+    """Time the operations on one matrix and return a list of records"""
+    results = []
+    itemsize = A.dtype.itemsize
+
+    def record(format, operation, seconds, nbytes, flops=0):
+        results.append({'matrix'    : name,
+                        'shape'     : list(A.shape),
+                        'nnz'       : int(A.nnz),
+                        'format'    : format,
+                        'operation' : operation,
+                        'time'      : seconds,
+                        'GB/s'      : nbytes / seconds / 1e9,
+                        'GFLOP/s'   : flops / seconds / 1e9,
+                        'roofline'  : nbytes / seconds / bandwidth})
+
+    M, N = A.shape
+    x = ones(N, dtype=A.dtype)
+    X = ones((N, 8), dtype=A.dtype)
+
+    C = A.tocoo()
+    n_diags = len(numpy.unique(C.col - C.row))
+
+    for format in formats:
+        if format == 'dia' and n_diags > 100:
+            continue # too many diagonals
+        B = A.asformat(format)
+        size = matrix_bytes(B)
+
+        t = timeit(lambda: B * x)
+        record(format, 'spmv', t, size + (M + N) * itemsize, 2 * A.nnz)
+
+        t = timeit(lambda: B * X)
+        record(format, 'spmm8', t, size + 8 * (M + N) * itemsize,
+               16 * A.nnz)
+
+        if format != 'csr':
+            t = timeit(lambda: B.tocsr())
+            record(format, 'tocsr', t, size + matrix_bytes(A))
+
+    B = A.tocsr()
+    C = B * B
+    t = timeit(lambda: B * B)
+    record('csr', 'spgemm', t, 2 * matrix_bytes(B) + matrix_bytes(C),
+           spgemm_flops(B, B))
+
+    t = timeit(lambda: B.tocsc())
+    record('csr', 'tocsc', t, 2 * matrix_bytes(B))
+
+    rows = arange(0, M, 4)
+    S = B[rows, :]
+    t = timeit(lambda: B[rows, :])
+    record('csr', 'row slice', t, 2 * matrix_bytes(S))
+
+    if M == N:
+        C = A.tocsc()
+        try:
+            lu = splu(C)
+        except RuntimeError:
+            pass # singular
+        else:
+            t = timeit(lambda: splu(C), min_iter=1)
+            record('csc', 'splu', t,
+                   matrix_bytes(C) + lu.nnz * (itemsize + 4))
+            t = timeit(lambda: lu.solve(x))
+            record('csc', 'splu solve', t, lu.nnz * (itemsize + 4),
+                   2 * lu.nnz)
+
+    return results
+
+
+def run(directory=None, synthetic=True, out=sys.stdout):
+    """Run the benchmarks and return them as a dict suitable for JSON"""
+    bandwidth = memory_bandwidth()
+
+    print >> out
+    print >> out, '               Sparse Matrix Corpus Benchmarks'
+    print >> out, '        measured memory bandwidth: %6.2f GB/s' % (bandwidth/1e9)
+    print >> out, '============================================================================='
+    print >> out, '    matrix    | format |  operation  | time (msec) |  GB/s  | GFLOP/s | roof '
+    print >> out, '-----------------------------------------------------------------------------'
+    fmt = ' %12s |  %3s   | %11s |  %9.3f  | %6.2f | %7.3f | %3d%%'
+
+    matrices = []
+    if synthetic:
+        matrices.extend(synthetic_matrices())
+    matrices.extend(corpus_matrices(directory))
+
+    results = []
+    for name, A in matrices:
+        for r in bench_matrix(name, A, bandwidth):
+            print >> out, fmt % (name[:12].center(12), r['format'],
+                                 r['operation'].center(11), 1000*r['time'],
+                                 r['GB/s'], r['GFLOP/s'], 100*r['roofline'])
+            results.append(r)
+
+    return {'machine' : {'platform'  : platform.platform(),
+                         'processor' : platform.processor(),
+                         'python'    : platform.python_version(),
+                         'numpy'     : numpy.__version__,
+                         'bandwidth' : bandwidth},
+            'results' : results}
+
+
+def compare(before, after, out=sys.stdout):
+    """Print the speedup of each operation between two result dicts"""
+    def key(r):
+        return (r['matrix'], r['format'], r['operation'])
+    old = dict([(key(r), r) for r in before['results']])
+
+    print >> out
+    print >> out, '                 Sparse Matrix Benchmark Comparison'
+    print >> out, '=================================================================='
+    print >> out, '    matrix    | format |  operation  |  before  |  after   | speedup'
+    print >> out, '------------------------------------------------------------------'
+    fmt = ' %12s |  %3s   | %11s | %8.3f | %8.3f | %6.2fx'
+    for r in after['results']:
+        if key(r) not in old:
+            continue
+        t0 = old[key(r)]['time']
+        print >> out, fmt % (r['matrix'][:12].center(12), r['format'],
+                             r['operation'].center(11), 1000*t0,
+                             1000*r['time'], t0 / r['time'])
+
+
+def write_json(results, filename):
+    import json
+    f = open(filename, 'w')
+    try:
+        json.dump(results, f, indent=1)
+    finally:
+        f.close()
+
+
+def read_json(filename):
+    import json
+    f = open(filename)
+    try:
+        return json.load(f)
+    finally:
+        f.close()
+
+
+class BenchmarkCorpus(TestCase):
+    """Benchmarks on the matrix corpus in $SCIPY_SPARSE_CORPUS"""
+
+    def bench_corpus(self):
+        results = run(os.environ.get('SCIPY_SPARSE_CORPUS'))
+        filename = os.environ.get('SCIPY_SPARSE_BENCH_JSON')
+        if filename:
+            write_json(results, filename)
+
+
+if __name__ == "__main__":
+    from optparse import OptionParser
+
+    parser = OptionParser(usage="%prog [options]\n"
+                                "       %prog --compare BEFORE.json AFTER.json")
+    parser.add_option("--corpus", metavar="DIR",
+                      default=os.environ.get('SCIPY_SPARSE_CORPUS'),
+                      help="directory of Matrix Market files")
+    parser.add_option("--json", metavar="FILE",
+                      help="write the results to FILE")
+    parser.add_option("--no-synthetic", dest="synthetic",
+                      action="store_false", default=True,
+                      help="only benchmark the corpus")
+    parser.add_option("--compare", action="store_true", default=False,
+                      help="compare two result files")
+    options, args = parser.parse_args()
+
+    if options.compare:
+        if len(args) != 2:
+            parser.error("--compare needs two result files")
+        compare(read_json(args[0]), read_json(args[1]))
+    else:
+        results = run(options.corpus, options.synthetic)
+        if options.json:
+            write_json(results, options.json)
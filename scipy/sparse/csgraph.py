@@ -2,11 +2,14 @@
 
 __docformat__ = "restructuredtext en"
 
-__all__ = ['cs_graph_components']
+__all__ = ['cs_graph_components', 'reverse_cuthill_mckee',
+           'approximate_minimum_degree', 'nested_dissection',
+           'symmetric_permute']
 
 import numpy as np
 
-from sparsetools import cs_graph_components as _cs_graph_components
+from sparsetools import cs_graph_components as _cs_graph_components, \
+        cs_graph_rcm, cs_graph_amd, cs_graph_nested_dissection, csr_permute
 
 from csr import csr_matrix
 from base import isspmatrix
@@ -78,3 +81,189 @@ def cs_graph_components(x):
     return n_comp, label
 
 
+def _symmetric_structure(x):
+    """Return the CSR structure of x + x.T, ignoring numerical values."""
+    try:
+        shape = x.shape
+    except AttributeError:
+        raise ValueError(_msg0)
+
+    if not ((len(x.shape) == 2) and (x.shape[0] == x.shape[1])):
+        raise ValueError(_msg1 % (x.shape,))
+
+    if isspmatrix(x):
+        x = x.tocsr()
+    else:
+        x = csr_matrix(x)
+
+    s = csr_matrix((np.ones(len(x.indices), dtype=np.int8),
+                    x.indices, x.indptr), shape=shape)
+    s = (s + s.T).tocsr()
+    s.sum_duplicates()
+
+    return s
+
+def reverse_cuthill_mckee(x):
+    """
+    Reverse Cuthill-McKee ordering of a sparse matrix.
+
+    The ordering reduces the bandwidth of the symmetric matrix
+    `x[perm,:][:,perm]`, which improves the memory locality of
+    matrix-vector products and incomplete factorizations.
+
+    Parameters
+    ----------
+    x: ndarray-like, 2 dimensions, or sparse matrix
+        A square matrix. The ordering is computed from the structure of
+        `x + x.T`, so the numerical values are ignored.
+
+    Returns
+    -------
+    perm: ndarray (ints, 1 dimension)
+        Row/column `perm[k]` of `x` becomes row/column `k` of the
+        permuted matrix.
+
+    See Also
+    --------
+    symmetric_permute, approximate_minimum_degree, nested_dissection
+
+    Examples
+    --------
+    >>> from scipy.sparse import csr_matrix, reverse_cuthill_mckee
+    >>> from scipy.sparse import symmetric_permute
+    >>> A = csr_matrix([[1,0,0,1],[0,1,1,0],[0,1,1,0],[1,0,0,1]])
+    >>> perm = reverse_cuthill_mckee(A)
+    >>> symmetric_permute(A, perm).todense()
+    matrix([[1, 1, 0, 0],
+            [1, 1, 0, 0],
+            [0, 0, 1, 1],
+            [0, 0, 1, 1]])
+
+    """
+    s = _symmetric_structure(x)
+    perm = np.empty((s.shape[0],), dtype=s.indptr.dtype)
+    cs_graph_rcm(s.shape[0], s.indptr, s.indices, perm)
+
+    return perm
+
+def approximate_minimum_degree(x):
+    """
+    Approximate minimum degree ordering of a sparse matrix.
+
+    The ordering reduces the fill-in of a Cholesky or LU factorization
+    of `x[perm,:][:,perm]`.
+
+    Parameters
+    ----------
+    x: ndarray-like, 2 dimensions, or sparse matrix
+        A square matrix. The ordering is computed from the structure of
+        `x + x.T`, so the numerical values are ignored.
+
+    Returns
+    -------
+    perm: ndarray (ints, 1 dimension)
+        Row/column `perm[k]` of `x` is eliminated `k`-th.
+
+    See Also
+    --------
+    symmetric_permute, reverse_cuthill_mckee, nested_dissection
+
+    Notes
+    -----
+    The elimination is simulated on the quotient graph using the
+    approximate external degrees of Amestoy, Davis and Duff, without
+    supervariable detection. Fill is comparable to SuperLU's
+    `MMD_AT_PLUS_A` column ordering for structurally symmetric matrices.
+
+    """
+    s = _symmetric_structure(x)
+    perm = np.empty((s.shape[0],), dtype=s.indptr.dtype)
+    cs_graph_amd(s.shape[0], s.indptr, s.indices, perm)
+
+    return perm
+
+def nested_dissection(x, min_size=64):
+    """
+    Nested dissection ordering of a sparse matrix.
+
+    The graph of `x` is bisected recursively by level-structure
+    separators, which are ordered after the two halves they split.
+    The ordering gives low fill for matrices arising from meshes.
+
+    Parameters
+    ----------
+    x: ndarray-like, 2 dimensions, or sparse matrix
+        A square matrix. The ordering is computed from the structure of
+        `x + x.T`, so the numerical values are ignored.
+    min_size: int, optional
+        Subgraphs with at most this many nodes are not dissected further.
+
+    Returns
+    -------
+    perm: ndarray (ints, 1 dimension)
+        Row/column `perm[k]` of `x` becomes row/column `k` of the
+        permuted matrix.
+
+    See Also
+    --------
+    symmetric_permute, reverse_cuthill_mckee, approximate_minimum_degree
+
+    """
+    s = _symmetric_structure(x)
+    perm = np.empty((s.shape[0],), dtype=s.indptr.dtype)
+    cs_graph_nested_dissection(s.shape[0], s.indptr, s.indices,
+                               int(min_size), perm)
+
+    return perm
+
+def symmetric_permute(x, perm):
+    """
+    Symmetrically permute the rows and columns of a sparse matrix.
+
+    Equivalent to `x[perm,:][:,perm]`, but computed in a single pass
+    over the matrix.
+
+    Parameters
+    ----------
+    x: sparse matrix
+        A square sparse matrix.
+    perm: ndarray-like (ints, 1 dimension)
+        A permutation of `range(x.shape[0])`, such as the one returned by
+        `reverse_cuthill_mckee`.
+
+    Returns
+    -------
+    y: sparse matrix
+        The permuted matrix, with sorted indices, in the format of `x`
+        when that is CSR or CSC and in CSR format otherwise.
+
+    """
+    if not ((len(x.shape) == 2) and (x.shape[0] == x.shape[1])):
+        raise ValueError(_msg1 % (x.shape,))
+
+    if isspmatrix(x) and x.format in ('csr', 'csc'):
+        fmt = x.format
+    else:
+        fmt = 'csr'
+        x = csr_matrix(x)
+
+    n = x.shape[0]
+    perm = np.asarray(perm, dtype=x.indptr.dtype)
+    if perm.shape != (n,):
+        raise ValueError('perm must have length %d' % n)
+    check = np.zeros(n, dtype=bool)
+    check[perm] = True
+    if not check.all():
+        raise ValueError('perm is not a permutation')
+
+    # P A P^T of a CSC matrix is the transpose of the same operation on
+    # its CSR view, so one kernel serves both formats.
+    indptr = np.empty(n + 1, dtype=x.indptr.dtype)
+    indices = np.empty(len(x.indices), dtype=x.indptr.dtype)
+    order = np.empty(len(x.indices), dtype=x.indptr.dtype)
+    csr_permute(n, x.indptr, x.indices, perm, indptr, indices, order)
+
+    y = x.__class__((x.data[order], indices, indptr), shape=x.shape)
+    y.has_sorted_indices = True
+
+    return y
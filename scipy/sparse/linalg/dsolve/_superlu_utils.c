@@ -7,11 +7,48 @@
 
 #include "_superluobject.h"
 #include "numpy/npy_3kcompat.h"
+#include "pythread.h"
 #include <setjmp.h>
 
 jmp_buf _superlu_py_jmpbuf;
 PyObject *_superlumodule_memory_dict=NULL;
 
+/* The global jump buffer may only be used while holding the GIL.  Code
+   that runs SuperLU with the GIL released registers a state of its own
+   for the calling thread, whose jump buffer the abort handler prefers.
+*/
+static int _superlu_py_state_key = -1;
+
+static SuperLUThreadState *superlu_python_thread_state(void)
+{
+  if (_superlu_py_state_key == -1) return NULL;
+  return (SuperLUThreadState *)PyThread_get_key_value(_superlu_py_state_key);
+}
+
+/* Must be called with the GIL held. */
+void superlu_python_set_thread_state(SuperLUThreadState *state)
+{
+  if (_superlu_py_state_key == -1) {
+    _superlu_py_state_key = PyThread_create_key();
+  }
+  state->nallocs = 0;
+  PyThread_delete_key_value(_superlu_py_state_key);
+  PyThread_set_key_value(_superlu_py_state_key, (void *)state);
+}
+
+/* Unregister the state of the thread, and free the blocks that SuperLU
+   left allocated when it aborted. */
+void superlu_python_release_thread_state(SuperLUThreadState *state)
+{
+  int i;
+
+  PyThread_delete_key_value(_superlu_py_state_key);
+  for (i = 0; i < state->nallocs; i++) {
+    free(state->allocs[i]);
+  }
+  state->nallocs = 0;
+}
+
 /* Abort to be used inside the superlu module so that memory allocation
    errors don't exit Python and memory allocated internal to SuperLU is freed.
    Calling program should deallocate (using SUPERLU_FREE) all memory that could have
@@ -20,28 +57,52 @@ PyObject *_superlumodule_memory_dict=NULL;
 
 void superlu_python_module_abort(char *msg)
 {
+  SuperLUThreadState *state = superlu_python_thread_state();
+  PyGILState_STATE gstate;
+
+  gstate = PyGILState_Ensure();
   PyErr_SetString(PyExc_RuntimeError, msg);
+  PyGILState_Release(gstate);
+
+  if (state != NULL) {
+    longjmp(state->jmpbuf, -1);
+  }
   longjmp(_superlu_py_jmpbuf, -1);
 }
 
+/* In a thread that runs SuperLU with the GIL released, the allocation
+   hooks record the blocks in the state of the thread, without taking the
+   GIL.  Only if the state is full, or for blocks allocated elsewhere, do
+   they take the GIL to use the module's dictionary. */
+
 void *superlu_python_module_malloc(size_t size)
 {
   PyObject *key=NULL;
   void *mem_ptr;
+  PyGILState_STATE gstate;
+  SuperLUThreadState *state = superlu_python_thread_state();
+
+  mem_ptr = malloc(size);
+  if (mem_ptr == NULL) return NULL;
+  if (state != NULL && state->nallocs < SUPERLU_THREAD_ALLOCS) {
+    state->allocs[state->nallocs++] = mem_ptr;
+    return mem_ptr;
+  }
 
+  gstate = PyGILState_Ensure();
   if (_superlumodule_memory_dict == NULL) {
     _superlumodule_memory_dict = PyDict_New();
   }
-  mem_ptr = malloc(size);
-  if (mem_ptr == NULL) return NULL;
   key = PyLong_FromVoidPtr(mem_ptr);
   if (key == NULL) goto fail;
   if (PyDict_SetItem(_superlumodule_memory_dict, key, Py_None)) goto fail;
   Py_DECREF(key);
+  PyGILState_Release(gstate);
   return mem_ptr;
 
  fail:
   Py_XDECREF(key);
+  PyGILState_Release(gstate);
   free(mem_ptr);
   superlu_python_module_abort("superlu_malloc: Cannot set dictionary key value in malloc.");
   return NULL;
@@ -52,8 +113,21 @@ void superlu_python_module_free(void *ptr)
 {
   PyObject *key;
   PyObject *ptype, *pvalue, *ptraceback;
+  PyGILState_STATE gstate;
+  SuperLUThreadState *state = superlu_python_thread_state();
+  int i;
 
   if (ptr == NULL) return;
+  if (state != NULL) {
+    for (i = 0; i < state->nallocs; i++) {
+      if (state->allocs[i] == ptr) {
+        state->allocs[i] = state->allocs[--state->nallocs];
+        free(ptr);
+        return;
+      }
+    }
+  }
+  gstate = PyGILState_Ensure();
   PyErr_Fetch(&ptype, &pvalue, &ptraceback);
   key = PyLong_FromVoidPtr(ptr);
   /* This will only free the pointer if it could find it in the dictionary
@@ -67,6 +141,7 @@ void superlu_python_module_free(void *ptr)
   }
   Py_DECREF(key);
   PyErr_Restore(ptype, pvalue, ptraceback);
+  PyGILState_Release(gstate);
   return;
 }
 
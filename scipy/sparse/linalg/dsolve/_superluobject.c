@@ -22,21 +22,31 @@ extern jmp_buf _superlu_py_jmpbuf;
  * SciPyLUObject methods
  */
 
-static char solve_doc[] = "x = self.solve(b, trans)\n\
+static char solve_doc[] = "x = self.solve(b, trans, overwrite_b)\n\
 \n\
 solves linear system of equations with one or sereral right hand sides.\n\
 \n\
 parameters\n\
 ----------\n\
 \n\
-b        array, right hand side(s) of equation\n\
+b        array, right hand side(s) of equation, of shape (n,) or (n, k)\n\
 x        array, solution vector(s)\n\
 trans    'N': solve A   * x == b\n\
          'T': solve A^T * x == b\n\
          'H': solve A^H * x == b\n\
          (optional, default value 'N')\n\
+overwrite_b  if true and b is a Fortran-contiguous array of the type of\n\
+         the factors, the solution is written into b and b is returned\n\
+         (optional, default value False)\n\
+\n\
+The GIL is released while solving, so that solves can run concurrently\n\
+in several threads, also with the same factor object.\n\
 ";
 
+/* Number of right hand sides passed to gstrs at a time; bounds the
+   work array of size n*nrhs that gstrs allocates. */
+#define SOLVE_BLOCK_SIZE 64
+
 static PyObject *
 SciPyLU_solve(SciPyLUObject *self, PyObject *args, PyObject *kwds) {
   PyArrayObject *b, *x=NULL;
@@ -46,11 +56,19 @@ SciPyLU_solve(SciPyLUObject *self, PyObject *args, PyObject *kwds) {
 #else
   int itrans = 'N';
 #endif
-  int info;
+  int overwrite_b = 0;
+  /* modified between setjmp and a possible longjmp of the solve: */
+  volatile int info = 0, aborted = 0;
+  volatile npy_intp j;
+  int block_info;
   trans_t trans;
   SuperLUStat_t stat;
+  SuperLUThreadState state;
+  npy_intp nrhs;
+  char *data;
+  size_t stride;
 
-  static char *kwlist[] = {"rhs","trans",NULL};
+  static char *kwlist[] = {"rhs","trans","overwrite_b",NULL};
 
   if (!CHECK_SLU_TYPE(self->type)) {
       PyErr_SetString(PyExc_ValueError, "unsupported data type");
@@ -58,12 +76,12 @@ SciPyLU_solve(SciPyLUObject *self, PyObject *args, PyObject *kwds) {
   }
 
 #ifndef NPY_PY3K
-  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|c", kwlist,
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|ci", kwlist,
 #else
-  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|C", kwlist,
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|Ci", kwlist,
 #endif
                                    &PyArray_Type, &b, 
-                                   &itrans))
+                                   &itrans, &overwrite_b))
     return NULL;
 
   /* solve transposed system: matrix was passed row-wise instead of
@@ -79,37 +97,89 @@ SciPyLU_solve(SciPyLUObject *self, PyObject *args, PyObject *kwds) {
     return NULL;
   }
 
-  if ((x = (PyArrayObject *) \
-       PyArray_CopyFromObject((PyObject *)b,self->type,1,2))==NULL) return NULL;
-
-  if (b->dimensions[0] != self->n) goto fail;
+  /* Solve in place when the caller hands over a suitable buffer,
+     otherwise work on a Fortran-ordered copy. */
+  if (overwrite_b && PyArray_TYPE(b) == self->type
+      && (b->nd == 1 || b->nd == 2)
+      && PyArray_CHKFLAGS(b, NPY_F_CONTIGUOUS)
+      && PyArray_ISALIGNED(b) && PyArray_ISWRITEABLE(b)) {
+      x = b;
+      Py_INCREF(x);
+  }
+  else {
+      x = (PyArrayObject *)PyArray_FromAny((PyObject *)b,
+                                           PyArray_DescrFromType(self->type),
+                                           1, 2,
+                                           NPY_F_CONTIGUOUS | NPY_ALIGNED |
+                                           NPY_WRITEABLE | NPY_ENSURECOPY,
+                                           NULL);
+      if (x == NULL) return NULL;
+  }
 
+  if (x->dimensions[0] != self->n) {
+      PyErr_SetString(PyExc_ValueError,
+                      "right hand side has the wrong number of rows");
+      goto fail;
+  }
 
-  if (setjmp(_superlu_py_jmpbuf)) goto fail; 
+  nrhs = (x->nd == 2) ? x->dimensions[1] : 1;
+  if (nrhs == 0 || self->n == 0) {
+      return (PyObject *)x;
+  }
 
-  if (DenseSuper_from_Numeric(&B, (PyObject *)x)) goto fail;
+  if (setjmp(_superlu_py_jmpbuf)) goto fail;
 
+  /* Each call has its own statistics, so that concurrent solves with
+     the same factors do not share them. */
   StatInit(&stat);
 
-  /* Solve the system, overwriting vector x. */
-  gstrs(self->type,
-        trans, &self->L, &self->U, self->perm_c, self->perm_r, &B,
-        &stat, &info);
+  /* One dense matrix header serves every block of columns. */
+  data = x->data;
+  stride = self->n * PyArray_ITEMSIZE(x);
+  Create_Dense_Matrix(self->type, &B, self->n,
+                      (int)((nrhs < SOLVE_BLOCK_SIZE) ? nrhs : SOLVE_BLOCK_SIZE),
+                      data, self->n, SLU_DN,
+                      NPY_TYPECODE_TO_SLU(self->type), SLU_GE);
+
+  superlu_python_set_thread_state(&state);
+  Py_BEGIN_ALLOW_THREADS
+  if (setjmp(state.jmpbuf) == 0) {
+      for (j = 0; j < nrhs && info == 0; j += SOLVE_BLOCK_SIZE) {
+          B.ncol = (int)((nrhs - j < SOLVE_BLOCK_SIZE) ?
+                         nrhs - j : SOLVE_BLOCK_SIZE);
+          ((DNformat *)B.Store)->nzval = data + j * stride;
+
+          /* Solve the system, overwriting the block of x. */
+          gstrs(self->type,
+                trans, &self->L, &self->U, self->perm_c, self->perm_r, &B,
+                &stat, &block_info);
+          info = block_info;
+      }
+  }
+  else {
+      aborted = 1;
+  }
+  Py_END_ALLOW_THREADS
+  superlu_python_release_thread_state(&state);
+
+  /* free memory */
+  Destroy_SuperMatrix_Store(&B);
+  StatFree(&stat);
 
+  if (aborted) {
+      Py_XDECREF(x);
+      return NULL;
+  }
   if (info) { 
       PyErr_SetString(PyExc_SystemError,
                       "gstrs was called with invalid arguments");
-      goto fail;
+      Py_XDECREF(x);
+      return NULL;
   }
   
-  /* free memory */
-  Destroy_SuperMatrix_Store(&B);
-  StatFree(&stat);
   return (PyObject *)x;
 
 fail:
-  Destroy_SuperMatrix_Store(&B);  
-  StatFree(&stat);
   Py_XDECREF(x);
   return NULL;
 }
@@ -211,7 +281,8 @@ perm_r\n\
 Methods\n\
 -------\n\
 solve\n\
-    solves the system for a given right hand side vector\n \
+    solves the system for given right hand side vector(s), optionally\n\
+    in place\n\
 \n\
 ";
 
@@ -291,9 +362,14 @@ int DenseSuper_from_Numeric(SuperMatrix *X, PyObject *PyX)
     n = 1;
     ldx = m;
   }
-  else {  /* nd == 2 */
-    m = aX->dimensions[1];
-    n = aX->dimensions[0];
+  else {  /* nd == 2, Fortran-ordered: one right hand side per column */
+    if (!PyArray_CHKFLAGS(aX, NPY_F_CONTIGUOUS)) {
+      PyErr_SetString(PyExc_ValueError,
+                      "dgssv: Second argument is not Fortran-contiguous.");
+      return -1;
+    }
+    m = aX->dimensions[0];
+    n = aX->dimensions[1];
     ldx = m;
   }
   
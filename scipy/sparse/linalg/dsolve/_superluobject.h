@@ -9,6 +9,7 @@
 #define __SUPERLU_OBJECT
 
 #include "Python.h"
+#include <setjmp.h>
 #include "SuperLU/SRC/slu_zdefs.h"
 #include "numpy/arrayobject.h"
 #include "SuperLU/SRC/slu_util.h"
@@ -44,6 +45,20 @@ int set_superlu_options_from_dict(superlu_options_t *options,
                                   int ilu, PyObject *option_dict,
                                   int *panel_size, int *relax);
 
+/* State of a thread that runs SuperLU with the GIL released: the jump
+   buffer of the abort handler, and the blocks allocated in the meantime,
+   which are tracked here rather than in the module's dictionary, so that
+   the allocation hooks do not need the GIL. */
+#define SUPERLU_THREAD_ALLOCS 32
+typedef struct {
+    jmp_buf jmpbuf;
+    void *allocs[SUPERLU_THREAD_ALLOCS];
+    int nallocs;
+} SuperLUThreadState;
+
+void superlu_python_set_thread_state(SuperLUThreadState *);
+void superlu_python_release_thread_state(SuperLUThreadState *);
+
 /*
  * Definitions for other SuperLU data types than Z,
  * and type-generic definitions.
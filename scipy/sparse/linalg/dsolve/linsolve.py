@@ -148,6 +148,12 @@ def splu(A, permc_spec=None, diag_pivot_thresh=None,
     -----
     This function uses the SuperLU library.
 
+    ``invA.solve(b)`` accepts a vector or an ``(N, k)`` array of right
+    hand sides. With ``overwrite_b=True`` and a Fortran-ordered `b` of the
+    same dtype as the factors, the solution is written into `b` without
+    making a copy. The GIL is released during the solve, so separate
+    factorizations can be used concurrently from several threads.
+
     References
     ----------
     .. [SLU] SuperLU http://crd.lbl.gov/~xiaoye/SuperLU/
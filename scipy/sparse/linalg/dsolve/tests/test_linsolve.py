@@ -1,6 +1,7 @@
 import warnings
 
-from numpy import array, finfo, arange, eye, all, unique, ones, dot, matrix
+from numpy import array, finfo, arange, eye, all, unique, ones, dot, matrix, \
+        asfortranarray
 import numpy.random as random
 from numpy.testing import TestCase, run_module_suite, assert_array_almost_equal, \
     assert_raises, assert_almost_equal, assert_equal, assert_array_equal, assert_
@@ -133,6 +134,55 @@ class TestSplu(object):
         lu = splu(a_)
         assert_array_equal(lu.perm_r, lu.perm_c)
 
+    def test_splu_multiple_rhs(self):
+        lu = splu(self.A)
+        b = random.rand(self.n, 70)
+        x = lu.solve(b)
+        assert_equal(x.shape, b.shape)
+        assert_array_almost_equal(self.A*x, b)
+
+        x = lu.solve(b, 'T')
+        assert_array_almost_equal(self.A.T*x, b)
+
+        assert_raises(ValueError, lu.solve, random.rand(self.n + 1))
+
+    def test_splu_solve_inplace(self):
+        lu = splu(self.A)
+
+        b = asfortranarray(random.rand(self.n, 3))
+        b0 = b.copy()
+        x = lu.solve(b, overwrite_b=True)
+        assert_(x is b)
+        assert_array_almost_equal(self.A*x, b0)
+
+        # C-ordered or mistyped buffers fall back to a copy
+        for b in [random.rand(self.n, 3), random.rand(self.n).astype('f')]:
+            b0 = b.copy()
+            x = lu.solve(b, overwrite_b=True)
+            assert_(x is not b)
+            assert_array_equal(b, b0)
+            assert_array_almost_equal(self.A*x, b0, decimal=5)
+
+    def test_splu_solve_threads(self):
+        import threading
+        lus = [splu(self.A*(k+1)) for k in range(4)]
+        b = random.rand(self.n)
+        results = [None]*len(lus)
+
+        def worker(k):
+            for j in range(50):
+                results[k] = lus[k].solve(b)
+
+        threads = [threading.Thread(target=worker, args=(k,))
+                   for k in range(len(lus))]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+        for k in range(len(lus)):
+            assert_array_almost_equal((self.A*(k+1))*results[k], b)
+
     def test_lu_refcount(self):
         # Test that we are keeping track of the reference count with splu.
         n = 30
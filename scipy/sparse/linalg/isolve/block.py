@@ -0,0 +1,308 @@
+"""Block Krylov methods for several right-hand sides"""
+
+__all__ = ['block_cg', 'block_gmres']
+
+import numpy as np
+
+from scipy.sparse.linalg.interface import aslinearoperator, IdentityOperator
+from iterative import _as_preconditioner
+from utils import coerce
+
+
+common_doc = \
+"""
+Parameters
+----------
+A : {sparse matrix, dense matrix, LinearOperator}
+    The N-by-N matrix of the linear system.
+B : {array, matrix}
+    Right hand sides of the linear system, one per column.  Has shape
+    (N,K), or (N,) for a single right hand side.
+
+Returns
+-------
+X : {array, matrix}
+    The converged solutions, with the shape of B.
+info : {array of integers, integer}
+    Convergence information for each column of B (an integer if B is a
+    vector):
+        0  : successful exit
+        >0 : convergence to tolerance not achieved, number of iterations
+
+Other Parameters
+----------------
+X0  : {array, matrix}
+    Starting guesses for the solutions, with the shape of B.
+tol : float
+    Tolerance to achieve.  A column has converged when its residual is
+    below `tol` times the norm of the corresponding column of B.
+maxiter : integer
+    Maximum number of iterations.  Iteration will stop after maxiter
+    steps even if the specified tolerance has not been achieved.
+M : {sparse matrix, dense matrix, LinearOperator, 'jacobi', 'ilu0'}
+    Preconditioner for A.  The preconditioner should approximate the
+    inverse of A.  The strings 'jacobi' and 'ilu0' select a diagonal or
+    an incomplete LU(0) preconditioner computed from a sparse A.
+callback : function
+    User-supplied function to call after each iteration.  It is called
+    as callback(Xk), where Xk is the current (N,K) block of solutions.
+
+Notes
+-----
+Every iteration multiplies A and M with a dense block of vectors at
+once, which for sparse matrices is done by csr_matvecs or bsr_matvecs
+and reads the matrix only once for all right hand sides.  Converged
+columns are removed from the block, and search directions that have
+become linearly dependent are dropped (deflation), so the block shrinks
+as the iteration proceeds.
+"""
+
+
+def set_docstring(header, footer):
+    def combine(fn):
+        fn.__doc__ = header + '\n' + common_doc + '\n' + footer
+        return fn
+    return combine
+
+
+def make_block_system(A, M, X0, B):
+    """Make a linear system AX=B with a block of right hand sides
+
+    Returns (A, M, X, B, postprocess) like make_system, except that X
+    and B have shape (N,K).
+    """
+    A_ = A
+    A = aslinearoperator(A)
+
+    if A.shape[0] != A.shape[1]:
+        raise ValueError('expected square matrix, but got shape=%s' % (A.shape,))
+
+    N = A.shape[0]
+
+    B = np.asanyarray(B)
+
+    if not (B.ndim == 2 and B.shape[0] == N or B.shape == (N,)):
+        raise ValueError('A and B have incompatible dimensions')
+
+    if B.dtype.char not in 'fdFD':
+        B = B.astype('d') # upcast non-FP types to double
+
+    def postprocess(X):
+        if isinstance(B, np.matrix):
+            X = np.asmatrix(X)
+        return X.reshape(B.shape)
+
+    if hasattr(A,'dtype'):
+        xtype = A.dtype.char
+    else:
+        xtype = A.matvec(np.asarray(B).reshape(N,-1)[:,0]).dtype.char
+    xtype = coerce(xtype, B.dtype.char)
+
+    B_ = np.asarray(B, dtype=xtype).reshape(N,-1)
+
+    if X0 is None:
+        X = np.zeros(B_.shape, dtype=xtype)
+    else:
+        X = np.array(X0, dtype=xtype)
+        if X.size != B_.size:
+            raise ValueError('A and X0 have incompatible dimensions')
+        X = X.reshape(B_.shape)
+
+    if M is None:
+        M = IdentityOperator(shape=A.shape, dtype=A.dtype)
+    else:
+        M = aslinearoperator(_as_preconditioner(A_, M, B_))
+        if A.shape != M.shape:
+            raise ValueError('matrix and preconditioner have different shapes')
+
+    return A, M, X, B_, postprocess
+
+
+def _colnorms(X):
+    return np.sqrt((abs(X)**2).sum(axis=0))
+
+def _matmat(A, X):
+    return np.asarray(A.matmat(np.ascontiguousarray(X)))
+
+def _orth(W):
+    """Return an orthonormal basis of the range of W, leaving out the
+    directions in which the (normalized) columns of W are numerically
+    dependent"""
+    from scipy.linalg import qr, svd
+
+    if W.shape[1] == 0:
+        return np.zeros(W.shape, dtype=W.dtype)
+    cn = _colnorms(W)
+    cn[cn == 0] = 1
+    Q, R = qr(W / cn, mode='economic')
+    U, s, Vh = svd(R)
+    rank = (s > np.sqrt(np.finfo(s.dtype).eps) * s[0]).sum()
+    return np.dot(Q, U[:,:rank])
+
+
+@set_docstring('Use block Conjugate Gradient iteration to solve A X = B',
+"""
+The iteration is the breakdown-free block CG of Ji and Li: the block of
+search directions is re-orthonormalized in every step, which also
+detects and removes dependent directions.  If no independent directions
+are left while some columns have not converged, for instance because
+the preconditioner is singular, info is -1 for those columns.
+""")
+def block_cg(A, B, X0=None, tol=1e-5, maxiter=None, M=None, callback=None):
+    from scipy.linalg import solve
+
+    vector = np.ndim(B) == 1
+
+    A,M,X,B,postprocess = make_block_system(A,M,X0,B)
+
+    N, K = B.shape
+    if maxiter is None:
+        maxiter = N*10
+
+    bnrm2 = _colnorms(B)
+    bnrm2[bnrm2 == 0] = 1
+
+    R = B - _matmat(A, X)
+    active = np.flatnonzero(_colnorms(R) > tol*bnrm2)
+
+    iter_ = 0
+    if len(active) > 0:
+        P = _orth(_matmat(M, R[:,active]))
+    while len(active) > 0 and P.shape[1] > 0 and iter_ < maxiter:
+        iter_ += 1
+
+        Q = _matmat(A, P)
+        PQ = np.dot(P.T.conj(), Q)
+
+        alpha = solve(PQ, np.dot(P.T.conj(), R[:,active]))
+        X[:,active] += np.dot(P, alpha)
+        R[:,active] -= np.dot(Q, alpha)
+
+        if callback is not None:
+            callback(postprocess(X))
+
+        active = np.flatnonzero(_colnorms(R) > tol*bnrm2)
+        if len(active) == 0:
+            break
+
+        # new directions, A-conjugate to the previous block
+        Z = _matmat(M, R[:,active])
+        beta = solve(PQ, np.dot(Q.T.conj(), Z))
+        P = _orth(Z - np.dot(P, beta))
+
+    info = np.zeros(K, dtype=int)
+    if len(active) > 0:
+        # either maxiter was reached, or no independent search directions
+        # are left although the residuals have not converged (breakdown)
+        if P.shape[1] > 0:
+            info[active] = iter_
+        else:
+            info[active] = -1
+
+    if vector:
+        info = info[0]
+    return postprocess(X), info
+
+
+@set_docstring('Use block Generalized Minimal RESidual iteration to solve A X = B',
+"""
+Additional parameters
+---------------------
+restart : int, optional
+    Number of block iterations between restarts.  Default is 20.  As for
+    gmres, maxiter counts restart cycles and the tolerance applies to the
+    preconditioned residual during a cycle.
+""")
+def block_gmres(A, B, X0=None, tol=1e-5, restart=None, maxiter=None, M=None,
+                callback=None):
+    from scipy.linalg import lstsq
+
+    vector = np.ndim(B) == 1
+
+    A,M,X,B,postprocess = make_block_system(A,M,X0,B)
+
+    N, K = B.shape
+    if maxiter is None:
+        maxiter = N*10
+
+    if restart is None:
+        restart = 20
+    restart = min(restart, N)
+
+    bnrm2 = _colnorms(B)
+    bnrm2[bnrm2 == 0] = 1
+
+    iter_ = 0
+    breakdown = False
+    while True:
+        R = B - _matmat(A, X)
+        active = np.flatnonzero(_colnorms(R) > tol*bnrm2)
+        if len(active) == 0 or iter_ == maxiter or breakdown:
+            break
+        iter_ += 1
+
+        # initial block V0 and its coefficients S = V0^H M R
+        Z = _matmat(M, R[:,active])
+        V = [_orth(Z)]
+        S = np.dot(V[0].T.conj(), Z)
+        p = V[0].shape[1]
+        if p == 0:
+            # the preconditioned residuals vanish although the residuals
+            # have not converged: no search directions are left
+            breakdown = True
+            break
+
+        # block Arnoldi, with H stored as a list of block columns
+        H = []
+        for j in xrange(restart):
+            W = _matmat(M, _matmat(A, V[j]))
+            Hj = []
+            for Vi in V:
+                Hij = np.dot(Vi.T.conj(), W)
+                W -= np.dot(Vi, Hij)
+                Hj.append(Hij)
+            Vnext = _orth(W)
+            Hj.append(np.dot(Vnext.T.conj(), W))
+            H.append(Hj)
+            V.append(Vnext)
+
+            # least squares problem min || E1 S - Hbar Y ||
+            rows = [Vi.shape[1] for Vi in V]
+            Hbar = np.zeros((sum(rows), p*(j+1)), dtype=X.dtype)
+            for c, Hc in enumerate(H):
+                r0 = 0
+                for Hrc, nr in zip(Hc, rows):
+                    Hbar[r0:r0+nr, c*p:(c+1)*p] = Hrc
+                    r0 += nr
+            E1S = np.zeros((sum(rows), len(active)), dtype=X.dtype)
+            E1S[:p] = S
+            Y = lstsq(Hbar, E1S)[0]
+
+            resid = _colnorms(E1S - np.dot(Hbar, Y))
+            if (resid <= tol*bnrm2[active]).all() or Vnext.shape[1] < p:
+                break
+
+        # without a next basis block the Krylov space is exhausted; if the
+        # residuals still have not converged after this update, another
+        # cycle would only repeat it
+        if Vnext.shape[1] == 0:
+            breakdown = True
+
+        for c in xrange(len(H)):
+            X[:,active] += np.dot(V[c], Y[c*p:(c+1)*p])
+
+        if callback is not None:
+            callback(postprocess(X))
+
+    info = np.zeros(K, dtype=int)
+    if len(active) > 0:
+        # either maxiter was reached, or no independent search directions
+        # are left although the residuals have not converged (breakdown)
+        if breakdown:
+            info[active] = -1
+        else:
+            info[active] = iter_
+
+    if vector:
+        info = info[0]
+    return postprocess(X), info
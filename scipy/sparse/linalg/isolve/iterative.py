@@ -5,8 +5,9 @@ __all__ = ['bicg','bicgstab','cg','cgs','gmres','qmr']
 import _iterative
 import numpy as np
 
+from scipy.sparse import isspmatrix, isspmatrix_bsr
 from scipy.sparse.linalg.interface import LinearOperator
-from utils import make_system
+from utils import make_system, coerce
 
 _type_conv = {'f':'s', 'd':'d', 'F':'c', 'D':'z'}
 
@@ -41,11 +42,13 @@ tol : float
 maxiter : integer
     Maximum number of iterations.  Iteration will stop after maxiter
     steps even if the specified tolerance has not been achieved.
-M : {sparse matrix, dense matrix, LinearOperator}
+M : {sparse matrix, dense matrix, LinearOperator, 'jacobi', 'ilu0'}
     Preconditioner for A.  The preconditioner should approximate the
     inverse of A.  Effective preconditioning dramatically improves the
     rate of convergence, which implies that fewer iterations are needed
-    to reach a given error tolerance.
+    to reach a given error tolerance.  Except for bicg, the strings
+    'jacobi' and 'ilu0' select a diagonal or an incomplete LU(0)
+    preconditioner computed from a sparse A.
 callback : function
     User-supplied function to call after each iteration.  It is called
     as callback(xk), where xk is the current solution vector.
@@ -59,9 +62,107 @@ xtype : {'f','d','F','D'}
     for the same type as b or use xtype='f','d','F',or 'D'.
     This parameter has been superceeded by LinearOperator.
 
+Notes
+-----
+When A is a sparse matrix, M is None or one of the preconditioner names,
+and no callback is given, the whole iteration runs in compiled code on
+the CSR (or BSR) arrays of A without returning to Python and with the
+GIL released.  Otherwise the solver calls A and M through Python once
+per matrix-vector product.
 """
 
 
+_native_precond = {'jacobi' : 1, 'ilu0' : 2}
+
+def _check_precond_name(A, M):
+    if M not in _native_precond:
+        raise ValueError("unknown preconditioner '%s'" % M)
+    if not isspmatrix(A):
+        raise ValueError("preconditioner '%s' requires a sparse matrix" % M)
+
+def _use_native(A, M, callback, xtype):
+    """Return True if the compiled driver loop can solve with A and M"""
+    if isinstance(M, str):
+        _check_precond_name(A, M)
+    elif M is not None or hasattr(A, 'psolve'):
+        return False
+    return (isspmatrix(A) and A.shape[0] == A.shape[1] and A.shape[0] > 0
+            and callback is None and xtype is None)
+
+def _native_matrix(A, dtype):
+    """Return (br, bc, indptr, indices, data) of A for the driver loops"""
+    if isspmatrix_bsr(A):
+        br, bc = A.blocksize
+    else:
+        A = A.tocsr()
+        br = bc = 1
+    if A.dtype != dtype:
+        A = A.astype(dtype)
+    nnz = A.indptr[-1]
+    return br, bc, A.indptr, A.indices[:nnz], A.data[:nnz].ravel()
+
+def _native_preconditioner(A, M, dtype):
+    """Return (ptype, pp, pj, px, pd) for the preconditioner named M"""
+    ltr = _type_conv[dtype.char]
+    dummy = np.zeros(1, dtype=np.intc)
+    if M is None:
+        return 0, dummy, dummy, np.zeros(1, dtype=dtype), dummy
+    elif M == 'jacobi':
+        d = np.asarray(A.diagonal(), dtype=dtype)
+        if (d == 0).any():
+            raise ValueError('Jacobi preconditioner requires a nonzero '
+                             'diagonal')
+        return 1, dummy, dummy, 1/d, dummy
+    else:
+        C = A.tocsr().astype(dtype)
+        C.sum_duplicates()
+        nnz = C.indptr[-1]
+        lu, pd, info = getattr(_iterative, ltr + 'ilu0')(C.indptr,
+                                                         C.indices[:nnz],
+                                                         C.data[:nnz])
+        if info > 0:
+            raise RuntimeError('ILU(0) breakdown: zero or missing pivot '
+                               'in row %d' % (info - 1))
+        return 2, C.indptr, C.indices[:nnz], lu, pd
+
+def _as_preconditioner(A, M, b):
+    """Turn a preconditioner name into a LinearOperator for the
+    reverse communication loops"""
+    if not isinstance(M, str):
+        return M
+    _check_precond_name(A, M)
+    dtype = np.dtype(coerce(A.dtype.char, np.asarray(b).dtype.char))
+    ptype, pp, pj, px, pd = _native_preconditioner(A, M, dtype)
+    sppsolve = getattr(_iterative, _type_conv[dtype.char] + 'sppsolve')
+    def matvec(r):
+        return sppsolve(ptype, pp, pj, px, pd, np.ravel(r))
+    return LinearOperator(A.shape, matvec, dtype=dtype)
+
+def _native_solve(method, A, b, x0, tol, maxiter, M, restrt=None):
+    """Solve with the compiled driver loop of the given method"""
+    A_ = A
+    A,M_,x,b,postprocess = make_system(A,None,x0,b,None)
+
+    n = len(b)
+    if maxiter is None:
+        maxiter = n*10
+
+    br, bc, ap, aj, ax = _native_matrix(A_, x.dtype)
+    ptype, pp, pj, px, pd = _native_preconditioner(A_, M, x.dtype)
+    solver = getattr(_iterative, _type_conv[x.dtype.char] + method + 'sp')
+
+    if method == 'gmres':
+        x, iter_, resid, info = solver(br, bc, ap, aj, ax,
+                                       ptype, pp, pj, px, pd,
+                                       b, x, restrt, maxiter, tol)
+    else:
+        x, iter_, resid, info = solver(br, bc, ap, aj, ax,
+                                       ptype, pp, pj, px, pd,
+                                       b, x, maxiter, tol)
+
+    return postprocess(x), info
+
+
 def set_docstring(header, footer):
     def combine(fn):
         fn.__doc__ = header + '\n' + common_doc + '\n' + footer
@@ -72,6 +173,9 @@ def set_docstring(header, footer):
 
 @set_docstring('Use BIConjugate Gradient iteration to solve A x = b','')
 def bicg(A, b, x0=None, tol=1e-5, maxiter=None, xtype=None, M=None, callback=None):
+    if isinstance(M, str):
+        raise ValueError("bicg needs the transpose of the preconditioner; "
+                         "'%s' is not supported" % M)
     A,M,x,b,postprocess = make_system(A,M,x0,b,xtype)
 
     n = len(b)
@@ -133,6 +237,10 @@ def bicg(A, b, x0=None, tol=1e-5, maxiter=None, xtype=None, M=None, callback=Non
 
 @set_docstring('Use BIConjugate Gradient STABilized iteration to solve A x = b','')
 def bicgstab(A, b, x0=None, tol=1e-5, maxiter=None, xtype=None, M=None, callback=None):
+    if _use_native(A, M, callback, xtype):
+        return _native_solve('bicgstab', A, b, x0, tol, maxiter, M)
+
+    M = _as_preconditioner(A, M, b)
     A,M,x,b,postprocess = make_system(A,M,x0,b,xtype)
 
     n = len(b)
@@ -191,6 +299,10 @@ def bicgstab(A, b, x0=None, tol=1e-5, maxiter=None, xtype=None, M=None, callback
 
 @set_docstring('Use Conjugate Gradient iteration to solve A x = b','')
 def cg(A, b, x0=None, tol=1e-5, maxiter=None, xtype=None, M=None, callback=None):
+    if _use_native(A, M, callback, xtype):
+        return _native_solve('cg', A, b, x0, tol, maxiter, M)
+
+    M = _as_preconditioner(A, M, b)
     A,M,x,b,postprocess = make_system(A,M,x0,b,xtype)
 
     n = len(b)
@@ -249,6 +361,7 @@ def cg(A, b, x0=None, tol=1e-5, maxiter=None, xtype=None, M=None, callback=None)
 
 @set_docstring('Use Conjugate Gradient Squared iteration to solve A x = b','')
 def cgs(A, b, x0=None, tol=1e-5, maxiter=None, xtype=None, M=None, callback=None):
+    M = _as_preconditioner(A, M, b)
     A,M,x,b,postprocess = make_system(A,M,x0,b,xtype)
 
     n = len(b)
@@ -339,12 +452,14 @@ def gmres(A, b, x0=None, tol=1e-5, restart=None, maxiter=None, xtype=None, M=Non
     maxiter : int, optional
         Maximum number of iterations.  Iteration will stop after maxiter
         steps even if the specified tolerance has not been achieved.
-    M : {sparse matrix, dense matrix, LinearOperator}
+    M : {sparse matrix, dense matrix, LinearOperator, 'jacobi', 'ilu0'}
         Inverse of the preconditioner of A.  M should approximate the
         inverse of A and be easy to solve for (see Notes).  Effective
         preconditioning dramatically improves the rate of convergence,
         which implies that fewer iterations are needed to reach a given
-        error tolerance.  By default, no preconditioner is used.
+        error tolerance.  By default, no preconditioner is used.  For a
+        sparse A the strings 'jacobi' and 'ilu0' select a diagonal or an
+        incomplete LU(0) preconditioner computed from A.
     callback : function
         User-supplied function to call after each iteration.  It is called
         as callback(rk), where rk is the current residual vector.
@@ -365,6 +480,10 @@ def gmres(A, b, x0=None, tol=1e-5, restart=None, maxiter=None, xtype=None, M=Non
       M_x = lambda x: spla.spsolve(P, x)
       M = spla.LinearOperator((n, n), M_x)
 
+    When A is a sparse matrix, M is None, 'jacobi' or 'ilu0', and no
+    callback is given, the iteration runs in compiled code without
+    returning to Python and with the GIL released.
+
     Deprecated Parameters
     ---------------------
     xtype : {'f','d','F','D'}
@@ -390,14 +509,20 @@ def gmres(A, b, x0=None, tol=1e-5, restart=None, maxiter=None, xtype=None, M=Non
         raise ValueError("Cannot specify both restart and restrt keywords. "
                          "Preferably use 'restart' only.")
 
+    if restrt is None:
+        restrt = 20
+
+    if _use_native(A, M, callback, xtype):
+        return _native_solve('gmres', A, b, x0, tol, maxiter, M,
+                             min(restrt, A.shape[0]))
+
+    M = _as_preconditioner(A, M, b)
     A,M,x,b,postprocess = make_system(A,M,x0,b,xtype)
 
     n = len(b)
     if maxiter is None:
         maxiter = n*10
 
-    if restrt is None:
-        restrt = 20
     restrt = min(restrt, n)
 
     matvec = A.matvec
@@ -30,7 +30,7 @@ def configuration(parent_package='',top_path=None):
                'QMRREVCOM.f.src',
 #               'SORREVCOM.f.src'
                ]
-    Util = ['STOPTEST2.f.src','getbreak.f.src']
+    Util = ['STOPTEST2.f.src','getbreak.f.src','SPDRIVER.f.src']
     sources = Util + methods + ['_iterative.pyf.src']
     config.add_extension('_iterative',
                          sources = [join('iterative',x) for x in sources],
@@ -0,0 +1,123 @@
+#!/usr/bin/env python
+"""Tests for the linalg.isolve.block module
+"""
+
+from numpy.testing import TestCase, assert_, assert_equal, run_module_suite
+
+import numpy as np
+from scipy.sparse import spdiags, kron, eye, bsr_matrix
+
+from scipy.sparse.linalg.interface import LinearOperator
+from scipy.sparse.linalg.isolve import block_cg, block_gmres, cg
+
+def poisson2d(n):
+    data = np.ones((3,n))
+    data[0,:] =  2
+    data[1,:] = -1
+    data[2,:] = -1
+    P = spdiags(data, [0,-1,1], n, n)
+    return (kron(P, eye(n,n)) + kron(eye(n,n), P)).tocsr()
+
+def colnorms(X):
+    return np.sqrt((abs(X)**2).sum(axis=0))
+
+
+class TestBlock(TestCase):
+    def setUp(self):
+        np.random.seed(1234)
+        self.A = poisson2d(12)
+        self.B = np.random.randn(self.A.shape[0], 6)
+
+    def check_solution(self, A, B, X, tol):
+        assert_equal(X.shape, B.shape)
+        assert_( (colnorms(B - A*X) <= tol*colnorms(B)).all() )
+
+    def test_convergence(self):
+        A, B = self.A, self.B
+        for solver in [block_cg, block_gmres]:
+            X, info = solver(A, B, tol=1e-8)
+            assert_equal(info, np.zeros(B.shape[1]))
+            self.check_solution(A, B, X, 1e-8)
+
+    def test_complex(self):
+        A = self.A + 1j*spdiags([np.arange(self.A.shape[0])], [0],
+                                *self.A.shape)
+        B = self.B + 1j*np.random.randn(*self.B.shape)
+        X, info = block_gmres(A, B, tol=1e-8)
+        assert_equal(info, np.zeros(B.shape[1]))
+        self.check_solution(A, B, X, 1e-8)
+
+    def test_vector(self):
+        A, b = self.A, self.B[:,0]
+        for solver in [block_cg, block_gmres]:
+            x, info = solver(A, b, tol=1e-8)
+            assert_equal(x.shape, b.shape)
+            assert_equal(info, 0)
+
+    def test_deflation(self):
+        """dependent and zero right hand sides"""
+        A, B = self.A, self.B.copy()
+        B[:,1] = 2*B[:,0] - B[:,2]
+        B[:,3] = 0
+        for solver in [block_cg, block_gmres]:
+            X, info = solver(A, B, tol=1e-8)
+            assert_equal(info, np.zeros(B.shape[1]))
+            self.check_solution(A, B, X, 1e-8)
+            assert_equal(X[:,3], 0)
+
+    def test_fewer_iterations(self):
+        """the block method needs fewer passes over A than separate solves"""
+        A, B = self.A, self.B
+        count = [0]
+        def matmat(X):
+            count[0] += 1
+            return A*X
+        Aop = LinearOperator(A.shape, matvec=matmat, matmat=matmat,
+                             dtype=A.dtype)
+        X, info = block_cg(Aop, B, tol=1e-8)
+        block_count = count[0]
+
+        count[0] = 0
+        x, info = cg(Aop, B[:,0], tol=1e-8)
+        assert_( block_count < count[0] )
+
+    def test_preconditioner(self):
+        A, B = self.A, self.B
+        for M in ['jacobi', 'ilu0', spdiags([1/A.diagonal()], [0], *A.shape)]:
+            for solver in [block_cg, block_gmres]:
+                X, info = solver(A, B, tol=1e-8, M=M)
+                assert_equal(info, np.zeros(B.shape[1]))
+                self.check_solution(A, B, X, 1e-8)
+
+    def test_breakdown(self):
+        """a preconditioner that leaves no search directions"""
+        A, B = self.A, self.B
+        zero = lambda X: 0*X
+        M = LinearOperator(A.shape, matvec=zero, matmat=zero, dtype=A.dtype)
+        for solver in [block_cg, block_gmres]:
+            X, info = solver(A, B, M=M)
+            assert_equal(info, -np.ones(B.shape[1]))
+
+    def test_bsr(self):
+        A = bsr_matrix(self.A, blocksize=(2,2))
+        X, info = block_cg(A, self.B, tol=1e-8)
+        self.check_solution(self.A, self.B, X, 1e-8)
+
+    def test_maxiter(self):
+        A, B = self.A, self.B
+        X, info = block_cg(A, B, tol=1e-12, maxiter=2)
+        assert_equal(info, 2*np.ones(B.shape[1]))
+        X, info = block_gmres(A, B, tol=1e-12, restart=2, maxiter=2)
+        assert_equal(info, 2*np.ones(B.shape[1]))
+
+    def test_x0(self):
+        A, B = self.A, self.B
+        X0 = np.ones(B.shape)
+        for solver in [block_cg, block_gmres]:
+            X, info = solver(A, B, X0=X0, tol=1e-8)
+            assert_equal(X0, np.ones(B.shape))
+            self.check_solution(A, B, X, 1e-8)
+
+
+if __name__ == "__main__":
+    run_module_suite()
@@ -2,11 +2,12 @@
 """ Test functions for the sparse.linalg.isolve module
 """
 
-from numpy.testing import TestCase, assert_equal, assert_array_equal, assert_
+from numpy.testing import TestCase, assert_equal, assert_array_equal, assert_, \
+        assert_raises, assert_array_almost_equal
 
 from numpy import zeros, ones, arange, array, abs, max
 from scipy.linalg import norm
-from scipy.sparse import spdiags, csr_matrix
+from scipy.sparse import spdiags, csr_matrix, bsr_matrix, kron, eye
 
 from scipy.sparse.linalg.interface import LinearOperator
 from scipy.sparse.linalg.isolve import cg, cgs, bicg, bicgstab, gmres, qmr, minres, lgmres
@@ -142,6 +143,81 @@ class TestIterative(TestCase):
                 assert_( norm(b - A*x) < tol*norm(b) )
 
 
+class TestNative(TestCase):
+    """the compiled driver loops used for sparse matrices"""
+    def setUp(self):
+        P = Poisson1D[:10,:10]
+        self.A = (kron(P, eye(10,10)) + kron(eye(10,10), P)).tocsr()
+        self.b = arange(self.A.shape[0], dtype=float)
+
+    def test_matches_revcom(self):
+        A, b = self.A, self.b
+        Aop = LinearOperator(A.shape, matvec=lambda x: A*x, dtype=A.dtype)
+        for solver in [cg, bicgstab, gmres]:
+            for dtype in ['f', 'd', 'F', 'D']:
+                tol = dtype in 'fF' and 1e-4 or 1e-10
+                B = A.astype(dtype)
+                bb = b.astype(dtype)
+                x1, info1 = solver(B, bb, tol=tol)
+                x2, info2 = solver(Aop, bb, tol=tol, xtype=dtype)
+                assert_equal(info1, 0)
+                assert_equal(info2, 0)
+                assert_equal(x1.dtype.char, dtype)
+                assert_( norm(bb - B*x1) < 10*tol*norm(bb) )
+                assert_array_almost_equal(x1, x2, decimal=dtype in 'fF'
+                                          and 2 or 6)
+
+    def test_preconditioners(self):
+        A, b = self.A, self.b
+        iters = {}
+        for M in [None, 'jacobi', 'ilu0']:
+            for solver in [cg, bicgstab, gmres]:
+                x, info = solver(A, b, tol=1e-10, M=M)
+                assert_equal(info, 0)
+                assert_( norm(b - A*x) < 1e-10*norm(b) )
+
+            # the same preconditioner through the Python loop
+            residuals = []
+            def callback(x):
+                residuals.append(1)
+            x, info = cg(A, b, tol=1e-10, M=M, callback=callback)
+            assert_equal(info, 0)
+            assert_( norm(b - A*x) < 1e-10*norm(b) )
+            iters[M] = len(residuals)
+
+            x, info = cgs(A, b, tol=1e-10, M=M)
+            assert_equal(info, 0)
+
+        assert_( iters['ilu0'] < iters[None] )
+
+    def test_bsr(self):
+        A, b = self.A, self.b
+        for blocksize in [(1,1), (2,2), (5,2)]:
+            B = bsr_matrix(A, blocksize=blocksize)
+            for solver in [cg, bicgstab, gmres]:
+                x, info = solver(B, b, tol=1e-10, M='jacobi')
+                assert_equal(info, 0)
+                assert_( norm(b - A*x) < 1e-10*norm(b) )
+
+    def test_maxiter(self):
+        A, b = self.A, self.b
+        for solver in [cg, bicgstab]:
+            x, info = solver(A, b, tol=1e-12, maxiter=3)
+            assert_equal(info, 3)
+        x, info = gmres(A, b, tol=1e-12, restart=2, maxiter=3)
+        assert_equal(info, 3)
+
+    def test_invalid(self):
+        A, b = self.A, self.b
+        assert_raises(ValueError, cg, A, b, M='ilu')
+        assert_raises(ValueError, bicg, A, b, M='jacobi')
+        assert_raises(ValueError, cg, A.todense(), b, M='jacobi')
+        A = A.tolil()
+        A[0,0] = 0
+        assert_raises(ValueError, cg, A.tocsr(), b, M='jacobi')
+        assert_raises(RuntimeError, gmres, A.tocsr(), b, M='ilu0')
+
+
 class TestQMR(TestCase):
     def test_leftright_precond(self):
         """Check that QMR works with left and right preconditioners"""
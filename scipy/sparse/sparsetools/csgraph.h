@@ -2,6 +2,8 @@
 #define __CSGRAPH_H__
 
 #include <vector>
+#include <utility>
+#include <algorithm>
 
 /*
  * Determine connected compoments of a compressed sparse graph.
@@ -73,6 +75,507 @@ I cs_graph_components(const I n_nod,
   return n_comp;
 }
 
+/*
+ * Breadth-first level structure of the component containing root,
+ * restricted to the nodes i with mask[i] == tag.
+ *
+ * Input Arguments:
+ *   I  Ap[n_nod+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   I  root          - starting node
+ *   I  mask[n_nod]   - node labels
+ *   I  tag           - label of the nodes that may be visited
+ *
+ * Output Arguments:
+ *   order            - visited nodes, level by level
+ *   level_ptr        - level k is order[level_ptr[k]:level_ptr[k+1]]
+ *
+ * Note:
+ *   seen[] is a work array which must be false on entry and is
+ *   restored on exit.
+ */
+template <class I>
+void cs_graph_level_structure(const I Ap[],
+                              const I Aj[],
+                              const I root,
+                              const I mask[],
+                              const I tag,
+                              std::vector<bool>& seen,
+                              std::vector<I>& order,
+                              std::vector<I>& level_ptr)
+{
+  order.clear();
+  level_ptr.clear();
+
+  order.push_back(root);
+  seen[root] = true;
+  level_ptr.push_back(0);
+
+  I level_start = 0;
+  while (level_start < (I) order.size()) {
+    const I level_end = order.size();
+    level_ptr.push_back(level_end);
+    for (I ii = level_start; ii < level_end; ii++) {
+      const I i = order[ii];
+      for (I jj = Ap[i]; jj < Ap[i+1]; jj++) {
+        const I j = Aj[jj];
+        if (!seen[j] && mask[j] == tag) {
+          seen[j] = true;
+          order.push_back(j);
+        }
+      }
+    }
+    level_start = level_end;
+  }
+
+  for (typename std::vector<I>::const_iterator it = order.begin();
+       it != order.end(); ++it) {
+    seen[*it] = false;
+  }
+}
+
+/*
+ * Find a pseudo-peripheral node of the component containing root
+ * (George and Liu, 1979) and leave its level structure in order and
+ * level_ptr.  deg[] holds the node degrees used to break ties.
+ */
+template <class I>
+I cs_graph_pseudo_peripheral(const I Ap[],
+                             const I Aj[],
+                             const I deg[],
+                             I root,
+                             const I mask[],
+                             const I tag,
+                             std::vector<bool>& seen,
+                             std::vector<I>& order,
+                             std::vector<I>& level_ptr)
+{
+  cs_graph_level_structure(Ap, Aj, root, mask, tag, seen, order, level_ptr);
+  I height = level_ptr.size();
+
+  for (;;) {
+    // Candidate: the node of minimum degree in the last level.
+    const I last = level_ptr[level_ptr.size() - 2];
+    I cand = order[last];
+    for (I ii = last + 1; ii < (I) order.size(); ii++) {
+      if (deg[order[ii]] < deg[cand]) cand = order[ii];
+    }
+
+    std::vector<I> cand_order, cand_level_ptr;
+    cs_graph_level_structure(Ap, Aj, cand, mask, tag, seen,
+                             cand_order, cand_level_ptr);
+    if ((I) cand_level_ptr.size() <= height) break;
+
+    root = cand;
+    height = cand_level_ptr.size();
+    order.swap(cand_order);
+    level_ptr.swap(cand_level_ptr);
+  }
+
+  return root;
+}
+
+/*
+ * Reverse Cuthill-McKee ordering of a compressed sparse graph.
+ *
+ * Input Arguments:
+ *   I  n_nod         - number of nodes
+ *   I  Ap[n_nod+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *
+ * Output Arguments:
+ *   I  perm[n_nod]   - node perm[k] becomes node k
+ *
+ * Note:
+ *   Output array perm must be preallocated
+ *
+ *   The graph must be symmetric; self loops are ignored.  Each
+ *   connected component is started from a pseudo-peripheral node
+ *   and neighbours are visited in order of increasing degree.
+ *
+ *   Complexity: O(nnz(A) log(max degree)) per BFS sweep.
+ */
+template <class I>
+void cs_graph_rcm(const I n_nod,
+                  const I Ap[],
+                  const I Aj[],
+                        I perm[])
+{
+  std::vector<I> deg(n_nod);
+  for (I i = 0; i < n_nod; i++) {
+    I d = 0;
+    for (I jj = Ap[i]; jj < Ap[i+1]; jj++) {
+      if (Aj[jj] != i) d++;
+    }
+    deg[i] = d;
+  }
+
+  // Unvisited nodes carry label 0, visited nodes label 1.
+  std::vector<I> mask(n_nod, 0);
+  std::vector<bool> seen(n_nod, false);
+  std::vector<I> order, level_ptr;
+  std::vector< std::pair<I,I> > nbrs;
+
+  // Nodes by increasing degree, lowest index first among equal degrees,
+  // counted into degree buckets.
+  I max_deg = 0;
+  for (I i = 0; i < n_nod; i++) max_deg = std::max(max_deg, deg[i]);
+  std::vector<I> by_deg(n_nod), deg_ptr(max_deg + 2, 0);
+  for (I i = 0; i < n_nod; i++) deg_ptr[deg[i] + 1]++;
+  for (I d = 0; d <= max_deg; d++) deg_ptr[d + 1] += deg_ptr[d];
+  for (I i = 0; i < n_nod; i++) by_deg[deg_ptr[deg[i]]++] = i;
+
+  I n_perm = 0;
+  I cursor = 0;
+  while (n_perm < n_nod) {
+    // Start from the unvisited node of minimum degree.
+    while (mask[by_deg[cursor]] != 0) cursor++;
+    I root = by_deg[cursor];
+    root = cs_graph_pseudo_peripheral(Ap, Aj, &deg[0], root,
+                                      &mask[0], (I) 0,
+                                      seen, order, level_ptr);
+
+    I head = n_perm;
+    perm[n_perm++] = root;
+    mask[root] = 1;
+    while (head < n_perm) {
+      const I i = perm[head++];
+      nbrs.clear();
+      for (I jj = Ap[i]; jj < Ap[i+1]; jj++) {
+        const I j = Aj[jj];
+        if (mask[j] == 0) {
+          mask[j] = 1;
+          nbrs.push_back(std::make_pair(deg[j], j));
+        }
+      }
+      std::sort(nbrs.begin(), nbrs.end());
+      for (I k = 0; k < (I) nbrs.size(); k++) {
+        perm[n_perm++] = nbrs[k].second;
+      }
+    }
+  }
+
+  std::reverse(perm, perm + n_nod);
+}
+
+/*
+ * Approximate minimum degree ordering of a compressed sparse graph.
+ *
+ * Input Arguments:
+ *   I  n_nod         - number of nodes
+ *   I  Ap[n_nod+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *
+ * Output Arguments:
+ *   I  perm[n_nod]   - node perm[k] is eliminated k-th
+ *
+ * Note:
+ *   Output array perm must be preallocated
+ *
+ *   The graph must be symmetric; self loops are ignored.
+ *
+ *   Elimination is carried out on the quotient graph: eliminated
+ *   nodes become elements that are absorbed by later pivots, so the
+ *   storage never exceeds that of the input graph plus one list per
+ *   element.  Degrees are the approximate external degrees of Amestoy,
+ *   Davis and Duff (1996), without supervariable detection.
+ */
+template <class I>
+void cs_graph_amd(const I n_nod,
+                  const I Ap[],
+                  const I Aj[],
+                        I perm[])
+{
+  enum { VARIABLE = 0, ELEMENT = 1, ABSORBED = 2 };
+
+  std::vector< std::vector<I> > adj(n_nod);    // adjacent variables
+  std::vector< std::vector<I> > elems(n_nod);  // adjacent elements
+  std::vector< std::vector<I> > vars(n_nod);   // variables of an element
+  std::vector<char> status(n_nod, VARIABLE);
+  std::vector<I> deg(n_nod);
+
+  for (I i = 0; i < n_nod; i++) {
+    for (I jj = Ap[i]; jj < Ap[i+1]; jj++) {
+      if (Aj[jj] != i) adj[i].push_back(Aj[jj]);
+    }
+    deg[i] = adj[i].size();
+  }
+
+  // Doubly linked degree buckets.
+  std::vector<I> head(n_nod, -1), next(n_nod, -1), prev(n_nod, -1);
+  for (I i = 0; i < n_nod; i++) {
+    next[i] = head[deg[i]];
+    if (next[i] != -1) prev[next[i]] = i;
+    head[deg[i]] = i;
+  }
+
+  std::vector<I> var_mark(n_nod, -1);   // == p if the variable is in Lp
+  std::vector<I> elem_mark(n_nod, -1);  // == p if ext[] is valid
+  std::vector<I> ext(n_nod, 0);         // |Le \ Lp|
+  std::vector<I> Lp;
+
+  I min_deg = 0;
+  for (I k = 0; k < n_nod; k++) {
+    while (head[min_deg] == -1) min_deg++;
+
+    const I p = head[min_deg];
+    head[min_deg] = next[p];
+    if (next[p] != -1) prev[next[p]] = -1;
+
+    perm[k] = p;
+    status[p] = ELEMENT;
+
+    // Lp = (Ap U union of Le, e in Ep) \ {p}
+    Lp.clear();
+    var_mark[p] = p;
+    for (I ii = 0; ii < (I) adj[p].size(); ii++) {
+      const I j = adj[p][ii];
+      if (status[j] == VARIABLE && var_mark[j] != p) {
+        var_mark[j] = p;
+        Lp.push_back(j);
+      }
+    }
+    for (I ee = 0; ee < (I) elems[p].size(); ee++) {
+      const I e = elems[p][ee];
+      if (status[e] != ELEMENT) continue;
+      for (I ii = 0; ii < (I) vars[e].size(); ii++) {
+        const I j = vars[e][ii];
+        if (status[j] == VARIABLE && var_mark[j] != p) {
+          var_mark[j] = p;
+          Lp.push_back(j);
+        }
+      }
+      status[e] = ABSORBED;
+      std::vector<I>().swap(vars[e]);
+    }
+    std::vector<I>().swap(adj[p]);
+    std::vector<I>().swap(elems[p]);
+    vars[p] = Lp;
+
+    // |Le \ Lp| for every element adjacent to Lp.
+    for (I ii = 0; ii < (I) Lp.size(); ii++) {
+      const I i = Lp[ii];
+      for (I ee = 0; ee < (I) elems[i].size(); ee++) {
+        const I e = elems[i][ee];
+        if (status[e] != ELEMENT || e == p) continue;
+        if (elem_mark[e] != p) {
+          elem_mark[e] = p;
+          ext[e] = vars[e].size();
+        }
+        ext[e]--;
+      }
+    }
+
+    const I n_left = n_nod - k - 1;
+    for (I ii = 0; ii < (I) Lp.size(); ii++) {
+      const I i = Lp[ii];
+
+      // Unlink i from its degree bucket.
+      if (prev[i] != -1) next[prev[i]] = next[i];
+      else               head[deg[i]] = next[i];
+      if (next[i] != -1) prev[next[i]] = prev[i];
+
+      // Variables reachable through p no longer need explicit edges.
+      std::vector<I>& Ai = adj[i];
+      I n_adj = 0;
+      for (I jj = 0; jj < (I) Ai.size(); jj++) {
+        const I j = Ai[jj];
+        if (status[j] == VARIABLE && var_mark[j] != p) Ai[n_adj++] = j;
+      }
+      Ai.resize(n_adj);
+
+      // Drop absorbed elements, and elements contained in Lp
+      // (aggressive absorption), then add p.
+      std::vector<I>& Ei = elems[i];
+      I n_elem = 0;
+      I d = n_adj + (I) Lp.size() - 1;
+      for (I ee = 0; ee < (I) Ei.size(); ee++) {
+        const I e = Ei[ee];
+        if (status[e] != ELEMENT || e == p) continue;
+        if (ext[e] == 0) {
+          status[e] = ABSORBED;
+          continue;
+        }
+        Ei[n_elem++] = e;
+        d += ext[e];
+      }
+      Ei.resize(n_elem);
+      Ei.push_back(p);
+
+      d = std::min(d, deg[i] + (I) Lp.size());
+      d = std::min(d, n_left - 1);
+      deg[i] = d;
+
+      prev[i] = -1;
+      next[i] = head[d];
+      if (next[i] != -1) prev[next[i]] = i;
+      head[d] = i;
+      if (d < min_deg) min_deg = d;
+    }
+  }
+}
+
+/*
+ * Order the nodes of the subgraph sub[] by recursive bisection with
+ * level-structure separators, appending the result to perm.
+ */
+template <class I>
+void cs_graph_dissect(const I Ap[],
+                      const I Aj[],
+                      const I deg[],
+                      const std::vector<I>& sub,
+                      const I min_size,
+                            I mask[],
+                            I& next_tag,
+                            std::vector<bool>& seen,
+                            I perm[],
+                            I& n_perm)
+{
+  std::vector<I> order, level_ptr;
+  const I tag = mask[sub[0]];
+
+  // Split sub into connected components, dissecting each one.
+  for (I ss = 0; ss < (I) sub.size(); ss++) {
+    const I seed = sub[ss];
+    if (mask[seed] != tag) continue;
+
+    cs_graph_pseudo_peripheral(Ap, Aj, deg, seed, mask, tag,
+                               seen, order, level_ptr);
+    const I n_comp = order.size();
+    const I n_levels = level_ptr.size() - 1;
+
+    if (n_comp <= min_size || n_levels < 3) {
+      for (I ii = 0; ii < n_comp; ii++) {
+        mask[order[ii]] = -1;
+        perm[n_perm++] = order[ii];
+      }
+      continue;
+    }
+
+    // Separator: the level that best halves the component.
+    I sep = 1;
+    while (sep < n_levels - 2 && 2 * level_ptr[sep + 1] < n_comp) sep++;
+
+    std::vector<I> part1(order.begin(), order.begin() + level_ptr[sep]);
+    std::vector<I> part2(order.begin() + level_ptr[sep + 1], order.end());
+    std::vector<I> separator(order.begin() + level_ptr[sep],
+                             order.begin() + level_ptr[sep + 1]);
+    order.clear();
+    level_ptr.clear();
+
+    const I tag1 = next_tag++;
+    const I tag2 = next_tag++;
+    for (I ii = 0; ii < (I) part1.size(); ii++) mask[part1[ii]] = tag1;
+    for (I ii = 0; ii < (I) part2.size(); ii++) mask[part2[ii]] = tag2;
+    for (I ii = 0; ii < (I) separator.size(); ii++) mask[separator[ii]] = -1;
+
+    cs_graph_dissect(Ap, Aj, deg, part1, min_size, mask, next_tag,
+                     seen, perm, n_perm);
+    cs_graph_dissect(Ap, Aj, deg, part2, min_size, mask, next_tag,
+                     seen, perm, n_perm);
+    for (I ii = 0; ii < (I) separator.size(); ii++) {
+      perm[n_perm++] = separator[ii];
+    }
+  }
+}
+
+/*
+ * Nested dissection ordering of a compressed sparse graph.
+ *
+ * Input Arguments:
+ *   I  n_nod         - number of nodes
+ *   I  Ap[n_nod+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   I  min_size      - subgraphs this small are not dissected further
+ *
+ * Output Arguments:
+ *   I  perm[n_nod]   - node perm[k] becomes node k
+ *
+ * Note:
+ *   Output array perm must be preallocated
+ *
+ *   The graph must be symmetric; self loops are ignored.  Each
+ *   component is bisected by the middle level of the level structure
+ *   rooted at a pseudo-peripheral node; separators are ordered after
+ *   the two halves they split.
+ */
+template <class I>
+void cs_graph_nested_dissection(const I n_nod,
+                                const I Ap[],
+                                const I Aj[],
+                                const I min_size,
+                                      I perm[])
+{
+  if (n_nod == 0) return;
+
+  std::vector<I> deg(n_nod);
+  for (I i = 0; i < n_nod; i++) deg[i] = Ap[i+1] - Ap[i];
+
+  std::vector<I> mask(n_nod, 0);
+  std::vector<bool> seen(n_nod, false);
+  std::vector<I> sub(n_nod);
+  for (I i = 0; i < n_nod; i++) sub[i] = i;
+
+  I next_tag = 1;
+  I n_perm = 0;
+  cs_graph_dissect(Ap, Aj, &deg[0], sub, std::max(min_size, (I) 1),
+                   &mask[0], next_tag, seen, perm, n_perm);
+}
+
+/*
+ * Compute B = A[perm,:][:,perm] for a square CSR matrix A.
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   I  perm[n_row]   - row/column perm[k] of A becomes row/column k of B
+ *
+ * Output Arguments:
+ *   I  Bp[n_row+1]   - row pointer
+ *   I  Bj[nnz(A)]    - column indices
+ *   I  Bi[nnz(A)]    - position in A of each entry of B
+ *
+ * Note:
+ *   Output arrays Bp, Bj, and Bi must be preallocated
+ *
+ *   Only the sparsity structure is permuted; the values follow with
+ *   Bx = Ax[Bi], which keeps this routine independent of the data type.
+ *   Column indices of B are sorted.
+ *
+ *   Complexity: O(nnz(A) log(max row length))
+ */
+template <class I>
+void csr_permute(const I n_row,
+                 const I Ap[],
+                 const I Aj[],
+                 const I perm[],
+                       I Bp[],
+                       I Bj[],
+                       I Bi[])
+{
+  std::vector<I> iperm(n_row);
+  for (I k = 0; k < n_row; k++) iperm[perm[k]] = k;
+
+  std::vector< std::pair<I,I> > row;
+  Bp[0] = 0;
+  I nnz = 0;
+  for (I k = 0; k < n_row; k++) {
+    const I i = perm[k];
+    row.clear();
+    for (I jj = Ap[i]; jj < Ap[i+1]; jj++) {
+      row.push_back(std::make_pair(iperm[Aj[jj]], jj));
+    }
+    std::sort(row.begin(), row.end());
+    for (I jj = 0; jj < (I) row.size(); jj++) {
+      Bj[nnz] = row[jj].first;
+      Bi[nnz] = row[jj].second;
+      nnz++;
+    }
+    Bp[k+1] = nnz;
+  }
+}
+
 #endif
 #ifndef __CSGRAPH_H__
 #define __CSGRAPH_H__
@@ -10,6 +10,10 @@
 %include "csgraph.h" 
 
 INSTANTIATE_INDEX(cs_graph_components)
+INSTANTIATE_INDEX(cs_graph_rcm)
+INSTANTIATE_INDEX(cs_graph_amd)
+INSTANTIATE_INDEX(cs_graph_nested_dissection)
+INSTANTIATE_INDEX(csr_permute)
 /* -*- C -*- */
 %module csgraph
 
@@ -71,4 +71,20 @@ def cs_graph_components(*args):
   """cs_graph_components(int n_nod, int Ap, int Aj, int flag) -> int"""
   return _csgraph.cs_graph_components(*args)
 
+def cs_graph_rcm(*args):
+  """cs_graph_rcm(int n_nod, int Ap, int Aj, int perm) -> void"""
+  return _csgraph.cs_graph_rcm(*args)
+
+def cs_graph_amd(*args):
+  """cs_graph_amd(int n_nod, int Ap, int Aj, int perm) -> void"""
+  return _csgraph.cs_graph_amd(*args)
+
+def cs_graph_nested_dissection(*args):
+  """cs_graph_nested_dissection(int n_nod, int Ap, int Aj, int min_size, int perm) -> void"""
+  return _csgraph.cs_graph_nested_dissection(*args)
+
+def csr_permute(*args):
+  """csr_permute(int n_row, int Ap, int Aj, int perm, int Bp, int Bj, int Bi) -> void"""
+  return _csgraph.csr_permute(*args)
+
 
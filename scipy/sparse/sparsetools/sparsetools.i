@@ -37,7 +37,8 @@
     const ctype Cp [ ],
     const ctype Ci [ ],	
     const ctype Cj [ ],
-    const ctype offsets [ ]
+    const ctype offsets [ ],
+    const ctype perm [ ]
 };
 %enddef
 
@@ -103,7 +104,8 @@
   ctype Cp [ ],
   ctype Ci [ ],
   ctype Cj [ ],
-  ctype flag [ ]
+  ctype flag [ ],
+  ctype perm [ ]
 };
 %enddef
 
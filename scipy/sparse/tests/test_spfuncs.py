@@ -1,8 +1,12 @@
+import numpy as np
 from numpy import array, kron, matrix, diag
-from numpy.testing import TestCase, run_module_suite, assert_, assert_equal
+from numpy.testing import TestCase, run_module_suite, assert_, assert_equal, \
+        assert_raises
 
 from scipy.sparse import spfuncs
 from scipy.sparse import csr_matrix, csc_matrix, bsr_matrix
+from scipy.sparse import reverse_cuthill_mckee, approximate_minimum_degree, \
+        nested_dissection, symmetric_permute
 from scipy.sparse.sparsetools import csr_scale_rows, csr_scale_columns, \
         bsr_scale_rows, bsr_scale_columns
 
@@ -119,5 +123,52 @@ class TestSparseFunctions(TestCase):
         assert_(n_comp == 2)
         assert_equal(flag, [0, 0, -2, 1])
 
+    def _poisson2d(self, n):
+        from scipy.sparse import kron, eye, spdiags
+        e = np.ones(n)
+        T = spdiags([-e, 2*e, -e], [-1, 0, 1], n, n)
+        return (kron(T, eye(n, n)) + kron(eye(n, n), T)).tocsr()
+
+    def _check_permutation(self, perm, n):
+        assert_equal(np.sort(perm), np.arange(n))
+
+    def test_reverse_cuthill_mckee(self):
+        A = self._poisson2d(10)
+        # scramble the natural ordering
+        p = np.random.RandomState(1234).permutation(A.shape[0])
+        A = symmetric_permute(A, p)
+
+        perm = reverse_cuthill_mckee(A)
+        self._check_permutation(perm, A.shape[0])
+
+        B = symmetric_permute(A, perm).tocoo()
+        assert_(abs(B.row - B.col).max() < 20)
+
+    def test_fill_reducing_orderings(self):
+        A = self._poisson2d(8)
+        for order in [approximate_minimum_degree(A),
+                      nested_dissection(A, min_size=4)]:
+            self._check_permutation(order, A.shape[0])
+
+        # disconnected graph with an empty row
+        D = np.eye(5)
+        D[0,3] = D[3,0] = 1
+        D[2,2] = 0
+        for order in [approximate_minimum_degree(D), nested_dissection(D)]:
+            self._check_permutation(order, 5)
+
+    def test_symmetric_permute(self):
+        D = matrix([[1,0,0,2],[3,0,1,0],[0,2,0,4],[5,0,6,7]])
+        perm = array([2,0,3,1])
+        expected = D[perm,:][:,perm]
+        for fmt in [csr_matrix, csc_matrix, bsr_matrix]:
+            B = symmetric_permute(fmt(D), perm)
+            assert_equal(B.todense(), expected)
+            assert_(B.has_sorted_indices)
+
+        S = csr_matrix(D)
+        assert_raises(ValueError, symmetric_permute, S, [0,1,1,2])
+        assert_raises(ValueError, symmetric_permute, S, [0,1,2])
+
 if __name__ == "__main__":
     run_module_suite()